@@ -3,6 +3,7 @@
  * Copyright (C) 2013-2014 Synopsys, Inc. All rights reserved.
  */
 
+#include <blk.h>
 #include <command.h>
 #include <common.h>
 #include <cpu_func.h>
@@ -17,6 +18,7 @@ int do_reset(cmd_tbl_t *cmdtp, int flag, int argc, char *const argv[])
 {
 	printf("Resetting the board...\n");
 
+	blk_flush_all();
 	reset_cpu(0);
 
 	return 0;
@@ -21,6 +21,7 @@
  */
 
 #include <common.h>
+#include <blk.h>
 #include <cpu_func.h>
 #include <irq_func.h>
 
@@ -32,6 +33,7 @@ int do_reset(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[])
 {
 	puts ("resetting ...\n");
 
+	blk_flush_all();
 	udelay (50000);				/* wait 50 ms */
 
 	disable_interrupts();
@@ -9,6 +9,7 @@
  */
 
 #include <common.h>
+#include <blk.h>
 #include <vsprintf.h>
 #include <watchdog.h>
 #include <command.h>
@@ -23,6 +24,7 @@ int do_reset(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[])
 {
 	ccm_t *ccm = (ccm_t *) MMAP_CCM;
 
+	blk_flush_all();
 	out_8(&ccm->rcr, CCM_RCR_SOFTRST);
 	/* we don't return! */
 	return 0;
@@ -14,6 +14,7 @@
  */
 
 #include <common.h>
+#include <blk.h>
 #include <vsprintf.h>
 #include <watchdog.h>
 #include <command.h>
@@ -29,6 +30,7 @@ int do_reset(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[])
 {
 	rcm_t *rcm = (rcm_t *)(MMAP_RCM);
 
+	blk_flush_all();
 	udelay(1000);
 
 	out_8(&rcm->rcr, RCM_RCR_SOFTRST);
@@ -140,6 +142,8 @@ int print_cpuinfo(void)
 
 int do_reset(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[])
 {
+	blk_flush_all();
+
 	/* Call the board specific reset actions first. */
 	if(board_reset) {
 		board_reset();
@@ -177,6 +181,7 @@ int do_reset(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[])
 {
 	wdog_t *wdp = (wdog_t *) (MMAP_WDOG);
 
+	blk_flush_all();
 	out_be16(&wdp->wdog_wrrr, 0);
 	udelay(1000);
 
@@ -266,6 +271,7 @@ int do_reset(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[])
 {
 	rcm_t *rcm = (rcm_t *)(MMAP_RCM);
 
+	blk_flush_all();
 	udelay(1000);
 
 	out_8(&rcm->rcr, RCM_RCR_SOFTRST);
@@ -354,6 +360,7 @@ int print_cpuinfo(void)
 
 int do_reset(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[])
 {
+	blk_flush_all();
 	MCFRESET_RCR = MCFRESET_RCR_SOFTRST;
 	return 0;
 };
@@ -373,6 +380,8 @@ int print_cpuinfo(void)
 
 int do_reset(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[])
 {
+	blk_flush_all();
+
 	/* enable watchdog, set timeout to 0 and wait */
 	mbar_writeByte(MCFSIM_SYPCR, 0xc0);
 	while (1) ;
@@ -405,6 +414,8 @@ int print_cpuinfo(void)
 
 int do_reset(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[])
 {
+	blk_flush_all();
+
 	/* enable watchdog, set timeout to 0 and wait */
 	mbar_writeByte(SIM_SYPCR, 0xc0);
 	while (1) ;
@@ -5,6 +5,7 @@
  */
 
 #include <common.h>
+#include <blk.h>
 #include <vsprintf.h>
 #include <asm/immap.h>
 #include <asm/io.h>
@@ -14,6 +15,8 @@ int do_reset(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[])
 {
 	sim_t *sim = (sim_t *)(MMAP_SIM);
 
+	blk_flush_all();
+
 	/* enable watchdog/reset, set timeout to 0 and wait */
 	out_8(&sim->sypcr, SYPCR_SWE | SYPCR_SWRI);
 
@@ -9,6 +9,7 @@
  */
 
 #include <common.h>
+#include <blk.h>
 #include <vsprintf.h>
 #include <watchdog.h>
 #include <command.h>
@@ -23,6 +24,7 @@ int do_reset(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[])
 {
 	rcm_t *rcm = (rcm_t *) (MMAP_RCM);
 
+	blk_flush_all();
 	udelay(1000);
 	setbits_8(&rcm->rcr, RCM_RCR_SOFTRST);
 
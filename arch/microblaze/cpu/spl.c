@@ -6,6 +6,7 @@
  */
 
 #include <common.h>
+#include <blk.h>
 #include <image.h>
 #include <spl.h>
 #include <asm/io.h>
@@ -50,6 +51,7 @@ int spl_start_uboot(void)
 
 int do_reset(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[])
 {
+	blk_flush_all();
 	__asm__ __volatile__ ("mts rmsr, r0;" \
 			      "bra r0");
 
@@ -5,6 +5,7 @@
  */
 
 #include <common.h>
+#include <blk.h>
 #include <command.h>
 #include <linux/compiler.h>
 #include <asm/cache.h>
@@ -22,6 +23,7 @@ void __weak _machine_restart(void)
 
 int do_reset(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[])
 {
+	blk_flush_all();
 	_machine_restart();
 
 	return 0;
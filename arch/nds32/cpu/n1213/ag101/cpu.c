@@ -14,6 +14,7 @@
 
 /* CPU specific code */
 #include <common.h>
+#include <blk.h>
 #include <command.h>
 #include <cpu_func.h>
 #include <irq_func.h>
@@ -41,6 +42,7 @@ int cleanup_before_linux(void)
 
 int do_reset(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[])
 {
+	blk_flush_all();
 	disable_interrupts();
 
 	/*
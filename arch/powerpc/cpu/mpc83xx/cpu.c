@@ -10,6 +10,7 @@
  */
 
 #include <common.h>
+#include <blk.h>
 #include <cpu_func.h>
 #include <irq_func.h>
 #include <time.h>
@@ -133,6 +134,7 @@ do_reset (cmd_tbl_t * cmdtp, int flag, int argc, char * const argv[])
 	volatile immap_t *immap = (immap_t *) CONFIG_SYS_IMMR;
 
 	puts("Resetting the board.\n");
+	blk_flush_all();
 
 #ifdef MPC83xx_RESET
 
@@ -10,6 +10,7 @@
 
 #include <config.h>
 #include <common.h>
+#include <blk.h>
 #include <cpu_func.h>
 #include <irq_func.h>
 #include <time.h>
@@ -301,6 +302,8 @@ int do_reset (cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[])
 	defined(CONFIG_ARCH_MPC8555) || defined(CONFIG_ARCH_MPC8560)
 	unsigned long val, msr;
 
+	blk_flush_all();
+
 	/*
 	 * Initiate hard reset in debug control register DBCR0
 	 * Make sure MSR[DE] = 1.  This only resets the core.
@@ -315,6 +318,8 @@ int do_reset (cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[])
 #else
 	volatile ccsr_gur_t *gur = (void *)(CONFIG_SYS_MPC85xx_GUTS_ADDR);
 
+	blk_flush_all();
+
 	/* Attempt board-specific reset */
 	board_reset();
 
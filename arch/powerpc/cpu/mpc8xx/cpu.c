@@ -17,6 +17,7 @@
  */
 
 #include <common.h>
+#include <blk.h>
 #include <cpu_func.h>
 #include <time.h>
 #include <vsprintf.h>
@@ -200,6 +201,8 @@ int do_reset(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[])
 
 	immap_t __iomem *immap = (immap_t __iomem *)CONFIG_SYS_IMMR;
 
+	blk_flush_all();
+
 	/* Checkstop Reset enable */
 	setbits_be32(&immap->im_clkrst.car_plprcr, PLPRCR_CSR);
 
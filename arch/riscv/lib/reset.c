@@ -4,6 +4,7 @@
  */
 
 #include <common.h>
+#include <blk.h>
 #include <command.h>
 #include <hang.h>
 
@@ -11,6 +12,7 @@ int do_reset(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[])
 {
 	printf("resetting ...\n");
 
+	blk_flush_all();
 	printf("reset not supported yet\n");
 	hang();
 
@@ -108,6 +108,43 @@ long sandbox_i2c_rtc_get_set_base_time(struct udevice *dev, long base_time);
 
 int sandbox_usb_keyb_add_string(struct udevice *dev, const char *str);
 
+/**
+ * sandbox_usb_set_queue() - select how the sandbox USB controller runs bulk
+ *
+ * This also resets the count returned by sandbox_usb_max_queued().
+ *
+ * @bus:	USB controller
+ * @enable:	true to queue bulk requests until they are reaped, false to
+ *		run each one synchronously
+ */
+void sandbox_usb_set_queue(struct udevice *bus, bool enable);
+
+/**
+ * sandbox_usb_max_queued() - get the bulk request high-water mark
+ *
+ * @bus:	USB controller
+ * @return largest number of bulk requests that were queued at once
+ */
+int sandbox_usb_max_queued(struct udevice *bus);
+
+/**
+ * sandbox_usb_uas_max_queued() - get the UAS queue high-water mark
+ *
+ * @dev:	UAS emulator device
+ * @return largest number of commands that were queued on the device at once
+ */
+int sandbox_usb_uas_max_queued(struct udevice *dev);
+
+/**
+ * sandbox_usb_uas_short_data() - cut the next read/write data phase short
+ *
+ * The next read or write command moves one block less than it asked for,
+ * but still reports a good status.
+ *
+ * @dev:	UAS emulator device
+ */
+void sandbox_usb_uas_short_data(struct udevice *dev);
+
 /**
  * sandbox_osd_get_mem() - get the internal memory of a sandbox OSD
  *
@@ -139,6 +176,26 @@ int sandbox_pwm_get_config(struct udevice *dev, uint channel, uint *period_nsp,
  */
 void sandbox_sf_set_block_protect(struct udevice *dev, int bp_mask);
 
+/**
+ * sandbox_spi_get_dirmap_reads() - Get the number of direct-mapped reads
+ *
+ * @bus: Sandbox SPI bus to check
+ * @return number of reads served through a spi-mem direct mapping
+ */
+uint sandbox_spi_get_dirmap_reads(struct udevice *bus);
+
+/**
+ * sandbox_mmc_get_counts() - Get statistics about block transfers
+ *
+ * @dev: Sandbox MMC device to check
+ * @sbc_countp: Returns the number of transfers announced with SET_BLOCK_COUNT
+ * @stop_countp: Returns the number of STOP_TRANSMISSION commands received
+ * @max_tasksp: Returns the largest number of tasks in one command-queue
+ *	request
+ */
+void sandbox_mmc_get_counts(struct udevice *dev, uint *sbc_countp,
+			    uint *stop_countp, uint *max_tasksp);
+
 /**
  * sandbox_get_codec_params() - Read back codec parameters
  *
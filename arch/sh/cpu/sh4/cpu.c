@@ -5,6 +5,7 @@
  */
 
 #include <common.h>
+#include <blk.h>
 #include <command.h>
 #include <irq_func.h>
 #include <cpu_func.h>
@@ -30,6 +31,7 @@ int cleanup_before_linux (void)
 
 int do_reset (cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[])
 {
+	blk_flush_all();
 	disable_interrupts();
 	reset_cpu(0);
 	return 0;
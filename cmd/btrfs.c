@@ -25,3 +25,19 @@ U_BOOT_CMD(btrsubvol, 3, 1, do_btrsubvol,
 	"<interface> <dev[:part]>\n"
 	"     - List subvolumes of a BTRFS filesystem."
 )
+
+static int do_btrcache(cmd_tbl_t *cmdtp, int flag, int argc, char *const argv[])
+{
+	if (argc != 1)
+		return CMD_RET_USAGE;
+
+	btrfs_show_cache_stats();
+	return 0;
+}
+
+U_BOOT_CMD(btrcache, 1, 1, do_btrcache,
+	"show BTRFS cache statistics",
+	"\n"
+	"     - Show the hits and misses of the BTRFS tree node and extent\n"
+	"       caches during the last access to a BTRFS filesystem."
+)
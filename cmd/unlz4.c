@@ -8,11 +8,13 @@
 #include <command.h>
 #include <env.h>
 #include <lz4.h>
+#include <mapmem.h>
 
 static int do_unlz4(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[])
 {
 	unsigned long src, dst;
 	size_t src_len = ~0UL, dst_len = ~0UL;
+	void *src_buf, *dst_buf;
 	int ret;
 
 	switch (argc) {
@@ -25,7 +27,12 @@ static int do_unlz4(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[])
 		return CMD_RET_USAGE;
 	}
 
-	ret = ulz4fn((void *)src, src_len, (void *)dst, &dst_len);
+	/* The frame is self-terminating, so the source size is not needed */
+	src_buf = map_sysmem(src, 0);
+	dst_buf = map_sysmem(dst, dst_len);
+	ret = ulz4fn(src_buf, src_len, dst_buf, &dst_len);
+	unmap_sysmem(dst_buf);
+	unmap_sysmem(src_buf);
 	if (ret) {
 		printf("Uncompressed err :%d\n", ret);
 		return 1;
@@ -8,6 +8,7 @@
 
 #include <errno.h>
 #include <common.h>
+#include <blk.h>
 #include <command.h>
 #include <console.h>
 #include <g_dnl.h>
@@ -42,8 +43,13 @@ static void ums_fini(void)
 {
 	int i;
 
-	for (i = 0; i < ums_count; i++)
+	for (i = 0; i < ums_count; i++) {
+		/* The host has detached, write back what it left cached */
+		if (blk_flush(&ums[i].block_dev))
+			printf("%s: failed to write cached blocks\n",
+			       ums[i].name);
 		free((void *)ums[i].name);
+	}
 	free(ums);
 	ums = NULL;
 	ums_count = 0;
@@ -9,6 +9,7 @@
  */
 
 #include <common.h>
+#include <blk.h>
 #include <command.h>
 #include <console.h>
 #include <env.h>
@@ -629,6 +630,12 @@ enum command_ret_t cmd_process(int flag, int argc, char * const argv[],
 		if (ticks)
 			*ticks = get_timer(0);
 		rc = cmd_call(cmdtp, flag, argc, argv, &newrep);
+		/*
+		 * Commands which wrote to a block device are done with it. The
+		 * blocks which could not be written are lost, so fail.
+		 */
+		if (blk_flush_all() && !rc)
+			rc = CMD_RET_FAILURE;
 		if (ticks)
 			*ticks = get_timer(*ticks);
 		*repeatable &= newrep;
@@ -7,12 +7,17 @@
 #include <common.h>
 #include <errno.h>
 #include <board.h>
+#include <bootstage.h>
 #include <fpga.h>
 #include <gzip.h>
 #include <image.h>
+#include <lz4.h>
 #include <malloc.h>
+#include <memalign.h>
 #include <spl.h>
+#include <zstd.h>
 #include <linux/libfdt.h>
+#include <linux/sizes.h>
 
 DECLARE_GLOBAL_DATA_PTR;
 
@@ -217,6 +222,128 @@ static int get_aligned_image_size(struct spl_load_info *info, int data_size,
 	return (data_size + info->bl_len - 1) / info->bl_len;
 }
 
+/* Check whether any compressed images can be loaded */
+static inline bool spl_fit_decomp_enabled(void)
+{
+	return IS_ENABLED(CONFIG_SPL_GZIP) || IS_ENABLED(CONFIG_SPL_LZ4) ||
+		IS_ENABLED(CONFIG_SPL_ZSTD);
+}
+
+/* Check whether images compressed with @comp are decompressed on loading */
+static bool spl_fit_can_decomp(int comp)
+{
+	return (IS_ENABLED(CONFIG_SPL_GZIP) && comp == IH_COMP_GZIP) ||
+		(IS_ENABLED(CONFIG_SPL_LZ4) && comp == IH_COMP_LZ4) ||
+		(IS_ENABLED(CONFIG_SPL_ZSTD) && comp == IH_COMP_ZSTD);
+}
+
+/**
+ * spl_fit_decomp() - decompress an image
+ *
+ * The time taken is recorded by bootstage under the name of the compression
+ * type, so that compressors can be compared.
+ *
+ * @comp:	compression type (IH_COMP_...), see spl_fit_can_decomp()
+ * @dst:	destination buffer
+ * @dstn:	size of the destination buffer
+ * @src:	compressed data
+ * @lenp:	size of the compressed data, updated to the size of the
+ *		decompressed data on success
+ * Return:	0 on success or a negative error number
+ */
+static int spl_fit_decomp(int comp, void *dst, size_t dstn, const void *src,
+			  size_t *lenp)
+{
+	ulong size = *lenp;
+	int ret = -EPROTONOSUPPORT;
+
+	/* Each compressor is timed separately so that they can be compared */
+	if (IS_ENABLED(CONFIG_SPL_GZIP) && comp == IH_COMP_GZIP) {
+		bootstage_start(BOOTSTAGE_ID_ACCUM_DECOMP_GZIP, "decomp_gzip");
+		ret = gunzip(dst, dstn, (uchar *)src, &size);
+		bootstage_accum(BOOTSTAGE_ID_ACCUM_DECOMP_GZIP);
+		*lenp = size;
+	} else if (IS_ENABLED(CONFIG_SPL_LZ4) && comp == IH_COMP_LZ4) {
+		bootstage_start(BOOTSTAGE_ID_ACCUM_DECOMP_LZ4, "decomp_lz4");
+		ret = ulz4fn(src, *lenp, dst, &dstn);
+		bootstage_accum(BOOTSTAGE_ID_ACCUM_DECOMP_LZ4);
+		*lenp = dstn;
+	} else if (IS_ENABLED(CONFIG_SPL_ZSTD) && comp == IH_COMP_ZSTD) {
+		bootstage_start(BOOTSTAGE_ID_ACCUM_DECOMP_ZSTD, "decomp_zstd");
+		ret = zstd_decompress(src, *lenp, dst, &dstn);
+		bootstage_accum(BOOTSTAGE_ID_ACCUM_DECOMP_ZSTD);
+		*lenp = dstn;
+	}
+
+	return ret;
+}
+
+/* Compressed data read at a time when streaming an LZ4 image */
+#define SPL_FIT_LZ4_CHUNK	SZ_64K
+
+/**
+ * spl_fit_stream_lz4() - read and decompress an LZ4 image piece by piece
+ *
+ * The compressed data is decompressed as it is read into a small buffer, so
+ * it does not need room in the load area and is only touched once.
+ *
+ * @info:	points to information about the device to load data from
+ * @sector:	the start sector of the FIT image on the device
+ * @offset:	offset of the image data from the start of the FIT
+ * @length:	size of the compressed data
+ * @dst:	destination buffer, of CONFIG_SYS_BOOTM_LEN bytes
+ * @lenp:	returns the size of the decompressed data
+ * Return:	0 on success, -ENOMEM if there is not enough memory to stream
+ *		the image, other negative error number on failure
+ */
+static int spl_fit_stream_lz4(struct spl_load_info *info, ulong sector,
+			      int offset, size_t length, void *dst,
+			      size_t *lenp)
+{
+	int unit = info->filename ? 1 : info->bl_len;
+	ulong pos = sector + get_aligned_image_offset(info, offset);
+	ulong left = get_aligned_image_size(info, length, offset);
+	ulong chunk = SPL_FIT_LZ4_CHUNK / unit;
+	size_t skip = get_aligned_image_overhead(info, offset);
+	struct lz4_stream s;
+	size_t len;
+	void *buf;
+	ulong n;
+	int ret = 0, err;
+
+	buf = malloc_cache_aligned(chunk * unit);
+	if (!buf)
+		return -ENOMEM;
+
+	ulz4_stream_init(&s, dst, CONFIG_SYS_BOOTM_LEN);
+	while (left && !ret) {
+		n = min(chunk, left);
+		bootstage_start(BOOTSTAGE_ID_ACCUM_SPL_FIT_READ, "fit_read");
+		if (info->read(info, pos, n, buf) != n)
+			ret = -EIO;
+		bootstage_accum(BOOTSTAGE_ID_ACCUM_SPL_FIT_READ);
+		if (ret)
+			break;
+		pos += n;
+		left -= n;
+
+		len = min(n * unit - skip, length);
+		bootstage_start(BOOTSTAGE_ID_ACCUM_DECOMP_LZ4, "decomp_lz4");
+		ret = ulz4_stream_decompress(&s, buf + skip, &len);
+		bootstage_accum(BOOTSTAGE_ID_ACCUM_DECOMP_LZ4);
+		length -= len;
+		skip = 0;
+	}
+	err = ulz4_stream_finish(&s, &len);
+	free(buf);
+	if (ret < 0)
+		return ret;
+	if (!err)
+		*lenp = len;
+
+	return err;
+}
+
 /**
  * spl_load_fit_image(): load the image described in a certain FIT node
  * @info:	points to information about the device to load data from
@@ -241,7 +368,6 @@ static int spl_load_fit_image(struct spl_load_info *info, ulong sector,
 	int offset;
 	size_t length;
 	int len;
-	ulong size;
 	ulong load_addr, load_ptr;
 	void *src;
 	ulong overhead;
@@ -250,6 +376,8 @@ static int spl_load_fit_image(struct spl_load_info *info, ulong sector,
 	uint8_t image_comp = -1, type = -1;
 	const void *data;
 	bool external_data = false;
+	size_t dstn = CONFIG_SYS_BOOTM_LEN;
+	int ret;
 
 	if (IS_ENABLED(CONFIG_SPL_FPGA_SUPPORT) ||
 	    (IS_ENABLED(CONFIG_SPL_OS_BOOT) && IS_ENABLED(CONFIG_SPL_GZIP))) {
@@ -259,7 +387,7 @@ static int spl_load_fit_image(struct spl_load_info *info, ulong sector,
 			debug("%s ", genimg_get_type_name(type));
 	}
 
-	if (IS_ENABLED(CONFIG_SPL_GZIP)) {
+	if (spl_fit_decomp_enabled()) {
 		fit_image_get_comp(fit, node, &image_comp);
 		debug("%s ", genimg_get_comp_name(image_comp));
 	}
@@ -279,15 +407,50 @@ static int spl_load_fit_image(struct spl_load_info *info, ulong sector,
 		if (fit_image_get_data_size(fit, node, &len))
 			return -ENOENT;
 
-		load_ptr = (load_addr + align_len) & ~align_len;
 		length = len;
 
+		/*
+		 * Without a signature to check first, LZ4 images can be
+		 * decompressed while they are read
+		 */
+		if (IS_ENABLED(CONFIG_SPL_LZ4) && image_comp == IH_COMP_LZ4 &&
+		    !IS_ENABLED(CONFIG_SPL_FIT_SIGNATURE) &&
+		    !IS_ENABLED(CONFIG_SPL_FIT_IMAGE_POST_PROCESS)) {
+			ret = spl_fit_stream_lz4(info, sector, offset, length,
+						 (void *)load_addr, &length);
+			if (!ret)
+				goto done;
+			if (ret != -ENOMEM) {
+				puts("Uncompressing error\n");
+				return -EIO;
+			}
+			/* No memory to stream it, read it all and decompress */
+		}
+
 		overhead = get_aligned_image_overhead(info, offset);
 		nr_sectors = get_aligned_image_size(info, length, offset);
 
-		if (info->read(info,
-			       sector + get_aligned_image_offset(info, offset),
-			       nr_sectors, (void *)load_ptr) != nr_sectors)
+		if (!IS_ENABLED(CONFIG_SPL_LOAD_FIT_IN_PLACE)) {
+			load_ptr = (load_addr + align_len) & ~align_len;
+		} else if (spl_fit_can_decomp(image_comp)) {
+			/* Decompress from the end of the output buffer */
+			load_ptr = load_addr + CONFIG_SYS_BOOTM_LEN -
+				nr_sectors * info->bl_len;
+			load_ptr &= ~align_len;
+			dstn = load_ptr + overhead - load_addr;
+		} else if (!((load_addr - overhead) & align_len)) {
+			/* Place the data right at its load address */
+			load_ptr = load_addr - overhead;
+		} else {
+			load_ptr = (load_addr + align_len) & ~align_len;
+		}
+
+		bootstage_start(BOOTSTAGE_ID_ACCUM_SPL_FIT_READ, "fit_read");
+		ret = info->read(info, sector +
+				 get_aligned_image_offset(info, offset),
+				 nr_sectors, (void *)load_ptr);
+		bootstage_accum(BOOTSTAGE_ID_ACCUM_SPL_FIT_READ);
+		if (ret != nr_sectors)
 			return -EIO;
 
 		debug("External data: dst=%lx, offset=%x, size=%lx\n",
@@ -317,18 +480,17 @@ static int spl_load_fit_image(struct spl_load_info *info, ulong sector,
 	board_fit_image_post_process(&src, &length);
 #endif
 
-	if (IS_ENABLED(CONFIG_SPL_GZIP) && image_comp == IH_COMP_GZIP) {
-		size = length;
-		if (gunzip((void *)load_addr, CONFIG_SYS_BOOTM_LEN,
-			   src, &size)) {
+	if (spl_fit_can_decomp(image_comp)) {
+		if (spl_fit_decomp(image_comp, (void *)load_addr, dstn, src,
+				   &length)) {
 			puts("Uncompressing error\n");
 			return -EIO;
 		}
-		length = size;
-	} else {
+	} else if (src != (void *)load_addr) {
 		memcpy((void *)load_addr, src, length);
 	}
 
+done:
 	if (image_info) {
 		image_info->load_addr = load_addr;
 		image_info->size = length;
@@ -292,6 +292,72 @@ int usb_bulk_msg(struct usb_device *dev, unsigned int pipe,
 }
 
 
+/*-------------------------------------------------------------------
+ * asynchronous bulk transfers. Controllers which cannot queue bulk
+ * transfers fall back to a synchronous transfer when the request is reaped.
+ */
+int usb_bulk_submit(struct usb_device *dev, struct usb_bulk_req *req)
+{
+	int ret;
+
+	if (req->length < 0)
+		return -EINVAL;
+	req->act_len = 0;
+	req->status = USB_ST_NOT_PROC;
+	req->done = false;
+	req->hc_priv = NULL;
+#if CONFIG_IS_ENABLED(DM_USB)
+	ret = submit_bulk_req(dev, req);
+	if (ret != -ENOSYS)
+		return ret;
+#endif
+	/* Mark the request as not queued; usb_bulk_reap() will send it */
+	req->hc_count = -1;
+
+	return 0;
+}
+
+int usb_bulk_reap(struct usb_device *dev, struct usb_bulk_req *req,
+		  int timeout)
+{
+	int ret;
+
+	if (!req->done && req->hc_count == -1) {
+		ret = usb_bulk_msg(dev, req->pipe, req->buffer, req->length,
+				   &req->act_len, timeout);
+		req->status = ret ? dev->status : 0;
+		if (ret && !req->status)
+			req->status = USB_ST_NAK_REC;
+		req->done = true;
+	}
+#if CONFIG_IS_ENABLED(DM_USB)
+	if (!req->done) {
+		ret = reap_bulk_req(dev, req, timeout);
+		if (ret)
+			return ret;
+	}
+#endif
+	if (!req->done)
+		return -ETIMEDOUT;
+
+	return req->status ? -EIO : 0;
+}
+
+int usb_bulk_cancel(struct usb_device *dev, struct usb_bulk_req *req)
+{
+	if (req->done)
+		return 0;
+	if (req->hc_count == -1) {
+		req->done = true;
+		return 0;
+	}
+#if CONFIG_IS_ENABLED(DM_USB)
+	return cancel_bulk_req(dev, req);
+#else
+	return -ENOSYS;
+#endif
+}
+
 /*-------------------------------------------------------------------
  * Max Packet stuff
  */
@@ -45,6 +45,7 @@
 
 #include <part.h>
 #include <usb.h>
+#include <usb/uas.h>
 
 #undef BBB_COMDAT_TRACE
 #undef BBB_XPORT_TRACE
@@ -203,6 +204,16 @@ static int usb_stor_probe_device(struct usb_device *udev)
 	 * is shared by all LUNs (block devices) attached to this mass storage
 	 * device.
 	 */
+	if (CONFIG_IS_ENABLED(USB_UAS)) {
+		ret = usb_uas_probe_device(udev, usb_max_devs);
+		if (!ret) {
+			usb_max_devs++;
+			return 0;
+		}
+		if (ret != -ENODEV)
+			return ret;
+	}
+
 	data = dev_get_platdata(udev->dev);
 	if (!usb_storage_probe(udev, 0, data))
 		return 0;
@@ -525,15 +536,15 @@ static int usb_stor_CB_reset(struct us_data *us)
 
 /*
  * Set up the command for a BBB device. Note that the actual SCSI
- * command is copied into cbw.CBWCDB.
+ * command is copied into cbw.CBWCDB. The CBW is queued in @req and must be
+ * reaped by the caller.
  */
-static int usb_stor_BBB_comdat(struct scsi_cmd *srb, struct us_data *us)
+static int usb_stor_BBB_comdat(struct scsi_cmd *srb, struct us_data *us,
+			       struct umass_bbb_cbw *cbw,
+			       struct usb_bulk_req *req)
 {
 	int result;
-	int actlen;
 	int dir_in;
-	unsigned int pipe;
-	ALLOC_CACHE_ALIGN_BUFFER(struct umass_bbb_cbw, cbw, 1);
 
 	dir_in = US_DIRECTION(srb->cmd[0]);
 
@@ -553,9 +564,6 @@ static int usb_stor_BBB_comdat(struct scsi_cmd *srb, struct us_data *us)
 		return -1;
 	}
 
-	/* always OUT to the ep */
-	pipe = usb_sndbulkpipe(us->pusb_dev, us->ep_out);
-
 	cbw->dCBWSignature = cpu_to_le32(CBWSIGNATURE);
 	cbw->dCBWTag = cpu_to_le32(CBWTag++);
 	cbw->dCBWDataTransferLength = cpu_to_le32(srb->datalen);
@@ -566,10 +574,14 @@ static int usb_stor_BBB_comdat(struct scsi_cmd *srb, struct us_data *us)
 	/* DST SRC LEN!!! */
 
 	memcpy(cbw->CBWCDB, srb->cmd, srb->cmdlen);
-	result = usb_bulk_msg(us->pusb_dev, pipe, cbw, UMASS_BBB_CBW_SIZE,
-			      &actlen, USB_CNTL_TIMEOUT * 5);
+
+	/* always OUT to the ep */
+	req->pipe = usb_sndbulkpipe(us->pusb_dev, us->ep_out);
+	req->buffer = cbw;
+	req->length = UMASS_BBB_CBW_SIZE;
+	result = usb_bulk_submit(us->pusb_dev, req);
 	if (result < 0)
-		debug("usb_stor_BBB_comdat:usb_bulk_msg error\n");
+		debug("usb_stor_BBB_comdat:usb_bulk_submit error\n");
 	return result;
 }
 
@@ -700,12 +712,38 @@ static int usb_stor_BBB_clear_endpt_stall(struct us_data *us, __u8 endpt)
 			       endpt, NULL, 0, USB_CNTL_TIMEOUT * 5);
 }
 
+/* Queue a bulk request for one phase of a BBB transfer */
+static int usb_stor_BBB_submit(struct us_data *us, struct usb_bulk_req *req,
+			       unsigned int pipe, void *buffer, int length)
+{
+	req->pipe = pipe;
+	req->buffer = buffer;
+	req->length = length;
+
+	return usb_bulk_submit(us->pusb_dev, req);
+}
+
+/* Wait for a queued phase of a BBB transfer, which must not be left queued */
+static int usb_stor_BBB_reap(struct us_data *us, struct usb_bulk_req *req)
+{
+	int result;
+
+	result = usb_bulk_reap(us->pusb_dev, req, USB_CNTL_TIMEOUT * 5);
+	if (result == -ETIMEDOUT)
+		usb_bulk_cancel(us->pusb_dev, req);
+
+	return result;
+}
+
 static int usb_stor_BBB_transport(struct scsi_cmd *srb, struct us_data *us)
 {
 	int result, retry;
 	int dir_in;
-	int actlen, data_actlen;
+	int data_actlen;
 	unsigned int pipe, pipein, pipeout;
+	struct usb_bulk_req cbw_req, data_req, csw_req;
+	bool data_queued = false, csw_queued = false;
+	ALLOC_CACHE_ALIGN_BUFFER(struct umass_bbb_cbw, cbw, 1);
 	ALLOC_CACHE_ALIGN_BUFFER(struct umass_bbb_csw, csw, 1);
 #ifdef BBB_XPORT_TRACE
 	unsigned char *ptr;
@@ -713,35 +751,66 @@ static int usb_stor_BBB_transport(struct scsi_cmd *srb, struct us_data *us)
 #endif
 
 	dir_in = US_DIRECTION(srb->cmd[0]);
+	pipein = usb_rcvbulkpipe(us->pusb_dev, us->ep_in);
+	pipeout = usb_sndbulkpipe(us->pusb_dev, us->ep_out);
+	if (dir_in)
+		pipe = pipein;
+	else
+		pipe = pipeout;
 
 	/* COMMAND phase */
 	debug("COMMAND phase\n");
-	result = usb_stor_BBB_comdat(srb, us);
+	result = usb_stor_BBB_comdat(srb, us, cbw, &cbw_req);
+
+	/*
+	 * Once the device is ready, queue the DATA and STATUS phases right
+	 * behind the command so that the controller can run through all
+	 * three without waiting for us in between.
+	 */
+	if (result >= 0 && (us->flags & USB_READY)) {
+		if (srb->datalen)
+			data_queued = !usb_stor_BBB_submit(us, &data_req, pipe,
+							   srb->pdata,
+							   srb->datalen);
+		if (data_queued || !srb->datalen)
+			csw_queued = !usb_stor_BBB_submit(us, &csw_req, pipein,
+							  csw,
+							  UMASS_BBB_CSW_SIZE);
+	}
+	if (result >= 0)
+		result = usb_stor_BBB_reap(us, &cbw_req);
 	if (result < 0) {
-		debug("failed to send CBW status %ld\n",
-		      us->pusb_dev->status);
+		debug("failed to send CBW status %ld\n", cbw_req.status);
+		if (data_queued)
+			usb_bulk_cancel(us->pusb_dev, &data_req);
+		if (csw_queued)
+			usb_bulk_cancel(us->pusb_dev, &csw_req);
 		usb_stor_BBB_reset(us);
 		return USB_STOR_TRANSPORT_FAILED;
 	}
 	if (!(us->flags & USB_READY))
 		mdelay(5);
-	pipein = usb_rcvbulkpipe(us->pusb_dev, us->ep_in);
-	pipeout = usb_sndbulkpipe(us->pusb_dev, us->ep_out);
 	/* DATA phase + error handling */
 	data_actlen = 0;
 	/* no data, go immediately to the STATUS phase */
 	if (srb->datalen == 0)
 		goto st;
 	debug("DATA phase\n");
-	if (dir_in)
-		pipe = pipein;
-	else
-		pipe = pipeout;
 
-	result = usb_bulk_msg(us->pusb_dev, pipe, srb->pdata, srb->datalen,
-			      &data_actlen, USB_CNTL_TIMEOUT * 5);
+	result = 0;
+	if (!data_queued)
+		result = usb_stor_BBB_submit(us, &data_req, pipe, srb->pdata,
+					     srb->datalen);
+	if (result >= 0)
+		result = usb_stor_BBB_reap(us, &data_req);
+	data_actlen = data_req.act_len;
+	if (result < 0 && csw_queued) {
+		/* the STATUS phase is retried by hand below */
+		usb_bulk_cancel(us->pusb_dev, &csw_req);
+		csw_queued = false;
+	}
 	/* special handling of STALL in DATA phase */
-	if ((result < 0) && (us->pusb_dev->status & USB_ST_STALLED)) {
+	if ((result < 0) && (data_req.status & USB_ST_STALLED)) {
 		debug("DATA:stall\n");
 		/* clear the STALL on the endpoint */
 		result = usb_stor_BBB_clear_endpt_stall(us,
@@ -751,8 +820,7 @@ static int usb_stor_BBB_transport(struct scsi_cmd *srb, struct us_data *us)
 			goto st;
 	}
 	if (result < 0) {
-		debug("usb_bulk_msg error status %ld\n",
-		      us->pusb_dev->status);
+		debug("usb_bulk_msg error status %ld\n", data_req.status);
 		usb_stor_BBB_reset(us);
 		return USB_STOR_TRANSPORT_FAILED;
 	}
@@ -766,12 +834,17 @@ st:
 	retry = 0;
 again:
 	debug("STATUS phase\n");
-	result = usb_bulk_msg(us->pusb_dev, pipein, csw, UMASS_BBB_CSW_SIZE,
-				&actlen, USB_CNTL_TIMEOUT*5);
+	result = 0;
+	if (!csw_queued)
+		result = usb_stor_BBB_submit(us, &csw_req, pipein, csw,
+					     UMASS_BBB_CSW_SIZE);
+	csw_queued = false;
+	if (result >= 0)
+		result = usb_stor_BBB_reap(us, &csw_req);
 
 	/* special handling of STALL in STATUS phase */
 	if ((result < 0) && (retry < 1) &&
-	    (us->pusb_dev->status & USB_ST_STALLED)) {
+	    (csw_req.status & USB_ST_STALLED)) {
 		debug("STATUS:stall\n");
 		/* clear the STALL on the endpoint */
 		result = usb_stor_BBB_clear_endpt_stall(us, us->ep_in);
@@ -780,8 +853,7 @@ again:
 			goto again;
 	}
 	if (result < 0) {
-		debug("usb_bulk_msg error status %ld\n",
-		      us->pusb_dev->status);
+		debug("usb_bulk_msg error status %ld\n", csw_req.status);
 		usb_stor_BBB_reset(us);
 		return USB_STOR_TRANSPORT_FAILED;
 	}
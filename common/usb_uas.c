@@ -0,0 +1,670 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * USB Attached SCSI (UAS) driver
+ *
+ * UAS queues tagged SCSI commands on a command pipe and reports progress on a
+ * separate status pipe, so a device can have several commands outstanding and
+ * complete them in whatever order suits it. U-Boot's host controllers do not
+ * support bulk streams, so this driver uses the USB 2.0 flavour of the
+ * protocol: the device announces the command it wants to move data for with a
+ * READ READY or WRITE READY IU, the host moves the data and then reads the
+ * SENSE IU which completes the command.
+ *
+ * Only LUN 0 is supported.
+ */
+
+#include <common.h>
+#include <blk.h>
+#include <dm.h>
+#include <log.h>
+#include <malloc.h>
+#include <memalign.h>
+#include <scsi.h>
+#include <usb.h>
+#include <usb/uas.h>
+#include <asm/unaligned.h>
+#include <dm/device-internal.h>
+#include <linux/kernel.h>
+
+#define UAS_QUEUE_DEPTH		4	/* commands outstanding at once */
+#define UAS_MIN_XFER_BLK	8	/* don't split requests finer than this */
+#define UAS_MAX_XFER_BLK	65535	/* limit of the READ(10) length field */
+#define UAS_TIMEOUT		(USB_CNTL_TIMEOUT * 5)
+#define UAS_TUR_RETRIES		10
+#define UAS_ALL_PIPES		0xf	/* bitmask of UAS_PIPE_ID_... values */
+
+#define UAS_SAI_RD_CAPAC16	0x10	/* service action of SCSI_RD_CAPAC16 */
+
+/**
+ * struct uas_plat - platform data for a UAS block device
+ *
+ * @ifnum:	Interface number of the UAS interface
+ * @cmd_pipe:	Pipe to send command IUs on
+ * @status_pipe: Pipe to receive status, sense and ready IUs on
+ * @data_in_pipe: Pipe for data read from the device
+ * @data_out_pipe: Pipe for data written to the device
+ */
+struct uas_plat {
+	int ifnum;
+	unsigned int cmd_pipe;
+	unsigned int status_pipe;
+	unsigned int data_in_pipe;
+	unsigned int data_out_pipe;
+};
+
+/**
+ * struct uas_cmd - state of a tagged command
+ *
+ * @req:	Bulk request used to send the command IU
+ * @data:	Data buffer for the command
+ * @datalen:	Number of bytes to transfer, 0 if none
+ * @write:	true if data flows from host to device
+ * @busy:	true while the command is outstanding on the device
+ * @status:	Result of the command once it completes (0 or -ve error)
+ * @lba:	First block of a read/write command
+ */
+struct uas_cmd {
+	struct usb_bulk_req req;
+	void *data;
+	int datalen;
+	bool write;
+	bool busy;
+	int status;
+	lbaint_t lba;
+};
+
+/**
+ * struct uas_priv - private state of a UAS block device
+ *
+ * @status:	Buffer for IUs received on the status pipe
+ * @buf:	Buffer for small data transfers (INQUIRY, READ CAPACITY)
+ * @iu:		Command IU buffers, one per tag
+ * @status_req:	Bulk request for the status pipe
+ * @cmd:	Command state, one per tag; tag N uses @cmd[N - 1]
+ * @queued:	Number of commands outstanding on the device
+ * @fail_lba:	Lowest block of any failed read/write command
+ * @max_xfer_blk: Maximum number of blocks in one command
+ */
+struct uas_priv {
+	struct uas_sense_iu status __aligned(ARCH_DMA_MINALIGN);
+	u8 buf[64] __aligned(ARCH_DMA_MINALIGN);
+	struct uas_command_iu iu[UAS_QUEUE_DEPTH] __aligned(ARCH_DMA_MINALIGN);
+	struct usb_bulk_req status_req;
+	struct uas_cmd cmd[UAS_QUEUE_DEPTH];
+	int queued;
+	lbaint_t fail_lba;
+	lbaint_t max_xfer_blk;
+};
+
+static struct usb_device *uas_get_udev(struct udevice *dev)
+{
+	return dev_get_parent_priv(dev_get_parent(dev));
+}
+
+/* Wait for a bulk request, giving up on it if the device does not respond */
+static int uas_bulk_wait(struct usb_device *udev, struct usb_bulk_req *req)
+{
+	int ret;
+
+	ret = usb_bulk_reap(udev, req, UAS_TIMEOUT);
+	if (ret == -ETIMEDOUT)
+		usb_bulk_cancel(udev, req);
+
+	return ret;
+}
+
+/**
+ * uas_prep_cmd() - set up a command for a tag
+ *
+ * @priv:	UAS private data
+ * @slot:	Command slot (tag - 1), which must not be busy
+ * @data:	Data buffer
+ * @datalen:	Number of bytes of data, 0 if none
+ * @write:	true if data flows from host to device
+ * @return command IU, whose CDB must be filled in by the caller
+ */
+static struct uas_command_iu *uas_prep_cmd(struct uas_priv *priv, int slot,
+					   void *data, int datalen, bool write)
+{
+	struct uas_command_iu *iu = &priv->iu[slot];
+	struct uas_cmd *cmd = &priv->cmd[slot];
+
+	memset(iu, '\0', sizeof(*iu));
+	iu->iu_id = UAS_IU_ID_COMMAND;
+	iu->tag = cpu_to_be16(slot + 1);
+	iu->prio_attr = UAS_TASK_SIMPLE;
+
+	cmd->data = data;
+	cmd->datalen = datalen;
+	cmd->write = write;
+	cmd->status = 0;
+	cmd->lba = 0;
+
+	return iu;
+}
+
+/* Queue the command IU for a slot on the command pipe */
+static int uas_submit_cmd(struct udevice *dev, int slot)
+{
+	struct uas_plat *plat = dev_get_platdata(dev);
+	struct uas_priv *priv = dev_get_priv(dev);
+	struct uas_cmd *cmd = &priv->cmd[slot];
+	int ret;
+
+	cmd->req.pipe = plat->cmd_pipe;
+	cmd->req.buffer = &priv->iu[slot];
+	cmd->req.length = sizeof(priv->iu[slot]);
+	ret = usb_bulk_submit(uas_get_udev(dev), &cmd->req);
+	if (ret)
+		return ret;
+	cmd->busy = true;
+	priv->queued++;
+
+	return 0;
+}
+
+/* Wait until all queued command IUs have been accepted by the device */
+static int uas_flush_cmds(struct udevice *dev)
+{
+	struct uas_priv *priv = dev_get_priv(dev);
+	struct usb_device *udev = uas_get_udev(dev);
+	int slot, ret;
+
+	for (slot = 0; slot < UAS_QUEUE_DEPTH; slot++) {
+		struct uas_cmd *cmd = &priv->cmd[slot];
+
+		if (!cmd->busy || cmd->req.done)
+			continue;
+		ret = uas_bulk_wait(udev, &cmd->req);
+		if (ret) {
+			debug("%s: Command IU failed (err=%d)\n", __func__,
+			      ret);
+			return ret;
+		}
+	}
+
+	return 0;
+}
+
+/**
+ * uas_service() - handle the next IU from the status pipe
+ *
+ * This moves the data for a command the device is ready for, or completes a
+ * command when its SENSE IU arrives.
+ *
+ * @dev:	UAS block device
+ * @return 0 if OK, -ve on transport error
+ */
+static int uas_service(struct udevice *dev)
+{
+	struct uas_plat *plat = dev_get_platdata(dev);
+	struct uas_priv *priv = dev_get_priv(dev);
+	struct usb_device *udev = uas_get_udev(dev);
+	struct usb_bulk_req *req = &priv->status_req;
+	struct uas_sense_iu *iu = &priv->status;
+	struct uas_cmd *cmd;
+	uint pipe;
+	int tag, act_len, ret;
+
+	req->pipe = plat->status_pipe;
+	req->buffer = iu;
+	req->length = sizeof(*iu);
+	ret = usb_bulk_submit(udev, req);
+	if (!ret)
+		ret = uas_bulk_wait(udev, req);
+	if (ret)
+		return ret;
+	if (req->act_len < UAS_READY_IU_LEN)
+		return -EPROTO;
+
+	tag = be16_to_cpu(iu->tag);
+	if (tag < 1 || tag > UAS_QUEUE_DEPTH || !priv->cmd[tag - 1].busy) {
+		debug("%s: IU %x for unknown tag %d\n", __func__, iu->iu_id,
+		      tag);
+		return -EPROTO;
+	}
+	cmd = &priv->cmd[tag - 1];
+
+	switch (iu->iu_id) {
+	case UAS_IU_ID_READ_READY:
+	case UAS_IU_ID_WRITE_READY:
+		if (!cmd->datalen ||
+		    cmd->write != (iu->iu_id == UAS_IU_ID_WRITE_READY))
+			return -EPROTO;
+		pipe = cmd->write ? plat->data_out_pipe : plat->data_in_pipe;
+		ret = usb_bulk_msg(udev, pipe, cmd->data, cmd->datalen,
+				   &act_len, UAS_TIMEOUT);
+		if (ret) {
+			debug("%s: Data transfer failed for tag %d\n",
+			      __func__, tag);
+			return ret;
+		}
+		/*
+		 * None of the commands sent here may move less data than
+		 * asked for, so fail the command whatever its status says
+		 */
+		if (act_len != cmd->datalen) {
+			debug("%s: Tag %d moved %d of %d bytes\n", __func__,
+			      tag, act_len, cmd->datalen);
+			cmd->status = -EIO;
+		}
+		return 0;
+	case UAS_IU_ID_STATUS:
+		if (iu->status) {
+			debug("%s: Tag %d status %x, sense key %x\n", __func__,
+			      tag, iu->status, iu->sense[2] & 0xf);
+			cmd->status = -EIO;
+		}
+		break;
+	case UAS_IU_ID_RESPONSE:
+		debug("%s: Tag %d response code %x\n", __func__, tag,
+		      ((struct uas_response_iu *)iu)->response_code);
+		cmd->status = -EIO;
+		break;
+	default:
+		debug("%s: Unknown IU %x\n", __func__, iu->iu_id);
+		return -EPROTO;
+	}
+
+	if (cmd->status && cmd->datalen && cmd->lba < priv->fail_lba)
+		priv->fail_lba = cmd->lba;
+	cmd->busy = false;
+	priv->queued--;
+
+	return 0;
+}
+
+/*
+ * After a transport error we cannot tell which commands the device still
+ * holds, so fail them all and clear any halted pipes.
+ */
+static void uas_recover(struct udevice *dev)
+{
+	struct uas_plat *plat = dev_get_platdata(dev);
+	struct uas_priv *priv = dev_get_priv(dev);
+	struct usb_device *udev = uas_get_udev(dev);
+	int slot;
+
+	for (slot = 0; slot < UAS_QUEUE_DEPTH; slot++) {
+		struct uas_cmd *cmd = &priv->cmd[slot];
+
+		if (!cmd->busy)
+			continue;
+		if (!cmd->req.done)
+			usb_bulk_cancel(udev, &cmd->req);
+		if (cmd->datalen && cmd->lba < priv->fail_lba)
+			priv->fail_lba = cmd->lba;
+		cmd->status = -EIO;
+		cmd->busy = false;
+	}
+	priv->queued = 0;
+
+	usb_clear_halt(udev, plat->cmd_pipe);
+	usb_clear_halt(udev, plat->status_pipe);
+	usb_clear_halt(udev, plat->data_in_pipe);
+	usb_clear_halt(udev, plat->data_out_pipe);
+}
+
+/**
+ * uas_exec() - run a single command to completion
+ *
+ * @dev:	UAS block device
+ * @cdb:	Command descriptor block
+ * @cdblen:	Length of @cdb in bytes
+ * @data:	Data buffer
+ * @datalen:	Number of bytes of data, 0 if none
+ * @write:	true if data flows from host to device
+ * @return 0 if OK, -EIO if the command failed, other -ve on transport error
+ */
+static int uas_exec(struct udevice *dev, const u8 *cdb, int cdblen,
+		    void *data, int datalen, bool write)
+{
+	struct uas_priv *priv = dev_get_priv(dev);
+	struct uas_command_iu *iu;
+	int ret;
+
+	iu = uas_prep_cmd(priv, 0, data, datalen, write);
+	memcpy(iu->cdb, cdb, cdblen);
+	ret = uas_submit_cmd(dev, 0);
+	if (!ret)
+		ret = uas_flush_cmds(dev);
+	while (!ret && priv->cmd[0].busy)
+		ret = uas_service(dev);
+	if (ret) {
+		uas_recover(dev);
+		return ret;
+	}
+
+	return priv->cmd[0].status;
+}
+
+/* Set up a READ or WRITE command for @blkcnt blocks starting at @lba */
+static void uas_prep_rw(struct uas_priv *priv, int slot, struct blk_desc *desc,
+			lbaint_t lba, lbaint_t blkcnt, void *buf, bool write)
+{
+	struct uas_command_iu *iu;
+
+	iu = uas_prep_cmd(priv, slot, buf, blkcnt * desc->blksz, write);
+	priv->cmd[slot].lba = lba;
+	if ((u64)lba + blkcnt > 0xffffffffULL) {
+		iu->cdb[0] = write ? UAS_SCSI_WRITE16 : UAS_SCSI_READ16;
+		put_unaligned_be64(lba, &iu->cdb[2]);
+		put_unaligned_be32(blkcnt, &iu->cdb[10]);
+	} else {
+		iu->cdb[0] = write ? SCSI_WRITE10 : SCSI_READ10;
+		put_unaligned_be32(lba, &iu->cdb[2]);
+		put_unaligned_be16(blkcnt, &iu->cdb[7]);
+	}
+}
+
+static unsigned long uas_rw(struct udevice *dev, lbaint_t blknr,
+			    lbaint_t blkcnt, void *buffer, bool write)
+{
+	struct blk_desc *desc = dev_get_uclass_platdata(dev);
+	struct uas_priv *priv = dev_get_priv(dev);
+	struct usb_device *udev = uas_get_udev(dev);
+	lbaint_t next = blknr, end = blknr + blkcnt;
+	lbaint_t chunk, count;
+	int slot, ret = 0;
+
+	if (!blkcnt)
+		return 0;
+
+	/*
+	 * Split the request so that all tags are in use, letting the device
+	 * overlap the commands, but don't bother with tiny pieces
+	 */
+	chunk = clamp_t(lbaint_t, DIV_ROUND_UP(blkcnt, UAS_QUEUE_DEPTH),
+			UAS_MIN_XFER_BLK, priv->max_xfer_blk);
+	priv->fail_lba = end;
+
+	usb_disable_asynch(1); /* asynch transfer not allowed */
+	usb_lock_async(udev, 1);
+	while (next < end || priv->queued) {
+		/* Keep every free tag busy until a command fails */
+		for (slot = 0; slot < UAS_QUEUE_DEPTH; slot++) {
+			if (next == end || priv->fail_lba != end)
+				break;
+			if (priv->cmd[slot].busy)
+				continue;
+			count = min(chunk, end - next);
+			uas_prep_rw(priv, slot, desc, next, count,
+				    buffer + (next - blknr) * desc->blksz,
+				    write);
+			ret = uas_submit_cmd(dev, slot);
+			if (ret)
+				break;
+			next += count;
+		}
+		if (!ret)
+			ret = uas_flush_cmds(dev);
+		if (!ret && priv->queued)
+			ret = uas_service(dev);
+		if (ret) {
+			debug("%s: Transport error %d\n", __func__, ret);
+			uas_recover(dev);
+			break;
+		}
+		if (priv->fail_lba != end && !priv->queued)
+			break;
+	}
+	usb_lock_async(udev, 0);
+	usb_disable_asynch(0); /* asynch transfer allowed */
+
+	return min(next, priv->fail_lba) - blknr;
+}
+
+static unsigned long uas_blk_read(struct udevice *dev, lbaint_t blknr,
+				  lbaint_t blkcnt, void *buffer)
+{
+	return uas_rw(dev, blknr, blkcnt, buffer, false);
+}
+
+static unsigned long uas_blk_write(struct udevice *dev, lbaint_t blknr,
+				   lbaint_t blkcnt, const void *buffer)
+{
+	return uas_rw(dev, blknr, blkcnt, (void *)buffer, true);
+}
+
+static int uas_read_capacity(struct udevice *dev, struct blk_desc *desc)
+{
+	struct uas_priv *priv = dev_get_priv(dev);
+	u8 cdb[UAS_MAX_CDB_LEN];
+	u64 last;
+	int ret;
+
+	memset(cdb, '\0', sizeof(cdb));
+	cdb[0] = SCSI_RD_CAPAC10;
+	ret = uas_exec(dev, cdb, 10, priv->buf, 8, false);
+	if (ret)
+		return ret;
+	last = get_unaligned_be32(&priv->buf[0]);
+	desc->blksz = get_unaligned_be32(&priv->buf[4]);
+
+	if (last == 0xffffffff) {
+		memset(cdb, '\0', sizeof(cdb));
+		cdb[0] = SCSI_RD_CAPAC16;
+		cdb[1] = UAS_SAI_RD_CAPAC16;
+		cdb[13] = 32;
+		ret = uas_exec(dev, cdb, 16, priv->buf, 32, false);
+		if (ret)
+			return ret;
+		last = get_unaligned_be64(&priv->buf[0]);
+		desc->blksz = get_unaligned_be32(&priv->buf[8]);
+	}
+	if (!desc->blksz || desc->blksz & (desc->blksz - 1))
+		return -EINVAL;
+	desc->lba = last + 1;
+	desc->log2blksz = LOG2(desc->blksz);
+
+	return 0;
+}
+
+static int uas_blk_probe(struct udevice *dev)
+{
+	struct blk_desc *desc = dev_get_uclass_platdata(dev);
+	struct uas_priv *priv = dev_get_priv(dev);
+	struct usb_device *udev = uas_get_udev(dev);
+	u8 cdb[UAS_MAX_CDB_LEN];
+	size_t size;
+	int retry, ret;
+
+	priv->max_xfer_blk = UAS_MAX_XFER_BLK;
+	ret = usb_get_max_xfer_size(udev, &size);
+	if (ret >= 0 && size / desc->blksz < priv->max_xfer_blk)
+		priv->max_xfer_blk = size / desc->blksz;
+
+	memset(cdb, '\0', sizeof(cdb));
+	cdb[0] = SCSI_INQUIRY;
+	cdb[4] = 36;
+	ret = uas_exec(dev, cdb, 6, priv->buf, 36, false);
+	if (ret) {
+		debug("%s: INQUIRY failed (err=%d)\n", __func__, ret);
+		return ret;
+	}
+	desc->type = priv->buf[0] & 0x1f;
+	desc->removable = priv->buf[1] & 0x80 ? 1 : 0;
+	memcpy(desc->vendor, &priv->buf[8], 8);
+	memcpy(desc->product, &priv->buf[16], 16);
+	memcpy(desc->revision, &priv->buf[32], 4);
+	desc->vendor[8] = '\0';
+	desc->product[16] = '\0';
+	desc->revision[4] = '\0';
+
+	/* Give the medium some time to become ready */
+	memset(cdb, '\0', sizeof(cdb));
+	cdb[0] = SCSI_TST_U_RDY;
+	for (retry = 0; retry < UAS_TUR_RETRIES; retry++) {
+		ret = uas_exec(dev, cdb, 6, NULL, 0, false);
+		if (ret != -EIO)
+			break;
+		mdelay(100);
+	}
+	if (ret) {
+		printf("Device NOT ready\n");
+		return ret;
+	}
+
+	ret = uas_read_capacity(dev, desc);
+	if (ret) {
+		printf("READ_CAP ERROR\n");
+		return ret;
+	}
+	/* Command sizes are now known in blocks of the real size */
+	if (desc->blksz != 512)
+		priv->max_xfer_blk = max_t(lbaint_t, 1,
+					   priv->max_xfer_blk * 512 /
+					   desc->blksz);
+	debug("%s: Capacity " LBAF " blocks of %lu bytes\n", __func__,
+	      desc->lba, desc->blksz);
+
+	return 0;
+}
+
+/**
+ * uas_find_pipes() - find the UAS alternate setting of a device
+ *
+ * This walks the raw configuration descriptor since U-Boot's parsed copy does
+ * not keep alternate settings or class-specific descriptors apart.
+ *
+ * @udev:	USB device to check
+ * @plat:	Returns the interface number and pipes
+ * @altp:	Returns the alternate setting
+ * @return 0 if OK, -ENODEV if there is no UAS interface, -ve on other error
+ */
+static int uas_find_pipes(struct usb_device *udev, struct uas_plat *plat,
+			  int *altp)
+{
+	struct usb_interface_descriptor *intf = NULL;
+	struct usb_endpoint_descriptor *ep = NULL;
+	struct usb_pipe_usage_descriptor *pu;
+	int len, pos, epnum, found = 0;
+	unsigned char *buf;
+	uint pipe;
+
+	len = usb_get_configuration_len(udev, udev->configno);
+	if (len < 0)
+		return len;
+	buf = malloc_cache_aligned(len);
+	if (!buf)
+		return -ENOMEM;
+	len = usb_get_configuration_no(udev, udev->configno, buf, len);
+	for (pos = 0; pos + 2 <= len && buf[pos] >= 2; pos += buf[pos]) {
+		switch (buf[pos + 1]) {
+		case USB_DT_INTERFACE:
+			intf = (void *)&buf[pos];
+			ep = NULL;
+			found = 0;
+			if (intf->bInterfaceClass != USB_CLASS_MASS_STORAGE ||
+			    intf->bInterfaceSubClass != US_SC_SCSI ||
+			    intf->bInterfaceProtocol != US_PR_UAS)
+				intf = NULL;
+			break;
+		case USB_DT_ENDPOINT:
+			ep = intf ? (void *)&buf[pos] : NULL;
+			break;
+		case USB_DT_PIPE_USAGE:
+			if (!ep || (ep->bmAttributes &
+				    USB_ENDPOINT_XFERTYPE_MASK) !=
+				   USB_ENDPOINT_XFER_BULK)
+				break;
+			pu = (void *)&buf[pos];
+			epnum = ep->bEndpointAddress &
+				USB_ENDPOINT_NUMBER_MASK;
+			if (ep->bEndpointAddress & USB_DIR_IN)
+				pipe = usb_rcvbulkpipe(udev, epnum);
+			else
+				pipe = usb_sndbulkpipe(udev, epnum);
+			switch (pu->bPipeID) {
+			case UAS_PIPE_ID_CMD:
+				plat->cmd_pipe = pipe;
+				break;
+			case UAS_PIPE_ID_STATUS:
+				plat->status_pipe = pipe;
+				break;
+			case UAS_PIPE_ID_DATA_IN:
+				plat->data_in_pipe = pipe;
+				break;
+			case UAS_PIPE_ID_DATA_OUT:
+				plat->data_out_pipe = pipe;
+				break;
+			default:
+				continue;
+			}
+			found |= 1 << (pu->bPipeID - 1);
+			break;
+		}
+		if (found == UAS_ALL_PIPES)
+			break;
+	}
+	if (found == UAS_ALL_PIPES) {
+		plat->ifnum = intf->bInterfaceNumber;
+		*altp = intf->bAlternateSetting;
+	}
+	free(buf);
+
+	return found == UAS_ALL_PIPES ? 0 : -ENODEV;
+}
+
+int usb_uas_probe_device(struct usb_device *udev, int devnum)
+{
+	struct uas_plat pipes;
+	struct blk_desc *desc;
+	struct udevice *dev;
+	int alt, ret;
+
+	/*
+	 * At SuperSpeed the UAS pipes must be driven with bulk streams, which
+	 * our host controllers do not provide. Use bulk-only transport there.
+	 */
+	if (udev->speed >= USB_SPEED_SUPER)
+		return -ENODEV;
+
+	ret = uas_find_pipes(udev, &pipes, &alt);
+	if (ret)
+		return ret;
+	debug("%s: UAS interface %d, alt %d\n", __func__, pipes.ifnum, alt);
+	ret = usb_set_interface(udev, pipes.ifnum, alt);
+	if (ret)
+		return -ENODEV;
+
+	ret = blk_create_devicef(udev->dev, "usb_uas_blk", "lun0", IF_TYPE_USB,
+				 devnum, 512, 0, &dev);
+	if (ret) {
+		debug("Cannot bind driver\n");
+		return ret;
+	}
+	*(struct uas_plat *)dev_get_platdata(dev) = pipes;
+	desc = dev_get_uclass_platdata(dev);
+	desc->target = udev->devnum;
+	desc->lun = 0;
+
+	ret = device_probe(dev);
+	if (ret) {
+		debug("%s: UAS device not usable (err=%d)\n", __func__, ret);
+		ret = device_unbind(dev);
+		if (ret)
+			return ret;
+		if (alt)
+			usb_set_interface(udev, pipes.ifnum, 0);
+		return -ENODEV;
+	}
+	debug("%s: Found device %p\n", __func__, udev);
+
+	return 0;
+}
+
+static const struct blk_ops uas_blk_ops = {
+	.read	= uas_blk_read,
+	.write	= uas_blk_write,
+};
+
+U_BOOT_DRIVER(usb_uas_blk) = {
+	.name		= "usb_uas_blk",
+	.id		= UCLASS_BLK,
+	.ops		= &uas_blk_ops,
+	.probe		= uas_blk_probe,
+	.priv_auto_alloc_size	= sizeof(struct uas_priv),
+	.platdata_auto_alloc_size = sizeof(struct uas_plat),
+	.flags		= DM_FLAG_ALLOC_PRIV_DMA,
+};
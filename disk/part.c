@@ -11,6 +11,7 @@
 #include <ide.h>
 #include <malloc.h>
 #include <part.h>
+#include <sort.h>
 #include <ubifs_uboot.h>
 
 #undef	PART_DEBUG
@@ -52,6 +53,242 @@ static struct part_driver *part_driver_lookup_type(struct blk_desc *dev_desc)
 	return NULL;
 }
 
+#if CONFIG_IS_ENABLED(PARTITION_CACHE)
+static int part_cache_cmp_name(const void *a, const void *b)
+{
+	const disk_partition_t *pa = *(const disk_partition_t **)a;
+	const disk_partition_t *pb = *(const disk_partition_t **)b;
+	int ret;
+
+	ret = strcmp((const char *)pa->name, (const char *)pb->name);
+	if (ret)
+		return ret;
+
+	return pa < pb ? -1 : pa > pb;
+}
+
+#if CONFIG_IS_ENABLED(PARTITION_UUIDS)
+static int part_cache_cmp_uuid(const void *a, const void *b)
+{
+	const disk_partition_t *pa = *(const disk_partition_t **)a;
+	const disk_partition_t *pb = *(const disk_partition_t **)b;
+	int ret;
+
+	ret = strcasecmp(pa->uuid, pb->uuid);
+	if (ret)
+		return ret;
+
+	return pa < pb ? -1 : pa > pb;
+}
+#endif
+
+void part_cache_drop(struct blk_desc *dev_desc)
+{
+	struct part_cache *cache = dev_desc->part_cache;
+
+	if (!cache)
+		return;
+
+	free(cache->parts);
+	free(cache->by_name);
+#if CONFIG_IS_ENABLED(PARTITION_UUIDS)
+	free(cache->by_uuid);
+#endif
+	free(cache);
+	dev_desc->part_cache = NULL;
+}
+
+void part_cache_invalidate(struct blk_desc *dev_desc, lbaint_t start,
+			   lbaint_t blkcnt)
+{
+	struct part_cache *cache = dev_desc->part_cache;
+
+	if (!cache)
+		return;
+
+	if (start < cache->table_end ||
+	    (cache->backup_start && start + blkcnt > cache->backup_start))
+		part_cache_drop(dev_desc);
+}
+
+/*
+ * Tables without a get_all() method are read one partition at a time. Where
+ * these tables live is not known here, so any write drops them.
+ */
+static int part_cache_get_each(struct blk_desc *dev_desc,
+			       struct part_driver *drv,
+			       struct part_cache *cache)
+{
+	int i;
+
+	cache->parts = calloc(drv->max_entries, sizeof(*cache->parts));
+	if (!cache->parts)
+		return -ENOMEM;
+
+	cache->count = drv->max_entries;
+	for (i = 0; i < cache->count; i++) {
+		if (drv->get_info(dev_desc, i + 1, &cache->parts[i]))
+			cache->parts[i].size = 0;
+	}
+	cache->table_end = dev_desc->lba;
+
+	return 0;
+}
+
+static int part_cache_index(struct part_cache *cache)
+{
+	int i, n = 0;
+
+	for (i = 0; i < cache->count; i++) {
+		if (cache->parts[i].size)
+			n++;
+	}
+
+	cache->nr_used = n;
+	if (!n)
+		return 0;
+
+	cache->by_name = calloc(n, sizeof(*cache->by_name));
+	if (!cache->by_name)
+		return -ENOMEM;
+#if CONFIG_IS_ENABLED(PARTITION_UUIDS)
+	cache->by_uuid = calloc(n, sizeof(*cache->by_uuid));
+	if (!cache->by_uuid)
+		return -ENOMEM;
+#endif
+
+	for (i = 0, n = 0; i < cache->count; i++) {
+		if (!cache->parts[i].size)
+			continue;
+		cache->by_name[n] = &cache->parts[i];
+#if CONFIG_IS_ENABLED(PARTITION_UUIDS)
+		cache->by_uuid[n] = &cache->parts[i];
+#endif
+		n++;
+	}
+
+	qsort(cache->by_name, n, sizeof(*cache->by_name), part_cache_cmp_name);
+#if CONFIG_IS_ENABLED(PARTITION_UUIDS)
+	qsort(cache->by_uuid, n, sizeof(*cache->by_uuid), part_cache_cmp_uuid);
+#endif
+
+	return 0;
+}
+
+/**
+ * part_cache_get() - Get the parsed partition table of a block device
+ *
+ * The table is read and indexed on first use.
+ *
+ * @dev_desc:	Block device descriptor
+ * @drv:	Partition driver for the device
+ * @return the cached table, or NULL if it cannot be read or is not cached
+ */
+static struct part_cache *part_cache_get(struct blk_desc *dev_desc,
+					 struct part_driver *drv)
+{
+	struct part_cache *cache = dev_desc->part_cache;
+	int ret;
+
+	if (cache && cache->part_type == dev_desc->part_type &&
+	    cache->hwpart == dev_desc->hwpart)
+		return cache;
+	part_cache_drop(dev_desc);
+
+	if (!drv->get_all && !drv->get_info)
+		return NULL;
+
+	cache = calloc(1, sizeof(*cache));
+	if (!cache)
+		return NULL;
+
+	dev_desc->part_cache = cache;
+	cache->part_type = dev_desc->part_type;
+	cache->hwpart = dev_desc->hwpart;
+	if (drv->get_all)
+		ret = drv->get_all(dev_desc, cache);
+	else
+		ret = part_cache_get_each(dev_desc, drv, cache);
+	if (!ret)
+		ret = part_cache_index(cache);
+	if (ret) {
+		part_cache_drop(dev_desc);
+		return NULL;
+	}
+
+	return cache;
+}
+
+/**
+ * part_cache_find() - Find the first partition matching a key in an index
+ *
+ * @index:	Index to search
+ * @n:		Number of entries in @index
+ * @key:	Key to look for
+ * @cmp:	Compares @key with the entry at a partition
+ * @return pointer to the index entry, or NULL if not found
+ */
+static disk_partition_t **part_cache_find(disk_partition_t **index, int n,
+					  const char *key,
+					  int (*cmp)(const char *key,
+						     const disk_partition_t *))
+{
+	int low = 0, high = n, mid;
+
+	/* Lower bound, so that duplicates give the lowest partition number */
+	while (low < high) {
+		mid = (low + high) / 2;
+		if (cmp(key, index[mid]) > 0)
+			low = mid + 1;
+		else
+			high = mid;
+	}
+	if (low < n && !cmp(key, index[low]))
+		return &index[low];
+
+	return NULL;
+}
+
+static int part_cache_key_name(const char *key, const disk_partition_t *info)
+{
+	return strcmp(key, (const char *)info->name);
+}
+
+#if CONFIG_IS_ENABLED(PARTITION_UUIDS)
+static int part_cache_key_uuid(const char *key, const disk_partition_t *info)
+{
+	return strcasecmp(key, info->uuid);
+}
+#endif
+
+/**
+ * part_cache_lookup() - Look up a partition through an index
+ *
+ * @cache:	Cached table
+ * @index:	Index to search
+ * @key:	Key to look for
+ * @cmp:	Compares @key with the entry at a partition
+ * @info:	Returns the partition information
+ * @return the partition number, or -1 if not found
+ */
+static int part_cache_lookup(struct part_cache *cache,
+			     disk_partition_t **index, const char *key,
+			     int (*cmp)(const char *key,
+					const disk_partition_t *),
+			     disk_partition_t *info)
+{
+	disk_partition_t **entry;
+
+	entry = part_cache_find(index, cache->nr_used, key, cmp);
+	if (!entry)
+		return -1;
+
+	*info = **entry;
+
+	return *entry - cache->parts + 1;
+}
+#endif
+
 #ifdef CONFIG_HAVE_BLOCK_DEVICE
 static struct blk_desc *get_dev_hwpart(const char *ifname, int dev, int hwpart)
 {
@@ -236,6 +473,7 @@ void part_init(struct blk_desc *dev_desc)
 	struct part_driver *entry;
 
 	blkcache_invalidate(dev_desc->if_type, dev_desc->devnum);
+	part_cache_drop(dev_desc);
 
 	dev_desc->part_type = PART_TYPE_UNKNOWN;
 	for (entry = drv; entry != drv + n_ents; entry++) {
@@ -322,6 +560,9 @@ int part_get_info(struct blk_desc *dev_desc, int part,
 {
 #ifdef CONFIG_HAVE_BLOCK_DEVICE
 	struct part_driver *drv;
+#if CONFIG_IS_ENABLED(PARTITION_CACHE)
+	struct part_cache *cache;
+#endif
 
 #if CONFIG_IS_ENABLED(PARTITION_UUIDS)
 	/* The common case is no UUID support */
@@ -342,6 +583,15 @@ int part_get_info(struct blk_desc *dev_desc, int part,
 		       drv->name);
 		return -ENOSYS;
 	}
+#if CONFIG_IS_ENABLED(PARTITION_CACHE)
+	cache = part_cache_get(dev_desc, drv);
+	if (cache && part >= 1 && part <= cache->count) {
+		if (!cache->parts[part - 1].size)
+			return -1;
+		*info = cache->parts[part - 1];
+		return 0;
+	}
+#endif
 	if (drv->get_info(dev_desc, part, info) == 0) {
 		PRINTF("## Valid %s partition found ##\n", drv->name);
 		return 0;
@@ -649,12 +899,21 @@ int part_get_info_by_name_type(struct blk_desc *dev_desc, const char *name,
 			       disk_partition_t *info, int part_type)
 {
 	struct part_driver *part_drv;
+#if CONFIG_IS_ENABLED(PARTITION_CACHE)
+	struct part_cache *cache;
+#endif
 	int ret;
 	int i;
 
 	part_drv = part_driver_lookup_type(dev_desc);
 	if (!part_drv)
 		return -1;
+#if CONFIG_IS_ENABLED(PARTITION_CACHE)
+	cache = part_cache_get(dev_desc, part_drv);
+	if (cache)
+		return part_cache_lookup(cache, cache->by_name, name,
+					 part_cache_key_name, info);
+#endif
 	for (i = 1; i < part_drv->max_entries; i++) {
 		ret = part_drv->get_info(dev_desc, i, info);
 		if (ret != 0) {
@@ -676,6 +935,36 @@ int part_get_info_by_name(struct blk_desc *dev_desc, const char *name,
 	return part_get_info_by_name_type(dev_desc, name, info, PART_TYPE_ALL);
 }
 
+#if CONFIG_IS_ENABLED(PARTITION_UUIDS)
+int part_get_info_by_uuid(struct blk_desc *dev_desc, const char *uuid,
+			  disk_partition_t *info)
+{
+	struct part_driver *part_drv;
+#if CONFIG_IS_ENABLED(PARTITION_CACHE)
+	struct part_cache *cache;
+#endif
+	int i;
+
+	part_drv = part_driver_lookup_type(dev_desc);
+	if (!part_drv)
+		return -1;
+#if CONFIG_IS_ENABLED(PARTITION_CACHE)
+	cache = part_cache_get(dev_desc, part_drv);
+	if (cache)
+		return part_cache_lookup(cache, cache->by_uuid, uuid,
+					 part_cache_key_uuid, info);
+#endif
+	for (i = 1; i < part_drv->max_entries; i++) {
+		if (part_get_info(dev_desc, i, info))
+			break;
+		if (!strcasecmp(uuid, info->uuid))
+			return i;
+	}
+
+	return -1;
+}
+#endif
+
 /**
  * Get partition info from device number and partition name.
  *
@@ -256,6 +256,31 @@ void part_print_efi(struct blk_desc *dev_desc)
 	return;
 }
 
+/* Fill in partition information from a valid partition table entry */
+static void gpt_pte_to_info(struct blk_desc *dev_desc, gpt_entry *pte,
+			    disk_partition_t *info)
+{
+	/* The 'lbaint_t' casting may limit the maximum disk size to 2 TB */
+	info->start = (lbaint_t)le64_to_cpu(pte->starting_lba);
+	/* The ending LBA is inclusive, to calculate size, add 1 to it */
+	info->size = (lbaint_t)le64_to_cpu(pte->ending_lba) + 1
+		     - info->start;
+	info->blksz = dev_desc->blksz;
+
+	snprintf((char *)info->name, sizeof(info->name), "%s",
+		 print_efiname(pte));
+	strcpy((char *)info->type, "U-Boot");
+	info->bootable = get_bootable(pte);
+#if CONFIG_IS_ENABLED(PARTITION_UUIDS)
+	uuid_bin_to_str(pte->unique_partition_guid.b, info->uuid,
+			UUID_STR_FORMAT_GUID);
+#endif
+#ifdef CONFIG_PARTITION_TYPE_GUID
+	uuid_bin_to_str(pte->partition_type_guid.b, info->type_guid,
+			UUID_STR_FORMAT_GUID);
+#endif
+}
+
 int part_get_info_efi(struct blk_desc *dev_desc, int part,
 		      disk_partition_t *info)
 {
@@ -280,25 +305,7 @@ int part_get_info_efi(struct blk_desc *dev_desc, int part,
 		return -1;
 	}
 
-	/* The 'lbaint_t' casting may limit the maximum disk size to 2 TB */
-	info->start = (lbaint_t)le64_to_cpu(gpt_pte[part - 1].starting_lba);
-	/* The ending LBA is inclusive, to calculate size, add 1 to it */
-	info->size = (lbaint_t)le64_to_cpu(gpt_pte[part - 1].ending_lba) + 1
-		     - info->start;
-	info->blksz = dev_desc->blksz;
-
-	snprintf((char *)info->name, sizeof(info->name), "%s",
-		 print_efiname(&gpt_pte[part - 1]));
-	strcpy((char *)info->type, "U-Boot");
-	info->bootable = get_bootable(&gpt_pte[part - 1]);
-#if CONFIG_IS_ENABLED(PARTITION_UUIDS)
-	uuid_bin_to_str(gpt_pte[part - 1].unique_partition_guid.b, info->uuid,
-			UUID_STR_FORMAT_GUID);
-#endif
-#ifdef CONFIG_PARTITION_TYPE_GUID
-	uuid_bin_to_str(gpt_pte[part - 1].partition_type_guid.b,
-			info->type_guid, UUID_STR_FORMAT_GUID);
-#endif
+	gpt_pte_to_info(dev_desc, &gpt_pte[part - 1], info);
 
 	debug("%s: start 0x" LBAF ", size 0x" LBAF ", name %s\n", __func__,
 	      info->start, info->size, info->name);
@@ -308,6 +315,48 @@ int part_get_info_efi(struct blk_desc *dev_desc, int part,
 	return 0;
 }
 
+#if CONFIG_IS_ENABLED(PARTITION_CACHE)
+static int part_get_all_efi(struct blk_desc *dev_desc,
+			    struct part_cache *cache)
+{
+	ALLOC_CACHE_ALIGN_BUFFER_PAD(gpt_header, gpt_head, 1, dev_desc->blksz);
+	gpt_entry *gpt_pte = NULL;
+	lbaint_t pte_end;
+	int i, count;
+	u32 pte_size;
+
+	/* This function validates AND fills in the GPT header and PTE */
+	if (find_valid_gpt(dev_desc, gpt_head, &gpt_pte) != 1)
+		return -EINVAL;
+
+	count = le32_to_cpu(gpt_head->num_partition_entries);
+	cache->parts = calloc(count, sizeof(*cache->parts));
+	if (!cache->parts) {
+		free(gpt_pte);
+		return -ENOMEM;
+	}
+
+	cache->count = count;
+	for (i = 0; i < count; i++) {
+		if (is_pte_valid(&gpt_pte[i]))
+			gpt_pte_to_info(dev_desc, &gpt_pte[i],
+					&cache->parts[i]);
+	}
+
+	/* Both tables lie outside the usable blocks */
+	pte_size = count * le32_to_cpu(gpt_head->sizeof_partition_entry);
+	pte_end = le64_to_cpu(gpt_head->partition_entry_lba) +
+		  BLOCK_CNT(pte_size, dev_desc);
+	cache->table_end = max_t(lbaint_t, pte_end,
+				 le64_to_cpu(gpt_head->first_usable_lba));
+	cache->backup_start = le64_to_cpu(gpt_head->last_usable_lba) + 1;
+
+	/* Remember to free pte */
+	free(gpt_pte);
+	return 0;
+}
+#endif
+
 static int part_test_efi(struct blk_desc *dev_desc)
 {
 	ALLOC_CACHE_ALIGN_BUFFER_PAD(legacy_mbr, legacymbr, 1, dev_desc->blksz);
@@ -1104,6 +1153,9 @@ U_BOOT_PART_TYPE(a_efi) = {
 	.part_type	= PART_TYPE_EFI,
 	.max_entries	= GPT_ENTRY_NUMBERS,
 	.get_info	= part_get_info_ptr(part_get_info_efi),
+#if CONFIG_IS_ENABLED(PARTITION_CACHE)
+	.get_all	= part_get_all_efi,
+#endif
 	.print		= part_print_ptr(part_print_efi),
 	.test		= part_test_efi,
 };
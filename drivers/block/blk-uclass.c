@@ -8,6 +8,7 @@
 #include <blk.h>
 #include <dm.h>
 #include <malloc.h>
+#include <sort.h>
 #include <dm/device-internal.h>
 #include <dm/lists.h>
 #include <dm/uclass-internal.h>
@@ -345,6 +346,10 @@ int blk_select_hwpart(struct udevice *dev, int hwpart)
 	if (!ops->select_hwpart)
 		return 0;
 
+	/* Cached blocks belong to the current hardware partition */
+	if (blk_flush(dev_get_uclass_platdata(dev)))
+		return -EIO;
+
 	return ops->select_hwpart(dev, hwpart);
 }
 
@@ -442,9 +447,11 @@ unsigned long blk_dread(struct blk_desc *block_dev, lbaint_t start,
 			  start, blkcnt, block_dev->blksz, buffer))
 		return blkcnt;
 	blks_read = ops->read(dev, start, blkcnt, buffer);
-	if (blks_read == blkcnt)
+	if (blks_read == blkcnt) {
+		blkwb_read(block_dev, start, blkcnt, buffer);
 		blkcache_fill(block_dev->if_type, block_dev->devnum,
 			      start, blkcnt, block_dev->blksz, buffer);
+	}
 
 	return blks_read;
 }
@@ -454,11 +461,18 @@ unsigned long blk_dwrite(struct blk_desc *block_dev, lbaint_t start,
 {
 	struct udevice *dev = block_dev->bdev;
 	const struct blk_ops *ops = blk_get_ops(dev);
+	long n;
 
 	if (!ops->write)
 		return -ENOSYS;
 
-	blkcache_invalidate(block_dev->if_type, block_dev->devnum);
+	blkcache_invalidate_range(block_dev->if_type, block_dev->devnum,
+				  start, blkcnt);
+	part_cache_invalidate(block_dev, start, blkcnt);
+	n = blkwb_write(block_dev, start, blkcnt, buffer);
+	if (n)
+		return n;
+
 	return ops->write(dev, start, blkcnt, buffer);
 }
 
@@ -471,10 +485,180 @@ unsigned long blk_derase(struct blk_desc *block_dev, lbaint_t start,
 	if (!ops->erase)
 		return -ENOSYS;
 
-	blkcache_invalidate(block_dev->if_type, block_dev->devnum);
+	blkcache_invalidate_range(block_dev->if_type, block_dev->devnum,
+				  start, blkcnt);
+	part_cache_invalidate(block_dev, start, blkcnt);
+	blkwb_discard(block_dev, start, blkcnt);
 	return ops->erase(dev, start, blkcnt);
 }
 
+static int blk_vec_cmp(const void *a, const void *b)
+{
+	const struct blk_vec *va = a, *vb = b;
+
+	if (va->start == vb->start)
+		return 0;
+
+	return va->start < vb->start ? -1 : 1;
+}
+
+int blk_merge_vecs(struct blk_vec *vecs, int count, unsigned long blksz)
+{
+	struct blk_vec *prev;
+	int i, n;
+
+	if (count < 2)
+		return count;
+
+	qsort(vecs, count, sizeof(*vecs), blk_vec_cmp);
+	for (i = 1, n = 1; i < count; i++) {
+		prev = &vecs[n - 1];
+		if (vecs[i].start == prev->start + prev->blkcnt &&
+		    vecs[i].buffer == prev->buffer + prev->blkcnt * blksz)
+			prev->blkcnt += vecs[i].blkcnt;
+		else
+			vecs[n++] = vecs[i];
+	}
+
+	return n;
+}
+
+/* Carry out each run on its own, for drivers without readv()/writev() */
+static ulong blk_do_vecs(struct blk_desc *block_dev,
+			 const struct blk_vec *vecs, int count, bool write)
+{
+	ulong n, total = 0;
+	int i;
+
+	for (i = 0; i < count; i++) {
+		if (write)
+			n = blk_dwrite(block_dev, vecs[i].start,
+				       vecs[i].blkcnt, vecs[i].buffer);
+		else
+			n = blk_dread(block_dev, vecs[i].start,
+				      vecs[i].blkcnt, vecs[i].buffer);
+		if (n != vecs[i].blkcnt)
+			return IS_ERR_VALUE(n) ? n : total + n;
+		total += n;
+	}
+
+	return total;
+}
+
+static lbaint_t blk_vecs_total(const struct blk_vec *vecs, int count)
+{
+	lbaint_t total = 0;
+	int i;
+
+	for (i = 0; i < count; i++)
+		total += vecs[i].blkcnt;
+
+	return total;
+}
+
+unsigned long blk_dreadv(struct blk_desc *block_dev, struct blk_vec *vecs,
+			 int count)
+{
+	struct udevice *dev = block_dev->bdev;
+	const struct blk_ops *ops = blk_get_ops(dev);
+	ulong n;
+	int i;
+
+	count = blk_merge_vecs(vecs, count, block_dev->blksz);
+	if (!ops->readv)
+		return blk_do_vecs(block_dev, vecs, count, false);
+
+	n = ops->readv(dev, vecs, count);
+	if (n == blk_vecs_total(vecs, count)) {
+		for (i = 0; i < count; i++)
+			blkwb_read(block_dev, vecs[i].start, vecs[i].blkcnt,
+				   vecs[i].buffer);
+	}
+
+	return n;
+}
+
+unsigned long blk_dwritev(struct blk_desc *block_dev, struct blk_vec *vecs,
+			  int count)
+{
+	struct udevice *dev = block_dev->bdev;
+	const struct blk_ops *ops = blk_get_ops(dev);
+	int i;
+
+	count = blk_merge_vecs(vecs, count, block_dev->blksz);
+	if (!ops->writev)
+		return blk_do_vecs(block_dev, vecs, count, true);
+
+	for (i = 0; i < count; i++) {
+		blkcache_invalidate_range(block_dev->if_type,
+					  block_dev->devnum, vecs[i].start,
+					  vecs[i].blkcnt);
+		part_cache_invalidate(block_dev, vecs[i].start,
+				      vecs[i].blkcnt);
+		blkwb_discard(block_dev, vecs[i].start, vecs[i].blkcnt);
+	}
+
+	return ops->writev(dev, vecs, count);
+}
+
+void blk_request_done(struct blk_request *req, long result)
+{
+	struct blk_desc *block_dev = req->desc;
+
+	/* Drop anything read into the cache while the write was queued */
+	if (req->write)
+		blkcache_invalidate_range(block_dev->if_type,
+					  block_dev->devnum, req->start,
+					  req->blkcnt);
+	req->result = result;
+	req->complete(req);
+}
+
+int blk_dsubmit(struct blk_desc *block_dev, struct blk_request *req)
+{
+	struct udevice *dev = block_dev->bdev;
+	const struct blk_ops *ops = blk_get_ops(dev);
+	long n;
+
+	if (req->write ? !ops->write : !ops->read)
+		return -ENOSYS;
+
+	req->desc = block_dev;
+	if (ops->submit) {
+		/* Queued requests go to the device, so it must be up to date */
+		if (blk_flush(block_dev))
+			return -EIO;
+		if (req->write) {
+			blkcache_invalidate_range(block_dev->if_type,
+						  block_dev->devnum,
+						  req->start, req->blkcnt);
+			part_cache_invalidate(block_dev, req->start,
+					      req->blkcnt);
+		}
+		return ops->submit(dev, req);
+	}
+
+	/* The driver cannot queue requests, so complete this one now */
+	if (req->write)
+		n = blk_dwrite(block_dev, req->start, req->blkcnt, req->buffer);
+	else
+		n = blk_dread(block_dev, req->start, req->blkcnt, req->buffer);
+	blk_request_done(req, n);
+
+	return 0;
+}
+
+int blk_dpoll(struct blk_desc *block_dev)
+{
+	struct udevice *dev = block_dev->bdev;
+	const struct blk_ops *ops = blk_get_ops(dev);
+
+	if (!ops->poll)
+		return 0;
+
+	return ops->poll(dev);
+}
+
 int blk_get_from_parent(struct udevice *parent, struct udevice **devp)
 {
 	struct udevice *dev;
@@ -651,9 +835,18 @@ static int blk_post_probe(struct udevice *dev)
 	return 0;
 }
 
+static int blk_pre_remove(struct udevice *dev)
+{
+	blkwb_free(dev_get_uclass_platdata(dev));
+	part_cache_drop(dev_get_uclass_platdata(dev));
+
+	return 0;
+}
+
 UCLASS_DRIVER(blk) = {
 	.id		= UCLASS_BLK,
 	.name		= "blk",
 	.post_probe	= blk_post_probe,
+	.pre_remove	= blk_pre_remove,
 	.per_device_platdata_auto_alloc_size = sizeof(struct blk_desc),
 };
@@ -262,3 +262,29 @@ int blk_select_hwpart_devnum(enum if_type if_type, int devnum, int hwpart)
 		return ret;
 	return drv->select_hwpart(desc, hwpart);
 }
+
+void blk_request_done(struct blk_request *req, long result)
+{
+	req->result = result;
+	req->complete(req);
+}
+
+/* Legacy drivers cannot queue requests, so each completes at once */
+int blk_dsubmit(struct blk_desc *block_dev, struct blk_request *req)
+{
+	long n;
+
+	req->desc = block_dev;
+	if (req->write)
+		n = blk_dwrite(block_dev, req->start, req->blkcnt, req->buffer);
+	else
+		n = blk_dread(block_dev, req->start, req->blkcnt, req->buffer);
+	blk_request_done(req, n);
+
+	return 0;
+}
+
+int blk_dpoll(struct blk_desc *block_dev)
+{
+	return 0;
+}
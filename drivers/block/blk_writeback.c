@@ -0,0 +1,303 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Write-back cache for block devices
+ *
+ * Filesystems rewrite the same metadata blocks (FAT sectors, bitmaps, group
+ * descriptors, journal blocks) many times while saving a file. Small writes
+ * are kept here and only sent to the device when flushed, merging adjacent
+ * blocks into single requests.
+ */
+
+#include <common.h>
+#include <blk.h>
+#include <dm.h>
+#include <malloc.h>
+#include <memalign.h>
+#include <linux/bitops.h>
+
+/* Blocks in a cache line */
+#define BLK_WB_LINE_BLOCKS	8
+/* Writes of at least this many blocks go straight to the device */
+#define BLK_WB_BYPASS_BLOCKS	64
+/* Largest write issued by a flush */
+#define BLK_WB_MAX_RUN		128
+
+/**
+ * struct blk_wb_line - Cached blocks of an aligned group
+ *
+ * @start:	first block of the line, a multiple of BLK_WB_LINE_BLOCKS
+ * @dirty:	bitmap of the blocks holding data to write
+ * @data:	data of the blocks
+ */
+struct blk_wb_line {
+	lbaint_t start;
+	u32 dirty;
+	char *data;
+};
+
+/**
+ * struct blk_wb - Write-back cache of a block device
+ *
+ * @lines:	lines, sorted by start block
+ * @count:	number of lines in use
+ * @dirty:	number of dirty blocks
+ * @buf:	buffer used to merge blocks when flushing
+ */
+struct blk_wb {
+	struct blk_wb_line lines[CONFIG_BLOCK_WRITEBACK_BLOCKS];
+	int count;
+	int dirty;
+	char *buf;
+};
+
+/* Find the first line which ends after @blk */
+static int blkwb_find(struct blk_wb *wb, lbaint_t blk)
+{
+	int lo = 0, hi = wb->count, mid;
+
+	while (lo < hi) {
+		mid = (lo + hi) / 2;
+		if (wb->lines[mid].start + BLK_WB_LINE_BLOCKS <= blk)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	return lo;
+}
+
+static struct blk_wb *blkwb_get(struct blk_desc *desc)
+{
+	struct blk_wb *wb = desc->wb;
+
+	if (wb)
+		return wb;
+
+	wb = calloc(1, sizeof(*wb));
+	if (!wb)
+		return NULL;
+	wb->buf = malloc_cache_aligned(BLK_WB_MAX_RUN * desc->blksz);
+	if (!wb->buf) {
+		free(wb);
+		return NULL;
+	}
+	desc->wb = wb;
+
+	return wb;
+}
+
+/* Get the line holding @blk, adding it if needed */
+static struct blk_wb_line *blkwb_line(struct blk_desc *desc, lbaint_t blk)
+{
+	struct blk_wb *wb = desc->wb;
+	struct blk_wb_line *line;
+	char *data;
+	int i;
+
+	i = blkwb_find(wb, blk);
+	if (i < wb->count && wb->lines[i].start <= blk)
+		return &wb->lines[i];
+	if (wb->count == ARRAY_SIZE(wb->lines))
+		return NULL;
+
+	data = malloc(BLK_WB_LINE_BLOCKS * desc->blksz);
+	if (!data)
+		return NULL;
+	line = &wb->lines[i];
+	memmove(line + 1, line, (wb->count - i) * sizeof(*line));
+	wb->count++;
+	line->start = blk - blk % BLK_WB_LINE_BLOCKS;
+	line->dirty = 0;
+	line->data = data;
+
+	return line;
+}
+
+long blkwb_write(struct blk_desc *desc, lbaint_t start, lbaint_t blkcnt,
+		 const void *buffer)
+{
+	struct blk_wb_line *line;
+	struct blk_wb *wb;
+	lbaint_t blk, n;
+	u32 mask;
+	int ret, off;
+
+	if (blkcnt >= BLK_WB_BYPASS_BLOCKS) {
+		blkwb_discard(desc, start, blkcnt);
+		return 0;
+	}
+
+	wb = blkwb_get(desc);
+	if (!wb)
+		return 0;
+
+	for (blk = start; blk < start + blkcnt; blk += n) {
+		line = blkwb_line(desc, blk);
+		if (!line) {
+			/* out of lines or memory, make room */
+			ret = blk_flush(desc);
+			if (ret)
+				return ret;
+			line = blkwb_line(desc, blk);
+			if (!line)
+				return -ENOMEM;
+		}
+
+		off = blk - line->start;
+		n = min_t(lbaint_t, BLK_WB_LINE_BLOCKS - off,
+			  start + blkcnt - blk);
+		memcpy(line->data + off * desc->blksz,
+		       buffer + (blk - start) * desc->blksz, n * desc->blksz);
+		mask = GENMASK(off + n - 1, off);
+		wb->dirty += hweight32(mask & ~line->dirty);
+		line->dirty |= mask;
+	}
+
+	/* high-water mark */
+	if (wb->dirty >= CONFIG_BLOCK_WRITEBACK_BLOCKS) {
+		ret = blk_flush(desc);
+		if (ret)
+			return ret;
+	}
+
+	return blkcnt;
+}
+
+void blkwb_read(struct blk_desc *desc, lbaint_t start, lbaint_t blkcnt,
+		void *buffer)
+{
+	struct blk_wb *wb = desc->wb;
+	struct blk_wb_line *line;
+	lbaint_t blk;
+	int i, bit;
+
+	if (!wb)
+		return;
+
+	for (i = blkwb_find(wb, start); i < wb->count; i++) {
+		line = &wb->lines[i];
+		if (line->start >= start + blkcnt)
+			break;
+		for (bit = 0; bit < BLK_WB_LINE_BLOCKS; bit++) {
+			blk = line->start + bit;
+			if (!(line->dirty & BIT(bit)) || blk < start ||
+			    blk >= start + blkcnt)
+				continue;
+			memcpy(buffer + (blk - start) * desc->blksz,
+			       line->data + bit * desc->blksz, desc->blksz);
+		}
+	}
+}
+
+void blkwb_discard(struct blk_desc *desc, lbaint_t start, lbaint_t blkcnt)
+{
+	struct blk_wb *wb = desc->wb;
+	struct blk_wb_line *line;
+	lbaint_t blk;
+	int i, bit;
+
+	if (!wb)
+		return;
+
+	/* emptied lines stay around until the next flush */
+	for (i = blkwb_find(wb, start); i < wb->count; i++) {
+		line = &wb->lines[i];
+		if (line->start >= start + blkcnt)
+			break;
+		for (bit = 0; bit < BLK_WB_LINE_BLOCKS; bit++) {
+			blk = line->start + bit;
+			if ((line->dirty & BIT(bit)) && blk >= start &&
+			    blk < start + blkcnt) {
+				line->dirty &= ~BIT(bit);
+				wb->dirty--;
+			}
+		}
+	}
+}
+
+/* Write @blkcnt merged blocks from the flush buffer */
+static int blkwb_write_run(struct blk_desc *desc, lbaint_t start,
+			   lbaint_t blkcnt)
+{
+	struct udevice *dev = desc->bdev;
+	ulong n;
+
+	n = blk_get_ops(dev)->write(dev, start, blkcnt, desc->wb->buf);
+	if (n != blkcnt) {
+		printf("%s: error writing blocks " LBAF "-" LBAF " of %s\n",
+		       __func__, start, start + blkcnt - 1, dev->name);
+		return -EIO;
+	}
+
+	return 0;
+}
+
+int blk_flush(struct blk_desc *desc)
+{
+	struct blk_wb *wb = desc->wb;
+	struct blk_wb_line *line;
+	lbaint_t blk, run_start = 0, run_len = 0;
+	int i, bit, ret = 0;
+
+	if (!wb || !wb->count)
+		return 0;
+
+	for (i = 0; i < wb->count; i++) {
+		line = &wb->lines[i];
+		for (bit = 0; bit < BLK_WB_LINE_BLOCKS; bit++) {
+			if (!(line->dirty & BIT(bit)))
+				continue;
+			blk = line->start + bit;
+			if (run_len && (blk != run_start + run_len ||
+					run_len == BLK_WB_MAX_RUN)) {
+				if (blkwb_write_run(desc, run_start, run_len))
+					ret = -EIO;
+				run_len = 0;
+			}
+			if (!run_len)
+				run_start = blk;
+			memcpy(wb->buf + run_len * desc->blksz,
+			       line->data + bit * desc->blksz, desc->blksz);
+			run_len++;
+		}
+		free(line->data);
+	}
+	if (run_len && blkwb_write_run(desc, run_start, run_len))
+		ret = -EIO;
+
+	/* failed blocks are dropped, the error is reported to the caller */
+	wb->count = 0;
+	wb->dirty = 0;
+
+	return ret;
+}
+
+int blk_flush_all(void)
+{
+	struct udevice *dev;
+	struct uclass *uc;
+	int ret = 0;
+
+	if (uclass_get(UCLASS_BLK, &uc))
+		return 0;
+
+	uclass_foreach_dev(dev, uc) {
+		if (!device_active(dev))
+			continue;
+		if (blk_flush(dev_get_uclass_platdata(dev)))
+			ret = -EIO;
+	}
+
+	return ret;
+}
+
+void blkwb_free(struct blk_desc *desc)
+{
+	if (!desc->wb)
+		return;
+
+	blk_flush(desc);
+	free(desc->wb->buf);
+	free(desc->wb);
+	desc->wb = NULL;
+}
@@ -155,6 +155,26 @@ void blkcache_invalidate(int iftype, int devnum)
 	}
 }
 
+void blkcache_invalidate_range(int iftype, int devnum, lbaint_t start,
+			       lbaint_t blkcnt)
+{
+	struct list_head *entry, *n;
+	struct block_cache_node *node;
+
+	list_for_each_safe(entry, n, &block_cache) {
+		node = (struct block_cache_node *)entry;
+		if ((node->iftype == iftype) &&
+		    (node->devnum == devnum) &&
+		    (node->start < start + blkcnt) &&
+		    (start < node->start + node->blkcnt)) {
+			list_del(entry);
+			free(node->cache);
+			free(node);
+			--_stats.entries;
+		}
+	}
+}
+
 void blkcache_configure(unsigned blocks, unsigned entries)
 {
 	struct block_cache_node *node;
@@ -136,6 +136,7 @@ int host_dev_bind(int devnum, char *filename)
 	host_dev = dev_get_platdata(dev);
 	host_dev->fd = fd;
 	host_dev->filename = fname;
+	INIT_LIST_HEAD(&host_dev->queue);
 
 	ret = device_probe(dev);
 	if (ret) {
@@ -219,15 +220,69 @@ int host_get_dev_err(int devnum, struct blk_desc **blk_devp)
 }
 
 #ifdef CONFIG_BLK
+/*
+ * Requests are queued and carried out one per poll, so that callers of the
+ * asynchronous interface see them complete later, in submission order
+ */
+static int host_block_submit(struct udevice *dev, struct blk_request *req)
+{
+	struct host_block_dev *host_dev = dev_get_platdata(dev);
+
+	list_add_tail(&req->node, &host_dev->queue);
+
+	return 0;
+}
+
+static int host_block_poll(struct udevice *dev)
+{
+	struct host_block_dev *host_dev = dev_get_platdata(dev);
+	struct blk_request *req;
+	struct list_head *pos;
+	int pending = 0;
+	long n;
+
+	if (list_empty(&host_dev->queue))
+		return 0;
+
+	req = list_first_entry(&host_dev->queue, struct blk_request, node);
+	list_del(&req->node);
+	if (req->write)
+		n = host_block_write(dev, req->start, req->blkcnt, req->buffer);
+	else
+		n = host_block_read(dev, req->start, req->blkcnt, req->buffer);
+	blk_request_done(req, n);
+
+	list_for_each(pos, &host_dev->queue)
+		pending++;
+
+	return pending;
+}
+
+static int host_block_remove(struct udevice *dev)
+{
+	struct host_block_dev *host_dev = dev_get_platdata(dev);
+	struct blk_request *req, *next;
+
+	list_for_each_entry_safe(req, next, &host_dev->queue, node) {
+		list_del(&req->node);
+		blk_request_done(req, -ENODEV);
+	}
+
+	return 0;
+}
+
 static const struct blk_ops sandbox_host_blk_ops = {
 	.read	= host_block_read,
 	.write	= host_block_write,
+	.submit	= host_block_submit,
+	.poll	= host_block_poll,
 };
 
 U_BOOT_DRIVER(sandbox_host_blk) = {
 	.name		= "sandbox_host_blk",
 	.id		= UCLASS_BLK,
 	.ops		= &sandbox_host_blk_ops,
+	.remove		= host_block_remove,
 	.platdata_auto_alloc_size = sizeof(struct host_block_dev),
 };
 #else
@@ -4,6 +4,7 @@
  */
 
 #include <common.h>
+#include <blk.h>
 #include <command.h>
 #include <env.h>
 #include <fastboot.h>
@@ -14,7 +15,8 @@
 #include <stdlib.h>
 
 /**
- * image_size - final fastboot image size
+ * image_size - final fastboot image size, 0 if the download buffer does not
+ * hold an image
  */
 static u32 image_size;
 
@@ -29,6 +31,7 @@ static u32 fastboot_bytes_received;
 static u32 fastboot_bytes_expected;
 
 static void okay(char *, char *);
+static void boot(char *, char *);
 static void getvar(char *, char *);
 static void download(char *, char *);
 #if CONFIG_IS_ENABLED(FASTBOOT_FLASH)
@@ -39,6 +42,9 @@ static void reboot_bootloader(char *, char *);
 #if CONFIG_IS_ENABLED(FASTBOOT_CMD_OEM_FORMAT)
 static void oem_format(char *, char *);
 #endif
+#if CONFIG_IS_ENABLED(FASTBOOT_FLASH_STREAM)
+static void oem_stream(char *, char *);
+#endif
 
 static const struct {
 	const char *command;
@@ -64,7 +70,7 @@ static const struct {
 #endif
 	[FASTBOOT_COMMAND_BOOT] =  {
 		.command = "boot",
-		.dispatch = okay
+		.dispatch = boot
 	},
 	[FASTBOOT_COMMAND_CONTINUE] =  {
 		.command = "continue",
@@ -88,6 +94,12 @@ static const struct {
 		.dispatch = oem_format,
 	},
 #endif
+#if CONFIG_IS_ENABLED(FASTBOOT_FLASH_STREAM)
+	[FASTBOOT_COMMAND_OEM_STREAM] = {
+		.command = "oem stream",
+		.dispatch = oem_stream,
+	},
+#endif
 };
 
 /**
@@ -138,6 +150,23 @@ static void okay(char *cmd_parameter, char *response)
 	fastboot_okay(NULL, response);
 }
 
+/**
+ * boot() - Check that there is an image to boot
+ *
+ * @cmd_parameter: Pointer to command parameter
+ * @response: Pointer to fastboot response buffer
+ *
+ * The image is booted by the transport once the OKAY response has been sent.
+ */
+static void boot(char *cmd_parameter, char *response)
+{
+	if (!image_size) {
+		fastboot_fail("no image downloaded", response);
+		return;
+	}
+	fastboot_okay(NULL, response);
+}
+
 /**
  * getvar() - Read a config/version variable
  *
@@ -163,6 +192,8 @@ static void download(char *cmd_parameter, char *response)
 		fastboot_fail("Expected command parameter", response);
 		return;
 	}
+	/* The buffer is overwritten, or unused if the download is streamed */
+	image_size = 0;
 	fastboot_bytes_received = 0;
 	fastboot_bytes_expected = simple_strtoul(cmd_parameter, &tmp, 16);
 	if (fastboot_bytes_expected == 0) {
@@ -175,6 +206,17 @@ static void download(char *cmd_parameter, char *response)
 	 *
 	 * where cmd_parameter is an 8 digit hexadecimal number
 	 */
+#if CONFIG_IS_ENABLED(FASTBOOT_FLASH_STREAM)
+	/* Streamed downloads are not limited by the buffer size */
+	if (fastboot_stream_armed()) {
+		if (fastboot_stream_start(fastboot_bytes_expected, response))
+			return;
+		printf("Starting streamed download of %d bytes\n",
+		       fastboot_bytes_expected);
+		fastboot_response("DATA", response, "%s", cmd_parameter);
+		return;
+	}
+#endif
 	if (fastboot_bytes_expected > fastboot_buf_size) {
 		fastboot_fail(cmd_parameter, response);
 	} else {
@@ -201,7 +243,8 @@ u32 fastboot_data_remaining(void)
  * @fastboot_data_len: Length of received fastboot data
  * @response: Pointer to fastboot response buffer
  *
- * Copies image data from fastboot_data to fastboot_buf_addr. Writes to
+ * Copies image data from fastboot_data to fastboot_buf_addr, or hands it
+ * to the streaming writer if the download is streamed to flash. Writes to
  * response. fastboot_bytes_received is updated to indicate the number
  * of bytes that have been transferred.
  *
@@ -223,8 +266,11 @@ void fastboot_data_download(const void *fastboot_data,
 		return;
 	}
 	/* Download data to fastboot_buf_addr */
-	memcpy(fastboot_buf_addr + fastboot_bytes_received,
-	       fastboot_data, fastboot_data_len);
+	if (fastboot_stream_active())
+		fastboot_stream_data(fastboot_data, fastboot_data_len);
+	else
+		memcpy(fastboot_buf_addr + fastboot_bytes_received,
+		       fastboot_data, fastboot_data_len);
 
 	pre_dot_num = fastboot_bytes_received / BYTES_PER_DOT;
 	fastboot_bytes_received += fastboot_data_len;
@@ -244,19 +290,39 @@ void fastboot_data_download(const void *fastboot_data,
  * @response: Pointer to fastboot response buffer
  *
  * Set image_size and ${filesize} to the total size of the downloaded image.
+ * A streamed image has already been written and is not in the download
+ * buffer, so both are set to 0 for it.
  */
 void fastboot_data_complete(char *response)
 {
+	if (fastboot_stream_active())
+		fastboot_stream_complete();
+	else
+		image_size = fastboot_bytes_received;
+
 	/* Download complete. Respond with "OKAY" */
 	fastboot_okay(NULL, response);
 	printf("\ndownloading of %d bytes finished\n", fastboot_bytes_received);
-	image_size = fastboot_bytes_received;
 	env_set_hex("filesize", image_size);
 	fastboot_bytes_expected = 0;
 	fastboot_bytes_received = 0;
 }
 
 #if CONFIG_IS_ENABLED(FASTBOOT_FLASH)
+/**
+ * flush() - write cached blocks back after a flash or erase
+ *
+ * @response: Pointer to fastboot response buffer
+ *
+ * The host may reboot or unplug the device as soon as it sees OKAY, so a
+ * successful response is turned into a failure if the flush fails.
+ */
+static void flush(char *response)
+{
+	if (blk_flush_all() && !strncmp(response, "OKAY", 4))
+		fastboot_fail("failed writing cached blocks", response);
+}
+
 /**
  * flash() - write the downloaded image to the indicated partition.
  *
@@ -264,10 +330,21 @@ void fastboot_data_complete(char *response)
  * @response: Pointer to fastboot response buffer
  *
  * Writes the previously downloaded image to the partition indicated by
- * cmd_parameter. Writes to response.
+ * cmd_parameter. Writes to response. If the image was already written while
+ * it was downloaded, only the result of that write is reported.
  */
 static void flash(char *cmd_parameter, char *response)
 {
+#if CONFIG_IS_ENABLED(FASTBOOT_FLASH_STREAM)
+	if (fastboot_stream_flash(cmd_parameter, response)) {
+		flush(response);
+		return;
+	}
+#endif
+	if (!image_size) {
+		fastboot_fail("no image downloaded", response);
+		return;
+	}
 #if CONFIG_IS_ENABLED(FASTBOOT_FLASH_MMC)
 	fastboot_mmc_flash_write(cmd_parameter, fastboot_buf_addr, image_size,
 				 response);
@@ -276,6 +353,7 @@ static void flash(char *cmd_parameter, char *response)
 	fastboot_nand_flash_write(cmd_parameter, fastboot_buf_addr, image_size,
 				  response);
 #endif
+	flush(response);
 }
 
 /**
@@ -295,6 +373,7 @@ static void erase(char *cmd_parameter, char *response)
 #if CONFIG_IS_ENABLED(FASTBOOT_FLASH_NAND)
 	fastboot_nand_erase(cmd_parameter, response);
 #endif
+	flush(response);
 }
 #endif
 
@@ -335,3 +414,16 @@ static void oem_format(char *cmd_parameter, char *response)
 	}
 }
 #endif
+
+#if CONFIG_IS_ENABLED(FASTBOOT_FLASH_STREAM)
+/**
+ * oem_stream() - Select the partition following downloads are streamed to
+ *
+ * @cmd_parameter: Pointer to partition name, empty to disable streaming
+ * @response: Pointer to fastboot response buffer
+ */
+static void oem_stream(char *cmd_parameter, char *response)
+{
+	fastboot_stream_arm(cmd_parameter, response);
+}
+#endif
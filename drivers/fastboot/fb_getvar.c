@@ -30,6 +30,9 @@ static void getvar_partition_type(char *part_name, char *response);
 static void getvar_partition_size(char *part_name, char *response);
 #endif
 static void getvar_is_userspace(char *var_parameter, char *response);
+#if CONFIG_IS_ENABLED(FASTBOOT_FLASH_STREAM)
+static void getvar_stream_flash(char *var_parameter, char *response);
+#endif
 
 static const struct {
 	const char *variable;
@@ -80,6 +83,11 @@ static const struct {
 	}, {
 		.variable = "is-userspace",
 		.dispatch = getvar_is_userspace
+#if CONFIG_IS_ENABLED(FASTBOOT_FLASH_STREAM)
+	}, {
+		.variable = "stream-flash",
+		.dispatch = getvar_stream_flash
+#endif
 	}
 };
 
@@ -250,6 +258,13 @@ static void getvar_is_userspace(char *var_parameter, char *response)
 	fastboot_okay("no", response);
 }
 
+#if CONFIG_IS_ENABLED(FASTBOOT_FLASH_STREAM)
+static void getvar_stream_flash(char *var_parameter, char *response)
+{
+	fastboot_okay("yes", response);
+}
+#endif
+
 /**
  * fastboot_getvar() - Writes variable indicated by cmd_parameter to response.
  *
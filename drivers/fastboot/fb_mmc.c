@@ -513,6 +513,50 @@ void fastboot_mmc_flash_write(const char *cmd, void *download_buffer,
 	}
 }
 
+#if CONFIG_IS_ENABLED(FASTBOOT_FLASH_STREAM)
+/**
+ * fastboot_mmc_stream_storage() - Describe an eMMC partition for streaming
+ *
+ * @part_name: Named partition the image is streamed to
+ * @storage: Pointer to returned storage description
+ * @response: Pointer to fastboot response buffer, set on error
+ * Return: 0 if OK, -ve on error
+ */
+int fastboot_mmc_stream_storage(const char *part_name,
+				struct sparse_storage *storage,
+				char *response)
+{
+	static struct fb_mmc_sparse sparse_priv;
+	struct blk_desc *dev_desc;
+	disk_partition_t info;
+
+	dev_desc = blk_get_dev("mmc", CONFIG_FASTBOOT_FLASH_MMC_DEV);
+	if (!dev_desc || dev_desc->type == DEV_TYPE_UNKNOWN) {
+		pr_err("invalid mmc device\n");
+		fastboot_fail("invalid mmc device", response);
+		return -ENODEV;
+	}
+
+	if (part_get_info_by_name_or_alias(dev_desc, part_name, &info) < 0) {
+		pr_err("cannot find partition: '%s'\n", part_name);
+		fastboot_fail("cannot find partition", response);
+		return -ENOENT;
+	}
+
+	sparse_priv.dev_desc = dev_desc;
+
+	storage->blksz = info.blksz;
+	storage->start = info.start;
+	storage->size = info.size;
+	storage->write = fb_mmc_sparse_write;
+	storage->reserve = fb_mmc_sparse_reserve;
+	storage->mssg = fastboot_fail;
+	storage->priv = &sparse_priv;
+
+	return 0;
+}
+#endif
+
 /**
  * fastboot_mmc_flash_erase() - Erase eMMC for fastboot
  *
@@ -0,0 +1,256 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Streaming flash support for fastboot
+ *
+ * When a partition has been armed with "oem stream:<partition>", the data
+ * phase of each following "download" command is written to that partition
+ * while it arrives, instead of being collected in the download buffer first.
+ * Data is gathered in a window at the start of the download buffer, which is
+ * written out each time it fills up. The write runs synchronously within the
+ * data phase, so it does not overlap with receiving, but the image size is
+ * no longer limited by the download buffer. Raw images are written as-is,
+ * Android sparse images are parsed incrementally.
+ */
+
+#include <common.h>
+#include <fastboot.h>
+#include <fastboot-internal.h>
+#include <fb_mmc.h>
+#include <image-sparse.h>
+#include <part.h>
+
+/**
+ * struct fb_stream - state of the streaming flash writer
+ *
+ * @part_name: Partition streaming is armed for, empty if disarmed
+ * @active: A download is currently being written to @part_name
+ * @done: The last download was streamed and awaits the flash command
+ * @ret: Result of the streamed write, 0 on success
+ * @msg: Response to send from the flash command if @ret is non-zero
+ * @storage: Storage backend the partition lives on
+ * @sparse: Incremental sparse parser, used if @is_sparse
+ * @typed: The image type has been determined from its first bytes
+ * @is_sparse: The image is an Android sparse image
+ * @buf: Buffer collecting data to write, at the start of the download buffer
+ * @buf_size: Size of @buf, a multiple of the storage block size
+ * @fill: Number of bytes in @buf
+ * @size: Total size of the download in bytes
+ * @blk: Next block to write for a raw image
+ */
+static struct fb_stream {
+	char part_name[PART_NAME_LEN];
+	bool active;
+	bool done;
+	int ret;
+	char msg[FASTBOOT_RESPONSE_LEN];
+	struct sparse_storage storage;
+	struct sparse_stream sparse;
+	bool typed;
+	bool is_sparse;
+	u8 *buf;
+	u32 buf_size;
+	u32 fill;
+	u32 size;
+	lbaint_t blk;
+} stream;
+
+void fastboot_stream_arm(const char *part_name, char *response)
+{
+	if (!part_name || !*part_name) {
+		stream.part_name[0] = '\0';
+		fastboot_okay("streaming disabled", response);
+		return;
+	}
+
+	if (strlen(part_name) >= sizeof(stream.part_name)) {
+		fastboot_fail("partition name too long", response);
+		return;
+	}
+	strcpy(stream.part_name, part_name);
+	fastboot_okay(NULL, response);
+}
+
+bool fastboot_stream_armed(void)
+{
+	return stream.part_name[0] != '\0';
+}
+
+bool fastboot_stream_active(void)
+{
+	return stream.active;
+}
+
+int fastboot_stream_start(u32 size, char *response)
+{
+	int ret;
+
+	stream.done = false;
+	ret = fastboot_mmc_stream_storage(stream.part_name, &stream.storage,
+					  response);
+	if (ret)
+		return ret;
+
+	stream.buf_size = min_t(u32, fastboot_buf_size,
+				CONFIG_FASTBOOT_FLASH_STREAM_BUF_SIZE);
+	stream.buf_size -= stream.buf_size % stream.storage.blksz;
+	if (!stream.buf_size) {
+		fastboot_fail("download buffer too small", response);
+		return -ENOSPC;
+	}
+	stream.buf = fastboot_buf_addr;
+	stream.fill = 0;
+	stream.size = size;
+	stream.blk = stream.storage.start;
+	stream.typed = false;
+	stream.is_sparse = false;
+	stream.ret = 0;
+	stream.msg[0] = '\0';
+	stream.active = true;
+
+	return 0;
+}
+
+static void fastboot_stream_fail(const char *reason)
+{
+	pr_err("%s\n", reason);
+	fastboot_fail(reason, stream.msg);
+	stream.ret = -EIO;
+}
+
+/**
+ * fastboot_stream_type() - Determine the image type from its first bytes
+ *
+ * @buf: Start of the image
+ * @len: Number of bytes available at @buf
+ */
+static void fastboot_stream_type(u8 *buf, u32 len)
+{
+	struct sparse_storage *storage = &stream.storage;
+
+	stream.typed = true;
+	if (len >= sizeof(sparse_header_t) && is_sparse_image(buf)) {
+		stream.is_sparse = true;
+		printf("Flashing sparse image at offset " LBAFU "\n",
+		       storage->start);
+		if (sparse_stream_init(&stream.sparse, storage,
+				       stream.part_name, stream.msg))
+			stream.ret = -ENOMEM;
+		return;
+	}
+
+	if (DIV_ROUND_UP(stream.size, storage->blksz) > storage->size) {
+		pr_err("too large for partition: '%s'\n", stream.part_name);
+		fastboot_stream_fail("too large for partition");
+		return;
+	}
+	puts("Flashing Raw Image\n");
+}
+
+/**
+ * fastboot_stream_flush() - Write out the data collected so far
+ *
+ * The buffer is free for new data once this returns.
+ */
+static void fastboot_stream_flush(void)
+{
+	struct sparse_storage *storage = &stream.storage;
+	u8 *buf = stream.buf;
+	u32 len = stream.fill;
+	lbaint_t blkcnt;
+	lbaint_t blks;
+
+	if (!len)
+		return;
+	stream.fill = 0;
+
+	if (!stream.typed)
+		fastboot_stream_type(buf, len);
+	if (stream.ret)
+		return;
+
+	if (stream.is_sparse) {
+		if (sparse_stream_write(&stream.sparse, buf, len))
+			stream.ret = -EIO;
+		return;
+	}
+
+	/* Only the last piece of a raw image can end mid-block */
+	blkcnt = DIV_ROUND_UP(len, storage->blksz);
+	memset(buf + len, '\0', blkcnt * storage->blksz - len);
+	blks = storage->write(storage, stream.blk, blkcnt, buf);
+	if (blks != blkcnt) {
+		pr_err("failed writing to device at block " LBAFU "\n",
+		       stream.blk);
+		fastboot_stream_fail("failed writing to device");
+		return;
+	}
+	stream.blk += blkcnt;
+}
+
+void fastboot_stream_data(const void *data, u32 len)
+{
+	void (*progress)(const char *msg) = fastboot_progress_callback;
+	u32 n;
+
+	/*
+	 * Writes now happen in the middle of the data phase, where the
+	 * transports must not emit INFO responses
+	 */
+	fastboot_progress_callback = NULL;
+	while (len) {
+		n = min(stream.buf_size - stream.fill, len);
+		memcpy(stream.buf + stream.fill, data, n);
+		stream.fill += n;
+		data += n;
+		len -= n;
+		if (stream.fill == stream.buf_size)
+			fastboot_stream_flush();
+	}
+	fastboot_progress_callback = progress;
+}
+
+void fastboot_stream_complete(void)
+{
+	void (*progress)(const char *msg) = fastboot_progress_callback;
+
+	fastboot_progress_callback = NULL;
+	fastboot_stream_flush();
+	fastboot_progress_callback = progress;
+
+	if (stream.is_sparse) {
+		if (sparse_stream_finish(&stream.sparse))
+			stream.ret = -EIO;
+	} else if (!stream.typed) {
+		fastboot_stream_fail("no data received");
+	} else if (!stream.ret) {
+		printf("........ wrote " LBAFU " bytes to '%s'\n",
+		       (stream.blk - stream.storage.start) *
+		       stream.storage.blksz, stream.part_name);
+	}
+
+	stream.active = false;
+	stream.done = true;
+}
+
+bool fastboot_stream_flash(const char *part_name, char *response)
+{
+	if (!stream.done)
+		return false;
+	stream.done = false;
+
+	if (!part_name || strcmp(part_name, stream.part_name)) {
+		fastboot_fail("image was streamed to another partition",
+			      response);
+		return true;
+	}
+
+	if (stream.ret) {
+		strlcpy(response, stream.msg, FASTBOOT_RESPONSE_LEN);
+		if (!*response)
+			fastboot_fail("streamed write failed", response);
+	} else {
+		fastboot_okay(NULL, response);
+	}
+
+	return true;
+}
@@ -48,9 +48,40 @@ int dm_mmc_send_cmd(struct udevice *dev, struct mmc_cmd *cmd,
 
 int mmc_send_cmd(struct mmc *mmc, struct mmc_cmd *cmd, struct mmc_data *data)
 {
+#if CONFIG_IS_ENABLED(MMC_CQE)
+	if (mmc->cqe_on) {
+		int ret;
+
+		/* A reset drops the card out of command queue mode by itself */
+		if (cmd->cmdidx == MMC_CMD_GO_IDLE_STATE) {
+			mmc->cqe_on = false;
+		} else if (cmd->cmdidx != MMC_CMD_SEND_STATUS) {
+			ret = mmc_cqe_off(mmc);
+			if (ret)
+				return ret;
+		}
+	}
+#endif
 	return dm_mmc_send_cmd(mmc->dev, cmd, data);
 }
 
+#if CONFIG_IS_ENABLED(MMC_CQE)
+int dm_mmc_cqe_request(struct udevice *dev, struct mmc_cqe_task *tasks,
+		       int count)
+{
+	struct dm_mmc_ops *ops = mmc_get_ops(dev);
+
+	if (!ops->cqe_request)
+		return -ENOSYS;
+	return ops->cqe_request(dev, tasks, count);
+}
+
+int mmc_cqe_request(struct mmc *mmc, struct mmc_cqe_task *tasks, int count)
+{
+	return dm_mmc_cqe_request(mmc->dev, tasks, count);
+}
+#endif
+
 int dm_mmc_set_ios(struct udevice *dev)
 {
 	struct dm_mmc_ops *ops = mmc_get_ops(dev);
@@ -8,6 +8,7 @@
 
 #include <config.h>
 #include <common.h>
+#include <bloblist.h>
 #include <command.h>
 #include <dm.h>
 #include <dm/device-internal.h>
@@ -368,11 +369,30 @@ int mmc_send_tuning(struct mmc *mmc, u32 opcode, int *cmd_error)
 }
 #endif
 
+int mmc_set_blockcount(struct mmc *mmc, unsigned int blockcount,
+		       bool is_rel_write)
+{
+	struct mmc_cmd cmd = {0};
+
+	cmd.cmdidx = MMC_CMD_SET_BLOCK_COUNT;
+	cmd.cmdarg = blockcount & 0x0000FFFF;
+	if (is_rel_write)
+		cmd.cmdarg |= 1 << 31;
+	cmd.resp_type = MMC_RSP_R1;
+
+	return mmc_send_cmd(mmc, &cmd, NULL);
+}
+
 static int mmc_read_blocks(struct mmc *mmc, void *dst, lbaint_t start,
 			   lbaint_t blkcnt)
 {
 	struct mmc_cmd cmd;
 	struct mmc_data data;
+	bool sbc = mmc_use_cmd23(mmc, blkcnt);
+
+	/* With a pre-defined block count the card stops on its own */
+	if (sbc && mmc_set_blockcount(mmc, blkcnt, false))
+		return 0;
 
 	if (blkcnt > 1)
 		cmd.cmdidx = MMC_CMD_READ_MULTIPLE_BLOCK;
@@ -394,7 +414,7 @@ static int mmc_read_blocks(struct mmc *mmc, void *dst, lbaint_t start,
 	if (mmc_send_cmd(mmc, &cmd, &data))
 		return 0;
 
-	if (blkcnt > 1) {
+	if (blkcnt > 1 && !sbc) {
 		cmd.cmdidx = MMC_CMD_STOP_TRANSMISSION;
 		cmd.cmdarg = 0;
 		cmd.resp_type = MMC_RSP_R1b;
@@ -419,6 +439,79 @@ static int mmc_get_b_max(struct mmc *mmc, void *dst, lbaint_t blkcnt)
 }
 #endif
 
+#if CONFIG_IS_ENABLED(MMC_CQE)
+static int mmc_cqe_on(struct mmc *mmc)
+{
+	int err;
+
+	if (mmc->cqe_on)
+		return 0;
+
+	/* Queued tasks always transfer 512-byte blocks */
+	err = mmc_set_blocklen(mmc, MMC_MAX_BLOCK_LEN);
+	if (err)
+		return err;
+
+	err = mmc_switch(mmc, EXT_CSD_CMD_SET_NORMAL, EXT_CSD_CMDQ_MODE_EN,
+			 EXT_CSD_CMDQ_MODE_ENABLED);
+	if (err)
+		return err;
+
+	mmc->cqe_on = true;
+
+	return 0;
+}
+
+int mmc_cqe_off(struct mmc *mmc)
+{
+	if (!mmc->cqe_on)
+		return 0;
+
+	/* Clear this first, so that the CMD6 below goes straight through */
+	mmc->cqe_on = false;
+
+	return mmc_switch(mmc, EXT_CSD_CMD_SET_NORMAL, EXT_CSD_CMDQ_MODE_EN, 0);
+}
+
+/*
+ * Read blocks by queueing up to cqe_depth tagged tasks at a time, so that the
+ * card can service them back to back without a command round trip between
+ * each transfer.
+ */
+static ulong mmc_cqe_read(struct mmc *mmc, void *dst, lbaint_t start,
+			  lbaint_t blkcnt, uint b_max)
+{
+	struct mmc_cqe_task tasks[MMC_CQE_MAX_DEPTH];
+	lbaint_t cur, blocks_todo = blkcnt;
+	uint task_max = min_t(uint, b_max, MMC_CQE_MAX_TASK_BLKS);
+	int count;
+
+	if (mmc_cqe_on(mmc)) {
+		pr_debug("%s: Failed to enable command queueing\n", __func__);
+		return 0;
+	}
+
+	do {
+		for (count = 0; blocks_todo && count < mmc->cqe_depth;
+		     count++) {
+			cur = min_t(lbaint_t, blocks_todo, task_max);
+			tasks[count].blk_addr = start;
+			tasks[count].blocks = cur;
+			tasks[count].dest = dst;
+			blocks_todo -= cur;
+			start += cur;
+			dst += cur * MMC_MAX_BLOCK_LEN;
+		}
+		if (mmc_cqe_request(mmc, tasks, count)) {
+			pr_debug("%s: Failed to read blocks\n", __func__);
+			return 0;
+		}
+	} while (blocks_todo > 0);
+
+	return blkcnt;
+}
+#endif
+
 #if CONFIG_IS_ENABLED(BLK)
 ulong mmc_bread(struct udevice *dev, lbaint_t start, lbaint_t blkcnt, void *dst)
 #else
@@ -457,13 +550,19 @@ ulong mmc_bread(struct blk_desc *block_dev, lbaint_t start, lbaint_t blkcnt,
 		return 0;
 	}
 
+	b_max = mmc_get_b_max(mmc, dst, blkcnt);
+
+#if CONFIG_IS_ENABLED(MMC_CQE)
+	/* RPMB accesses are not allowed in command queue mode */
+	if (mmc->cqe_depth && block_dev->hwpart != MMC_PART_RPMB)
+		return mmc_cqe_read(mmc, dst, start, blkcnt, b_max);
+#endif
+
 	if (mmc_set_blocklen(mmc, mmc->read_bl_len)) {
 		pr_debug("%s: Failed to set blocklen\n", __func__);
 		return 0;
 	}
 
-	b_max = mmc_get_b_max(mmc, dst, blkcnt);
-
 	do {
 		cur = (blocks_todo > b_max) ? b_max : blocks_todo;
 		if (mmc_read_blocks(mmc, dst, start, cur) != cur) {
@@ -2181,6 +2280,99 @@ error:
 }
 #endif
 
+#if CONFIG_IS_ENABLED(MMC_FAST_INIT)
+static struct mmc_init_rec *mmc_find_init_rec(struct mmc *mmc, bool create)
+{
+	struct mmc_init_cache *cache;
+	struct mmc_init_rec *rec, *free_rec = NULL;
+
+	if (create)
+		cache = bloblist_ensure(BLOBLISTT_MMC_INIT, sizeof(*cache));
+	else
+		cache = bloblist_find(BLOBLISTT_MMC_INIT, sizeof(*cache));
+	if (!cache)
+		return NULL;
+
+	for (rec = cache->rec; rec < cache->rec + MMC_INIT_CACHE_SIZE; rec++) {
+		if (rec->bus_width && rec->seq == mmc->dev->seq)
+			return rec;
+		if (!rec->bus_width && !free_rec)
+			free_rec = rec;
+	}
+
+	return create ? free_rec : NULL;
+}
+
+static void mmc_save_init_rec(struct mmc *mmc)
+{
+	struct mmc_init_rec *rec;
+
+	rec = mmc_find_init_rec(mmc, true);
+	if (!rec)
+		return;
+	memcpy(rec->cid, mmc->cid, sizeof(rec->cid));
+	rec->seq = mmc->dev->seq;
+	rec->is_sd = IS_SD(mmc);
+	rec->mode = mmc->selected_mode;
+	rec->bus_width = mmc->bus_width;
+}
+
+/*
+ * Go straight to the bus mode and width recorded for this card, if it is the
+ * one seen last time. The mode switch is checked in the usual way, so a stale
+ * record costs a single failed attempt before full negotiation.
+ */
+static int mmc_fast_select_mode(struct mmc *mmc)
+{
+	struct mmc_init_rec *rec;
+	uint caps;
+
+	rec = mmc_find_init_rec(mmc, false);
+	if (!rec || rec->is_sd != IS_SD(mmc) ||
+	    memcmp(rec->cid, mmc->cid, sizeof(rec->cid)))
+		return -ENOENT;
+
+	caps = MMC_CAP(rec->mode);
+	if (rec->bus_width == 8)
+		caps |= MMC_MODE_8BIT;
+	else if (rec->bus_width == 4)
+		caps |= MMC_MODE_4BIT;
+	else
+		caps |= MMC_MODE_1BIT;
+	if ((mmc->card_caps & caps) != caps)
+		return -ENOENT;
+
+	pr_debug("%s: using recorded mode %s width %d\n", mmc->cfg->name,
+		 mmc_mode_name(rec->mode), rec->bus_width);
+	if (IS_SD(mmc))
+		return sd_select_mode_and_width(mmc, caps);
+
+	return mmc_select_mode_and_width(mmc, caps);
+}
+
+/* Whether this card was recorded as eMMC, so need not be probed as SD */
+static bool mmc_known_emmc(struct mmc *mmc)
+{
+	struct mmc_init_rec *rec = mmc_find_init_rec(mmc, false);
+
+	return rec && !rec->is_sd;
+}
+#else
+static inline void mmc_save_init_rec(struct mmc *mmc)
+{
+}
+
+static inline int mmc_fast_select_mode(struct mmc *mmc)
+{
+	return -ENOENT;
+}
+
+static inline bool mmc_known_emmc(struct mmc *mmc)
+{
+	return false;
+}
+#endif
+
 #if CONFIG_IS_ENABLED(MMC_TINY)
 DEFINE_CACHE_ALIGN_BUFFER(u8, ext_csd_bkup, MMC_MAX_BLOCK_LEN);
 #endif
@@ -2380,6 +2572,16 @@ static int mmc_startup_v4(struct mmc *mmc)
 
 	mmc->wr_rel_set = ext_csd[EXT_CSD_WR_REL_SET];
 
+#if CONFIG_IS_ENABLED(MMC_CQE)
+	/* Queued tasks are block-addressed, so byte-addressed cards miss out */
+	if (mmc->version >= MMC_VERSION_5_1 && mmc->high_capacity &&
+	    (mmc->host_caps & MMC_CAP_CQE) &&
+	    (ext_csd[EXT_CSD_CMDQ_SUPPORT] & EXT_CSD_CMDQ_SUPPORTED))
+		mmc->cqe_depth = min((ext_csd[EXT_CSD_CMDQ_DEPTH] &
+				      EXT_CSD_CMDQ_DEPTH_MASK) + 1,
+				     MMC_CQE_MAX_DEPTH);
+#endif
+
 	return 0;
 error:
 	if (mmc->ext_csd) {
@@ -2565,6 +2767,9 @@ static int mmc_startup(struct mmc *mmc)
 	mmc->erase_grp_size = 1;
 #endif
 	mmc->part_config = MMCPART_NOAVAILABLE;
+#if CONFIG_IS_ENABLED(MMC_CQE)
+	mmc->cqe_depth = 0;
+#endif
 
 	err = mmc_startup_v4(mmc);
 	if (err)
@@ -2579,22 +2784,35 @@ static int mmc_startup(struct mmc *mmc)
 	mmc_select_mode(mmc, MMC_LEGACY);
 	mmc_set_bus_width(mmc, 1);
 #else
-	if (IS_SD(mmc)) {
+	if (IS_SD(mmc))
 		err = sd_get_capabilities(mmc);
-		if (err)
-			return err;
-		err = sd_select_mode_and_width(mmc, mmc->card_caps);
-	} else {
+	else
 		err = mmc_get_capabilities(mmc);
-		if (err)
-			return err;
+	if (err)
+		return err;
+
+	err = mmc_fast_select_mode(mmc);
+	if (err && IS_SD(mmc))
+		err = sd_select_mode_and_width(mmc, mmc->card_caps);
+	else if (err)
 		err = mmc_select_mode_and_width(mmc, mmc->card_caps);
-	}
 #endif
 	if (err)
 		return err;
 
 	mmc->best_mode = mmc->selected_mode;
+	if (!mmc_host_is_spi(mmc))
+		mmc_save_init_rec(mmc);
+
+	/*
+	 * SET_BLOCK_COUNT is mandatory from MMC v3.1 but optional for SD. The
+	 * CSD cannot tell v3.1 apart from other v3.x versions: SPEC_VERS 3
+	 * covers v3.1 to v3.31 and is reported as MMC_VERSION_3.
+	 */
+	mmc->cmd23 = !mmc_host_is_spi(mmc) &&
+		     (mmc->host_caps & MMC_CAP_CMD23) &&
+		     (IS_SD(mmc) ? !!(mmc->scr[0] & SD_SCR_CMD23_SUPPORT) :
+		      mmc->version >= MMC_VERSION_3);
 
 	/* Fix the block length for DDR mode */
 	if (mmc->ddr_mode) {
@@ -2823,6 +3041,15 @@ retry:
 	/* The internal partition reset to user partition(0) at every CMD0*/
 	mmc_get_blk_desc(mmc)->hwpart = 0;
 
+	/* Skip the SD probing, and its timeouts, for a known eMMC device */
+	if (mmc_known_emmc(mmc)) {
+		if (!mmc_send_op_cond(mmc))
+			return 0;
+		err = mmc_go_idle(mmc);
+		if (err)
+			return err;
+	}
+
 	/* Test for SD version 2 */
 	err = mmc_send_if_cond(mmc);
 
@@ -16,6 +16,27 @@ int mmc_send_status(struct mmc *mmc, unsigned int *status);
 int mmc_poll_for_busy(struct mmc *mmc, int timeout);
 
 int mmc_set_blocklen(struct mmc *mmc, int len);
+int mmc_set_blockcount(struct mmc *mmc, unsigned int blockcount,
+		       bool is_rel_write);
+
+/* Whether a multi-block transfer of @blkcnt blocks is announced with CMD23 */
+static inline bool mmc_use_cmd23(struct mmc *mmc, lbaint_t blkcnt)
+{
+	return mmc->cmd23 && blkcnt > 1 && blkcnt <= MMC_MAX_SET_BLOCK_COUNT;
+}
+
+#if CONFIG_IS_ENABLED(MMC_CQE)
+/**
+ * mmc_cqe_off() - Take the card out of command queue mode
+ *
+ * Legacy commands other than SEND_STATUS are not accepted while the card is
+ * in command queue mode, so this must be called before sending them.
+ *
+ * @mmc:	MMC device
+ * @return 0 if OK, -ve on error
+ */
+int mmc_cqe_off(struct mmc *mmc);
+#endif
 #ifdef CONFIG_FSL_ESDHC_ADAPTER_IDENT
 void mmc_adapter_card_type_ident(void);
 #endif
@@ -10,30 +10,110 @@
 #include <fdtdec.h>
 #include <mmc.h>
 #include <asm/test.h>
+#include <asm/unaligned.h>
 
 struct sandbox_mmc_plat {
 	struct mmc_config cfg;
 	struct mmc mmc;
+	bool emmc;
 };
 
+#define MMC_CSIZE 0
+#define MMC_CMULT 8 /* 8 because the card is high-capacity */
+#define MMC_BL_LEN_SHIFT 10
+#define MMC_BL_LEN BIT(MMC_BL_LEN_SHIFT)
+#define MMC_CAPACITY (((MMC_CSIZE + 1) << (MMC_CMULT + 2)) \
+		      * MMC_BL_LEN) /* 1 MiB */
+
+/* Largest transfer the eMMC personality accepts, to get several queued tasks */
+#define MMC_EMMC_B_MAX		128
+#define MMC_EMMC_CMDQ_DEPTH	16
+
 /**
- * sandbox_mmc_send_cmd() - Emulate SD commands
+ * struct sandbox_mmc_priv - private data for the emulated card
  *
- * This emulate an SD card version 2. Single-block reads result in zero data.
- * Multiple-block reads return a test string.
+ * @buf:	Card contents
+ * @ext_csd:	Extended CSD register (eMMC personality only)
+ * @blk_count:	Block count announced by SET_BLOCK_COUNT, 0 if none
+ * @sbc_count:	Number of transfers which used SET_BLOCK_COUNT
+ * @stop_count:	Number of STOP_TRANSMISSION commands received
+ * @max_tasks:	Largest number of tasks in one command-queue request
+ * @erase_start:	First block of the erase range, as sent by the host
+ * @erase_end:	Last block of the erase range, as sent by the host
+ */
+struct sandbox_mmc_priv {
+	u8 buf[MMC_CAPACITY];
+	u8 ext_csd[MMC_MAX_BLOCK_LEN];
+	uint blk_count;
+	uint sbc_count;
+	uint stop_count;
+	uint max_tasks;
+	ulong erase_start;
+	ulong erase_end;
+};
+
+/* Check a data transfer against a preceding SET_BLOCK_COUNT, if any */
+static int sandbox_mmc_check_sbc(struct sandbox_mmc_priv *priv,
+				 struct mmc_data *data)
+{
+	uint blk_count = priv->blk_count;
+
+	if (!blk_count)
+		return 0;
+	priv->blk_count = 0;
+	if (data->blocks != blk_count)
+		return -EINVAL;
+	priv->sbc_count++;
+
+	return 0;
+}
+
+/**
+ * sandbox_mmc_send_cmd() - Emulate SD and eMMC commands
+ *
+ * This emulates an SD card version 2 with 1 MiB of memory, or an eMMC 5.1
+ * device of the same size if the node has a "sandbox,emmc" property. The
+ * memory initially holds a test string in the first block.
  */
 static int sandbox_mmc_send_cmd(struct udevice *dev, struct mmc_cmd *cmd,
 				struct mmc_data *data)
 {
+	struct sandbox_mmc_plat *plat = dev_get_platdata(dev);
+	struct sandbox_mmc_priv *priv = dev_get_priv(dev);
+	struct mmc *mmc = mmc_get_mmc_dev(dev);
+	ulong erase_start, erase_end;
+	int ret;
+
+	/* Only queued tasks and status queries are allowed in queue mode */
+	if ((priv->ext_csd[EXT_CSD_CMDQ_MODE_EN] & EXT_CSD_CMDQ_MODE_ENABLED) &&
+	    data) {
+		debug("%s: Command %d in command queue mode\n", __func__,
+		      cmd->cmdidx);
+		return -EINVAL;
+	}
+
 	switch (cmd->cmdidx) {
 	case MMC_CMD_ALL_SEND_CID:
 		memset(cmd->response, '\0', sizeof(cmd->response));
 		break;
 	case SD_CMD_SEND_RELATIVE_ADDR:
 		cmd->response[0] = 0 << 16; /* mmc->rca */
+		break;
 	case MMC_CMD_GO_IDLE_STATE:
+		priv->ext_csd[EXT_CSD_CMDQ_MODE_EN] = 0;
+		break;
+	case MMC_CMD_SEND_OP_COND:
+		cmd->response[0] = OCR_BUSY | OCR_HCS | MMC_VDD_32_33 |
+				   MMC_VDD_33_34;
 		break;
 	case SD_CMD_SEND_IF_COND:
+		/* For eMMC this is SEND_EXT_CSD */
+		if (plat->emmc) {
+			if (!data)
+				return -ETIMEDOUT;
+			memcpy(data->dest, priv->ext_csd, MMC_MAX_BLOCK_LEN);
+			break;
+		}
 		cmd->response[0] = 0xaa;
 		break;
 	case MMC_CMD_SEND_STATUS:
@@ -43,13 +123,23 @@ static int sandbox_mmc_send_cmd(struct udevice *dev, struct mmc_cmd *cmd,
 		break;
 	case MMC_CMD_SEND_CSD:
 		cmd->response[0] = 0;
-		cmd->response[1] = 10 << 16;	/* 1 << block_len */
-		cmd->response[2] = 0;
+		cmd->response[1] = (MMC_BL_LEN_SHIFT << 16) |
+				   ((MMC_CSIZE >> 16) & 0x3f);
+		cmd->response[2] = (MMC_CSIZE & 0xffff) << 16;
 		cmd->response[3] = 0;
+		if (plat->emmc) {
+			cmd->response[0] |= 4 << 26; /* MMC version 4 */
+			cmd->response[3] = MMC_BL_LEN_SHIFT << 22;
+		}
 		break;
 	case SD_CMD_SWITCH_FUNC: {
-		if (!data)
+		/* For eMMC this is SWITCH, writing a byte of the EXT_CSD */
+		if (!data) {
+			if (plat->emmc)
+				priv->ext_csd[(cmd->cmdarg >> 16) & 0xff] =
+					(cmd->cmdarg >> 8) & 0xff;
 			break;
+		}
 		u32 *resp = (u32 *)data->dest;
 		resp[3] = 0;
 		resp[7] = cpu_to_be32(SD_HIGHSPEED_BUSY);
@@ -58,12 +148,59 @@ static int sandbox_mmc_send_cmd(struct udevice *dev, struct mmc_cmd *cmd,
 		break;
 	}
 	case MMC_CMD_READ_SINGLE_BLOCK:
-		memset(data->dest, '\0', data->blocksize);
+	case MMC_CMD_READ_MULTIPLE_BLOCK: {
+		ulong pos = cmd->cmdarg;
+
+		if (mmc->high_capacity)
+			pos *= mmc->read_bl_len;
+		if (pos + data->blocks * data->blocksize > MMC_CAPACITY)
+			return -ERANGE;
+		ret = sandbox_mmc_check_sbc(priv, data);
+		if (ret)
+			return ret;
+		memcpy(data->dest, &priv->buf[pos],
+		       data->blocks * data->blocksize);
 		break;
-	case MMC_CMD_READ_MULTIPLE_BLOCK:
-		strcpy(data->dest, "this is a test");
+	}
+	case MMC_CMD_WRITE_SINGLE_BLOCK:
+	case MMC_CMD_WRITE_MULTIPLE_BLOCK: {
+		ulong pos = cmd->cmdarg;
+
+		if (mmc->high_capacity)
+			pos *= mmc->write_bl_len;
+		if (pos + data->blocks * data->blocksize > MMC_CAPACITY)
+			return -ERANGE;
+		ret = sandbox_mmc_check_sbc(priv, data);
+		if (ret)
+			return ret;
+		memcpy(&priv->buf[pos], data->src,
+		       data->blocks * data->blocksize);
 		break;
+	}
 	case MMC_CMD_STOP_TRANSMISSION:
+		priv->stop_count++;
+		break;
+	case MMC_CMD_SET_BLOCK_COUNT:
+		priv->blk_count = cmd->cmdarg & 0xffff;
+		break;
+	case SD_CMD_ERASE_WR_BLK_START:
+		priv->erase_start = cmd->cmdarg;
+		break;
+	case SD_CMD_ERASE_WR_BLK_END:
+		priv->erase_end = cmd->cmdarg;
+		break;
+	case MMC_CMD_ERASE:
+		erase_start = priv->erase_start;
+		erase_end = priv->erase_end;
+		if (mmc->high_capacity) {
+			erase_start *= mmc->write_bl_len;
+			erase_end *= mmc->write_bl_len;
+		}
+		if (erase_end + mmc->write_bl_len > MMC_CAPACITY ||
+		    erase_start > erase_end)
+			return -ERANGE;
+		memset(&priv->buf[erase_start], 0,
+		       erase_end - erase_start + mmc->write_bl_len);
 		break;
 	case SD_CMD_APP_SEND_OP_COND:
 		cmd->response[0] = OCR_BUSY | OCR_HCS;
@@ -71,6 +208,9 @@ static int sandbox_mmc_send_cmd(struct udevice *dev, struct mmc_cmd *cmd,
 		cmd->response[2] = 0;
 		break;
 	case MMC_CMD_APP_CMD:
+		/* eMMC devices do not answer, which tells them apart from SD */
+		if (plat->emmc)
+			return -ETIMEDOUT;
 		break;
 	case MMC_CMD_SET_BLOCKLEN:
 		debug("block len %d\n", cmd->cmdarg);
@@ -78,7 +218,8 @@ static int sandbox_mmc_send_cmd(struct udevice *dev, struct mmc_cmd *cmd,
 	case SD_CMD_APP_SEND_SCR: {
 		u32 *scr = (u32 *)data->dest;
 
-		scr[0] = cpu_to_be32(2 << 24 | 1 << 15);  /* SD version 3 */
+		/* SD version 3, with SET_BLOCK_COUNT */
+		scr[0] = cpu_to_be32(2 << 24 | 1 << 15 | SD_SCR_CMD23_SUPPORT);
 		break;
 	}
 	default:
@@ -99,15 +240,68 @@ static int sandbox_mmc_get_cd(struct udevice *dev)
 	return 1;
 }
 
+#if CONFIG_IS_ENABLED(MMC_CQE)
+static int sandbox_mmc_cqe_request(struct udevice *dev,
+				   struct mmc_cqe_task *tasks, int count)
+{
+	struct sandbox_mmc_priv *priv = dev_get_priv(dev);
+	struct mmc_cqe_task *task;
+	ulong pos, len;
+
+	if (!(priv->ext_csd[EXT_CSD_CMDQ_MODE_EN] & EXT_CSD_CMDQ_MODE_ENABLED))
+		return -EINVAL;
+	if (count > MMC_EMMC_CMDQ_DEPTH)
+		return -EINVAL;
+
+	for (task = tasks; task < tasks + count; task++) {
+		pos = (ulong)task->blk_addr * MMC_MAX_BLOCK_LEN;
+		len = task->blocks * MMC_MAX_BLOCK_LEN;
+		if (pos + len > MMC_CAPACITY)
+			return -ERANGE;
+		memcpy(task->dest, &priv->buf[pos], len);
+	}
+	priv->max_tasks = max_t(uint, priv->max_tasks, count);
+
+	return 0;
+}
+#endif
+
 static const struct dm_mmc_ops sandbox_mmc_ops = {
 	.send_cmd = sandbox_mmc_send_cmd,
 	.set_ios = sandbox_mmc_set_ios,
 	.get_cd = sandbox_mmc_get_cd,
+#if CONFIG_IS_ENABLED(MMC_CQE)
+	.cqe_request = sandbox_mmc_cqe_request,
+#endif
 };
 
+void sandbox_mmc_get_counts(struct udevice *dev, uint *sbc_countp,
+			    uint *stop_countp, uint *max_tasksp)
+{
+	struct sandbox_mmc_priv *priv = dev_get_priv(dev);
+
+	*sbc_countp = priv->sbc_count;
+	*stop_countp = priv->stop_count;
+	*max_tasksp = priv->max_tasks;
+}
+
 int sandbox_mmc_probe(struct udevice *dev)
 {
 	struct sandbox_mmc_plat *plat = dev_get_platdata(dev);
+	struct sandbox_mmc_priv *priv = dev_get_priv(dev);
+	u8 *ext_csd = priv->ext_csd;
+
+	strcpy((char *)priv->buf, "this is a test");
+
+	if (plat->emmc) {
+		ext_csd[EXT_CSD_REV] = 8; /* eMMC 5.1 */
+		ext_csd[EXT_CSD_CARD_TYPE] = EXT_CSD_CARD_TYPE_52 |
+					     EXT_CSD_CARD_TYPE_26;
+		put_unaligned_le32(MMC_CAPACITY / MMC_MAX_BLOCK_LEN,
+				   &ext_csd[EXT_CSD_SEC_CNT]);
+		ext_csd[EXT_CSD_CMDQ_SUPPORT] = EXT_CSD_CMDQ_SUPPORTED;
+		ext_csd[EXT_CSD_CMDQ_DEPTH] = MMC_EMMC_CMDQ_DEPTH - 1;
+	}
 
 	return mmc_init(&plat->mmc);
 }
@@ -117,12 +311,19 @@ int sandbox_mmc_bind(struct udevice *dev)
 	struct sandbox_mmc_plat *plat = dev_get_platdata(dev);
 	struct mmc_config *cfg = &plat->cfg;
 
+	plat->emmc = dev_read_bool(dev, "sandbox,emmc");
+
 	cfg->name = dev->name;
-	cfg->host_caps = MMC_MODE_HS_52MHz | MMC_MODE_HS | MMC_MODE_8BIT;
+	cfg->host_caps = MMC_MODE_HS_52MHz | MMC_MODE_HS | MMC_MODE_8BIT |
+			 MMC_CAP_CMD23;
 	cfg->voltages = MMC_VDD_165_195 | MMC_VDD_32_33 | MMC_VDD_33_34;
 	cfg->f_min = 1000000;
 	cfg->f_max = 52000000;
 	cfg->b_max = U32_MAX;
+	if (plat->emmc) {
+		cfg->host_caps |= MMC_CAP_CQE;
+		cfg->b_max = MMC_EMMC_B_MAX;
+	}
 
 	return mmc_bind(dev, &plat->mmc, cfg);
 }
@@ -148,4 +349,5 @@ U_BOOT_DRIVER(mmc_sandbox) = {
 	.unbind		= sandbox_mmc_unbind,
 	.probe		= sandbox_mmc_probe,
 	.platdata_auto_alloc_size = sizeof(struct sandbox_mmc_plat),
+	.priv_auto_alloc_size = sizeof(struct sandbox_mmc_priv),
 };
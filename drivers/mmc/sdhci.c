@@ -12,6 +12,7 @@
 #include <dm.h>
 #include <errno.h>
 #include <malloc.h>
+#include <mapmem.h>
 #include <mmc.h>
 #include <sdhci.h>
 #include <dm.h>
@@ -704,6 +705,228 @@ static int sdhci_get_cd(struct udevice *dev)
 		return value;
 }
 
+#if CONFIG_IS_ENABLED(MMC_SDHCI_CQE)
+#define CQHCI_TIMEOUT_MS	10000
+#define CQHCI_HALT_TIMEOUT_MS	100
+
+static inline void cqhci_writel(struct sdhci_host *host, u32 val, int reg)
+{
+	writel(val, host->cqe_base + reg);
+}
+
+static inline u32 cqhci_readl(struct sdhci_host *host, int reg)
+{
+	return readl(host->cqe_base + reg);
+}
+
+/* Transfer and link descriptors use the ADMA2 layout, ADMA_DESC_LEN apart */
+static void sdhci_cqe_set_desc(u8 *ptr, u8 attr, dma_addr_t addr, u16 len)
+{
+	struct sdhci_adma_desc *desc = (struct sdhci_adma_desc *)ptr;
+
+	desc->attr = ADMA_DESC_ATTR_VALID | attr;
+	desc->len = len;
+	desc->reserved = 0;
+	desc->addr_lo = lower_32_bits(addr);
+#ifdef CONFIG_DMA_ADDR_T_64BIT
+	desc->addr_hi = upper_32_bits(addr);
+#endif
+}
+
+static dma_addr_t sdhci_cqe_prep_task(struct sdhci_host *host, int tag,
+				      struct mmc_cqe_task *task)
+{
+	u8 *slot = host->cqe_tdl + tag * CQHCI_SLOT_SZ;
+	u8 *trans = host->cqe_trans + tag * CQHCI_SLOT_DESCS * ADMA_DESC_LEN;
+	uint len = task->blocks * MMC_MAX_BLOCK_LEN;
+	dma_addr_t dma_addr, addr;
+	u64 td;
+
+	td = CQHCI_TD_VALID | CQHCI_TD_END | CQHCI_TD_INT |
+	     CQHCI_TD_ACT_TASK | CQHCI_TD_DATA_DIR_READ |
+	     CQHCI_TD_BLK_COUNT(task->blocks) |
+	     CQHCI_TD_BLK_ADDR(task->blk_addr);
+	memset(slot, 0, ADMA_DESC_LEN);
+	*(__le64 *)slot = cpu_to_le64(td);
+
+	dma_addr = dma_map_single(task->dest, len, DMA_FROM_DEVICE);
+	for (addr = dma_addr; len > ADMA_MAX_LEN; addr += ADMA_MAX_LEN) {
+		sdhci_cqe_set_desc(trans, ADMA_DESC_TRANSFER_DATA, addr,
+				   ADMA_MAX_LEN);
+		trans += ADMA_DESC_LEN;
+		len -= ADMA_MAX_LEN;
+	}
+	sdhci_cqe_set_desc(trans, ADMA_DESC_TRANSFER_DATA | ADMA_DESC_ATTR_END,
+			   addr, len);
+
+	/* The link descriptor follows the task descriptor in the slot */
+	sdhci_cqe_set_desc(slot + ADMA_DESC_LEN, ADMA_DESC_LINK_DESC,
+			   (dma_addr_t)(host->cqe_trans +
+					tag * CQHCI_SLOT_DESCS * ADMA_DESC_LEN),
+			   0);
+
+	return dma_addr;
+}
+
+static void sdhci_cqe_enable(struct sdhci_host *host)
+{
+	dma_addr_t tdl = (dma_addr_t)host->cqe_tdl;
+	u32 cfg;
+	u8 ctrl;
+
+	/* The engine runs ADMA2 transfers from its own descriptor lists */
+	ctrl = sdhci_readb(host, SDHCI_HOST_CONTROL);
+	ctrl &= ~SDHCI_CTRL_DMA_MASK;
+	if (host->flags & USE_ADMA64)
+		ctrl |= SDHCI_CTRL_ADMA64;
+	else
+		ctrl |= SDHCI_CTRL_ADMA32;
+	sdhci_writeb(host, ctrl, SDHCI_HOST_CONTROL);
+	sdhci_writew(host, SDHCI_MAKE_BLKSZ(SDHCI_DEFAULT_BOUNDARY_ARG,
+					    MMC_MAX_BLOCK_LEN),
+		     SDHCI_BLOCK_SIZE);
+	sdhci_writeb(host, 0xe, SDHCI_TIMEOUT_CONTROL);
+	sdhci_writel(host, SDHCI_INT_CQE | SDHCI_INT_ERROR_MASK,
+		     SDHCI_INT_ENABLE);
+
+	/* The configuration can only be changed while the engine is off */
+	cfg = cqhci_readl(host, CQHCI_CFG);
+	cfg &= ~(CQHCI_ENABLE | CQHCI_DCMD | CQHCI_TASK_DESC_SZ);
+	cqhci_writel(host, cfg, CQHCI_CFG);
+	if (host->flags & USE_ADMA64)
+		cfg |= CQHCI_TASK_DESC_SZ;
+	cqhci_writel(host, cfg, CQHCI_CFG);
+
+	cqhci_writel(host, lower_32_bits(tdl), CQHCI_TDLBA);
+	cqhci_writel(host, upper_32_bits(tdl), CQHCI_TDLBAU);
+	cqhci_writel(host, host->mmc->rca, CQHCI_SSC2);
+
+	/* Completion is polled, so latch the status but signal nothing */
+	cqhci_writel(host, CQHCI_IS_MASK, CQHCI_IS);
+	cqhci_writel(host, CQHCI_IS_MASK, CQHCI_ISTE);
+	cqhci_writel(host, 0, CQHCI_ISGE);
+
+	cqhci_writel(host, cfg | CQHCI_ENABLE, CQHCI_CFG);
+	cqhci_writel(host, 0, CQHCI_CTL);
+}
+
+static void sdhci_cqe_disable(struct sdhci_host *host, bool error)
+{
+	ulong start = get_timer(0);
+
+	cqhci_writel(host, CQHCI_HALT, CQHCI_CTL);
+	while (!(cqhci_readl(host, CQHCI_CTL) & CQHCI_HALT)) {
+		if (get_timer(start) > CQHCI_HALT_TIMEOUT_MS) {
+			printf("%s: Command queue halt timed out\n", __func__);
+			break;
+		}
+		udelay(10);
+	}
+	if (error)
+		cqhci_writel(host, CQHCI_HALT | CQHCI_CLEAR_ALL_TASKS,
+			     CQHCI_CTL);
+
+	cqhci_writel(host, cqhci_readl(host, CQHCI_CFG) & ~CQHCI_ENABLE,
+		     CQHCI_CFG);
+	cqhci_writel(host, CQHCI_IS_MASK, CQHCI_IS);
+	cqhci_writel(host, cqhci_readl(host, CQHCI_TCN), CQHCI_TCN);
+
+	sdhci_writel(host, SDHCI_INT_ALL_MASK, SDHCI_INT_STATUS);
+	sdhci_writel(host, SDHCI_INT_DATA_MASK | SDHCI_INT_CMD_MASK,
+		     SDHCI_INT_ENABLE);
+	if (error)
+		sdhci_reset(host, SDHCI_RESET_CMD | SDHCI_RESET_DATA);
+}
+
+static int sdhci_cqe_request(struct udevice *dev, struct mmc_cqe_task *tasks,
+			     int count)
+{
+	struct mmc *mmc = mmc_get_mmc_dev(dev);
+	struct sdhci_host *host = mmc->priv;
+	dma_addr_t dma_addr[CQHCI_NUM_SLOTS];
+	u32 pending = 0, done = 0, status, tcn;
+	ulong start;
+	int i, ret = 0;
+
+	if (!host->cqe_base)
+		return -ENOSYS;
+	if (count > CQHCI_NUM_SLOTS)
+		return -EINVAL;
+
+	for (i = 0; i < count; i++) {
+		if (tasks[i].blocks > MMC_CQE_MAX_TASK_BLKS)
+			return -EINVAL;
+		dma_addr[i] = sdhci_cqe_prep_task(host, i, &tasks[i]);
+		pending |= BIT(i);
+	}
+	flush_cache((dma_addr_t)host->cqe_tdl,
+		    ROUND(CQHCI_TDL_SZ, ARCH_DMA_MINALIGN));
+	flush_cache((dma_addr_t)host->cqe_trans,
+		    ROUND(CQHCI_TRANS_SZ, ARCH_DMA_MINALIGN));
+
+	sdhci_cqe_enable(host);
+	cqhci_writel(host, pending, CQHCI_TDBR);
+
+	/* Allow for slow cards by only timing out when nothing completes */
+	start = get_timer(0);
+	while (done != pending) {
+		status = cqhci_readl(host, CQHCI_IS);
+		if (status & CQHCI_IS_ERROR) {
+			printf("%s: Command queue error, status 0x%x task 0x%x\n",
+			       __func__, status,
+			       cqhci_readl(host, CQHCI_TERRI));
+			ret = -EIO;
+			break;
+		}
+		tcn = cqhci_readl(host, CQHCI_TCN);
+		if (tcn) {
+			cqhci_writel(host, tcn, CQHCI_TCN);
+			done |= tcn;
+			start = get_timer(0);
+		} else if (get_timer(start) > CQHCI_TIMEOUT_MS) {
+			printf("%s: Command queue timed out, done 0x%x\n",
+			       __func__, done);
+			ret = -ETIMEDOUT;
+			break;
+		}
+	}
+
+	sdhci_cqe_disable(host, ret != 0);
+
+	for (i = 0; i < count; i++)
+		dma_unmap_single(dma_addr[i],
+				 tasks[i].blocks * MMC_MAX_BLOCK_LEN,
+				 DMA_FROM_DEVICE);
+
+	return ret;
+}
+
+static int sdhci_cqe_setup(struct mmc_config *cfg, struct sdhci_host *host)
+{
+	fdt_addr_t addr;
+
+	if (!host->cqe_base) {
+		addr = dev_read_addr_name(host->mmc->dev, "cqhci");
+		if (addr == FDT_ADDR_T_NONE)
+			return 0;
+		host->cqe_base = map_sysmem(addr, 0);
+	}
+
+	/* Align the task list to its own size, as some engines require */
+	host->cqe_tdl = memalign(max(ARCH_DMA_MINALIGN, CQHCI_TDL_SZ),
+				 CQHCI_TDL_SZ);
+	host->cqe_trans = memalign(ARCH_DMA_MINALIGN, CQHCI_TRANS_SZ);
+	if (!host->cqe_tdl || !host->cqe_trans)
+		return -ENOMEM;
+	memset(host->cqe_tdl, 0, CQHCI_TDL_SZ);
+	memset(host->cqe_trans, 0, CQHCI_TRANS_SZ);
+
+	cfg->host_caps |= MMC_CAP_CQE;
+
+	return 0;
+}
+#endif
+
 const struct dm_mmc_ops sdhci_ops = {
 	.send_cmd	= sdhci_send_command,
 	.set_ios	= sdhci_set_ios,
@@ -712,6 +935,9 @@ const struct dm_mmc_ops sdhci_ops = {
 #ifdef MMC_SUPPORTS_TUNING
 	.execute_tuning	= sdhci_execute_tuning,
 #endif
+#if CONFIG_IS_ENABLED(MMC_SDHCI_CQE)
+	.cqe_request	= sdhci_cqe_request,
+#endif
 };
 #else
 static const struct mmc_ops sdhci_ops = {
@@ -827,6 +1053,10 @@ int sdhci_setup_cfg(struct mmc_config *cfg, struct sdhci_host *host,
 	if (host->quirks & SDHCI_QUIRK_BROKEN_VOLTAGE)
 		cfg->voltages |= host->voltages;
 
+	/*
+	 * CMD23 is not set here since some controllers mishandle it. Drivers
+	 * which support it add MMC_CAP_CMD23 to host->host_caps.
+	 */
 	cfg->host_caps |= MMC_MODE_HS | MMC_MODE_HS_52MHz | MMC_MODE_4BIT;
 
 	/* Since Host Controller Version3.0 */
@@ -867,7 +1097,11 @@ int sdhci_setup_cfg(struct mmc_config *cfg, struct sdhci_host *host,
 
 	cfg->b_max = CONFIG_SYS_MMC_MAX_BLK_COUNT;
 
+#if CONFIG_IS_ENABLED(MMC_SDHCI_CQE)
+	return sdhci_cqe_setup(cfg, host);
+#else
 	return 0;
+#endif
 }
 
 #ifdef CONFIG_BLK
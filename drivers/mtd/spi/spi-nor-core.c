@@ -71,6 +71,23 @@ static int spi_nor_write_reg(struct spi_nor *nor, u8 opcode, u8 *buf, int len)
 	return spi_nor_read_write_reg(nor, &op, buf);
 }
 
+static void spi_nor_ra_invalidate(struct spi_nor *nor)
+{
+	nor->ra_len = 0;
+}
+
+static void spi_nor_setup_read_op(struct spi_nor *nor, struct spi_mem_op *op)
+{
+	/* get transfer protocols. */
+	op->cmd.buswidth = spi_nor_get_protocol_inst_nbits(nor->read_proto);
+	op->addr.buswidth = spi_nor_get_protocol_addr_nbits(nor->read_proto);
+	op->dummy.buswidth = op->addr.buswidth;
+	op->data.buswidth = spi_nor_get_protocol_data_nbits(nor->read_proto);
+
+	/* convert the dummy cycles to the number of bytes */
+	op->dummy.nbytes = (nor->read_dummy * op->dummy.buswidth) / 8;
+}
+
 static ssize_t spi_nor_read_data(struct spi_nor *nor, loff_t from, size_t len,
 				 u_char *buf)
 {
@@ -82,14 +99,12 @@ static ssize_t spi_nor_read_data(struct spi_nor *nor, loff_t from, size_t len,
 	size_t remaining = len;
 	int ret;
 
-	/* get transfer protocols. */
-	op.cmd.buswidth = spi_nor_get_protocol_inst_nbits(nor->read_proto);
-	op.addr.buswidth = spi_nor_get_protocol_addr_nbits(nor->read_proto);
-	op.dummy.buswidth = op.addr.buswidth;
-	op.data.buswidth = spi_nor_get_protocol_data_nbits(nor->read_proto);
+#ifdef CONFIG_SPI_FLASH_DIRMAP
+	if (nor->dirmap_rdesc)
+		return spi_mem_dirmap_read(nor->dirmap_rdesc, from, len, buf);
+#endif
 
-	/* convert the dummy cycles to the number of bytes */
-	op.dummy.nbytes = (nor->read_dummy * op.dummy.buswidth) / 8;
+	spi_nor_setup_read_op(nor, &op);
 
 	while (remaining) {
 		op.data.nbytes = remaining < UINT_MAX ? remaining : UINT_MAX;
@@ -555,6 +570,8 @@ static int spi_nor_erase(struct mtd_info *mtd, struct erase_info *instr)
 	if (!instr->len)
 		return 0;
 
+	spi_nor_ra_invalidate(nor);
+
 	div_u64_rem(instr->len, mtd->erasesize, &rem);
 	if (rem)
 		return -EINVAL;
@@ -904,14 +921,11 @@ static const struct flash_info *spi_nor_read_id(struct spi_nor *nor)
 	return ERR_PTR(-ENODEV);
 }
 
-static int spi_nor_read(struct mtd_info *mtd, loff_t from, size_t len,
-			size_t *retlen, u_char *buf)
+static int spi_nor_read_raw(struct spi_nor *nor, loff_t from, size_t len,
+			    size_t *retlen, u_char *buf)
 {
-	struct spi_nor *nor = mtd_to_spi_nor(mtd);
 	int ret;
 
-	dev_dbg(nor->dev, "from 0x%08x, len %zd\n", (u32)from, len);
-
 	while (len) {
 		loff_t addr = from;
 		size_t read_len = len;
@@ -953,6 +967,47 @@ read_err:
 	return ret;
 }
 
+/*
+ * Serve a small read from the read-ahead buffer, refilling it from @from if
+ * the requested range is not already held there.
+ */
+static int spi_nor_ra_read(struct spi_nor *nor, loff_t from, size_t len,
+			   size_t *retlen, u_char *buf)
+{
+	size_t fill_len, fill_retlen = 0;
+	int ret;
+
+	if (from < nor->ra_from || from + len > nor->ra_from + nor->ra_len) {
+		fill_len = min_t(u64, CONFIG_SPI_FLASH_READAHEAD_SIZE,
+				 nor->mtd.size - from);
+		spi_nor_ra_invalidate(nor);
+		ret = spi_nor_read_raw(nor, from, fill_len, &fill_retlen,
+				       nor->ra_buf);
+		if (ret)
+			return ret;
+		nor->ra_from = from;
+		nor->ra_len = fill_len;
+	}
+
+	memcpy(buf, nor->ra_buf + (from - nor->ra_from), len);
+	*retlen += len;
+
+	return 0;
+}
+
+static int spi_nor_read(struct mtd_info *mtd, loff_t from, size_t len,
+			size_t *retlen, u_char *buf)
+{
+	struct spi_nor *nor = mtd_to_spi_nor(mtd);
+
+	dev_dbg(nor->dev, "from 0x%08x, len %zd\n", (u32)from, len);
+
+	if (nor->ra_buf && len < CONFIG_SPI_FLASH_READAHEAD_SIZE)
+		return spi_nor_ra_read(nor, from, len, retlen, buf);
+
+	return spi_nor_read_raw(nor, from, len, retlen, buf);
+}
+
 #ifdef CONFIG_SPI_FLASH_SST
 /*
  * sst26 flash series has its own block protection implementation:
@@ -1159,6 +1214,7 @@ static int sst_write(struct mtd_info *mtd, loff_t to, size_t len,
 	int ret;
 
 	dev_dbg(nor->dev, "to 0x%08x, len %zd\n", (u32)to, len);
+	spi_nor_ra_invalidate(nor);
 	if (spi->mode & SPI_TX_BYTE)
 		return sst_write_byteprogram(nor, to, len, retlen, buf);
 
@@ -1238,6 +1294,8 @@ static int spi_nor_write(struct mtd_info *mtd, loff_t to, size_t len,
 	if (!len)
 		return 0;
 
+	spi_nor_ra_invalidate(nor);
+
 	for (i = 0; i < len; ) {
 		ssize_t written;
 		loff_t addr = to + i;
@@ -2468,6 +2526,32 @@ static int spi_nor_init(struct spi_nor *nor)
 	return 0;
 }
 
+#ifdef CONFIG_SPI_FLASH_DIRMAP
+static int spi_nor_create_read_dirmap(struct spi_nor *nor)
+{
+	struct spi_mem_dirmap_info info = {
+		.op_tmpl = SPI_MEM_OP(SPI_MEM_OP_CMD(nor->read_opcode, 1),
+				      SPI_MEM_OP_ADDR(nor->addr_width, 0, 1),
+				      SPI_MEM_OP_DUMMY(nor->read_dummy, 1),
+				      SPI_MEM_OP_DATA_IN(0, NULL, 1)),
+		.offset = 0,
+		.length = nor->mtd.size,
+	};
+
+	spi_nor_setup_read_op(nor, &info.op_tmpl);
+
+	nor->dirmap_rdesc = spi_mem_dirmap_create(nor->spi, &info);
+	if (IS_ERR(nor->dirmap_rdesc)) {
+		int ret = PTR_ERR(nor->dirmap_rdesc);
+
+		nor->dirmap_rdesc = NULL;
+		return ret;
+	}
+
+	return 0;
+}
+#endif
+
 int spi_nor_scan(struct spi_nor *nor)
 {
 	struct spi_nor_flash_parameter params;
@@ -2628,6 +2712,19 @@ int spi_nor_scan(struct spi_nor *nor)
 	nor->erase_size = mtd->erasesize;
 	nor->sector_size = mtd->erasesize;
 
+#ifdef CONFIG_SPI_FLASH_DIRMAP
+	/* Only data reads go through the mapping, so this is not fatal */
+	if (spi_nor_create_read_dirmap(nor))
+		dev_dbg(nor->dev, "no direct mapping, using regular reads\n");
+#endif
+
+	/* Read-ahead is only an optimisation, so carry on without it */
+	nor->ra_len = 0;
+	if (CONFIG_SPI_FLASH_READAHEAD_SIZE && !nor->ra_buf)
+		nor->ra_buf = devm_kmalloc(nor->dev,
+					   CONFIG_SPI_FLASH_READAHEAD_SIZE,
+					   GFP_KERNEL);
+
 #ifndef CONFIG_SPL_BUILD
 	printf("SF: Detected %s with page size ", nor->name);
 	print_size(nor->page_size, ", erase size ");
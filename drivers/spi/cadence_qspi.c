@@ -281,6 +281,43 @@ static int cadence_spi_mem_exec_op(struct spi_slave *spi,
 	return err;
 }
 
+static int cadence_spi_mem_dirmap_create(struct spi_mem_dirmap_desc *desc)
+{
+	struct udevice *bus = desc->slave->dev->parent;
+	struct cadence_spi_platdata *plat = bus->platdata;
+
+	/* Only the AHB window in direct access mode can be mapped */
+	if (!plat->use_dac_mode ||
+	    desc->info.offset + desc->info.length > plat->ahbsize)
+		return -ENOTSUPP;
+
+	return 0;
+}
+
+static ssize_t cadence_spi_mem_dirmap_read(struct spi_mem_dirmap_desc *desc,
+					   u64 offs, size_t len, void *buf)
+{
+	struct udevice *bus = desc->slave->dev->parent;
+	struct cadence_spi_platdata *plat = bus->platdata;
+	struct cadence_spi_priv *priv = dev_get_priv(bus);
+	struct spi_mem_op op = desc->info.op_tmpl;
+	int err;
+
+	op.addr.val = desc->info.offset + offs;
+	op.data.nbytes = len;
+	op.data.buf.in = buf;
+
+	cadence_qspi_apb_chipselect(priv->regbase,
+				    spi_chip_select(desc->slave->dev),
+				    plat->is_decoded_cs);
+
+	err = cadence_qspi_apb_read_setup(plat, &op);
+	if (!err)
+		err = cadence_qspi_apb_read_execute(plat, &op);
+
+	return err ? err : len;
+}
+
 static int cadence_spi_ofdata_to_platdata(struct udevice *bus)
 {
 	struct cadence_spi_platdata *plat = bus->platdata;
@@ -329,6 +366,8 @@ static int cadence_spi_ofdata_to_platdata(struct udevice *bus)
 
 static const struct spi_controller_mem_ops cadence_spi_mem_ops = {
 	.exec_op = cadence_spi_mem_exec_op,
+	.dirmap_create = cadence_spi_mem_dirmap_create,
+	.dirmap_read = cadence_spi_mem_dirmap_read,
 };
 
 static const struct dm_spi_ops cadence_spi_ops = {
@@ -14,6 +14,7 @@
 #include <dm.h>
 #include <malloc.h>
 #include <spi.h>
+#include <spi-mem.h>
 #include <spi_flash.h>
 #include <os.h>
 
@@ -26,6 +27,25 @@
 # define CONFIG_SPI_IDLE_VAL 0xFF
 #endif
 
+/* Maximum length of the command, address and dummy bytes of a mapped read */
+#define SANDBOX_SPI_MAX_HDR_LEN	8
+
+/**
+ * struct sandbox_spi_priv - Private data for the sandbox SPI bus
+ *
+ * @dirmap_reads: Number of reads served through a direct mapping
+ */
+struct sandbox_spi_priv {
+	uint dirmap_reads;
+};
+
+uint sandbox_spi_get_dirmap_reads(struct udevice *bus)
+{
+	struct sandbox_spi_priv *priv = dev_get_priv(bus);
+
+	return priv->dirmap_reads;
+}
+
 const char *sandbox_spi_parse_spec(const char *arg, unsigned long *bus,
 				   unsigned long *cs)
 {
@@ -132,12 +152,60 @@ static int sandbox_spi_get_mmap(struct udevice *dev, ulong *map_basep,
 	return 0;
 }
 
+static int sandbox_spi_dirmap_create(struct spi_mem_dirmap_desc *desc)
+{
+	/* The command, address and dummy bytes must fit in the header */
+	if (sizeof(desc->info.op_tmpl.cmd.opcode) +
+	    desc->info.op_tmpl.addr.nbytes +
+	    desc->info.op_tmpl.dummy.nbytes > SANDBOX_SPI_MAX_HDR_LEN)
+		return -ENOTSUPP;
+
+	return 0;
+}
+
+/*
+ * Emulate a memory-mapped window: the whole request is streamed from the
+ * emulator in a single transaction, with no FIFO-size splitting.
+ */
+static ssize_t sandbox_spi_dirmap_read(struct spi_mem_dirmap_desc *desc,
+				       u64 offs, size_t len, void *buf)
+{
+	const struct spi_mem_op *tmpl = &desc->info.op_tmpl;
+	struct udevice *dev = desc->slave->dev;
+	struct sandbox_spi_priv *priv = dev_get_priv(dev->parent);
+	u8 hdr[SANDBOX_SPI_MAX_HDR_LEN];
+	u64 addr = desc->info.offset + offs;
+	uint pos = 0;
+	int ret, i;
+
+	hdr[pos++] = tmpl->cmd.opcode;
+	for (i = 0; i < tmpl->addr.nbytes; i++)
+		hdr[pos++] = addr >> (8 * (tmpl->addr.nbytes - i - 1));
+	memset(hdr + pos, 0xff, tmpl->dummy.nbytes);
+	pos += tmpl->dummy.nbytes;
+
+	ret = sandbox_spi_xfer(dev, pos * 8, hdr, NULL, SPI_XFER_BEGIN);
+	if (!ret)
+		ret = sandbox_spi_xfer(dev, len * 8, NULL, buf, SPI_XFER_END);
+	if (ret)
+		return ret;
+	priv->dirmap_reads++;
+
+	return len;
+}
+
+static const struct spi_controller_mem_ops sandbox_spi_mem_ops = {
+	.dirmap_create	= sandbox_spi_dirmap_create,
+	.dirmap_read	= sandbox_spi_dirmap_read,
+};
+
 static const struct dm_spi_ops sandbox_spi_ops = {
 	.xfer		= sandbox_spi_xfer,
 	.set_speed	= sandbox_spi_set_speed,
 	.set_mode	= sandbox_spi_set_mode,
 	.cs_info	= sandbox_cs_info,
 	.get_mmap	= sandbox_spi_get_mmap,
+	.mem_ops	= &sandbox_spi_mem_ops,
 };
 
 static const struct udevice_id sandbox_spi_ids[] = {
@@ -150,4 +218,5 @@ U_BOOT_DRIVER(spi_sandbox) = {
 	.id	= UCLASS_SPI,
 	.of_match = sandbox_spi_ids,
 	.ops	= &sandbox_spi_ops,
+	.priv_auto_alloc_size = sizeof(struct sandbox_spi_priv),
 };
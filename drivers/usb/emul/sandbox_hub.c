@@ -10,7 +10,7 @@
 #include <dm/device-internal.h>
 
 /* We only support up to 8 */
-#define SANDBOX_NUM_PORTS	4
+#define SANDBOX_NUM_PORTS	5
 
 struct sandbox_hub_platdata {
 	struct usb_dev_platdata plat;
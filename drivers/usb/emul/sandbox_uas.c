@@ -0,0 +1,483 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Sandbox emulation of a USB Attached SCSI (UAS) disk
+ */
+
+#include <common.h>
+#include <dm.h>
+#include <malloc.h>
+#include <scsi.h>
+#include <usb.h>
+#include <usb/uas.h>
+#include <asm/test.h>
+#include <asm/unaligned.h>
+
+/*
+ * This driver emulates a RAM-backed disk using the USB 2.0 flavour of UAS,
+ * i.e. without bulk streams. Command IUs are queued as they arrive and
+ * served newest first, so that the host sees commands complete out of order.
+ * It supports only a single logical unit number (LUN 0).
+ */
+
+enum {
+	SANDBOX_UAS_EP_CMD		= 1,	/* endpoints */
+	SANDBOX_UAS_EP_STATUS		= 2,
+	SANDBOX_UAS_EP_DATA_IN		= 3,
+	SANDBOX_UAS_EP_DATA_OUT		= 4,
+
+	SANDBOX_UAS_BLOCK_LEN		= 512,
+	SANDBOX_UAS_BLOCKS		= 2048,
+	SANDBOX_UAS_MAX_CMDS		= 16,
+
+	SANDBOX_UAS_CHECK_CONDITION	= 0x02,	/* SCSI status */
+};
+
+enum {
+	STRINGID_MANUFACTURER = 1,
+	STRINGID_PRODUCT,
+	STRINGID_SERIAL,
+
+	STRINGID_COUNT,
+};
+
+/**
+ * struct sandbox_uas_cmd - a command queued on the device
+ *
+ * @tag:	Tag from the command IU
+ * @cdb:	Command descriptor block
+ * @ready:	true once READY has been sent and the data phase is under way
+ * @data_done:	true once the data phase has completed
+ * @status:	SCSI status to report in the SENSE IU
+ * @pos:	Byte offset into the backing store for read/write commands
+ * @len:	Number of bytes of data to transfer, 0 if none
+ * @write:	true if data flows from host to device
+ * @resp:	Response data for commands which don't access the disk
+ */
+struct sandbox_uas_cmd {
+	u16 tag;
+	u8 cdb[UAS_MAX_CDB_LEN];
+	bool ready;
+	bool data_done;
+	u8 status;
+	ulong pos;
+	int len;
+	bool write;
+	u8 resp[36];
+};
+
+/**
+ * struct sandbox_uas_priv - private state for this driver
+ *
+ * @cmd:	Queued commands, oldest first
+ * @num_cmds:	Number of entries in @cmd
+ * @max_queued:	Largest number of commands seen queued at once
+ * @short_data:	true to move one block less in the next read/write data phase
+ * @disk:	Backing store of the disk
+ */
+struct sandbox_uas_priv {
+	struct sandbox_uas_cmd cmd[SANDBOX_UAS_MAX_CMDS];
+	int num_cmds;
+	int max_queued;
+	bool short_data;
+	u8 *disk;
+};
+
+struct sandbox_uas_plat {
+	struct usb_string uas_strings[STRINGID_COUNT];
+};
+
+static struct usb_device_descriptor uas_device_desc = {
+	.bLength =		sizeof(uas_device_desc),
+	.bDescriptorType =	USB_DT_DEVICE,
+
+	.bcdUSB =		__constant_cpu_to_le16(0x0200),
+
+	.bDeviceClass =		0,
+	.bDeviceSubClass =	0,
+	.bDeviceProtocol =	0,
+
+	.idVendor =		__constant_cpu_to_le16(0x1234),
+	.idProduct =		__constant_cpu_to_le16(0x5679),
+	.iManufacturer =	STRINGID_MANUFACTURER,
+	.iProduct =		STRINGID_PRODUCT,
+	.iSerialNumber =	STRINGID_SERIAL,
+	.bNumConfigurations =	1,
+};
+
+static struct usb_config_descriptor uas_config0 = {
+	.bLength		= sizeof(uas_config0),
+	.bDescriptorType	= USB_DT_CONFIG,
+
+	/* wTotalLength is set up by usb-emul-uclass */
+	.bNumInterfaces		= 1,
+	.bConfigurationValue	= 0,
+	.iConfiguration		= 0,
+	.bmAttributes		= 1 << 7,
+	.bMaxPower		= 50,
+};
+
+static struct usb_interface_descriptor uas_interface0 = {
+	.bLength		= sizeof(uas_interface0),
+	.bDescriptorType	= USB_DT_INTERFACE,
+
+	.bInterfaceNumber	= 0,
+	.bAlternateSetting	= 0,
+	.bNumEndpoints		= 4,
+	.bInterfaceClass	= USB_CLASS_MASS_STORAGE,
+	.bInterfaceSubClass	= US_SC_SCSI,
+	.bInterfaceProtocol	= US_PR_UAS,
+	.iInterface		= 0,
+};
+
+static struct usb_endpoint_descriptor uas_endpoint_cmd = {
+	.bLength		= USB_DT_ENDPOINT_SIZE,
+	.bDescriptorType	= USB_DT_ENDPOINT,
+
+	.bEndpointAddress	= SANDBOX_UAS_EP_CMD,
+	.bmAttributes		= USB_ENDPOINT_XFER_BULK,
+	.wMaxPacketSize		= __constant_cpu_to_le16(512),
+	.bInterval		= 0,
+};
+
+static struct usb_pipe_usage_descriptor uas_pipe_cmd = {
+	.bLength		= sizeof(uas_pipe_cmd),
+	.bDescriptorType	= USB_DT_PIPE_USAGE,
+	.bPipeID		= UAS_PIPE_ID_CMD,
+};
+
+static struct usb_endpoint_descriptor uas_endpoint_status = {
+	.bLength		= USB_DT_ENDPOINT_SIZE,
+	.bDescriptorType	= USB_DT_ENDPOINT,
+
+	.bEndpointAddress	= SANDBOX_UAS_EP_STATUS | USB_ENDPOINT_DIR_MASK,
+	.bmAttributes		= USB_ENDPOINT_XFER_BULK,
+	.wMaxPacketSize		= __constant_cpu_to_le16(512),
+	.bInterval		= 0,
+};
+
+static struct usb_pipe_usage_descriptor uas_pipe_status = {
+	.bLength		= sizeof(uas_pipe_status),
+	.bDescriptorType	= USB_DT_PIPE_USAGE,
+	.bPipeID		= UAS_PIPE_ID_STATUS,
+};
+
+static struct usb_endpoint_descriptor uas_endpoint_data_in = {
+	.bLength		= USB_DT_ENDPOINT_SIZE,
+	.bDescriptorType	= USB_DT_ENDPOINT,
+
+	.bEndpointAddress	= SANDBOX_UAS_EP_DATA_IN | USB_ENDPOINT_DIR_MASK,
+	.bmAttributes		= USB_ENDPOINT_XFER_BULK,
+	.wMaxPacketSize		= __constant_cpu_to_le16(512),
+	.bInterval		= 0,
+};
+
+static struct usb_pipe_usage_descriptor uas_pipe_data_in = {
+	.bLength		= sizeof(uas_pipe_data_in),
+	.bDescriptorType	= USB_DT_PIPE_USAGE,
+	.bPipeID		= UAS_PIPE_ID_DATA_IN,
+};
+
+static struct usb_endpoint_descriptor uas_endpoint_data_out = {
+	.bLength		= USB_DT_ENDPOINT_SIZE,
+	.bDescriptorType	= USB_DT_ENDPOINT,
+
+	.bEndpointAddress	= SANDBOX_UAS_EP_DATA_OUT,
+	.bmAttributes		= USB_ENDPOINT_XFER_BULK,
+	.wMaxPacketSize		= __constant_cpu_to_le16(512),
+	.bInterval		= 0,
+};
+
+static struct usb_pipe_usage_descriptor uas_pipe_data_out = {
+	.bLength		= sizeof(uas_pipe_data_out),
+	.bDescriptorType	= USB_DT_PIPE_USAGE,
+	.bPipeID		= UAS_PIPE_ID_DATA_OUT,
+};
+
+static void *uas_desc_list[] = {
+	&uas_device_desc,
+	&uas_config0,
+	&uas_interface0,
+	&uas_endpoint_cmd,
+	&uas_pipe_cmd,
+	&uas_endpoint_status,
+	&uas_pipe_status,
+	&uas_endpoint_data_in,
+	&uas_pipe_data_in,
+	&uas_endpoint_data_out,
+	&uas_pipe_data_out,
+	NULL,
+};
+
+static int sandbox_uas_control(struct udevice *dev, struct usb_device *udev,
+			       unsigned long pipe, void *buff, int len,
+			       struct devrequest *setup)
+{
+	debug("pipe=%lx, request=%x\n", pipe, setup->request);
+
+	return -EIO;
+}
+
+/**
+ * setup_command() - work out what a newly queued command will do
+ *
+ * @plat:	Sandbox UAS platform data
+ * @cmd:	Command to set up; its CDB has been filled in
+ */
+static void setup_command(struct sandbox_uas_plat *plat,
+			  struct sandbox_uas_cmd *cmd)
+{
+	u64 lba = 0;
+	u32 count = 0;
+
+	cmd->status = 0;
+	cmd->len = 0;
+	cmd->write = false;
+
+	switch (cmd->cdb[0]) {
+	case SCSI_TST_U_RDY:
+		return;
+	case SCSI_INQUIRY:
+		memset(cmd->resp, '\0', sizeof(cmd->resp));
+		cmd->resp[2] = 6;		/* SPC-4 */
+		cmd->resp[3] = 2;		/* response data format */
+		cmd->resp[4] = sizeof(cmd->resp) - 5;
+		strncpy((char *)&cmd->resp[8],
+			plat->uas_strings[STRINGID_MANUFACTURER - 1].s, 8);
+		strncpy((char *)&cmd->resp[16],
+			plat->uas_strings[STRINGID_PRODUCT - 1].s, 16);
+		strncpy((char *)&cmd->resp[32], "1.0", 4);
+		cmd->len = min_t(int, cmd->cdb[4], sizeof(cmd->resp));
+		return;
+	case SCSI_RD_CAPAC10:
+		put_unaligned_be32(SANDBOX_UAS_BLOCKS - 1, &cmd->resp[0]);
+		put_unaligned_be32(SANDBOX_UAS_BLOCK_LEN, &cmd->resp[4]);
+		cmd->len = 8;
+		return;
+	case SCSI_READ10:
+	case SCSI_WRITE10:
+		lba = get_unaligned_be32(&cmd->cdb[2]);
+		count = get_unaligned_be16(&cmd->cdb[7]);
+		break;
+	case UAS_SCSI_READ16:
+	case UAS_SCSI_WRITE16:
+		lba = get_unaligned_be64(&cmd->cdb[2]);
+		count = get_unaligned_be32(&cmd->cdb[10]);
+		break;
+	default:
+		debug("Command not supported: %x\n", cmd->cdb[0]);
+		cmd->status = SANDBOX_UAS_CHECK_CONDITION;
+		return;
+	}
+
+	if (lba + count > SANDBOX_UAS_BLOCKS) {
+		cmd->status = SANDBOX_UAS_CHECK_CONDITION;
+		return;
+	}
+	cmd->pos = lba * SANDBOX_UAS_BLOCK_LEN;
+	cmd->len = count * SANDBOX_UAS_BLOCK_LEN;
+	cmd->write = cmd->cdb[0] == SCSI_WRITE10 ||
+		     cmd->cdb[0] == UAS_SCSI_WRITE16;
+}
+
+static int handle_command(struct sandbox_uas_plat *plat,
+			  struct sandbox_uas_priv *priv, const void *buff,
+			  int len)
+{
+	const struct uas_command_iu *iu = buff;
+	struct sandbox_uas_cmd *cmd;
+
+	if (len != sizeof(*iu) || iu->iu_id != UAS_IU_ID_COMMAND)
+		return -EIO;
+	if (priv->num_cmds == SANDBOX_UAS_MAX_CMDS)
+		return -EIO;
+
+	cmd = &priv->cmd[priv->num_cmds++];
+	memset(cmd, '\0', sizeof(*cmd));
+	cmd->tag = be16_to_cpu(iu->tag);
+	memcpy(cmd->cdb, iu->cdb, sizeof(cmd->cdb));
+	setup_command(plat, cmd);
+	priv->max_queued = max(priv->max_queued, priv->num_cmds);
+
+	return len;
+}
+
+/* Find the command currently in its data phase, if any */
+static struct sandbox_uas_cmd *find_active(struct sandbox_uas_priv *priv)
+{
+	int i;
+
+	for (i = 0; i < priv->num_cmds; i++) {
+		if (priv->cmd[i].ready)
+			return &priv->cmd[i];
+	}
+
+	return NULL;
+}
+
+static void remove_command(struct sandbox_uas_priv *priv,
+			   struct sandbox_uas_cmd *cmd)
+{
+	int idx = cmd - priv->cmd;
+
+	memmove(cmd, cmd + 1, (priv->num_cmds - idx - 1) * sizeof(*cmd));
+	priv->num_cmds--;
+}
+
+static int handle_status(struct sandbox_uas_priv *priv, void *buff, int len)
+{
+	struct uas_sense_iu *iu = buff;
+	struct sandbox_uas_cmd *cmd;
+
+	if (len < UAS_READY_IU_LEN)
+		return -EIO;
+
+	cmd = find_active(priv);
+	if (cmd && !cmd->data_done)
+		return -EIO;	/* host must move the data first */
+	if (!cmd) {
+		if (!priv->num_cmds)
+			return -EIO;
+		/* Serve the newest command first */
+		cmd = &priv->cmd[priv->num_cmds - 1];
+		if (cmd->len && !cmd->status) {
+			memset(iu, '\0', UAS_READY_IU_LEN);
+			iu->iu_id = cmd->write ? UAS_IU_ID_WRITE_READY :
+				UAS_IU_ID_READ_READY;
+			iu->tag = cpu_to_be16(cmd->tag);
+			cmd->ready = true;
+
+			return UAS_READY_IU_LEN;
+		}
+	}
+
+	len = min_t(int, len, offsetof(struct uas_sense_iu, sense));
+	memset(iu, '\0', len);
+	iu->iu_id = UAS_IU_ID_STATUS;
+	iu->tag = cpu_to_be16(cmd->tag);
+	iu->status = cmd->status;
+	remove_command(priv, cmd);
+
+	return len;
+}
+
+static int handle_data(struct sandbox_uas_priv *priv, void *buff, int len,
+		       bool write)
+{
+	struct sandbox_uas_cmd *cmd = find_active(priv);
+	bool resp;
+
+	if (!cmd || cmd->data_done || cmd->write != write)
+		return -EIO;
+	len = min(len, cmd->len);
+	resp = cmd->cdb[0] == SCSI_INQUIRY || cmd->cdb[0] == SCSI_RD_CAPAC10;
+	if (!resp && priv->short_data && len > SANDBOX_UAS_BLOCK_LEN) {
+		/* Leave the status good, as a faulty device would */
+		len -= SANDBOX_UAS_BLOCK_LEN;
+		priv->short_data = false;
+	}
+	if (resp)
+		memcpy(buff, cmd->resp, len);
+	else if (write)
+		memcpy(priv->disk + cmd->pos, buff, len);
+	else
+		memcpy(buff, priv->disk + cmd->pos, len);
+	cmd->data_done = true;
+
+	return len;
+}
+
+static int sandbox_uas_bulk(struct udevice *dev, struct usb_device *udev,
+			    unsigned long pipe, void *buff, int len)
+{
+	struct sandbox_uas_plat *plat = dev_get_platdata(dev);
+	struct sandbox_uas_priv *priv = dev_get_priv(dev);
+	int ep = usb_pipeendpoint(pipe);
+
+	debug("%s: dev=%s, pipe=%lx, ep=%x, len=%x\n", __func__, dev->name,
+	      pipe, ep, len);
+	switch (ep) {
+	case SANDBOX_UAS_EP_CMD:
+		return handle_command(plat, priv, buff, len);
+	case SANDBOX_UAS_EP_STATUS:
+		return handle_status(priv, buff, len);
+	case SANDBOX_UAS_EP_DATA_IN:
+		return handle_data(priv, buff, len, false);
+	case SANDBOX_UAS_EP_DATA_OUT:
+		return handle_data(priv, buff, len, true);
+	}
+
+	return -EIO;
+}
+
+int sandbox_usb_uas_max_queued(struct udevice *dev)
+{
+	struct sandbox_uas_priv *priv = dev_get_priv(dev);
+
+	return priv->max_queued;
+}
+
+void sandbox_usb_uas_short_data(struct udevice *dev)
+{
+	struct sandbox_uas_priv *priv = dev_get_priv(dev);
+
+	priv->short_data = true;
+}
+
+static int sandbox_uas_bind(struct udevice *dev)
+{
+	struct sandbox_uas_plat *plat = dev_get_platdata(dev);
+	struct usb_string *fs;
+
+	fs = plat->uas_strings;
+	fs[0].id = STRINGID_MANUFACTURER;
+	fs[0].s = "sandbox";
+	fs[1].id = STRINGID_PRODUCT;
+	fs[1].s = "uas";
+	fs[2].id = STRINGID_SERIAL;
+	fs[2].s = dev->name;
+
+	return usb_emul_setup_device(dev, plat->uas_strings, uas_desc_list);
+}
+
+static int sandbox_uas_probe(struct udevice *dev)
+{
+	struct sandbox_uas_priv *priv = dev_get_priv(dev);
+
+	priv->disk = calloc(SANDBOX_UAS_BLOCKS, SANDBOX_UAS_BLOCK_LEN);
+	if (!priv->disk)
+		return -ENOMEM;
+	strcpy((char *)priv->disk, "this is a uas test");
+
+	return 0;
+}
+
+static int sandbox_uas_remove(struct udevice *dev)
+{
+	struct sandbox_uas_priv *priv = dev_get_priv(dev);
+
+	free(priv->disk);
+
+	return 0;
+}
+
+static const struct dm_usb_ops sandbox_usb_uas_ops = {
+	.control	= sandbox_uas_control,
+	.bulk		= sandbox_uas_bulk,
+};
+
+static const struct udevice_id sandbox_usb_uas_ids[] = {
+	{ .compatible = "sandbox,usb-uas" },
+	{ }
+};
+
+U_BOOT_DRIVER(usb_sandbox_uas) = {
+	.name	= "usb_sandbox_uas",
+	.id	= UCLASS_USB_EMUL,
+	.of_match = sandbox_usb_uas_ids,
+	.bind	= sandbox_uas_bind,
+	.probe	= sandbox_uas_probe,
+	.remove	= sandbox_uas_remove,
+	.ops	= &sandbox_usb_uas_ops,
+	.priv_auto_alloc_size = sizeof(struct sandbox_uas_priv),
+	.platdata_auto_alloc_size = sizeof(struct sandbox_uas_plat),
+};
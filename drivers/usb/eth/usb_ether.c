@@ -72,9 +72,14 @@ int usb_ether_register(struct udevice *dev, struct ueth_data *ueth, int rxsize)
 	}
 
 	ueth->rxsize = rxsize;
-	ueth->rxbuf = memalign(ARCH_DMA_MINALIGN, rxsize);
-	if (!ueth->rxbuf)
+	ueth->rxbufs = memalign(ARCH_DMA_MINALIGN,
+				USB_ETHER_RX_QUEUE *
+				ALIGN(rxsize, ARCH_DMA_MINALIGN));
+	if (!ueth->rxbufs)
 		return -ENOMEM;
+	ueth->rxbuf = ueth->rxbufs;
+	ueth->rxhead = 0;
+	ueth->rxqueued = 0;
 
 	ret = usb_set_interface(udev, iface_desc->bInterfaceNumber, ifnum);
 	if (ret) {
@@ -89,20 +94,59 @@ int usb_ether_register(struct udevice *dev, struct ueth_data *ueth, int rxsize)
 
 int usb_ether_deregister(struct ueth_data *ueth)
 {
+	int i;
+
+	if (!ueth->pusb_dev)
+		return 0;
+	for (i = 0; i < ueth->rxqueued; i++)
+		usb_bulk_cancel(ueth->pusb_dev,
+				&ueth->rxreq[(ueth->rxhead + i) %
+					     USB_ETHER_RX_QUEUE]);
+	ueth->rxqueued = 0;
+
 	return 0;
 }
 
 int usb_ether_receive(struct ueth_data *ueth, int rxsize)
 {
+	struct usb_bulk_req *req;
 	int actual_len;
-	int ret;
+	int ret = 0;
+	int i;
 
 	if (rxsize > ueth->rxsize)
 		return -EINVAL;
-	ret = usb_bulk_msg(ueth->pusb_dev,
-			   usb_rcvbulkpipe(ueth->pusb_dev, ueth->ep_in),
-			   ueth->rxbuf, rxsize, &actual_len,
-			   USB_BULK_RECV_TIMEOUT);
+
+	/*
+	 * Top up the receive queue. The buffer returned last time has been
+	 * processed by now, so it can be queued again.
+	 */
+	while (ueth->rxqueued < USB_ETHER_RX_QUEUE) {
+		i = (ueth->rxhead + ueth->rxqueued) % USB_ETHER_RX_QUEUE;
+		req = &ueth->rxreq[i];
+		req->pipe = usb_rcvbulkpipe(ueth->pusb_dev, ueth->ep_in);
+		req->buffer = ueth->rxbufs +
+			i * ALIGN(ueth->rxsize, ARCH_DMA_MINALIGN);
+		req->length = rxsize;
+		ret = usb_bulk_submit(ueth->pusb_dev, req);
+		if (ret)
+			break;
+		ueth->rxqueued++;
+	}
+	if (!ueth->rxqueued) {
+		printf("Rx: failed to queue: %d\n", ret);
+		return ret;
+	}
+
+	/* Packets arrive in the order in which the transfers were queued */
+	req = &ueth->rxreq[ueth->rxhead];
+	ret = usb_bulk_reap(ueth->pusb_dev, req, USB_BULK_RECV_TIMEOUT);
+	if (ret == -ETIMEDOUT)
+		return -EAGAIN;
+	ueth->rxhead = (ueth->rxhead + 1) % USB_ETHER_RX_QUEUE;
+	ueth->rxqueued--;
+	ueth->rxbuf = req->buffer;
+	actual_len = req->act_len;
 	debug("Rx: len = %u, actual = %u, err = %d\n", rxsize, actual_len, ret);
 	if (ret) {
 		printf("Rx: failed to receive: %d\n", ret);
@@ -7,10 +7,26 @@
 #include <common.h>
 #include <dm.h>
 #include <usb.h>
+#include <asm/test.h>
 #include <dm/root.h>
+#include <linux/list.h>
 
+/**
+ * struct sandbox_usb_ctrl - private data for the sandbox USB controller
+ *
+ * @rootdev:	USB address of the root hub
+ * @queue:	true to queue bulk requests until they are reaped, false to let
+ *		the uclass send them synchronously
+ * @reqs:	list of queued bulk requests, oldest first
+ * @queued:	number of requests in @reqs
+ * @max_queued:	largest value @queued has reached
+ */
 struct sandbox_usb_ctrl {
 	int rootdev;
+	bool queue;
+	struct list_head reqs;
+	int queued;
+	int max_queued;
 };
 
 static void usbmon_trace(struct udevice *bus, ulong pipe,
@@ -97,6 +113,101 @@ static int sandbox_submit_bulk(struct udevice *bus, struct usb_device *udev,
 	return ret;
 }
 
+static bool sandbox_same_ep(struct usb_bulk_req *a, struct usb_bulk_req *b)
+{
+	const ulong mask = USB_PIPE_DEV_MASK | USB_PIPE_EP_MASK | USB_DIR_IN;
+
+	return (a->pipe & mask) == (b->pipe & mask);
+}
+
+static void sandbox_retire_bulk(struct udevice *bus, struct usb_device *udev,
+				struct usb_bulk_req *req, bool run)
+{
+	struct sandbox_usb_ctrl *ctrl = dev_get_priv(bus);
+	int ret;
+
+	list_del(&req->hc_node);
+	ctrl->queued--;
+	req->done = true;
+	if (!run) {
+		req->status = USB_ST_NOT_PROC;
+		return;
+	}
+	ret = sandbox_submit_bulk(bus, udev, req->pipe, req->buffer,
+				  req->length);
+	if (ret < 0) {
+		req->act_len = 0;
+		req->status = ret == -EPIPE ? USB_ST_STALLED : USB_ST_CRC_ERR;
+	} else {
+		req->act_len = ret;
+		req->status = 0;
+	}
+}
+
+static int sandbox_submit_bulk_req(struct udevice *bus,
+				   struct usb_device *udev,
+				   struct usb_bulk_req *req)
+{
+	struct sandbox_usb_ctrl *ctrl = dev_get_priv(bus);
+
+	if (!ctrl->queue)
+		return -ENOSYS;
+	req->hc_count = 0;
+	list_add_tail(&req->hc_node, &ctrl->reqs);
+	ctrl->queued++;
+	ctrl->max_queued = max(ctrl->max_queued, ctrl->queued);
+
+	return 0;
+}
+
+static int sandbox_reap_bulk_req(struct udevice *bus, struct usb_device *udev,
+				 struct usb_bulk_req *req, int timeout)
+{
+	struct sandbox_usb_ctrl *ctrl = dev_get_priv(bus);
+	struct usb_bulk_req *cur, *next;
+
+	/* Requests on an endpoint complete in the order they were queued */
+	list_for_each_entry_safe(cur, next, &ctrl->reqs, hc_node) {
+		if (!sandbox_same_ep(cur, req))
+			continue;
+		sandbox_retire_bulk(bus, udev, cur, true);
+		if (cur == req)
+			break;
+	}
+
+	return req->done ? 0 : -ETIMEDOUT;
+}
+
+static int sandbox_cancel_bulk_req(struct udevice *bus,
+				   struct usb_device *udev,
+				   struct usb_bulk_req *req)
+{
+	struct sandbox_usb_ctrl *ctrl = dev_get_priv(bus);
+	struct usb_bulk_req *cur, *next;
+
+	list_for_each_entry_safe(cur, next, &ctrl->reqs, hc_node) {
+		if (sandbox_same_ep(cur, req))
+			sandbox_retire_bulk(bus, udev, cur, false);
+	}
+
+	return 0;
+}
+
+void sandbox_usb_set_queue(struct udevice *bus, bool enable)
+{
+	struct sandbox_usb_ctrl *ctrl = dev_get_priv(bus);
+
+	ctrl->queue = enable;
+	ctrl->max_queued = 0;
+}
+
+int sandbox_usb_max_queued(struct udevice *bus)
+{
+	struct sandbox_usb_ctrl *ctrl = dev_get_priv(bus);
+
+	return ctrl->max_queued;
+}
+
 static int sandbox_submit_int(struct udevice *bus, struct usb_device *udev,
 			      unsigned long pipe, void *buffer, int length,
 			      int interval, bool nonblock)
@@ -133,6 +244,10 @@ static int sandbox_alloc_device(struct udevice *dev, struct usb_device *udev)
 
 static int sandbox_usb_probe(struct udevice *dev)
 {
+	struct sandbox_usb_ctrl *ctrl = dev_get_priv(dev);
+
+	INIT_LIST_HEAD(&ctrl->reqs);
+
 	return 0;
 }
 
@@ -140,6 +255,9 @@ static const struct dm_usb_ops sandbox_usb_ops = {
 	.control	= sandbox_submit_control,
 	.bulk		= sandbox_submit_bulk,
 	.interrupt	= sandbox_submit_int,
+	.submit_bulk_req = sandbox_submit_bulk_req,
+	.reap_bulk_req	= sandbox_reap_bulk_req,
+	.cancel_bulk_req = sandbox_cancel_bulk_req,
 	.alloc_device	= sandbox_alloc_device,
 };
 
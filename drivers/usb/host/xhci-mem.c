@@ -444,6 +444,7 @@ int xhci_alloc_virt_device(struct xhci_ctrl *ctrl, unsigned int slot_id)
 {
 	u64 byte_64 = 0;
 	struct xhci_virt_device *virt_dev;
+	int i;
 
 	/* Slot ID 0 is reserved */
 	if (ctrl->devs[slot_id]) {
@@ -461,6 +462,8 @@ int xhci_alloc_virt_device(struct xhci_ctrl *ctrl, unsigned int slot_id)
 
 	memset(ctrl->devs[slot_id], 0, sizeof(struct xhci_virt_device));
 	virt_dev = ctrl->devs[slot_id];
+	for (i = 0; i < ARRAY_SIZE(virt_dev->eps); i++)
+		INIT_LIST_HEAD(&virt_dev->eps[i].bulk_reqs);
 
 	/* Allocate the (output) device context that will be used in the HC. */
 	virt_dev->out_ctx = xhci_alloc_container_ctx(ctrl,
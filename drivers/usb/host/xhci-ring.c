@@ -423,6 +423,105 @@ static int event_ready(struct xhci_ctrl *ctrl)
 	return 1;
 }
 
+static unsigned long transfer_status(union xhci_trb *event)
+{
+	switch (GET_COMP_CODE(le32_to_cpu(event->trans_event.transfer_len))) {
+	case COMP_SUCCESS:
+	case COMP_SHORT_TX:
+		return 0;
+	case COMP_STALL:
+		return USB_ST_STALLED;
+	case COMP_DB_ERR:
+	case COMP_TRB_ERR:
+		return USB_ST_BUF_ERR;
+	case COMP_BABBLE:
+		return USB_ST_BABBLE_DET;
+	default:
+		return 0x80;  /* USB_ST_TOO_LAZY_TO_MAKE_A_NEW_MACRO */
+	}
+}
+
+static void record_transfer_result(struct usb_device *udev,
+				   union xhci_trb *event, int length)
+{
+	udev->act_len = min(length, length -
+		(int)EVENT_TRB_LEN(le32_to_cpu(event->trans_event.transfer_len)));
+
+	if (GET_COMP_CODE(le32_to_cpu(event->trans_event.transfer_len)) ==
+	    COMP_SUCCESS)
+		BUG_ON(udev->act_len != length);
+	udev->status = transfer_status(event);
+}
+
+/**** Asynchronous bulk requests ****/
+
+/**
+ * Matches a transfer event against the asynchronous bulk requests queued on
+ * its endpoint and completes the request it belongs to. Requests on one
+ * endpoint complete in order, so only the oldest one can match.
+ *
+ * @param ctrl	Host controller data structure
+ * @param event	Transfer event TRB
+ * @return true if the event was consumed, false if it belongs to someone else
+ */
+static bool xhci_bulk_req_event(struct xhci_ctrl *ctrl, union xhci_trb *event)
+{
+	u32 flags = le32_to_cpu(event->trans_event.flags);
+	u32 len = le32_to_cpu(event->trans_event.transfer_len);
+	unsigned int slot_id = TRB_TO_SLOT_ID(flags);
+	union xhci_trb *trb;
+	struct xhci_virt_device *virt_dev;
+	struct xhci_virt_ep *ep;
+	struct usb_bulk_req *req;
+	u64 addr;
+	int act_len;
+
+	/* Stop events are collected by whoever stopped the ring */
+	if (GET_COMP_CODE(len) == COMP_STOP ||
+	    GET_COMP_CODE(len) == COMP_STOP_INVAL)
+		return false;
+	if (!slot_id || slot_id >= MAX_HC_SLOTS || !ctrl->devs[slot_id])
+		return false;
+	virt_dev = ctrl->devs[slot_id];
+	ep = &virt_dev->eps[TRB_TO_EP_INDEX(flags)];
+	trb = (union xhci_trb *)(uintptr_t)
+		le64_to_cpu(event->trans_event.buffer);
+
+	/*
+	 * After a short packet some controllers still report the last TRB of
+	 * the TD, which has already been given back
+	 */
+	if (ep->short_trb && trb == ep->short_trb) {
+		ep->short_trb = NULL;
+		return true;
+	}
+	if (list_empty(&ep->bulk_reqs))
+		return false;
+
+	req = list_first_entry(&ep->bulk_reqs, struct usb_bulk_req, hc_node);
+	addr = ((u64)le32_to_cpu(trb->generic.field[1]) << 32) |
+		le32_to_cpu(trb->generic.field[0]);
+	act_len = addr - (uintptr_t)req->buffer +
+		(le32_to_cpu(trb->generic.field[2]) & TRB_LEN_MASK) -
+		EVENT_TRB_LEN(len);
+	req->act_len = clamp(act_len, 0, req->length);
+	req->status = transfer_status(event);
+
+	if (trb != req->hc_priv && GET_COMP_CODE(len) == COMP_SHORT_TX)
+		ep->short_trb = req->hc_priv;
+	else
+		ep->short_trb = NULL;
+	/* The endpoint will not process the rest of its queue */
+	if (req->status)
+		ep->ep_state |= EP_HALTED;
+	list_del(&req->hc_node);
+	ep->bulk_trbs -= req->hc_count;
+	xhci_inval_cache((uintptr_t)req->buffer, req->length);
+	req->done = true;
+
+	return true;
+}
+
 /**
  * Waits for a specific type of event and returns it. Discards unexpected
  * events. Caller *must* call xhci_acknowledge_event() after it is finished
@@ -444,6 +543,10 @@ union xhci_trb *xhci_wait_for_event(struct xhci_ctrl *ctrl, trb_type expected)
 			continue;
 
 		type = TRB_FIELD_TO_TYPE(le32_to_cpu(event->event_cmd.flags));
+		if (type == TRB_TRANSFER && xhci_bulk_req_event(ctrl, event)) {
+			xhci_acknowledge_event(ctrl);
+			continue;
+		}
 		if (type == expected)
 			return event;
 
@@ -485,10 +588,31 @@ union xhci_trb *xhci_wait_for_event(struct xhci_ctrl *ctrl, trb_type expected)
 static void abort_td(struct usb_device *udev, int ep_index)
 {
 	struct xhci_ctrl *ctrl = xhci_get_ctrl(udev);
-	struct xhci_ring *ring =  ctrl->devs[udev->slot_id]->eps[ep_index].ring;
+	struct xhci_virt_device *virt_dev = ctrl->devs[udev->slot_id];
+	struct xhci_ring *ring = virt_dev->eps[ep_index].ring;
+	struct xhci_ep_ctx *ep_ctx;
 	union xhci_trb *event;
 	u32 field;
 
+	xhci_inval_cache((uintptr_t)virt_dev->out_ctx->bytes,
+			 virt_dev->out_ctx->size);
+	ep_ctx = xhci_get_ep_ctx(ctrl, virt_dev->out_ctx, ep_index);
+	switch (le32_to_cpu(ep_ctx->ep_info) & EP_STATE_MASK) {
+	case EP_STATE_HALTED:
+		/* A halted ring cannot be stopped, reset it instead */
+		xhci_queue_command(ctrl, NULL, udev->slot_id, ep_index,
+				   TRB_RESET_EP);
+		event = xhci_wait_for_event(ctrl, TRB_COMPLETION);
+		BUG_ON(TRB_TO_SLOT_ID(le32_to_cpu(event->event_cmd.flags))
+			!= udev->slot_id || GET_COMP_CODE(le32_to_cpu(
+			event->event_cmd.status)) != COMP_SUCCESS);
+		xhci_acknowledge_event(ctrl);
+		/* fallthrough */
+	case EP_STATE_ERROR:
+	case EP_STATE_STOPPED:
+		goto set_deq;
+	}
+
 	xhci_queue_command(ctrl, NULL, udev->slot_id, ep_index, TRB_STOP_RING);
 
 	event = xhci_wait_for_event(ctrl, TRB_TRANSFER);
@@ -505,6 +629,7 @@ static void abort_td(struct usb_device *udev, int ep_index)
 		event->event_cmd.status)) != COMP_SUCCESS);
 	xhci_acknowledge_event(ctrl);
 
+set_deq:
 	xhci_queue_command(ctrl, (void *)((uintptr_t)ring->enqueue |
 		ring->cycle_state), udev->slot_id, ep_index, TRB_SET_DEQ);
 	event = xhci_wait_for_event(ctrl, TRB_COMPLETION);
@@ -514,48 +639,57 @@ static void abort_td(struct usb_device *udev, int ep_index)
 	xhci_acknowledge_event(ctrl);
 }
 
-static void record_transfer_result(struct usb_device *udev,
-				   union xhci_trb *event, int length)
+/**
+ * Retires all pending events, completing any asynchronous bulk requests they
+ * belong to. The hardware is told about the new dequeue pointer once for the
+ * whole batch.
+ *
+ * @param ctrl	Host controller data structure
+ * @return number of events retired
+ */
+static int xhci_reap_events(struct xhci_ctrl *ctrl)
 {
-	udev->act_len = min(length, length -
-		(int)EVENT_TRB_LEN(le32_to_cpu(event->trans_event.transfer_len)));
-
-	switch (GET_COMP_CODE(le32_to_cpu(event->trans_event.transfer_len))) {
-	case COMP_SUCCESS:
-		BUG_ON(udev->act_len != length);
-		/* fallthrough */
-	case COMP_SHORT_TX:
-		udev->status = 0;
-		break;
-	case COMP_STALL:
-		udev->status = USB_ST_STALLED;
-		break;
-	case COMP_DB_ERR:
-	case COMP_TRB_ERR:
-		udev->status = USB_ST_BUF_ERR;
-		break;
-	case COMP_BABBLE:
-		udev->status = USB_ST_BABBLE_DET;
-		break;
-	default:
-		udev->status = 0x80;  /* USB_ST_TOO_LAZY_TO_MAKE_A_NEW_MACRO */
+	union xhci_trb *event;
+	int count = 0;
+
+	while (event_ready(ctrl)) {
+		event = ctrl->event_ring->dequeue;
+		if (TRB_FIELD_TO_TYPE(le32_to_cpu(event->event_cmd.flags)) !=
+		    TRB_TRANSFER || !xhci_bulk_req_event(ctrl, event))
+			debug("Unexpected XHCI event TRB, skipping... (%08x %08x %08x %08x)\n",
+			      le32_to_cpu(event->generic.field[0]),
+			      le32_to_cpu(event->generic.field[1]),
+			      le32_to_cpu(event->generic.field[2]),
+			      le32_to_cpu(event->generic.field[3]));
+		inc_deq(ctrl, ctrl->event_ring);
+		count++;
 	}
+
+	if (count)
+		xhci_writeq(&ctrl->ir_set->erst_dequeue,
+			    (uintptr_t)ctrl->event_ring->dequeue | ERST_EHB);
+
+	return count;
 }
 
 /**** Bulk and Control transfer methods ****/
 /**
- * Queues up the BULK Request
+ * Queues up a BULK TD and hands it to the hardware without waiting for it
  *
  * @param udev		pointer to the USB device structure
  * @param pipe		contains the DIR_IN or OUT , devnum
  * @param length	length of the buffer
  * @param buffer	buffer to be read/written based on the request
- * @return returns 0 if successful else -1 on failure
+ * @param last_trbp	returns the last TRB of the TD (the one with IOC set)
+ * @return number of TRBs queued, or -EBUSY if the ring is too full, other
+ *	   -ve on error
  */
-int xhci_bulk_tx(struct usb_device *udev, unsigned long pipe,
-			int length, void *buffer)
+static int xhci_queue_bulk_td(struct usb_device *udev, unsigned long pipe,
+			      int length, void *buffer,
+			      struct xhci_generic_trb **last_trbp)
 {
 	int num_trbs = 0;
+	int queued_trbs;
 	struct xhci_generic_trb *start_trb;
 	bool first_trb = false;
 	int start_cycle;
@@ -567,7 +701,6 @@ int xhci_bulk_tx(struct usb_device *udev, unsigned long pipe,
 	struct xhci_virt_device *virt_dev;
 	struct xhci_ep_ctx *ep_ctx;
 	struct xhci_ring *ring;		/* EP transfer ring */
-	union xhci_trb *event;
 
 	int running_total, trb_buff_len;
 	unsigned int total_packet_count;
@@ -612,6 +745,14 @@ int xhci_bulk_tx(struct usb_device *udev, unsigned long pipe,
 		num_trbs++;
 		running_total += TRB_MAX_BUFF_SIZE;
 	}
+	queued_trbs = num_trbs;
+
+	/*
+	 * The ring is a single segment whose last TRB is a link TRB. Leave
+	 * room for the TDs that are already queued on it.
+	 */
+	if (virt_dev->eps[ep_index].bulk_trbs + num_trbs > TRBS_PER_SEGMENT - 2)
+		return -EBUSY;
 
 	/*
 	 * XXX: Calling routine prepare_ring() called in place of
@@ -699,7 +840,7 @@ int xhci_bulk_tx(struct usb_device *udev, unsigned long pipe,
 		trb_fields[2] = length_field;
 		trb_fields[3] = field | (TRB_NORMAL << TRB_TYPE_SHIFT);
 
-		queue_trb(ctrl, ring, (num_trbs > 1), trb_fields);
+		*last_trbp = queue_trb(ctrl, ring, (num_trbs > 1), trb_fields);
 
 		--num_trbs;
 
@@ -712,6 +853,44 @@ int xhci_bulk_tx(struct usb_device *udev, unsigned long pipe,
 
 	giveback_first_trb(udev, ep_index, start_cycle, start_trb);
 
+	return queued_trbs;
+}
+
+/**
+ * Queues up the BULK Request
+ *
+ * @param udev		pointer to the USB device structure
+ * @param pipe		contains the DIR_IN or OUT , devnum
+ * @param length	length of the buffer
+ * @param buffer	buffer to be read/written based on the request
+ * @return returns 0 if successful else -1 on failure
+ */
+int xhci_bulk_tx(struct usb_device *udev, unsigned long pipe,
+			int length, void *buffer)
+{
+	struct xhci_ctrl *ctrl = xhci_get_ctrl(udev);
+	int slot_id = udev->slot_id;
+	int ep_index = usb_pipe_ep_index(pipe);
+	struct xhci_virt_ep *ep = &ctrl->devs[slot_id]->eps[ep_index];
+	struct xhci_generic_trb *last_trb;
+	union xhci_trb *event;
+	u32 field;
+	int ret;
+
+	/* Let any asynchronous requests on this endpoint finish first */
+	while (!list_empty(&ep->bulk_reqs)) {
+		struct usb_bulk_req *req;
+
+		req = list_first_entry(&ep->bulk_reqs, struct usb_bulk_req,
+				       hc_node);
+		if (xhci_bulk_reap(udev, req, XHCI_TIMEOUT))
+			xhci_bulk_cancel(udev, req);
+	}
+
+	ret = xhci_queue_bulk_td(udev, pipe, length, buffer, &last_trb);
+	if (ret < 0)
+		return ret;
+
 	event = xhci_wait_for_event(ctrl, TRB_TRANSFER);
 	if (!event) {
 		debug("XHCI bulk transfer timed out, aborting...\n");
@@ -734,6 +913,100 @@ int xhci_bulk_tx(struct usb_device *udev, unsigned long pipe,
 	return (udev->status != USB_ST_NOT_PROC) ? 0 : -1;
 }
 
+/**
+ * Queues up an asynchronous BULK request. Several requests may be queued on
+ * the same endpoint; they are completed by xhci_bulk_reap().
+ *
+ * @param udev	pointer to the USB device structure
+ * @param req	request to queue
+ * @return 0 if successful, -EBUSY if the endpoint ring is full, other -ve on
+ *	   error
+ */
+int xhci_bulk_submit(struct usb_device *udev, struct usb_bulk_req *req)
+{
+	struct xhci_ctrl *ctrl = xhci_get_ctrl(udev);
+	int ep_index = usb_pipe_ep_index(req->pipe);
+	struct xhci_virt_ep *ep = &ctrl->devs[udev->slot_id]->eps[ep_index];
+	struct xhci_generic_trb *last_trb;
+	int ret;
+
+	ret = xhci_queue_bulk_td(udev, req->pipe, req->length, req->buffer,
+				 &last_trb);
+	if (ret < 0)
+		return ret;
+
+	req->hc_priv = last_trb;
+	req->hc_count = ret;
+	ep->bulk_trbs += ret;
+	list_add_tail(&req->hc_node, &ep->bulk_reqs);
+
+	return 0;
+}
+
+/**
+ * Waits for an asynchronous BULK request to complete, retiring completed
+ * requests on all endpoints as their events come in
+ *
+ * @param udev		pointer to the USB device structure
+ * @param req		request to wait for
+ * @param timeout	timeout in milliseconds
+ * @return 0 if the request is done, -ETIMEDOUT if not
+ */
+int xhci_bulk_reap(struct usb_device *udev, struct usb_bulk_req *req,
+		   int timeout)
+{
+	struct xhci_ctrl *ctrl = xhci_get_ctrl(udev);
+	int ep_index = usb_pipe_ep_index(req->pipe);
+	struct xhci_virt_ep *ep = &ctrl->devs[udev->slot_id]->eps[ep_index];
+	unsigned long ts = get_timer(0);
+
+	while (!req->done) {
+		xhci_reap_events(ctrl);
+		if (req->done)
+			break;
+		/* An earlier request failed and stopped the endpoint */
+		if (ep->ep_state & EP_HALTED)
+			return xhci_bulk_cancel(udev, req);
+		if (get_timer(ts) >= timeout)
+			return -ETIMEDOUT;
+	}
+
+	return 0;
+}
+
+/**
+ * Cancels all asynchronous BULK requests still queued on the endpoint of
+ * @req, marking them done with USB_ST_NOT_PROC
+ *
+ * @param udev	pointer to the USB device structure
+ * @param req	request to cancel
+ * @return 0
+ */
+int xhci_bulk_cancel(struct usb_device *udev, struct usb_bulk_req *req)
+{
+	struct xhci_ctrl *ctrl = xhci_get_ctrl(udev);
+	int ep_index = usb_pipe_ep_index(req->pipe);
+	struct xhci_virt_ep *ep = &ctrl->devs[udev->slot_id]->eps[ep_index];
+	struct usb_bulk_req *pos, *n;
+
+	if (req->done && !(ep->ep_state & EP_HALTED))
+		return 0;
+
+	abort_td(udev, ep_index);
+
+	list_for_each_entry_safe(pos, n, &ep->bulk_reqs, hc_node) {
+		list_del(&pos->hc_node);
+		pos->act_len = 0;
+		pos->status = USB_ST_NOT_PROC;
+		pos->done = true;
+	}
+	ep->bulk_trbs = 0;
+	ep->short_trb = NULL;
+	ep->ep_state &= ~EP_HALTED;
+
+	return 0;
+}
+
 /**
  * Queues up the Control Transfer Request
  *
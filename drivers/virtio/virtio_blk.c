@@ -10,35 +10,58 @@
 #include <virtio_types.h>
 #include <virtio.h>
 #include <virtio_ring.h>
+#include <linux/err.h>
 #include "virtio_blk.h"
 
+/* Most data buffers passed in a single request */
+#define VIRTIO_BLK_MAX_SEGS	16
+
+static const u32 feature[] = {
+	VIRTIO_BLK_F_SEG_MAX
+};
+
+static const u32 feature_legacy[] = {
+	VIRTIO_BLK_F_SEG_MAX
+};
+
 struct virtio_blk_priv {
 	struct virtqueue *vq;
+	unsigned int seg_max;
 };
 
-static ulong virtio_blk_do_req(struct udevice *dev, u64 sector,
-			       lbaint_t blkcnt, void *buffer, u32 type)
+/*
+ * Send one request for @count runs of blocks which follow each other on
+ * the disk, each with its own buffer
+ */
+static ulong virtio_blk_do_req(struct udevice *dev,
+			       const struct blk_vec *vecs, int count, u32 type)
 {
 	struct virtio_blk_priv *priv = dev_get_priv(dev);
 	unsigned int num_out = 0, num_in = 0;
-	struct virtio_sg *sgs[3];
+	struct virtio_sg *sgs[VIRTIO_BLK_MAX_SEGS + 2];
+	struct virtio_sg data_sg[VIRTIO_BLK_MAX_SEGS];
+	lbaint_t blkcnt = 0;
 	u8 status;
-	int ret;
+	int i, ret;
 
 	struct virtio_blk_outhdr out_hdr = {
 		.type = cpu_to_virtio32(dev, type),
-		.sector = cpu_to_virtio64(dev, sector),
+		.sector = cpu_to_virtio64(dev, vecs[0].start),
 	};
 	struct virtio_sg hdr_sg = { &out_hdr, sizeof(out_hdr) };
-	struct virtio_sg data_sg = { buffer, blkcnt * 512 };
 	struct virtio_sg status_sg = { &status, sizeof(status) };
 
 	sgs[num_out++] = &hdr_sg;
 
-	if (type & VIRTIO_BLK_T_OUT)
-		sgs[num_out++] = &data_sg;
-	else
-		sgs[num_out + num_in++] = &data_sg;
+	for (i = 0; i < count; i++) {
+		data_sg[i].addr = vecs[i].buffer;
+		data_sg[i].length = vecs[i].blkcnt * 512;
+		blkcnt += vecs[i].blkcnt;
+		if (type & VIRTIO_BLK_T_OUT)
+			sgs[num_out++] = &data_sg[i];
+		else
+			sgs[num_out + num_in++] = &data_sg[i];
+	}
 
 	sgs[num_out + num_in++] = &status_sg;
 
@@ -57,15 +80,52 @@ static ulong virtio_blk_do_req(struct udevice *dev, u64 sector,
 static ulong virtio_blk_read(struct udevice *dev, lbaint_t start,
 			     lbaint_t blkcnt, void *buffer)
 {
-	return virtio_blk_do_req(dev, start, blkcnt, buffer,
-				 VIRTIO_BLK_T_IN);
+	struct blk_vec vec = { start, blkcnt, buffer };
+
+	return virtio_blk_do_req(dev, &vec, 1, VIRTIO_BLK_T_IN);
 }
 
 static ulong virtio_blk_write(struct udevice *dev, lbaint_t start,
 			      lbaint_t blkcnt, const void *buffer)
 {
-	return virtio_blk_do_req(dev, start, blkcnt, (void *)buffer,
-				 VIRTIO_BLK_T_OUT);
+	struct blk_vec vec = { start, blkcnt, (void *)buffer };
+
+	return virtio_blk_do_req(dev, &vec, 1, VIRTIO_BLK_T_OUT);
+}
+
+/* Send runs which follow each other on the disk as one request */
+static ulong virtio_blk_do_vecs(struct udevice *dev,
+				const struct blk_vec *vecs, int count, u32 type)
+{
+	struct virtio_blk_priv *priv = dev_get_priv(dev);
+	ulong n, total = 0;
+	int i, nr;
+
+	for (i = 0; i < count; i += nr) {
+		for (nr = 1; i + nr < count && nr < priv->seg_max; nr++) {
+			if (vecs[i + nr].start != vecs[i + nr - 1].start +
+			    vecs[i + nr - 1].blkcnt)
+				break;
+		}
+		n = virtio_blk_do_req(dev, vecs + i, nr, type);
+		if (IS_ERR_VALUE(n))
+			return n;
+		total += n;
+	}
+
+	return total;
+}
+
+static ulong virtio_blk_readv(struct udevice *dev, const struct blk_vec *vecs,
+			      int count)
+{
+	return virtio_blk_do_vecs(dev, vecs, count, VIRTIO_BLK_T_IN);
+}
+
+static ulong virtio_blk_writev(struct udevice *dev,
+			       const struct blk_vec *vecs, int count)
+{
+	return virtio_blk_do_vecs(dev, vecs, count, VIRTIO_BLK_T_OUT);
 }
 
 static int virtio_blk_bind(struct udevice *dev)
@@ -97,7 +157,8 @@ static int virtio_blk_bind(struct udevice *dev)
 	desc->bdev = dev;
 
 	/* Indicate what driver features we support */
-	virtio_driver_features_init(uc_priv, NULL, 0, NULL, 0);
+	virtio_driver_features_init(uc_priv, feature, ARRAY_SIZE(feature),
+				    feature_legacy, ARRAY_SIZE(feature_legacy));
 
 	return 0;
 }
@@ -106,6 +167,7 @@ static int virtio_blk_probe(struct udevice *dev)
 {
 	struct virtio_blk_priv *priv = dev_get_priv(dev);
 	struct blk_desc *desc = dev_get_uclass_platdata(dev);
+	u32 seg_max;
 	u64 cap;
 	int ret;
 
@@ -117,12 +179,22 @@ static int virtio_blk_probe(struct udevice *dev)
 	virtio_cread(dev, struct virtio_blk_config, capacity, &cap);
 	desc->lba = cap;
 
+	/* Without the feature the device takes a single data buffer */
+	priv->seg_max = 1;
+	if (!virtio_cread_feature(dev, VIRTIO_BLK_F_SEG_MAX,
+				  struct virtio_blk_config, seg_max, &seg_max))
+		priv->seg_max = clamp_t(u32, seg_max, 1, VIRTIO_BLK_MAX_SEGS);
+	/* leave room for the header and status */
+	priv->seg_max = min(priv->seg_max, priv->vq->vring.num - 2);
+
 	return 0;
 }
 
 static const struct blk_ops virtio_blk_ops = {
 	.read	= virtio_blk_read,
 	.write	= virtio_blk_write,
+	.readv	= virtio_blk_readv,
+	.writev	= virtio_blk_writev,
 };
 
 U_BOOT_DRIVER(virtio_blk) = {
@@ -7,6 +7,7 @@
 
 #include "btrfs.h"
 #include <config.h>
+#include <fs.h>
 #include <malloc.h>
 #include <linux/time.h>
 
@@ -80,8 +81,11 @@ int btrfs_probe(struct blk_desc *fs_dev_desc, disk_partition_t *fs_partition)
 	btrfs_part_info = fs_partition;
 
 	memset(&btrfs_info, 0, sizeof(btrfs_info));
+	btrfs_cache_init(&btrfs_info.node_cache, "tree node",
+			 CONFIG_BTRFS_NODE_CACHE_SIZE);
+	btrfs_cache_init(&btrfs_info.extent_cache, "extent",
+			 CONFIG_BTRFS_EXTENT_CACHE_SIZE);
 
-	btrfs_hash_init();
 	if (btrfs_read_superblock())
 		return -1;
 
@@ -106,6 +110,12 @@ int btrfs_probe(struct blk_desc *fs_dev_desc, disk_partition_t *fs_partition)
 		return -1;
 	}
 
+	if (IS_ENABLED(CONFIG_BTRFS_VERIFY_CSUM) &&
+	    btrfs_find_root(BTRFS_CSUM_TREE_OBJECTID, &btrfs_info.csum_root,
+			    NULL))
+		printf("%s: no checksum tree, data is not verified\n",
+		       __func__);
+
 	return 0;
 }
 
@@ -207,11 +217,74 @@ int btrfs_read(const char *file, void *buf, loff_t offset, loff_t len,
 	return 0;
 }
 
+struct btrfs_file {
+	struct fs_file parent;
+	struct btrfs_root root;
+	u64 inr;
+};
+
+int btrfs_open_file(const char *file, struct fs_file **filep)
+{
+	struct btrfs_file *bfile;
+	struct btrfs_inode_item inode;
+	u8 type;
+
+	bfile = calloc(1, sizeof(*bfile));
+	if (!bfile)
+		return -ENOMEM;
+
+	bfile->root = btrfs_info.fs_root;
+	bfile->inr = btrfs_lookup_path(&bfile->root, bfile->root.root_dirid,
+				       file, &type, &inode, 40);
+	if (bfile->inr == -1ULL || type != BTRFS_FT_REG_FILE) {
+		free(bfile);
+		return -ENOENT;
+	}
+
+	bfile->parent.size = inode.size;
+	*filep = &bfile->parent;
+
+	return 0;
+}
+
+int btrfs_read_at(struct fs_file *file, void *buf, loff_t offset, loff_t len,
+		  loff_t *actread)
+{
+	struct btrfs_file *bfile = container_of(file, struct btrfs_file,
+						parent);
+	u64 rd;
+
+	rd = btrfs_file_read(&bfile->root, bfile->inr, offset, len, buf);
+	if (rd == -1ULL)
+		return -1;
+
+	*actread = rd;
+	return 0;
+}
+
+void btrfs_close_file(struct fs_file *file)
+{
+	free(container_of(file, struct btrfs_file, parent));
+}
+
 void btrfs_close(void)
 {
+	btrfs_cache_drop(&btrfs_info.node_cache);
+	btrfs_cache_drop(&btrfs_info.extent_cache);
 	btrfs_chunk_map_exit();
 }
 
+void btrfs_show_cache_stats(void)
+{
+	if (!btrfs_info.node_cache.name) {
+		printf("No BTRFS filesystem accessed yet\n");
+		return;
+	}
+
+	btrfs_cache_show(&btrfs_info.node_cache);
+	btrfs_cache_show(&btrfs_info.extent_cache);
+}
+
 int btrfs_uuid(char *uuid_str)
 {
 #ifdef CONFIG_LIB_UUID
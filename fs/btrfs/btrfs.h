@@ -8,23 +8,46 @@
 #ifndef __BTRFS_BTRFS_H__
 #define __BTRFS_BTRFS_H__
 
+#include <linux/list.h>
 #include <linux/rbtree.h>
 #include "conv-funcs.h"
 
+/**
+ * struct btrfs_cache - LRU cache of buffers keyed by logical address
+ *
+ * @lru:	entries, most recently used first
+ * @name:	name shown in the statistics
+ * @max:	maximum number of entries, 0 to disable the cache
+ * @count:	current number of entries
+ * @hits:	number of successful lookups
+ * @misses:	number of failed lookups
+ */
+struct btrfs_cache {
+	struct list_head lru;
+	const char *name;
+	int max;
+	int count;
+	u32 hits;
+	u32 misses;
+};
+
 struct btrfs_info {
 	struct btrfs_super_block sb;
 
 	struct btrfs_root tree_root;
 	struct btrfs_root fs_root;
 	struct btrfs_root chunk_root;
+	struct btrfs_root csum_root;
 
 	struct rb_root chunks_root;
+
+	struct btrfs_cache node_cache;
+	struct btrfs_cache extent_cache;
 };
 
 extern struct btrfs_info btrfs_info;
 
 /* hash.c */
-void btrfs_hash_init(void);
 u32 btrfs_crc32c(u32, const void *, size_t);
 u32 btrfs_csum_data(char *, u32, size_t);
 void btrfs_csum_final(u32, void *);
@@ -46,6 +69,13 @@ int btrfs_chunk_map_init(void);
 void btrfs_chunk_map_exit(void);
 int btrfs_read_chunk_tree(void);
 
+/* cache.c */
+void btrfs_cache_init(struct btrfs_cache *, const char *, int);
+void *btrfs_cache_get(struct btrfs_cache *, u64, u64 *);
+void btrfs_cache_put(struct btrfs_cache *, u64, void *, u64);
+void btrfs_cache_drop(struct btrfs_cache *);
+void btrfs_cache_show(struct btrfs_cache *);
+
 /* compression.c */
 u32 btrfs_decompress(u8 type, const char *, u32, char *, u32);
 
@@ -0,0 +1,115 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * BTRFS filesystem implementation for U-Boot
+ *
+ * Small LRU caches of tree nodes and decompressed extents
+ */
+
+#include "btrfs.h"
+#include <malloc.h>
+
+struct btrfs_cache_entry {
+	struct list_head list;
+	u64 key;
+	u64 len;
+	void *data;
+};
+
+void btrfs_cache_init(struct btrfs_cache *cache, const char *name, int max)
+{
+	INIT_LIST_HEAD(&cache->lru);
+	cache->name = name;
+	cache->max = max;
+	cache->count = 0;
+	cache->hits = 0;
+	cache->misses = 0;
+}
+
+/*
+ * Look up @key and mark it as most recently used. The data stays owned by the
+ * cache and is only valid until the next btrfs_cache_put() or drop.
+ */
+void *btrfs_cache_get(struct btrfs_cache *cache, u64 key, u64 *len)
+{
+	struct btrfs_cache_entry *entry;
+
+	if (!cache->max)
+		return NULL;
+
+	list_for_each_entry(entry, &cache->lru, list) {
+		if (entry->key == key) {
+			list_move(&entry->list, &cache->lru);
+			cache->hits++;
+			*len = entry->len;
+			return entry->data;
+		}
+	}
+
+	cache->misses++;
+	return NULL;
+}
+
+static void btrfs_cache_free_entry(struct btrfs_cache *cache,
+				   struct btrfs_cache_entry *entry)
+{
+	list_del(&entry->list);
+	free(entry->data);
+	free(entry);
+	cache->count--;
+}
+
+/*
+ * Insert @data of @len bytes under @key, replacing an older entry with the
+ * same key and evicting the least recently used one if the cache is full.
+ * The cache takes ownership of @data in all cases.
+ */
+void btrfs_cache_put(struct btrfs_cache *cache, u64 key, void *data, u64 len)
+{
+	struct btrfs_cache_entry *entry, *tmp;
+
+	if (!cache->max) {
+		free(data);
+		return;
+	}
+
+	list_for_each_entry_safe(entry, tmp, &cache->lru, list) {
+		if (entry->key == key)
+			btrfs_cache_free_entry(cache, entry);
+	}
+
+	if (cache->count >= cache->max)
+		btrfs_cache_free_entry(cache,
+				       list_last_entry(&cache->lru,
+						       struct btrfs_cache_entry,
+						       list));
+
+	entry = malloc(sizeof(*entry));
+	if (!entry) {
+		free(data);
+		return;
+	}
+
+	entry->key = key;
+	entry->len = len;
+	entry->data = data;
+	list_add(&entry->list, &cache->lru);
+	cache->count++;
+}
+
+void btrfs_cache_drop(struct btrfs_cache *cache)
+{
+	struct btrfs_cache_entry *entry, *tmp;
+
+	if (!cache->max)
+		return;
+
+	list_for_each_entry_safe(entry, tmp, &cache->lru, list)
+		btrfs_cache_free_entry(cache, entry);
+}
+
+/* The statistics are kept when the cache is dropped, until the next init */
+void btrfs_cache_show(struct btrfs_cache *cache)
+{
+	printf("%s cache: %d entries, %u hits, %u misses\n", cache->name,
+	       cache->max, cache->hits, cache->misses);
+}
@@ -6,9 +6,8 @@
  */
 
 #include "btrfs.h"
-#include <malloc.h>
+#include <zstd.h>
 #include <linux/lzo.h>
-#include <linux/zstd.h>
 #include <linux/compat.h>
 #include <u-boot/zlib.h>
 #include <asm/unaligned.h>
@@ -133,56 +132,39 @@ static u32 decompress_zlib(const u8 *_cbuf, u32 clen, u8 *dbuf, u32 dlen)
 #define ZSTD_BTRFS_MAX_WINDOWLOG 17
 #define ZSTD_BTRFS_MAX_INPUT (1 << ZSTD_BTRFS_MAX_WINDOWLOG)
 
+/*
+ * The compressed extent may be followed by padding, so stop at the end of
+ * the frame. The workspace is shared between extents.
+ */
 static u32 decompress_zstd(const u8 *cbuf, u32 clen, u8 *dbuf, u32 dlen)
 {
-	ZSTD_DStream *dstream;
-	ZSTD_inBuffer in_buf;
-	ZSTD_outBuffer out_buf;
-	void *workspace;
-	size_t wsize;
-	u32 res = -1;
-
-	wsize = ZSTD_DStreamWorkspaceBound(ZSTD_BTRFS_MAX_INPUT);
-	workspace = malloc(wsize);
-	if (!workspace) {
-		debug("%s: cannot allocate workspace of size %zu\n", __func__,
-		      wsize);
-		return -1;
-	}
+	struct zstd_stream zs;
+	size_t srcn, dstn;
+	u32 in = 0, out = 0;
+	int ret;
 
-	dstream = ZSTD_initDStream(ZSTD_BTRFS_MAX_INPUT, workspace, wsize);
-	if (!dstream) {
-		printf("%s: ZSTD_initDStream failed\n", __func__);
-		goto err_free;
+	ret = zstd_stream_init(&zs, ZSTD_BTRFS_MAX_INPUT);
+	if (ret) {
+		debug("%s: cannot set up decompression: %d\n", __func__, ret);
+		return -1;
 	}
 
-	in_buf.src = cbuf;
-	in_buf.pos = 0;
-	in_buf.size = clen;
-
-	out_buf.dst = dbuf;
-	out_buf.pos = 0;
-	out_buf.size = dlen;
-
-	while (1) {
-		size_t ret;
-
-		ret = ZSTD_decompressStream(dstream, &out_buf, &in_buf);
-		if (ZSTD_isError(ret)) {
-			printf("%s: ZSTD_decompressStream error %d\n", __func__,
-			       ZSTD_getErrorCode(ret));
-			goto err_free;
-		}
-
-		if (in_buf.pos >= clen || !ret)
-			break;
+	do {
+		srcn = clen - in;
+		dstn = dlen - out;
+		ret = zstd_stream_decompress(&zs, cbuf + in, &srcn, dbuf + out,
+					     &dstn);
+		in += srcn;
+		out += dstn;
+	} while (!ret && in < clen && out < dlen);
+	zstd_stream_finish(&zs);
+
+	if (ret < 0) {
+		printf("%s: decompression error %d\n", __func__, ret);
+		return -1;
 	}
 
-	res = out_buf.pos;
-
-err_free:
-	free(workspace);
-	return res;
+	return out;
 }
 
 u32 btrfs_decompress(u8 type, const char *c, u32 clen, char *d, u32 dlen)
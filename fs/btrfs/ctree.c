@@ -104,20 +104,46 @@ void btrfs_free_path(struct btrfs_path *p)
 	clear_path(p);
 }
 
-static int read_tree_node(u64 physical, union btrfs_tree_node **buf)
+/*
+ * Callers own the returned node and may convert item data in place, so a
+ * cached node is handed out as a copy.
+ */
+static int read_tree_node(u64 logical, union btrfs_tree_node **buf)
 {
 	ALLOC_CACHE_ALIGN_BUFFER(struct btrfs_header, hdr,
 				 sizeof(struct btrfs_header));
 	unsigned long size, offset = sizeof(*hdr);
-	union btrfs_tree_node *res;
-	u32 i;
+	union btrfs_tree_node *res, *cached;
+	u8 result[BTRFS_CSUM_SIZE];
+	u64 physical, len;
+	u32 i, crc = ~(u32)0;
+
+	cached = btrfs_cache_get(&btrfs_info.node_cache, logical, &len);
+	if (cached) {
+		res = malloc_cache_aligned(len);
+		if (!res)
+			return -1;
+
+		memcpy(res, cached, len);
+		*buf = res;
+		return 0;
+	}
+
+	physical = btrfs_map_logical_to_physical(logical);
+	if (physical == -1ULL)
+		return -1;
 
 	if (!btrfs_devread(physical, sizeof(*hdr), hdr))
 		return -1;
 
+	/* the checksum covers the on-disk (little endian) header */
+	if (IS_ENABLED(CONFIG_BTRFS_VERIFY_CSUM))
+		crc = btrfs_csum_data((char *)hdr + BTRFS_CSUM_SIZE, crc,
+				      sizeof(*hdr) - BTRFS_CSUM_SIZE);
 	btrfs_header_to_cpu(hdr);
 
-	if (hdr->level)
+	/* the whole node is needed to check it */
+	if (hdr->level && !IS_ENABLED(CONFIG_BTRFS_VERIFY_CSUM))
 		size = sizeof(struct btrfs_node)
 		       + hdr->nritems * sizeof(struct btrfs_key_ptr);
 	else
@@ -135,6 +161,17 @@ static int read_tree_node(u64 physical, union btrfs_tree_node **buf)
 		return -1;
 	}
 
+	if (IS_ENABLED(CONFIG_BTRFS_VERIFY_CSUM)) {
+		crc = btrfs_csum_data((char *)res + offset, crc, size - offset);
+		btrfs_csum_final(crc, result);
+		if (memcmp(hdr->csum, result, sizeof(u32))) {
+			printf("%s: checksum mismatch in tree node at %llu\n",
+			       __func__, logical);
+			free(res);
+			return -1;
+		}
+	}
+
 	memcpy(&res->header, hdr, sizeof(*hdr));
 	if (hdr->level)
 		for (i = 0; i < hdr->nritems; ++i)
@@ -143,6 +180,15 @@ static int read_tree_node(u64 physical, union btrfs_tree_node **buf)
 		for (i = 0; i < hdr->nritems; ++i)
 			btrfs_item_to_cpu(&res->leaf.items[i]);
 
+	if (btrfs_info.node_cache.max) {
+		cached = malloc(size);
+		if (cached) {
+			memcpy(cached, res, size);
+			btrfs_cache_put(&btrfs_info.node_cache, logical, cached,
+					size);
+		}
+	}
+
 	*buf = res;
 
 	return 0;
@@ -153,7 +199,7 @@ int btrfs_search_tree(const struct btrfs_root *root, struct btrfs_key *key,
 {
 	u8 lvl, prev_lvl;
 	int i, slot, ret;
-	u64 logical, physical;
+	u64 logical;
 	union btrfs_tree_node *buf;
 
 	clear_path(p);
@@ -161,11 +207,7 @@ int btrfs_search_tree(const struct btrfs_root *root, struct btrfs_key *key,
 	logical = root->bytenr;
 
 	for (i = 0; i < BTRFS_MAX_LEVEL; ++i) {
-		physical = btrfs_map_logical_to_physical(logical);
-		if (physical == -1ULL)
-			goto err;
-
-		if (read_tree_node(physical, &buf))
+		if (read_tree_node(logical, &buf))
 			goto err;
 
 		lvl = buf->header.level;
@@ -237,15 +279,11 @@ static int jump_leaf(struct btrfs_path *path, int dir)
 	from_level = level;
 
 	while (level >= 0) {
-		u64 logical, physical;
+		u64 logical;
 
 		slot = p.slots[level + 1];
 		logical = p.nodes[level + 1]->node.ptrs[slot].blockptr;
-		physical = btrfs_map_logical_to_physical(logical);
-		if (physical == -1ULL)
-			goto err;
-
-		if (read_tree_node(physical, &p.nodes[level]))
+		if (read_tree_node(logical, &p.nodes[level]))
 			goto err;
 
 		if (dir > 0)
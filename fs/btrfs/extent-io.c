@@ -61,13 +61,101 @@ err:
 	return -1ULL;
 }
 
+/*
+ * Check data read from the disk against the checksum tree. @buf holds @len
+ * bytes found at @logical (@physical on the disk). Checksums cover whole
+ * sectors, so sectors only partly in @buf are read again. Sectors without
+ * a checksum, as in nodatasum files, are not checked.
+ */
+static int btrfs_check_data_csum(u64 logical, u64 physical, const char *buf,
+				 u64 len)
+{
+	const u32 sectorsize = btrfs_info.sb.sectorsize;
+	const int csum_size = sizeof(u32);
+	u64 start, end, item_start, item_end, pos;
+	struct btrfs_key key, *found;
+	struct btrfs_path path;
+	u8 result[BTRFS_CSUM_SIZE];
+	char *sector = NULL;
+	const char *data;
+	const u8 *csums;
+	int ret = -1, next;
+	u32 crc, nr;
+
+	if (!btrfs_info.csum_root.bytenr || !len)
+		return 0;
+
+	start = round_down(logical, (u64)sectorsize);
+	end = round_up(logical + len, (u64)sectorsize);
+
+	key.objectid = BTRFS_EXTENT_CSUM_OBJECTID;
+	key.type = BTRFS_EXTENT_CSUM_KEY;
+	key.offset = start;
+	if (btrfs_search_tree(&btrfs_info.csum_root, &key, &path))
+		return -1;
+
+	/* the item covering @start, if any, is the last one before it */
+	if (path.slots[0] >= path.nodes[0]->header.nritems ||
+	    btrfs_comp_keys(btrfs_path_leaf_key(&path), &key) > 0)
+		if (btrfs_prev_slot(&path) < 0)
+			goto out;
+
+	while (path.slots[0] < path.nodes[0]->header.nritems) {
+		found = btrfs_path_leaf_key(&path);
+		if (found->type != BTRFS_EXTENT_CSUM_KEY ||
+		    found->offset >= end)
+			break;
+
+		nr = btrfs_path_item_size(&path) / csum_size;
+		item_start = found->offset;
+		item_end = item_start + (u64)nr * sectorsize;
+		csums = btrfs_path_item_ptr(&path, u8);
+
+		for (pos = max(start, item_start); pos < min(end, item_end);
+		     pos += sectorsize) {
+			data = buf + (pos - logical);
+			if (pos < logical || pos + sectorsize > logical + len) {
+				if (!sector)
+					sector = malloc(sectorsize);
+				if (!sector ||
+				    !btrfs_devread(physical + (pos - logical),
+						   sectorsize, sector))
+					goto out;
+				data = sector;
+			}
+
+			crc = btrfs_csum_data((char *)data, ~(u32)0,
+					      sectorsize);
+			btrfs_csum_final(crc, result);
+			if (memcmp(csums + (pos - item_start) / sectorsize *
+				   csum_size, result, csum_size)) {
+				printf("%s: checksum mismatch in data at %llu\n",
+				       __func__, pos);
+				goto out;
+			}
+		}
+
+		next = btrfs_next_slot(&path);
+		if (next < 0)
+			goto out;
+		if (next)
+			break;
+	}
+
+	ret = 0;
+out:
+	free(sector);
+	btrfs_free_path(&path);
+	return ret;
+}
+
 u64 btrfs_read_extent_reg(struct btrfs_path *path,
 			  struct btrfs_file_extent_item *extent, u64 offset,
 			  u64 size, char *out)
 {
-	u64 physical, clen, dlen, orig_size = size;
+	u64 physical, clen, dlen, orig_size = size, len;
 	u32 res;
-	char *cbuf, *dbuf;
+	char *cbuf, *dbuf, *cached;
 
 	clen = extent->disk_num_bytes;
 	dlen = extent->num_bytes;
@@ -93,6 +181,19 @@ u64 btrfs_read_extent_reg(struct btrfs_path *path,
 		if (!btrfs_devread(physical, size, out))
 			return -1ULL;
 
+		if (IS_ENABLED(CONFIG_BTRFS_VERIFY_CSUM) &&
+		    btrfs_check_data_csum(extent->disk_bytenr + extent->offset +
+					  offset, physical, out, size))
+			return -1ULL;
+
+		return size;
+	}
+
+	/* decompressed extent kept from an earlier partial read */
+	cached = btrfs_cache_get(&btrfs_info.extent_cache, extent->disk_bytenr,
+				 &len);
+	if (cached && offset + size <= len) {
+		memcpy(out, cached + offset, size);
 		return size;
 	}
 
@@ -108,17 +209,31 @@ u64 btrfs_read_extent_reg(struct btrfs_path *path,
 	if (!btrfs_devread(physical, clen, cbuf))
 		goto err;
 
+	if (IS_ENABLED(CONFIG_BTRFS_VERIFY_CSUM) &&
+	    btrfs_check_data_csum(extent->disk_bytenr, physical, cbuf, clen))
+		goto err;
+
 	res = btrfs_decompress(extent->compression, cbuf, clen, dbuf, dlen);
 	if (res == -1)
 		goto err;
 
+	/* the rest of the extent is likely to be read next */
+	if ((offset || size < res) && btrfs_info.extent_cache.max) {
+		cached = malloc(res);
+		if (cached) {
+			memcpy(cached, dbuf, res);
+			btrfs_cache_put(&btrfs_info.extent_cache,
+					extent->disk_bytenr, cached, res);
+		}
+	}
+
 	if (dlen > orig_size)
 		memcpy(out, dbuf + offset, size);
 	else
 		memmove(out, dbuf + offset, size);
 
 	free(cbuf);
-	return res;
+	return size;
 
 err:
 	free(cbuf);
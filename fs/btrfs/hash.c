@@ -9,22 +9,9 @@
 #include <u-boot/crc.h>
 #include <asm/unaligned.h>
 
-static u32 btrfs_crc32c_table[256];
-
-void btrfs_hash_init(void)
-{
-	static int inited = 0;
-
-	if (!inited) {
-		crc32c_init(btrfs_crc32c_table, 0x82F63B78);
-		inited = 1;
-	}
-}
-
 u32 btrfs_crc32c(u32 crc, const void *data, size_t length)
 {
-	return crc32c_cal(crc, (const char *) data, length,
-			  btrfs_crc32c_table);
+	return crc32c(crc, data, length);
 }
 
 u32 btrfs_csum_data(char *data, u32 seed, size_t len)
@@ -53,6 +53,11 @@ int ext4fs_devread(lbaint_t sector, int byte_offset, int byte_len,
 			  byte_len, buffer);
 }
 
+int ext4fs_devreadv(struct blk_vec *vecs, int count)
+{
+	return fs_devreadv(get_fs()->dev_desc, part_info, vecs, count);
+}
+
 int ext4_read_superblock(char *buffer)
 {
 	struct ext_filesystem *fs = get_fs();
@@ -27,6 +27,8 @@
 #include <linux/stat.h>
 #include <linux/time.h>
 #include <asm/byteorder.h>
+#include <asm/unaligned.h>
+#include <u-boot/crc.h>
 #include "ext4_common.h"
 
 struct ext2_data *ext4fs_root;
@@ -92,6 +94,21 @@ static inline void ext4fs_bg_free_blocks_dec
 		bg->free_blocks_high = cpu_to_le16(free_blocks >> 16);
 }
 
+static inline void ext4fs_bg_free_blocks_sub
+	(struct ext2_block_group *bg, const struct ext_filesystem *fs,
+	 uint32_t count)
+{
+	uint32_t free_blocks = le16_to_cpu(bg->free_blocks);
+
+	if (fs->gdsize == 64)
+		free_blocks += le16_to_cpu(bg->free_blocks_high) << 16;
+	free_blocks -= count;
+
+	bg->free_blocks = cpu_to_le16(free_blocks & 0xffff);
+	if (fs->gdsize == 64)
+		bg->free_blocks_high = cpu_to_le16(free_blocks >> 16);
+}
+
 static inline void ext4fs_bg_itable_unused_dec
 	(struct ext2_block_group *bg, const struct ext_filesystem *fs)
 {
@@ -1084,6 +1101,118 @@ fail:
 	return -1;
 }
 
+/*
+ * Find the first free block at or after 'bit' in a group's block bitmap of
+ * 'nbits' blocks, and the number of free blocks following it, up to 'max'.
+ * Return the length of the run, 0 if the group has no free block left.
+ */
+static uint32_t ext4fs_find_free_run(const unsigned char *bmap, uint32_t nbits,
+				     uint32_t *bit, uint32_t max)
+{
+	uint32_t i = *bit, len;
+
+	while (i < nbits) {
+		if (!(i % 8) && bmap[i / 8] == 0xff)
+			i += 8;
+		else if (bmap[i / 8] & (1 << (i % 8)))
+			i++;
+		else
+			break;
+	}
+	if (i >= nbits)
+		return 0;
+
+	for (len = 1; len < max && i + len < nbits; len++) {
+		if (bmap[(i + len) / 8] & (1 << ((i + len) % 8)))
+			break;
+	}
+	*bit = i;
+
+	return len;
+}
+
+/**
+ * ext4fs_get_new_blk_run() - allocate a run of contiguous blocks
+ *
+ * The search starts after the last block handed out by this function or
+ * ext4fs_get_new_blk_no(), so that following calls continue where the
+ * previous run ended, and wraps around at the end of the filesystem.
+ *
+ * @want:	maximum number of blocks to allocate
+ * @start:	returns the first block of the run
+ * Return:	number of blocks allocated, 0 if there is no free block left
+ */
+uint32_t ext4fs_get_new_blk_run(uint32_t want, uint64_t *start)
+{
+	struct ext_filesystem *fs = get_fs();
+	uint32_t blk_per_grp = le32_to_cpu(fs->sb->blocks_per_group);
+	uint32_t first_blk = le32_to_cpu(fs->sb->first_data_block);
+	uint32_t data_blks = le32_to_cpu(fs->sb->total_blocks) - first_blk;
+	uint32_t bg_idx, bit, nbits, len, i, tried;
+	struct ext2_block_group *bgd;
+	uint64_t b_bitmap_blk;
+	uint16_t bg_flags;
+	char *journal_buffer;
+
+	/* Goal block, relative to the first data block */
+	bit = 0;
+	if (fs->first_pass_bbmap && fs->curr_blkno + 1 - first_blk < data_blks)
+		bit = fs->curr_blkno + 1 - first_blk;
+	bg_idx = bit / blk_per_grp;
+	bit %= blk_per_grp;
+
+	journal_buffer = zalloc(fs->blksz);
+	if (!journal_buffer)
+		return 0;
+
+	for (tried = 0; tried <= fs->no_blkgrp;
+	     tried++, bg_idx = (bg_idx + 1) % fs->no_blkgrp, bit = 0) {
+		bgd = ext4fs_get_group_descriptor(fs, bg_idx);
+		if (!ext4fs_bg_get_free_blocks(bgd, fs))
+			continue;
+
+		bg_flags = ext4fs_bg_get_flags(bgd);
+		b_bitmap_blk = ext4fs_bg_get_block_id(bgd, fs);
+		if (bg_flags & EXT4_BG_BLOCK_UNINIT) {
+			memset(fs->blk_bmaps[bg_idx], '\0', fs->blksz);
+			put_ext4(b_bitmap_blk * fs->blksz,
+				 fs->blk_bmaps[bg_idx], fs->blksz);
+			bg_flags &= ~EXT4_BG_BLOCK_UNINIT;
+			ext4fs_bg_set_flags(bgd, bg_flags);
+		}
+
+		nbits = min(blk_per_grp, data_blks - bg_idx * blk_per_grp);
+		len = ext4fs_find_free_run(fs->blk_bmaps[bg_idx], nbits, &bit,
+					   want);
+		if (!len)
+			continue;
+
+		/* journal backup */
+		if (!ext4fs_devread(b_bitmap_blk * fs->sect_perblk, 0,
+				    fs->blksz, journal_buffer) ||
+		    ext4fs_log_journal(journal_buffer, b_bitmap_blk))
+			break;
+
+		for (i = bit; i < bit + len; i++)
+			fs->blk_bmaps[bg_idx][i / 8] |= 1 << (i % 8);
+		ext4fs_bg_free_blocks_sub(bgd, fs, len);
+		ext4fs_sb_set_free_blocks(fs->sb,
+					  ext4fs_sb_get_free_blocks(fs->sb) -
+					  len);
+
+		*start = first_blk + (uint64_t)bg_idx * blk_per_grp + bit;
+		fs->curr_blkno = *start + len - 1;
+		fs->first_pass_bbmap = 1;
+		free(journal_buffer);
+
+		return len;
+	}
+
+	free(journal_buffer);
+
+	return 0;
+}
+
 int ext4fs_get_new_inode_no(void)
 {
 	short i;
@@ -1563,6 +1692,76 @@ static struct ext4_extent_header *ext4fs_get_extent_block
 	}
 }
 
+/* Fields of the on-disk inode past the part kept in struct ext2_inode */
+#define EXT4_INODE_CSUM_LO_OFFSET	0x7c
+#define EXT4_INODE_EXTRA_ISIZE_OFFSET	0x80
+#define EXT4_INODE_CSUM_HI_OFFSET	0x82
+
+static int ext4fs_gd_csum_verify(int group, struct ext2_block_group *blkgrp)
+{
+	struct ext_filesystem *fs = get_fs();
+	int offset = offsetof(struct ext2_block_group, bg_checksum);
+	__le32 le32_group = cpu_to_le32(group);
+	__le16 zero = 0;
+	uint32_t crc;
+
+	crc = crc32c(fs->csum_seed, &le32_group, sizeof(le32_group));
+	crc = crc32c(crc, blkgrp, offset);
+	crc = crc32c(crc, &zero, sizeof(zero));	/* skip checksum */
+	offset += sizeof(blkgrp->bg_checksum);
+	if (offset < fs->gdsize)
+		crc = crc32c(crc, (char *)blkgrp + offset, fs->gdsize - offset);
+
+	if ((crc & 0xffff) != le16_to_cpu(blkgrp->bg_checksum)) {
+		printf("ext4fs: checksum mismatch in group descriptor %d\n",
+		       group);
+		return 0;
+	}
+
+	return 1;
+}
+
+static int ext4fs_inode_csum_verify(int ino, const char *raw)
+{
+	struct ext_filesystem *fs = get_fs();
+	const struct ext2_inode *inode = (const struct ext2_inode *)raw;
+	int offset = EXT4_INODE_CSUM_LO_OFFSET;
+	__le32 le32_ino = cpu_to_le32(ino);
+	uint32_t crc, csum;
+	__le16 zero = 0;
+	bool has_hi;
+
+	has_hi = fs->inodesz > sizeof(struct ext2_inode) &&
+		 sizeof(struct ext2_inode) +
+		 get_unaligned_le16(raw + EXT4_INODE_EXTRA_ISIZE_OFFSET) >=
+		 EXT4_INODE_CSUM_HI_OFFSET + sizeof(zero);
+
+	crc = crc32c(fs->csum_seed, &le32_ino, sizeof(le32_ino));
+	crc = crc32c(crc, &inode->version, sizeof(inode->version));
+	crc = crc32c(crc, raw, offset);
+	crc = crc32c(crc, &zero, sizeof(zero));
+	offset += sizeof(zero);
+	csum = get_unaligned_le16(raw + EXT4_INODE_CSUM_LO_OFFSET);
+	if (has_hi) {
+		crc = crc32c(crc, raw + offset,
+			     EXT4_INODE_CSUM_HI_OFFSET - offset);
+		crc = crc32c(crc, &zero, sizeof(zero));
+		offset = EXT4_INODE_CSUM_HI_OFFSET;
+		csum |= (uint32_t)get_unaligned_le16(raw + offset) << 16;
+		offset += sizeof(zero);
+	}
+	crc = crc32c(crc, raw + offset, fs->inodesz - offset);
+	if (!has_hi)
+		crc &= 0xffff;
+
+	if (crc != csum) {
+		printf("ext4fs: checksum mismatch in inode %d\n", ino);
+		return 0;
+	}
+
+	return 1;
+}
+
 static int ext4fs_blockgroup
 	(struct ext2_data *data, int group, struct ext2_block_group *blkgrp)
 {
@@ -1584,9 +1783,15 @@ static int ext4fs_blockgroup
 	debug("ext4fs read %d group descriptor (blkno %ld blkoff %u)\n",
 	      group, blkno, blkoff);
 
-	return ext4fs_devread((lbaint_t)blkno <<
-			      (LOG2_BLOCK_SIZE(data) - log2blksz),
-			      blkoff, desc_size, (char *)blkgrp);
+	if (!ext4fs_devread((lbaint_t)blkno <<
+			    (LOG2_BLOCK_SIZE(data) - log2blksz),
+			    blkoff, desc_size, (char *)blkgrp))
+		return 0;
+
+	if (get_fs()->csum_seed)
+		return ext4fs_gd_csum_verify(group, blkgrp);
+
+	return 1;
 }
 
 int ext4fs_read_inode(struct ext2_data *data, int ino, struct ext2_inode *inode)
@@ -1598,6 +1803,7 @@ int ext4fs_read_inode(struct ext2_data *data, int ino, struct ext2_inode *inode)
 	int inodes_per_block, status;
 	long int blkno;
 	unsigned int blkoff;
+	char *raw;
 
 	/* Allocate blkgrp based on gdsize (for 64-bit support). */
 	blkgrp = zalloc(get_fs()->gdsize);
@@ -1629,14 +1835,30 @@ int ext4fs_read_inode(struct ext2_data *data, int ino, struct ext2_inode *inode)
 	/* Free blkgrp as it is no longer required. */
 	free(blkgrp);
 
-	/* Read the inode. */
-	status = ext4fs_devread((lbaint_t)blkno << (LOG2_BLOCK_SIZE(data) -
-				log2blksz), blkoff,
-				sizeof(struct ext2_inode), (char *)inode);
-	if (status == 0)
+	/* Read the inode, all of it if its checksum is to be verified. */
+	if (!fs->csum_seed) {
+		status = ext4fs_devread((lbaint_t)blkno <<
+					(LOG2_BLOCK_SIZE(data) - log2blksz),
+					blkoff, sizeof(struct ext2_inode),
+					(char *)inode);
+		if (status == 0)
+			return 0;
+
+		return 1;
+	}
+
+	raw = malloc(fs->inodesz);
+	if (!raw)
 		return 0;
+	status = ext4fs_devread((lbaint_t)blkno << (LOG2_BLOCK_SIZE(data) -
+				log2blksz), blkoff, fs->inodesz, raw);
+	if (status)
+		status = ext4fs_inode_csum_verify(ino + 1, raw);
+	if (status)
+		memcpy(inode, raw, sizeof(struct ext2_inode));
+	free(raw);
 
-	return 1;
+	return status;
 }
 
 long int read_allocated_block(struct ext2_inode *inode, int fileblock,
@@ -2395,6 +2617,18 @@ int ext4fs_mount(unsigned part_length)
 			le16_to_cpu(data->sblock.descriptor_size) : 32;
 	}
 
+	fs->csum_seed = 0;
+	if (IS_ENABLED(CONFIG_EXT4_VERIFY_CSUM) &&
+	    le32_to_cpu(data->sblock.feature_ro_compat) &
+	    EXT4_FEATURE_RO_COMPAT_METADATA_CSUM) {
+		if (le32_to_cpu(data->sblock.feature_incompat) &
+		    EXT4_FEATURE_INCOMPAT_CSUM_SEED)
+			fs->csum_seed = le32_to_cpu(data->sblock.checksum_seed);
+		else
+			fs->csum_seed = crc32c(~0, data->sblock.unique_id,
+					       sizeof(data->sblock.unique_id));
+	}
+
 	debug("EXT2 rev %d, inode_size %d, descriptor size %d\n",
 	      le32_to_cpu(data->sblock.revision_level),
 	      fs->inodesz, fs->gdsize);
@@ -163,6 +163,10 @@ int ext4fs_log_journal(char *journal_buffer, uint32_t blknr)
 		if (journal_ptr[i]->blknr == blknr)
 			return 0;
 	}
+	if (gindex >= MAX_JOURNAL_ENTRIES) {
+		printf("Too many blocks to back up in the journal\n");
+		return -ENOSPC;
+	}
 
 	journal_ptr[gindex]->buf = zalloc(fs->blksz);
 	if (!journal_ptr[gindex]->buf)
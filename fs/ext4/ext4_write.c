@@ -432,24 +432,61 @@ fail:
 	free(journal_buffer);
 }
 
+/*
+ * Return a block to its group, backing up the block bitmap in the journal
+ * the first time the group is touched
+ */
+static int ext4fs_free_block(long int blknr, char *journal_buffer)
+{
+	static int prev_bg_bmap_idx = -1;
+	struct ext_filesystem *fs = get_fs();
+	uint32_t blk_per_grp = le32_to_cpu(fs->sb->blocks_per_group);
+	struct ext2_block_group *bgd;
+	int bg_idx;
+
+	bg_idx = blknr / blk_per_grp;
+	if (fs->blksz == 1024) {
+		if (!(blknr % blk_per_grp))
+			bg_idx--;
+	}
+	ext4fs_reset_block_bmap(blknr, fs->blk_bmaps[bg_idx], bg_idx);
+	debug("EXT4 Block releasing %ld: %d\n", blknr, bg_idx);
+
+	/* get  block group descriptor table */
+	bgd = ext4fs_get_group_descriptor(fs, bg_idx);
+	ext4fs_bg_free_blocks_inc(bgd, fs);
+	ext4fs_sb_free_blocks_inc(fs->sb);
+	/* journal backup */
+	if (prev_bg_bmap_idx != bg_idx) {
+		uint64_t b_bitmap_blk = ext4fs_bg_get_block_id(bgd, fs);
+
+		if (!ext4fs_devread(b_bitmap_blk * fs->sect_perblk, 0,
+				    fs->blksz, journal_buffer))
+			return -1;
+		if (ext4fs_log_journal(journal_buffer, b_bitmap_blk))
+			return -1;
+		prev_bg_bmap_idx = bg_idx;
+	}
+
+	return 0;
+}
+
 static int ext4fs_delete_file(int inodeno)
 {
 	struct ext2_inode inode;
 	short status;
 	int i;
-	int remainder;
 	long int blknr;
-	int bg_idx;
 	int ibmap_idx;
 	char *read_buffer = NULL;
 	char *start_block_address = NULL;
 	uint32_t no_blocks;
+	struct ext4_extent_header *eh = NULL;
+	struct ext4_extent_idx *idx;
 
-	static int prev_bg_bmap_idx = -1;
 	unsigned int inodes_per_block;
 	uint32_t blkno;
 	unsigned int blkoff;
-	uint32_t blk_per_grp = le32_to_cpu(ext4fs_root->sblock.blocks_per_group);
 	uint32_t inode_per_grp = le32_to_cpu(ext4fs_root->sblock.inodes_per_group);
 	struct ext2_inode *inode_buffer = NULL;
 	struct ext2_block_group *bgd = NULL;
@@ -476,10 +513,8 @@ static int ext4fs_delete_file(int inodeno)
 	}
 
 	if (le32_to_cpu(inode.flags) & EXT4_EXTENTS_FL) {
-		/* FIXME delete extent index blocks, i.e. eh_depth >= 1 */
-		struct ext4_extent_header *eh =
-			(struct ext4_extent_header *)
-				inode.b.blocks.dir_blocks;
+		/* FIXME delete extent index blocks, i.e. eh_depth >= 2 */
+		eh = (struct ext4_extent_header *)inode.b.blocks.dir_blocks;
 		debug("del: dep=%d entries=%d\n", eh->eh_depth, eh->eh_entries);
 	} else {
 		delete_single_indirect_block(&inode);
@@ -494,31 +529,18 @@ static int ext4fs_delete_file(int inodeno)
 			continue;
 		if (blknr < 0)
 			goto fail;
-		bg_idx = blknr / blk_per_grp;
-		if (fs->blksz == 1024) {
-			remainder = blknr % blk_per_grp;
-			if (!remainder)
-				bg_idx--;
-		}
-		ext4fs_reset_block_bmap(blknr, fs->blk_bmaps[bg_idx],
-					bg_idx);
-		debug("EXT4 Block releasing %ld: %d\n", blknr, bg_idx);
+		if (ext4fs_free_block(blknr, journal_buffer))
+			goto fail;
+	}
 
-		/* get  block group descriptor table */
-		bgd = ext4fs_get_group_descriptor(fs, bg_idx);
-		ext4fs_bg_free_blocks_inc(bgd, fs);
-		ext4fs_sb_free_blocks_inc(fs->sb);
-		/* journal backup */
-		if (prev_bg_bmap_idx != bg_idx) {
-			uint64_t b_bitmap_blk = ext4fs_bg_get_block_id(bgd, fs);
-			status = ext4fs_devread(b_bitmap_blk * fs->sect_perblk,
-						0, fs->blksz,
-						journal_buffer);
-			if (status == 0)
-				goto fail;
-			if (ext4fs_log_journal(journal_buffer, b_bitmap_blk))
+	/* release the leaf blocks of a one level extent tree */
+	if (eh && le16_to_cpu(eh->eh_depth) == 1) {
+		idx = (struct ext4_extent_idx *)(eh + 1);
+		for (i = 0; i < le16_to_cpu(eh->eh_entries); i++) {
+			blknr = le32_to_cpu(idx[i].ei_leaf_lo) |
+				(uint64_t)le16_to_cpu(idx[i].ei_leaf_hi) << 32;
+			if (ext4fs_free_block(blknr, journal_buffer))
 				goto fail;
-			prev_bg_bmap_idx = bg_idx;
 		}
 	}
 
@@ -839,6 +861,141 @@ static int ext4fs_write_file(struct ext2_inode *file_inode,
 	return len;
 }
 
+/* Longest extent that is not marked as uninitialised */
+#define EXT4_EXT_MAX_LEN	(1 << 15)
+/* Number of entries in the extent tree root inside the inode */
+#define EXT4_EXT_ROOT_ENTRIES	4
+
+static void ext4fs_ext_set_start(struct ext4_extent *ext, uint64_t start)
+{
+	ext->ee_start_lo = cpu_to_le32(start & 0xffffffff);
+	ext->ee_start_hi = cpu_to_le16(start >> 32);
+}
+
+/*
+ * Allocate the data blocks of a new file in runs of contiguous blocks,
+ * write each run with a single device access and record the runs as an
+ * extent tree. Up to four extents fit into the inode itself, more go into
+ * leaf blocks referenced from the inode. blks_reqd returns the number of
+ * blocks used, including leaf blocks.
+ */
+static int ext4fs_write_extents(struct ext2_inode *file_inode,
+				const char *buf, unsigned long size,
+				unsigned int *blks_reqd)
+{
+	struct ext_filesystem *fs = get_fs();
+	struct ext4_extent_header *eh =
+		(struct ext4_extent_header *)file_inode->b.blocks.dir_blocks;
+	struct ext4_extent_idx *idx = (struct ext4_extent_idx *)(eh + 1);
+	unsigned int per_leaf = (fs->blksz - sizeof(*eh)) /
+				sizeof(struct ext4_extent);
+	unsigned int max_ext = EXT4_EXT_ROOT_ENTRIES * per_leaf;
+	unsigned int nblocks = DIV_ROUND_UP(size, fs->blksz);
+	unsigned int done = 0, nr_ext = 0, nr_leaves = 0, len, i;
+	struct ext4_extent *ext, *prev;
+	struct ext4_extent_header *leaf;
+	unsigned long bytes, tail;
+	uint64_t start, prev_end = 0;
+	char *block;
+	int ret = -1;
+
+	ext = zalloc(max_ext * sizeof(*ext));
+	block = zalloc(fs->blksz);
+	if (!ext || !block)
+		goto fail;
+
+	while (done < nblocks) {
+		len = ext4fs_get_new_blk_run(min_t(unsigned int,
+						   nblocks - done,
+						   EXT4_EXT_MAX_LEN), &start);
+		if (!len) {
+			printf("no block left to assign\n");
+			goto fail;
+		}
+		debug("EXT %u: %u blocks at %llu\n", done, len, start);
+
+		/* write the run, the last block padded with zeroes */
+		bytes = min_t(unsigned long, (unsigned long)len * fs->blksz,
+			      size - (unsigned long)done * fs->blksz);
+		tail = bytes % fs->blksz;
+		if (bytes - tail)
+			put_ext4(start * fs->blksz, buf, bytes - tail);
+		if (tail) {
+			memset(block, '\0', fs->blksz);
+			memcpy(block, buf + bytes - tail, tail);
+			put_ext4((start + len - 1) * fs->blksz, block,
+				 fs->blksz);
+		}
+		buf += bytes;
+
+		/* runs across a block group boundary may continue the last */
+		prev = nr_ext ? &ext[nr_ext - 1] : NULL;
+		if (prev) {
+			prev_end = le16_to_cpu(prev->ee_start_hi);
+			prev_end = (prev_end << 32) +
+				   le32_to_cpu(prev->ee_start_lo) +
+				   le16_to_cpu(prev->ee_len);
+		}
+		if (prev && start == prev_end &&
+		    le16_to_cpu(prev->ee_len) + len <= EXT4_EXT_MAX_LEN) {
+			prev->ee_len = cpu_to_le16(le16_to_cpu(prev->ee_len) +
+						   len);
+		} else if (nr_ext == max_ext) {
+			printf("file too fragmented for an extent tree\n");
+			goto fail;
+		} else {
+			ext[nr_ext].ee_block = cpu_to_le32(done);
+			ext[nr_ext].ee_len = cpu_to_le16(len);
+			ext4fs_ext_set_start(&ext[nr_ext], start);
+			nr_ext++;
+		}
+		done += len;
+	}
+
+	memset(eh, '\0', sizeof(file_inode->b.blocks));
+	eh->eh_magic = cpu_to_le16(EXT4_EXT_MAGIC);
+	eh->eh_max = cpu_to_le16(EXT4_EXT_ROOT_ENTRIES);
+	if (nr_ext <= EXT4_EXT_ROOT_ENTRIES) {
+		eh->eh_entries = cpu_to_le16(nr_ext);
+		memcpy(eh + 1, ext, nr_ext * sizeof(*ext));
+	} else {
+		/* one level of leaf blocks below the root */
+		for (i = 0; i < nr_ext; i += per_leaf, nr_leaves++) {
+			len = min(nr_ext - i, per_leaf);
+			if (!ext4fs_get_new_blk_run(1, &start)) {
+				printf("no block left to assign\n");
+				goto fail;
+			}
+			debug("EXT leaf %u at %llu\n", nr_leaves, start);
+
+			memset(block, '\0', fs->blksz);
+			leaf = (struct ext4_extent_header *)block;
+			leaf->eh_magic = cpu_to_le16(EXT4_EXT_MAGIC);
+			leaf->eh_entries = cpu_to_le16(len);
+			leaf->eh_max = cpu_to_le16(per_leaf);
+			memcpy(leaf + 1, &ext[i], len * sizeof(*ext));
+			put_ext4(start * fs->blksz, block, fs->blksz);
+
+			idx[nr_leaves].ei_block = ext[i].ee_block;
+			idx[nr_leaves].ei_leaf_lo = cpu_to_le32(start &
+								0xffffffff);
+			idx[nr_leaves].ei_leaf_hi = cpu_to_le16(start >> 32);
+		}
+		eh->eh_entries = cpu_to_le16(nr_leaves);
+		eh->eh_depth = cpu_to_le16(1);
+	}
+
+	file_inode->flags = cpu_to_le32(le32_to_cpu(file_inode->flags) |
+					EXT4_EXTENTS_FL);
+	*blks_reqd = nblocks + nr_leaves;
+	ret = 0;
+fail:
+	free(block);
+	free(ext);
+
+	return ret;
+}
+
 int ext4fs_write(const char *fname, const char *buffer,
 		 unsigned long sizebytes, int type)
 {
@@ -864,6 +1021,7 @@ int ext4fs_write(const char *fname, const char *buffer,
 	struct ext_filesystem *fs = get_fs();
 	ALLOC_CACHE_ALIGN_BUFFER(char, filename, 256);
 	bool store_link_in_inode = false;
+	bool use_extents;
 	memset(filename, 0x00, 256);
 
 	if (type != FILETYPE_REG && type != FILETYPE_SYMLINK)
@@ -954,9 +1112,23 @@ int ext4fs_write(const char *fname, const char *buffer,
 	file_inode->ctime = cpu_to_le32(timestamp);
 	file_inode->nlinks = cpu_to_le16(1);
 
-	/* Allocate data blocks */
-	ext4fs_allocate_blocks(file_inode, blocks_remaining,
-			       &blks_reqd_for_file);
+	/*
+	 * Allocate data blocks. On filesystems with extents they are written
+	 * right away, run by run.
+	 */
+	use_extents = !store_link_in_inode &&
+		      (le32_to_cpu(fs->sb->feature_incompat) &
+		       EXT4_FEATURE_INCOMPAT_EXTENTS);
+	if (use_extents) {
+		if (ext4fs_write_extents(file_inode, buffer, sizebytes,
+					 &blks_reqd_for_file)) {
+			printf("Error in copying content\n");
+			goto fail;
+		}
+	} else {
+		ext4fs_allocate_blocks(file_inode, blocks_remaining,
+				       &blks_reqd_for_file);
+	}
 	file_inode->blockcnt = cpu_to_le32((blks_reqd_for_file * fs->blksz) >>
 					   LOG2_SECTOR_SIZE);
 
@@ -979,7 +1151,8 @@ int ext4fs_write(const char *fname, const char *buffer,
 	if (ext4fs_put_metadata(temp_ptr, itable_blkno))
 		goto fail;
 	/* copy the file content into data blocks */
-	if (ext4fs_write_file(file_inode, 0, sizebytes, buffer) == -1) {
+	if (!use_extents &&
+	    ext4fs_write_file(file_inode, 0, sizebytes, buffer) == -1) {
 		printf("Error in copying content\n");
 		/* FIXME: Deallocate data blocks */
 		goto fail;
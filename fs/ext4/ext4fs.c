@@ -25,6 +25,7 @@
 #include <ext4fs.h>
 #include "ext4_common.h"
 #include <div64.h>
+#include <fs.h>
 #include <malloc.h>
 
 int ext4fs_symlinknest;
@@ -41,13 +42,77 @@ void ext4fs_free_node(struct ext2fs_node *node, struct ext2fs_node *currroot)
 		free(node);
 }
 
+/* Number of runs of sectors collected before they are read */
+#define EXT4_READ_VECS	32
+
+struct ext4_read_runs {
+	struct blk_vec vecs[EXT4_READ_VECS];
+	int count;
+};
+
+/* Read the runs collected so far, returns 1 if OK, 0 on error */
+static int ext4fs_submit_runs(struct ext4_read_runs *runs)
+{
+	int status = 1;
+
+	if (runs->count)
+		status = ext4fs_devreadv(runs->vecs, runs->count);
+	runs->count = 0;
+
+	return status;
+}
+
+/*
+ * Queue @len bytes starting @skip bytes into @sector. Partial sectors at
+ * either end are read straight away, whole sectors are collected so that
+ * the runs of a fragmented file go to the device together.
+ */
+static int ext4fs_queue_run(struct ext4_read_runs *runs, lbaint_t sector,
+			    int skip, int len, char *buf)
+{
+	struct blk_desc *desc = get_fs()->dev_desc;
+	int log2blksz = desc->log2blksz;
+	int n;
+
+	sector += skip >> log2blksz;
+	skip &= desc->blksz - 1;
+	if (skip) {
+		n = min_t(int, desc->blksz - skip, len);
+		if (!ext4fs_devread(sector, skip, n, buf))
+			return 0;
+		sector++;
+		buf += n;
+		len -= n;
+	}
+
+	n = len >> log2blksz;
+	if (n) {
+		if (runs->count == EXT4_READ_VECS &&
+		    !ext4fs_submit_runs(runs))
+			return 0;
+		runs->vecs[runs->count].start = sector;
+		runs->vecs[runs->count].blkcnt = n;
+		runs->vecs[runs->count].buffer = buf;
+		runs->count++;
+		sector += n;
+		buf += n << log2blksz;
+		len -= n << log2blksz;
+	}
+
+	if (len)
+		return ext4fs_devread(sector, 0, len, buf);
+
+	return 1;
+}
+
 /*
  * Taken from openmoko-kernel mailing list: By Andy green
  * Optimized read file API : collects and defers contiguous sector
  * reads into one potentially more efficient larger sequential read action
  */
-int ext4fs_read_file(struct ext2fs_node *node, loff_t pos,
-		loff_t len, char *buf, loff_t *actread)
+static int ext4fs_read_file_cached(struct ext2fs_node *node, loff_t pos,
+				   loff_t len, char *buf, loff_t *actread,
+				   struct ext_block_cache *cache)
 {
 	struct ext_filesystem *fs = get_fs();
 	int i;
@@ -63,32 +128,27 @@ int ext4fs_read_file(struct ext2fs_node *node, loff_t pos,
 	lbaint_t delayed_next = 0;
 	char *delayed_buf = NULL;
 	char *start_buf = buf;
+	struct ext4_read_runs runs;
 	short status;
-	struct ext_block_cache cache;
-
-	ext_cache_init(&cache);
 
 	/* Adjust len so it we can't read past the end of the file. */
 	if (len + pos > filesize)
 		len = (filesize - pos);
 
-	if (blocksize <= 0 || len <= 0) {
-		ext_cache_fini(&cache);
+	if (blocksize <= 0 || len <= 0)
 		return -1;
-	}
 
 	blockcnt = lldiv(((len + pos) + blocksize - 1), blocksize);
+	runs.count = 0;
 
 	for (i = lldiv(pos, blocksize); i < blockcnt; i++) {
 		long int blknr;
 		int blockoff = pos - (blocksize * i);
 		int blockend = blocksize;
 		int skipfirst = 0;
-		blknr = read_allocated_block(&node->inode, i, &cache);
-		if (blknr < 0) {
-			ext_cache_fini(&cache);
+		blknr = read_allocated_block(&node->inode, i, cache);
+		if (blknr < 0)
 			return -1;
-		}
 
 		blknr = blknr << log2_fs_blocksize;
 
@@ -114,14 +174,13 @@ int ext4fs_read_file(struct ext2fs_node *node, loff_t pos,
 					delayed_extent += blockend;
 					delayed_next += blockend >> log2blksz;
 				} else {	/* spill */
-					status = ext4fs_devread(delayed_start,
+					status = ext4fs_queue_run(&runs,
+							delayed_start,
 							delayed_skipfirst,
 							delayed_extent,
 							delayed_buf);
-					if (status == 0) {
-						ext_cache_fini(&cache);
+					if (status == 0)
 						return -1;
-					}
 					previous_block_number = blknr;
 					delayed_start = blknr;
 					delayed_extent = blockend;
@@ -144,14 +203,13 @@ int ext4fs_read_file(struct ext2fs_node *node, loff_t pos,
 			int n_left;
 			if (previous_block_number != -1) {
 				/* spill */
-				status = ext4fs_devread(delayed_start,
-							delayed_skipfirst,
-							delayed_extent,
-							delayed_buf);
-				if (status == 0) {
-					ext_cache_fini(&cache);
+				status = ext4fs_queue_run(&runs,
+							  delayed_start,
+							  delayed_skipfirst,
+							  delayed_extent,
+							  delayed_buf);
+				if (status == 0)
 					return -1;
-				}
 				previous_block_number = -1;
 			}
 			/* Zero no more than `len' bytes. */
@@ -165,21 +223,33 @@ int ext4fs_read_file(struct ext2fs_node *node, loff_t pos,
 	}
 	if (previous_block_number != -1) {
 		/* spill */
-		status = ext4fs_devread(delayed_start,
-					delayed_skipfirst, delayed_extent,
-					delayed_buf);
-		if (status == 0) {
-			ext_cache_fini(&cache);
+		status = ext4fs_queue_run(&runs, delayed_start,
+					  delayed_skipfirst, delayed_extent,
+					  delayed_buf);
+		if (status == 0)
 			return -1;
-		}
 		previous_block_number = -1;
 	}
+	if (!ext4fs_submit_runs(&runs))
+		return -1;
 
 	*actread  = len;
-	ext_cache_fini(&cache);
 	return 0;
 }
 
+int ext4fs_read_file(struct ext2fs_node *node, loff_t pos,
+		loff_t len, char *buf, loff_t *actread)
+{
+	struct ext_block_cache cache;
+	int ret;
+
+	ext_cache_init(&cache);
+	ret = ext4fs_read_file_cached(node, pos, len, buf, actread, &cache);
+	ext_cache_fini(&cache);
+
+	return ret;
+}
+
 int ext4fs_ls(const char *dirname)
 {
 	struct ext2fs_node *dirnode = NULL;
@@ -256,6 +326,56 @@ int ext4_read_file(const char *filename, void *buf, loff_t offset, loff_t len,
 	return ext4fs_read(buf, offset, len, len_read);
 }
 
+struct ext4_file {
+	struct fs_file parent;
+	struct ext2fs_node node;
+	struct ext_block_cache cache;
+};
+
+int ext4fs_open_file(const char *filename, struct fs_file **filep)
+{
+	struct ext4_file *file;
+	loff_t file_len;
+
+	file = calloc(1, sizeof(*file));
+	if (!file)
+		return -ENOMEM;
+
+	if (ext4fs_open(filename, &file_len) < 0) {
+		free(file);
+		return -ENOENT;
+	}
+
+	/* Keep the resolved inode, the node itself belongs to this mount */
+	file->node = *ext4fs_file;
+	file->parent.size = file_len;
+	ext_cache_init(&file->cache);
+	*filep = &file->parent;
+
+	return 0;
+}
+
+int ext4fs_read_at(struct fs_file *filp, void *buf, loff_t offset,
+		   loff_t len, loff_t *actread)
+{
+	struct ext4_file *file = container_of(filp, struct ext4_file, parent);
+
+	if (!ext4fs_root)
+		return -1;
+	file->node.data = ext4fs_root;
+
+	return ext4fs_read_file_cached(&file->node, offset, len, buf, actread,
+				       &file->cache);
+}
+
+void ext4fs_close_file(struct fs_file *filp)
+{
+	struct ext4_file *file = container_of(filp, struct ext4_file, parent);
+
+	ext_cache_fini(&file->cache);
+	free(file);
+}
+
 int ext4fs_uuid(char *uuid_str)
 {
 	if (ext4fs_root == NULL)
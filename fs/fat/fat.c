@@ -14,6 +14,7 @@
 #include <exports.h>
 #include <fat.h>
 #include <fs.h>
+#include <fs_internal.h>
 #include <asm/byteorder.h>
 #include <part.h>
 #include <malloc.h>
@@ -301,6 +302,81 @@ get_cluster(fsdata *mydata, __u32 clustnum, __u8 *buffer, unsigned long size)
 	return 0;
 }
 
+/* Number of runs of sectors collected before they are read */
+#define FAT_READ_VECS	32
+
+struct fat_read_runs {
+	struct blk_vec vecs[FAT_READ_VECS];
+	int count;
+};
+
+/* Read the runs collected so far, returns 0 on success, -1 otherwise */
+static int fat_submit_runs(struct fat_read_runs *runs)
+{
+	int status = 1;
+
+	if (runs->count)
+		status = fs_devreadv(cur_dev, &cur_part_info, runs->vecs,
+				     runs->count);
+	runs->count = 0;
+
+	return status ? 0 : -1;
+}
+
+/*
+ * Like get_cluster(), but the whole sectors are only queued in 'runs', so
+ * that the fragments of a file are sent to the device together. The data
+ * is not in 'buffer' until fat_submit_runs() has been called.
+ */
+static int fat_queue_cluster(fsdata *mydata, struct fat_read_runs *runs,
+			     __u32 clustnum, __u8 *buffer, unsigned long size)
+{
+	__u32 startsect, nsect;
+
+	if ((unsigned long)buffer & (ARCH_DMA_MINALIGN - 1))
+		return get_cluster(mydata, clustnum, buffer, size);
+
+	if (clustnum > 0)
+		startsect = clust_to_sect(mydata, clustnum);
+	else
+		startsect = mydata->rootdir_sect;
+
+	nsect = size / mydata->sect_size;
+	if (nsect) {
+		if (runs->count == FAT_READ_VECS && fat_submit_runs(runs))
+			return -1;
+		runs->vecs[runs->count].start = startsect;
+		runs->vecs[runs->count].blkcnt = nsect;
+		runs->vecs[runs->count].buffer = buffer;
+		runs->count++;
+		startsect += nsect;
+		buffer += nsect * mydata->sect_size;
+		size -= nsect * mydata->sect_size;
+	}
+	if (size) {
+		ALLOC_CACHE_ALIGN_BUFFER(__u8, tmpbuf, mydata->sect_size);
+
+		if (disk_read(startsect, 1, tmpbuf) != 1) {
+			debug("Error reading data\n");
+			return -1;
+		}
+		memcpy(buffer, tmpbuf, size);
+	}
+
+	return 0;
+}
+
+/**
+ * typedef fat_clust_pos - cluster of a file at a known position
+ *
+ * @pos:	offset in the file of the first byte of the cluster
+ * @clust:	cluster number, 0 if not known
+ */
+typedef struct {
+	loff_t pos;
+	__u32 clust;
+} fat_clust_pos;
+
 /**
  * get_contents() - read from file
  *
@@ -308,22 +384,30 @@ get_cluster(fsdata *mydata, __u32 clustnum, __u8 *buffer, unsigned long size)
  * into 'buffer'. Update the number of bytes read in *gotsize or return -1 on
  * fatal errors.
  *
+ * If 'hint' is given, the cluster chain is followed from the cluster it
+ * records rather than from the start of the file when possible, and it is
+ * updated to the last cluster read. Sequential reads through a file handle
+ * thus do not walk the cluster chain from the start each time.
+ *
  * @mydata:	file system description
  * @dentprt:	directory entry pointer
  * @pos:	position from where to read
  * @buffer:	buffer into which to read
  * @maxsize:	maximum number of bytes to read
  * @gotsize:	number of bytes actually read
+ * @hint:	known cluster position in the file or NULL
  * Return:	-1 on error, otherwise 0
  */
 static int get_contents(fsdata *mydata, dir_entry *dentptr, loff_t pos,
-			__u8 *buffer, loff_t maxsize, loff_t *gotsize)
+			__u8 *buffer, loff_t maxsize, loff_t *gotsize,
+			fat_clust_pos *hint)
 {
 	loff_t filesize = FAT2CPU32(dentptr->size);
 	unsigned int bytesperclust = mydata->clust_size * mydata->sect_size;
 	__u32 curclust = START(dentptr);
 	__u32 endclust, newclust;
-	loff_t actsize;
+	loff_t actsize, clustpos;
+	struct fat_read_runs runs;
 
 	*gotsize = 0;
 	debug("Filesize: %llu bytes\n", filesize);
@@ -339,6 +423,10 @@ static int get_contents(fsdata *mydata, dir_entry *dentptr, loff_t pos,
 	debug("%llu bytes\n", filesize);
 
 	actsize = bytesperclust;
+	if (hint && hint->clust && hint->pos <= pos) {
+		curclust = hint->clust;
+		actsize += hint->pos;
+	}
 
 	/* go to cluster at pos */
 	while (actsize <= pos) {
@@ -353,6 +441,7 @@ static int get_contents(fsdata *mydata, dir_entry *dentptr, loff_t pos,
 
 	/* actsize > pos */
 	actsize -= bytesperclust;
+	clustpos = actsize;
 	filesize -= actsize;
 	pos -= actsize;
 
@@ -377,8 +466,13 @@ static int get_contents(fsdata *mydata, dir_entry *dentptr, loff_t pos,
 		memcpy(buffer, tmp_buffer + pos, actsize);
 		free(tmp_buffer);
 		*gotsize += actsize;
-		if (!filesize)
+		if (!filesize) {
+			if (hint) {
+				hint->pos = clustpos;
+				hint->clust = curclust;
+			}
 			return 0;
+		}
 		buffer += actsize;
 
 		curclust = get_fatent(mydata, curclust);
@@ -387,10 +481,12 @@ static int get_contents(fsdata *mydata, dir_entry *dentptr, loff_t pos,
 			printf("Invalid FAT entry\n");
 			return -1;
 		}
+		clustpos += bytesperclust;
 	}
 
 	actsize = bytesperclust;
 	endclust = curclust;
+	runs.count = 0;
 
 	do {
 		/* search for consecutive clusters */
@@ -409,20 +505,29 @@ static int get_contents(fsdata *mydata, dir_entry *dentptr, loff_t pos,
 
 		/* get remaining bytes */
 		actsize = filesize;
-		if (get_cluster(mydata, curclust, buffer, (int)actsize) != 0) {
+		if (fat_queue_cluster(mydata, &runs, curclust, buffer,
+				      (int)actsize) != 0 ||
+		    fat_submit_runs(&runs) != 0) {
 			printf("Error reading cluster\n");
 			return -1;
 		}
 		*gotsize += actsize;
+		if (hint) {
+			hint->pos = clustpos + (loff_t)(endclust - curclust) *
+					       bytesperclust;
+			hint->clust = endclust;
+		}
 		return 0;
 getit:
-		if (get_cluster(mydata, curclust, buffer, (int)actsize) != 0) {
+		if (fat_queue_cluster(mydata, &runs, curclust, buffer,
+				      (int)actsize) != 0) {
 			printf("Error reading cluster\n");
 			return -1;
 		}
 		*gotsize += (int)actsize;
 		filesize -= actsize;
 		buffer += actsize;
+		clustpos += actsize;
 
 		curclust = get_fatent(mydata, endclust);
 		if (CHECK_CLUST(curclust, mydata->fatsize)) {
@@ -556,6 +661,7 @@ static int get_fs_info(fsdata *mydata)
 {
 	boot_sector bs;
 	volume_info volinfo;
+	u32 data_sect, fat_bytes, fat_ents;
 	int ret;
 
 	ret = read_bootsectandvi(&bs, &volinfo, &mydata->fatsize);
@@ -621,6 +727,25 @@ static int get_fs_info(fsdata *mydata)
 		mydata->root_cluster = 0;
 	}
 
+	/* Highest cluster, limited by both the data area and the FAT */
+	data_sect = mydata->data_begin + mydata->clust_size * 2;
+	mydata->max_clust = 1;
+	if (mydata->total_sect > data_sect)
+		mydata->max_clust += (mydata->total_sect - data_sect) /
+				     mydata->clust_size;
+	fat_bytes = mydata->fatlength * mydata->sect_size;
+	fat_ents = fat_bytes / mydata->fatsize * 8 +
+		   fat_bytes % mydata->fatsize * 8 / mydata->fatsize;
+	if (mydata->max_clust >= fat_ents)
+		mydata->max_clust = fat_ents - 1;
+
+	mydata->fsinfo_sect = 0;
+	if (mydata->fatsize == 32 && bs.info_sector &&
+	    bs.info_sector < bs.reserved)
+		mydata->fsinfo_sect = bs.info_sector;
+	mydata->fsinfo_dirty = 0;
+	mydata->clust_map = NULL;
+
 	mydata->fatbufnum = -1;
 	mydata->fat_dirty = 0;
 	mydata->fatbuf = malloc_cache_aligned(FATBUFSIZE);
@@ -1215,7 +1340,8 @@ int file_fat_read_at(const char *filename, loff_t pos, void *buffer,
 	/* For saving default max clustersize memory allocated to malloc pool */
 	dir_entry *dentptr = itr->dent;
 
-	ret = get_contents(&fsdata, dentptr, pos, buffer, maxsize, actread);
+	ret = get_contents(&fsdata, dentptr, pos, buffer, maxsize, actread,
+			   NULL);
 
 out_free_both:
 	free(fsdata.fatbuf);
@@ -1313,6 +1439,68 @@ void fat_closedir(struct fs_dir_stream *dirs)
 	free(dir);
 }
 
+typedef struct {
+	struct fs_file parent;
+	fsdata fsdata;
+	dir_entry dent;
+	fat_clust_pos hint;
+} fat_file;
+
+int fat_open_file(const char *filename, struct fs_file **filep)
+{
+	fat_file *file;
+	fat_itr *itr;
+	int ret;
+
+	file = malloc_cache_aligned(sizeof(*file));
+	itr = malloc_cache_aligned(sizeof(fat_itr));
+	if (!file || !itr) {
+		ret = -ENOMEM;
+		goto fail_free;
+	}
+	memset(file, 0, sizeof(*file));
+
+	ret = fat_itr_root(itr, &file->fsdata);
+	if (ret)
+		goto fail_free;
+
+	ret = fat_itr_resolve(itr, filename, TYPE_FILE);
+	if (ret) {
+		free(file->fsdata.fatbuf);
+		goto fail_free;
+	}
+
+	/* Only the directory entry is needed, the iterator is large */
+	file->dent = *itr->dent;
+	file->parent.size = FAT2CPU32(file->dent.size);
+	free(itr);
+
+	*filep = &file->parent;
+	return 0;
+
+fail_free:
+	free(itr);
+	free(file);
+	return ret;
+}
+
+int fat_read_at(struct fs_file *filp, void *buf, loff_t offset, loff_t len,
+		loff_t *actread)
+{
+	fat_file *file = container_of(filp, fat_file, parent);
+
+	return get_contents(&file->fsdata, &file->dent, offset, buf, len,
+			    actread, &file->hint);
+}
+
+void fat_close_file(struct fs_file *filp)
+{
+	fat_file *file = container_of(filp, fat_file, parent);
+
+	free(file->fsdata.fatbuf);
+	free(file);
+}
+
 void fat_close(void)
 {
 }
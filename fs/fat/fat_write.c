@@ -141,6 +141,201 @@ static int flush_dirty_fat_buffer(fsdata *mydata)
 	return 0;
 }
 
+static int fsinfo_valid(const struct fsinfo_sector *fsinfo)
+{
+	return le32_to_cpu(fsinfo->lead_sign) == FSINFO_LEAD_SIGN &&
+	       le32_to_cpu(fsinfo->struct_sign) == FSINFO_STRUCT_SIGN &&
+	       le32_to_cpu(fsinfo->trail_sign) == FSINFO_TRAIL_SIGN;
+}
+
+/*
+ * Update the free cluster count and next free hint in the FAT32 FSInfo
+ * sector. Without a cluster map the number of free clusters is not known
+ * any more, so it is marked as such.
+ */
+static int flush_fsinfo(fsdata *mydata)
+{
+	struct fsinfo_sector *fsinfo;
+	int ret = 0;
+
+	if (!mydata->fsinfo_sect || !mydata->fsinfo_dirty)
+		return 0;
+
+	fsinfo = malloc_cache_aligned(mydata->sect_size);
+	if (!fsinfo)
+		return -1;
+
+	if (disk_read(mydata->fsinfo_sect, 1, fsinfo) < 0) {
+		debug("error: reading FSInfo sector\n");
+		ret = -1;
+		goto exit;
+	}
+	if (!fsinfo_valid(fsinfo))
+		goto exit;
+
+	if (mydata->clust_map) {
+		fsinfo->free_count = cpu_to_le32(mydata->free_clust);
+		fsinfo->next_free = cpu_to_le32(mydata->next_free);
+	} else {
+		fsinfo->free_count = cpu_to_le32(FSINFO_UNKNOWN);
+	}
+
+	if (disk_write(mydata->fsinfo_sect, 1, fsinfo) < 0) {
+		debug("error: writing FSInfo sector\n");
+		ret = -1;
+		goto exit;
+	}
+	mydata->fsinfo_dirty = 0;
+
+exit:
+	free(fsinfo);
+	return ret;
+}
+
+static int clust_used(fsdata *mydata, __u32 clust)
+{
+	return mydata->clust_map[clust / 8] & (1 << (clust % 8));
+}
+
+/*
+ * Record in the cluster map whether 'clust' is in use
+ */
+static void clust_map_set(fsdata *mydata, __u32 clust, int used)
+{
+	__u8 mask = 1 << (clust % 8);
+
+	if (clust < 2 || clust > mydata->max_clust ||
+	    !clust_used(mydata, clust) == !used)
+		return;
+
+	if (used) {
+		mydata->clust_map[clust / 8] |= mask;
+		mydata->free_clust--;
+		mydata->next_free = clust < mydata->max_clust ? clust + 1 : 2;
+	} else {
+		mydata->clust_map[clust / 8] &= ~mask;
+		mydata->free_clust++;
+	}
+}
+
+/*
+ * Get entry 'i' of a buffer holding part of a FAT (12/16/32) table
+ */
+static __u32 fat_buf_entry(fsdata *mydata, __u8 *buf, __u32 i)
+{
+	__u32 val, off8;
+
+	switch (mydata->fatsize) {
+	case 32:
+		return FAT2CPU32(((__u32 *)buf)[i]) & 0xfffffff;
+	case 16:
+		return FAT2CPU16(((__u16 *)buf)[i]);
+	default:
+		off8 = (i * 3) / 2;
+		val = buf[off8] + (buf[off8 + 1] << 8);
+		if (i & 0x1)
+			val >>= 4;
+		return val & 0xfff;
+	}
+}
+
+/* Sectors of FAT read at once to build the cluster map, a multiple of 3 */
+#define CLUST_MAP_READ_SECTS	(FATBUFBLOCKS * 16)
+
+/*
+ * Build the map of clusters in use by reading the whole FAT once, so that
+ * allocating clusters does not need to go through the FAT again and again.
+ * Searches start at the FSInfo next free hint, if there is one.
+ * Return 0 if the map is available, -1 otherwise
+ */
+static int clust_map_init(fsdata *mydata)
+{
+	__u32 sect, nsects, nents, clust, i, hint;
+	__u8 *buf;
+
+	if (mydata->clust_map)
+		return 0;
+
+	/* The FAT is read from the device, so write back changes first */
+	if (flush_dirty_fat_buffer(mydata) < 0)
+		return -1;
+
+	buf = malloc_cache_aligned(CLUST_MAP_READ_SECTS * mydata->sect_size);
+	mydata->clust_map = calloc(mydata->max_clust / 8 + 1, 1);
+	if (!buf || !mydata->clust_map) {
+		debug("FAT: no memory for cluster map, scanning FAT\n");
+		goto fail;
+	}
+
+	/* Clusters 0 and 1 are reserved, start with all others free */
+	mydata->clust_map[0] = 0x3;
+	mydata->free_clust = mydata->max_clust - 1;
+	clust = 0;
+	for (sect = 0; clust <= mydata->max_clust; sect += nsects) {
+		nsects = min_t(__u32, CLUST_MAP_READ_SECTS,
+			       mydata->fatlength - sect);
+		if (disk_read(mydata->fat_sect + sect, nsects, buf) < 0) {
+			debug("Error reading FAT blocks\n");
+			goto fail;
+		}
+
+		nents = nsects * mydata->sect_size * 8 / mydata->fatsize;
+		for (i = 0; i < nents && clust <= mydata->max_clust;
+		     i++, clust++) {
+			if (fat_buf_entry(mydata, buf, i))
+				clust_map_set(mydata, clust, 1);
+		}
+	}
+
+	mydata->next_free = 2;
+	if (mydata->fsinfo_sect &&
+	    disk_read(mydata->fsinfo_sect, 1, buf) >= 0 &&
+	    fsinfo_valid((struct fsinfo_sector *)buf)) {
+		hint = le32_to_cpu(((struct fsinfo_sector *)buf)->next_free);
+		if (hint >= 2 && hint <= mydata->max_clust)
+			mydata->next_free = hint;
+	}
+
+	debug("FAT: %u of %u clusters free, next free: %u\n",
+	      mydata->free_clust, mydata->max_clust - 1, mydata->next_free);
+	free(buf);
+
+	return 0;
+
+fail:
+	free(mydata->clust_map);
+	mydata->clust_map = NULL;
+	free(buf);
+
+	return -1;
+}
+
+/*
+ * Find the first cluster of a run of 'count' free clusters in the range
+ * [start, end) of the cluster map. Return 0 if there is none.
+ */
+static __u32 clust_map_find(fsdata *mydata, __u32 start, __u32 end,
+			    __u32 count)
+{
+	__u32 clust, run = 0;
+
+	for (clust = start; clust < end; clust++) {
+		/* Skip over fully used parts of the map quickly */
+		if (!(clust % 8) && mydata->clust_map[clust / 8] == 0xff) {
+			clust += 7;
+			run = 0;
+			continue;
+		}
+
+		if (clust_used(mydata, clust))
+			run = 0;
+		else if (++run == count)
+			return clust - count + 1;
+	}
+
+	return 0;
+}
+
 /*
  * Set the file name information from 'name' into 'slotptr',
  */
@@ -310,6 +505,10 @@ static int set_fatent_value(fsdata *mydata, __u32 entry, __u32 entry_value)
 
 	/* Mark as dirty */
 	mydata->fat_dirty = 1;
+	mydata->fsinfo_dirty = 1;
+
+	if (mydata->clust_map)
+		clust_map_set(mydata, entry, entry_value != 0);
 
 	/* Set the actual entry */
 	switch (mydata->fatsize) {
@@ -365,23 +564,40 @@ static int set_fatent_value(fsdata *mydata, __u32 entry, __u32 entry_value)
 	return 0;
 }
 
+static __u32 find_empty_cluster(fsdata *mydata, __u32 count);
+
 /*
  * Determine the next free cluster after 'entry' in a FAT (12/16/32) table
  * and link it to 'entry'. EOC marker is not set on returned entry.
+ * Return 0 if there is no free cluster left.
  */
 static __u32 determine_fatent(fsdata *mydata, __u32 entry)
 {
 	__u32 next_fat, next_entry = entry + 1;
 
-	while (1) {
-		next_fat = get_fatent(mydata, next_entry);
-		if (next_fat == 0) {
-			/* found free entry, link to entry */
-			set_fatent_value(mydata, entry, next_entry);
-			break;
+	if (!clust_map_init(mydata)) {
+		/* Prefer the following clusters to keep the file contiguous */
+		next_entry = clust_map_find(mydata, entry + 1,
+					    mydata->max_clust + 1, 1);
+		if (next_entry)
+			clust_map_set(mydata, next_entry, 1);
+		else
+			next_entry = find_empty_cluster(mydata, 1);
+		if (!next_entry)
+			return 0;
+	} else {
+		while (1) {
+			if (next_entry > mydata->max_clust)
+				return 0;
+			next_fat = get_fatent(mydata, next_entry);
+			if (next_fat == 0)
+				break;
+			next_entry++;
 		}
-		next_entry++;
 	}
+
+	/* link the free entry to entry */
+	set_fatent_value(mydata, entry, next_entry);
 	debug("FAT%d: entry: %08x, entry_value: %04x\n",
 	       mydata->fatsize, entry, next_entry);
 
@@ -605,19 +821,38 @@ get_set_cluster(fsdata *mydata, __u32 clustnum, loff_t pos, __u8 *buffer,
 }
 
 /*
- * Find the first empty cluster
+ * Find an empty cluster to start writing 'count' clusters of data at,
+ * and reserve it in the cluster map.
+ *
+ * The first run of free clusters that is long enough is preferred, so that
+ * the data can be written in one go. If there is none, the first free
+ * cluster is used. Searches start at the next free hint.
+ * Return 0 if there is no free cluster left.
  */
-static int find_empty_cluster(fsdata *mydata)
+static __u32 find_empty_cluster(fsdata *mydata, __u32 count)
 {
-	__u32 fat_val, entry = 3;
-
-	while (1) {
-		fat_val = get_fatent(mydata, entry);
-		if (fat_val == 0)
-			break;
-		entry++;
+	__u32 fat_val, entry, end = mydata->max_clust + 1;
+
+	if (clust_map_init(mydata)) {
+		/* No map, go through the FAT instead */
+		for (entry = 3; entry < end; entry++) {
+			fat_val = get_fatent(mydata, entry);
+			if (fat_val == 0)
+				return entry;
+		}
+		return 0;
 	}
 
+	entry = clust_map_find(mydata, mydata->next_free, end, count);
+	if (!entry)
+		entry = clust_map_find(mydata, 2, end, count);
+	if (!entry)
+		entry = clust_map_find(mydata, mydata->next_free, end, 1);
+	if (!entry)
+		entry = clust_map_find(mydata, 2, end, 1);
+	if (entry)
+		clust_map_set(mydata, entry, 1);
+
 	return entry;
 }
 
@@ -630,7 +865,11 @@ static int new_dir_table(fat_itr *itr)
 	int dir_newclust = 0;
 	unsigned int bytesperclust = mydata->clust_size * mydata->sect_size;
 
-	dir_newclust = find_empty_cluster(mydata);
+	dir_newclust = find_empty_cluster(mydata, 1);
+	if (!dir_newclust) {
+		printf("Error: no space left for directory entries\n");
+		return -1;
+	}
 	set_fatent_value(mydata, itr->clust, dir_newclust);
 	if (mydata->fatsize == 32)
 		set_fatent_value(mydata, dir_newclust, 0xffffff8);
@@ -726,7 +965,7 @@ set_contents(fsdata *mydata, dir_entry *dentptr, loff_t pos, __u8 *buffer,
 {
 	unsigned int bytesperclust = mydata->clust_size * mydata->sect_size;
 	__u32 curclust = START(dentptr);
-	__u32 endclust = 0, newclust = 0;
+	__u32 endclust = 0, newclust = 0, nclust;
 	u64 cur_pos, filesize;
 	loff_t offset, actsize, wsize;
 
@@ -864,15 +1103,31 @@ set_clusters:
 	/* allocate and write */
 	assert(!pos);
 
+	/* Fail early rather than leaving a partly written file behind */
+	nclust = DIV_ROUND_UP_ULL(filesize, bytesperclust);
+	if (!clust_map_init(mydata) && nclust > mydata->free_clust) {
+		printf("Error: no space left: %llu\n", filesize);
+		return -1;
+	}
+
 	/* Assure that curclust is valid */
 	if (!curclust) {
-		curclust = find_empty_cluster(mydata);
+		curclust = find_empty_cluster(mydata, nclust);
+		if (!curclust) {
+			printf("Error: no space left: %llu\n", filesize);
+			return -1;
+		}
 		set_start_cluster(mydata, dentptr, curclust);
 	} else {
 		newclust = get_fatent(mydata, curclust);
 
 		if (IS_LAST_CLUST(newclust, mydata->fatsize)) {
 			newclust = determine_fatent(mydata, curclust);
+			if (!newclust) {
+				printf("Error: no space left: %llu\n",
+				       filesize);
+				return -1;
+			}
 			set_fatent_value(mydata, curclust, newclust);
 			curclust = newclust;
 		} else {
@@ -893,6 +1148,11 @@ set_clusters:
 		/* search for consecutive clusters */
 		while (actsize < filesize) {
 			newclust = determine_fatent(mydata, endclust);
+			if (!newclust) {
+				printf("Error: no space left: %llu\n",
+				       filesize);
+				return -1;
+			}
 
 			if ((newclust - 1) != endclust)
 				/* write to <curclust..endclust> */
@@ -1191,6 +1451,8 @@ int file_fat_write_at(const char *filename, loff_t pos, void *buffer,
 
 	/* Flush fat buffer */
 	ret = flush_dirty_fat_buffer(mydata);
+	if (!ret)
+		ret = flush_fsinfo(mydata);
 	if (ret) {
 		printf("Error: flush fat buffer\n");
 		ret = -EIO;
@@ -1207,6 +1469,7 @@ int file_fat_write_at(const char *filename, loff_t pos, void *buffer,
 exit:
 	free(filename_copy);
 	free(mydata->fatbuf);
+	free(mydata->clust_map);
 	free(itr);
 	return ret;
 }
@@ -1261,7 +1524,7 @@ static int delete_dentry(fat_itr *itr)
 
 	/* free cluster blocks */
 	clear_fatent(mydata, START(dentptr));
-	if (flush_dirty_fat_buffer(mydata) < 0) {
+	if (flush_dirty_fat_buffer(mydata) < 0 || flush_fsinfo(mydata) < 0) {
 		printf("Error: flush fat buffer\n");
 		return -EIO;
 	}
@@ -1471,6 +1734,8 @@ int fat_mkdir(const char *new_dirname)
 
 	/* Flush fat buffer */
 	ret = flush_dirty_fat_buffer(mydata);
+	if (!ret)
+		ret = flush_fsinfo(mydata);
 	if (ret) {
 		printf("Error: flush fat buffer\n");
 		goto exit;
@@ -1484,6 +1749,7 @@ int fat_mkdir(const char *new_dirname)
 exit:
 	free(dirname_copy);
 	free(mydata->fatbuf);
+	free(mydata->clust_map);
 	free(itr);
 	free(dotdent);
 	return ret;
@@ -7,6 +7,7 @@
 #include <errno.h>
 #include <common.h>
 #include <env.h>
+#include <malloc.h>
 #include <mapmem.h>
 #include <part.h>
 #include <ext4fs.h>
@@ -15,6 +16,7 @@
 #include <sandboxfs.h>
 #include <ubifs_uboot.h>
 #include <btrfs.h>
+#include <squashfs.h>
 #include <asm/io.h>
 #include <div64.h>
 #include <linux/math64.h>
@@ -162,8 +164,69 @@ struct fstype_info {
 	int (*unlink)(const char *filename);
 	int (*mkdir)(const char *dirname);
 	int (*ln)(const char *filename, const char *target);
+	/*
+	 * Open a regular file. On success return 0 and the file via 'filep',
+	 * with its size filled in. On error return -errno. See
+	 * fs_open_file().
+	 */
+	int (*open_file)(const char *filename, struct fs_file **filep);
+	/*
+	 * Read from an open file. 'offset' is below the file size and 'len'
+	 * does not extend beyond it. See fs_read_at().
+	 */
+	int (*read_at)(struct fs_file *file, void *buf, loff_t offset,
+		       loff_t len, loff_t *actread);
+	/* see fs_close_file() */
+	void (*close_file)(struct fs_file *file);
 };
 
+static struct fstype_info *fs_get_info(int fstype);
+
+/* Open file as used by the generic implementation below */
+struct fs_file_generic {
+	struct fs_file parent;
+	char path[];
+};
+
+/*
+ * generic implementation of file handles in terms of size/read, which
+ * looks up the path again for every read
+ */
+static int fs_open_file_generic(const char *filename, struct fs_file **filep)
+{
+	struct fstype_info *info = fs_get_info(fs_type);
+	struct fs_file_generic *file;
+	loff_t size;
+
+	if (info->size(filename, &size))
+		return -ENOENT;
+
+	file = calloc(1, sizeof(*file) + strlen(filename) + 1);
+	if (!file)
+		return -ENOMEM;
+	strcpy(file->path, filename);
+	file->parent.size = size;
+	*filep = &file->parent;
+
+	return 0;
+}
+
+static int fs_read_at_generic(struct fs_file *filp, void *buf, loff_t offset,
+			      loff_t len, loff_t *actread)
+{
+	struct fs_file_generic *file = container_of(filp,
+						    struct fs_file_generic,
+						    parent);
+
+	return fs_get_info(fs_type)->read(file->path, buf, offset, len,
+					  actread);
+}
+
+static void fs_close_file_generic(struct fs_file *filp)
+{
+	free(container_of(filp, struct fs_file_generic, parent));
+}
+
 static struct fstype_info fstypes[] = {
 #ifdef CONFIG_FS_FAT
 	{
@@ -190,6 +253,9 @@ static struct fstype_info fstypes[] = {
 		.readdir = fat_readdir,
 		.closedir = fat_closedir,
 		.ln = fs_ln_unsupported,
+		.open_file = fat_open_file,
+		.read_at = fat_read_at,
+		.close_file = fat_close_file,
 	},
 #endif
 
@@ -215,6 +281,9 @@ static struct fstype_info fstypes[] = {
 		.opendir = fs_opendir_unsupported,
 		.unlink = fs_unlink_unsupported,
 		.mkdir = fs_mkdir_unsupported,
+		.open_file = ext4fs_open_file,
+		.read_at = ext4fs_read_at,
+		.close_file = ext4fs_close_file,
 	},
 #endif
 #ifdef CONFIG_SANDBOX
@@ -234,6 +303,9 @@ static struct fstype_info fstypes[] = {
 		.unlink = fs_unlink_unsupported,
 		.mkdir = fs_mkdir_unsupported,
 		.ln = fs_ln_unsupported,
+		.open_file = fs_open_file_generic,
+		.read_at = fs_read_at_generic,
+		.close_file = fs_close_file_generic,
 	},
 #endif
 #ifdef CONFIG_CMD_UBIFS
@@ -253,6 +325,9 @@ static struct fstype_info fstypes[] = {
 		.unlink = fs_unlink_unsupported,
 		.mkdir = fs_mkdir_unsupported,
 		.ln = fs_ln_unsupported,
+		.open_file = ubifs_open_file,
+		.read_at = ubifs_read_at,
+		.close_file = ubifs_close_file,
 	},
 #endif
 #ifdef CONFIG_FS_BTRFS
@@ -272,6 +347,33 @@ static struct fstype_info fstypes[] = {
 		.unlink = fs_unlink_unsupported,
 		.mkdir = fs_mkdir_unsupported,
 		.ln = fs_ln_unsupported,
+		.open_file = btrfs_open_file,
+		.read_at = btrfs_read_at,
+		.close_file = btrfs_close_file,
+	},
+#endif
+#ifdef CONFIG_FS_SQUASHFS
+	{
+		.fstype = FS_TYPE_SQUASHFS,
+		.name = "squashfs",
+		.null_dev_desc_ok = false,
+		.probe = sqfs_probe,
+		.close = sqfs_close,
+		.ls = fs_ls_generic,
+		.exists = sqfs_exists,
+		.size = sqfs_size,
+		.read = sqfs_read,
+		.write = fs_write_unsupported,
+		.uuid = fs_uuid_unsupported,
+		.opendir = sqfs_opendir,
+		.readdir = sqfs_readdir,
+		.closedir = sqfs_closedir,
+		.unlink = fs_unlink_unsupported,
+		.mkdir = fs_mkdir_unsupported,
+		.ln = fs_ln_unsupported,
+		.open_file = sqfs_open_file,
+		.read_at = sqfs_read_at,
+		.close_file = sqfs_close_file,
 	},
 #endif
 	{
@@ -290,6 +392,9 @@ static struct fstype_info fstypes[] = {
 		.unlink = fs_unlink_unsupported,
 		.mkdir = fs_mkdir_unsupported,
 		.ln = fs_ln_unsupported,
+		.open_file = fs_open_file_generic,
+		.read_at = fs_read_at_generic,
+		.close_file = fs_close_file_generic,
 	},
 };
 
@@ -333,6 +438,13 @@ const char *fs_get_type_name(void)
 	return fs_get_info(fs_type)->name;
 }
 
+/* Close a file system which fs_open_file() left set up */
+static void fs_release(void)
+{
+	if (fs_type != FS_TYPE_ANY)
+		fs_close();
+}
+
 int fs_set_blk_dev(const char *ifname, const char *dev_part_str, int fstype)
 {
 	struct fstype_info *info;
@@ -354,6 +466,7 @@ int fs_set_blk_dev(const char *ifname, const char *dev_part_str, int fstype)
 	}
 #endif
 
+	fs_release();
 	part = blk_get_device_part_str(ifname, dev_part_str, &fs_dev_desc,
 					&fs_partition, 1);
 	if (part < 0)
@@ -383,6 +496,7 @@ int fs_set_blk_dev_with_part(struct blk_desc *desc, int part)
 	struct fstype_info *info;
 	int ret, i;
 
+	fs_release();
 	if (part >= 1)
 		ret = part_get_info(desc, part, &fs_partition);
 	else
@@ -402,13 +516,20 @@ int fs_set_blk_dev_with_part(struct blk_desc *desc, int part)
 	return -1;
 }
 
-void fs_close(void)
+int fs_close(void)
 {
 	struct fstype_info *info = fs_get_info(fs_type);
+	int ret = 0;
 
 	info->close();
 
+	/* Send what the filesystem wrote on to the device */
+	if (fs_dev_desc)
+		ret = blk_flush(fs_dev_desc);
+
 	fs_type = FS_TYPE_ANY;
+
+	return ret;
 }
 
 int fs_uuid(char *uuid_str)
@@ -458,19 +579,13 @@ int fs_size(const char *filename, loff_t *size)
 }
 
 #ifdef CONFIG_LMB
-/* Check if a file may be read to the given address */
-static int fs_read_lmb_check(const char *filename, ulong addr, loff_t offset,
-			     loff_t len, struct fstype_info *info)
+/* Check if a file of the given size may be read to the given address */
+static int fs_read_lmb_check(loff_t size, ulong addr, loff_t offset,
+			     loff_t len)
 {
 	struct lmb lmb;
-	int ret;
-	loff_t size;
 	loff_t read_len;
 
-	/* get the actual size of the file */
-	ret = info->size(filename, &size);
-	if (ret)
-		return ret;
 	if (offset >= size) {
 		/* offset >= EOF, no bytes will be written */
 		return 0;
@@ -492,21 +607,13 @@ static int fs_read_lmb_check(const char *filename, ulong addr, loff_t offset,
 }
 #endif
 
-static int _fs_read(const char *filename, ulong addr, loff_t offset, loff_t len,
-		    int do_lmb_check, loff_t *actread)
+int fs_read(const char *filename, ulong addr, loff_t offset, loff_t len,
+	    loff_t *actread)
 {
 	struct fstype_info *info = fs_get_info(fs_type);
 	void *buf;
 	int ret;
 
-#ifdef CONFIG_LMB
-	if (do_lmb_check) {
-		ret = fs_read_lmb_check(filename, addr, offset, len, info);
-		if (ret)
-			return ret;
-	}
-#endif
-
 	/*
 	 * We don't actually know how many bytes are being read, since len==0
 	 * means read the whole file.
@@ -523,18 +630,12 @@ static int _fs_read(const char *filename, ulong addr, loff_t offset, loff_t len,
 	return ret;
 }
 
-int fs_read(const char *filename, ulong addr, loff_t offset, loff_t len,
-	    loff_t *actread)
-{
-	return _fs_read(filename, addr, offset, len, 0, actread);
-}
-
 int fs_write(const char *filename, ulong addr, loff_t offset, loff_t len,
 	     loff_t *actwrite)
 {
 	struct fstype_info *info = fs_get_info(fs_type);
 	void *buf;
-	int ret;
+	int ret, err;
 
 	buf = map_sysmem(addr, len);
 	ret = info->write(filename, buf, offset, len, actwrite);
@@ -544,11 +645,110 @@ int fs_write(const char *filename, ulong addr, loff_t offset, loff_t len,
 		printf("** Unable to write file %s **\n", filename);
 		ret = -1;
 	}
-	fs_close();
+	err = fs_close();
+	if (err && !ret) {
+		printf("** Unable to write file %s **\n", filename);
+		ret = err;
+	}
 
 	return ret;
 }
 
+struct fs_file *fs_open_file(const char *filename)
+{
+	struct fstype_info *info = fs_get_info(fs_type);
+	struct fs_file *file = NULL;
+	int ret;
+
+	ret = info->open_file(filename, &file);
+	if (ret) {
+		fs_close();
+		errno = -ret;
+		return NULL;
+	}
+
+	/* Leave the file system set up for fs_read_at() */
+	file->desc = fs_dev_desc;
+	file->part = fs_dev_part;
+	file->fstype = fs_type;
+
+	return file;
+}
+
+/* Check whether the file system a file was opened on is still set up */
+static bool fs_file_is_current(struct fs_file *file)
+{
+	return fs_type == file->fstype && fs_dev_desc == file->desc &&
+	       fs_dev_part == file->part;
+}
+
+/* Set up the partition a file was opened on again */
+static int fs_set_file_dev(struct fs_file *file)
+{
+	struct fstype_info *info = fs_get_info(file->fstype);
+
+	/* File systems which are not based on a block device */
+	if (!file->desc) {
+		fs_release();
+		if (info->probe(NULL, &fs_partition))
+			return -ENODEV;
+		fs_dev_desc = NULL;
+		fs_dev_part = file->part;
+		fs_type = file->fstype;
+		return 0;
+	}
+
+	if (fs_set_blk_dev_with_part(file->desc, file->part))
+		return -ENODEV;
+	if (fs_type != file->fstype) {
+		fs_close();
+		return -ENODEV;
+	}
+
+	return 0;
+}
+
+int fs_read_at(struct fs_file *file, ulong addr, loff_t offset, loff_t len,
+	       loff_t *actread)
+{
+	struct fstype_info *info;
+	void *buf;
+	int ret;
+
+	*actread = 0;
+	if (offset >= file->size)
+		return 0;
+	if (!len || len > file->size - offset)
+		len = file->size - offset;
+
+	/* Only probe again if something else used the fs layer meanwhile */
+	if (!fs_file_is_current(file)) {
+		ret = fs_set_file_dev(file);
+		if (ret)
+			return ret;
+	}
+	info = fs_get_info(fs_type);
+
+	buf = map_sysmem(addr, len);
+	ret = info->read_at(file, buf, offset, len, actread);
+	unmap_sysmem(buf);
+
+	return ret;
+}
+
+void fs_close_file(struct fs_file *file)
+{
+	bool current;
+
+	if (!file)
+		return;
+
+	current = fs_file_is_current(file);
+	fs_get_info(file->fstype)->close_file(file);
+	if (current)
+		fs_close();
+}
+
 struct fs_dir_stream *fs_opendir(const char *filename)
 {
 	struct fstype_info *info = fs_get_info(fs_type);
@@ -603,34 +803,34 @@ void fs_closedir(struct fs_dir_stream *dirs)
 
 int fs_unlink(const char *filename)
 {
-	int ret;
+	int ret, err;
 
 	struct fstype_info *info = fs_get_info(fs_type);
 
 	ret = info->unlink(filename);
 
-	fs_close();
+	err = fs_close();
 
-	return ret;
+	return ret ? ret : err;
 }
 
 int fs_mkdir(const char *dirname)
 {
-	int ret;
+	int ret, err;
 
 	struct fstype_info *info = fs_get_info(fs_type);
 
 	ret = info->mkdir(dirname);
 
-	fs_close();
+	err = fs_close();
 
-	return ret;
+	return ret ? ret : err;
 }
 
 int fs_ln(const char *fname, const char *target)
 {
 	struct fstype_info *info = fs_get_info(fs_type);
-	int ret;
+	int ret, err;
 
 	ret = info->ln(fname, target);
 
@@ -638,9 +838,9 @@ int fs_ln(const char *fname, const char *target)
 		printf("** Unable to create link %s -> %s **\n", fname, target);
 		ret = -1;
 	}
-	fs_close();
+	err = fs_close();
 
-	return ret;
+	return ret ? ret : err;
 }
 
 int do_size(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[],
@@ -668,6 +868,7 @@ int do_load(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[],
 	unsigned long addr;
 	const char *addr_str;
 	const char *filename;
+	struct fs_file *file;
 	loff_t bytes;
 	loff_t pos;
 	loff_t len_read;
@@ -717,10 +918,25 @@ int do_load(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[],
 			(argc > 4) ? argv[4] : "");
 #endif
 	time = get_timer(0);
-	ret = _fs_read(filename, addr, pos, bytes, 1, &len_read);
+	file = fs_open_file(filename);
+	if (!file) {
+		printf("** File not found %s **\n", filename);
+		return 1;
+	}
+#ifdef CONFIG_LMB
+	ret = fs_read_lmb_check(file->size, addr, pos, bytes);
+	if (ret) {
+		fs_close_file(file);
+		return 1;
+	}
+#endif
+	ret = fs_read_at(file, addr, pos, bytes, &len_read);
+	fs_close_file(file);
 	time = get_timer(time);
-	if (ret < 0)
+	if (ret < 0) {
+		printf("** Unable to read file %s **\n", filename);
 		return 1;
+	}
 
 	printf("%llu bytes read in %lu ms", len_read, time);
 	if (time > 0) {
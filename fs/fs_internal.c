@@ -90,3 +90,32 @@ int fs_devread(struct blk_desc *blk, disk_partition_t *partition,
 	}
 	return 1;
 }
+
+int fs_devreadv(struct blk_desc *blk, disk_partition_t *partition,
+		struct blk_vec *vecs, int count)
+{
+	lbaint_t total = 0;
+	int i;
+
+	if (blk == NULL) {
+		printf("** Invalid Block Device Descriptor (NULL)\n");
+		return 0;
+	}
+
+	for (i = 0; i < count; i++) {
+		if (vecs[i].start + vecs[i].blkcnt > partition->size) {
+			printf("%s read outside partition " LBAFU "\n",
+			       __func__, vecs[i].start);
+			return 0;
+		}
+		vecs[i].start += partition->start;
+		total += vecs[i].blkcnt;
+	}
+
+	if (blk_dreadv(blk, vecs, count) != total) {
+		printf(" ** %s read error **\n", __func__);
+		return 0;
+	}
+
+	return 1;
+}
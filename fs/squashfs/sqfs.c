@@ -0,0 +1,867 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * SquashFS filesystem implementation for U-Boot
+ *
+ * Read-only support for SquashFS 4.0 images compressed with gzip, LZ4 or
+ * zstd.
+ */
+
+#include <common.h>
+#include <errno.h>
+#include <fs.h>
+#include <fs_internal.h>
+#include <malloc.h>
+#include <memalign.h>
+#include <squashfs.h>
+#include <asm/unaligned.h>
+#include <linux/kernel.h>
+#include "sqfs_filesystem.h"
+
+#define SQFS_CACHE_INVALID	(~0ULL)
+/* Symbolic links followed while looking up a path */
+#define SQFS_MAX_LINKS		8
+/* Directory levels kept to resolve ".." */
+#define SQFS_MAX_DEPTH		64
+#define SQFS_MAX_LINK_LEN	4096
+
+/**
+ * struct sqfs_cache_entry - Decompressed block
+ *
+ * @key:	disk offset of the block, SQFS_CACHE_INVALID if unused
+ * @next:	disk offset of the block following it
+ * @len:	length of the decompressed data
+ * @stamp:	time of the last use
+ * @data:	decompressed data
+ */
+struct sqfs_cache_entry {
+	u64 key;
+	u64 next;
+	u32 len;
+	ulong stamp;
+	u8 *data;
+};
+
+/**
+ * struct sqfs_cache - Least recently used cache of decompressed blocks
+ *
+ * @entries:	cache entries
+ * @count:	number of entries
+ * @size:	size of the buffer of each entry
+ * @clock:	incremented on each use of an entry
+ */
+struct sqfs_cache {
+	struct sqfs_cache_entry *entries;
+	int count;
+	u32 size;
+	ulong clock;
+};
+
+/* Open regular file */
+struct sqfs_file {
+	struct fs_file parent;
+	struct sqfs_inode inode;
+	u32 nblocks;
+	u32 *sizes;	/* on-disk sizes of the data blocks */
+	u64 *starts;	/* disk offsets of the data blocks */
+};
+
+struct sqfs_dir_stream {
+	struct fs_dir_stream parent;
+	struct fs_dirent dirent;
+	struct sqfs_dir_iter it;
+};
+
+/*
+ * The caches live from probe to close, so they serve all lookups of one
+ * operation and all reads of a file opened with fs_open_file(). They are not
+ * kept across probes, as the device may be written or rebound in between.
+ */
+static struct sqfs_ctxt {
+	struct blk_desc *desc;
+	disk_partition_t *part;
+	struct sqfs_super_block sb;
+	int comp;
+	u32 block_size;
+	u64 bytes_used;
+	u64 inode_table;
+	u64 dir_table;
+	u32 frags;
+	u64 *frag_index;
+	struct sqfs_cache meta_cache;
+	struct sqfs_cache block_cache;
+	u8 *scratch;
+} ctxt;
+
+static int sqfs_cache_init(struct sqfs_cache *cache, int count, u32 size)
+{
+	int i;
+
+	cache->entries = calloc(count, sizeof(*cache->entries));
+	if (!cache->entries)
+		return -ENOMEM;
+	for (i = 0; i < count; i++)
+		cache->entries[i].key = SQFS_CACHE_INVALID;
+	cache->count = count;
+	cache->size = size;
+	cache->clock = 0;
+
+	return 0;
+}
+
+static void sqfs_cache_free(struct sqfs_cache *cache)
+{
+	int i;
+
+	for (i = 0; i < cache->count; i++)
+		free(cache->entries[i].data);
+	free(cache->entries);
+	cache->entries = NULL;
+	cache->count = 0;
+}
+
+static struct sqfs_cache_entry *sqfs_cache_get(struct sqfs_cache *cache,
+					       u64 key)
+{
+	int i;
+
+	for (i = 0; i < cache->count; i++) {
+		if (cache->entries[i].key == key) {
+			cache->entries[i].stamp = ++cache->clock;
+			return &cache->entries[i];
+		}
+	}
+
+	return NULL;
+}
+
+/* Get the least recently used entry, to be filled by the caller */
+static struct sqfs_cache_entry *sqfs_cache_slot(struct sqfs_cache *cache)
+{
+	struct sqfs_cache_entry *entry = &cache->entries[0];
+	int i;
+
+	for (i = 1; i < cache->count; i++) {
+		if (cache->entries[i].stamp < entry->stamp)
+			entry = &cache->entries[i];
+	}
+
+	if (!entry->data) {
+		entry->data = malloc_cache_aligned(cache->size);
+		if (!entry->data)
+			return NULL;
+	}
+	entry->key = SQFS_CACHE_INVALID;
+	entry->stamp = ++cache->clock;
+
+	return entry;
+}
+
+static int sqfs_disk_read(u64 pos, u32 len, void *buf)
+{
+	int log2blksz = ctxt.desc->log2blksz;
+
+	if (pos > ctxt.bytes_used || len > ctxt.bytes_used - pos) {
+		printf("%s: read beyond the end of the image\n", __func__);
+		return -EINVAL;
+	}
+
+	if (!fs_devread(ctxt.desc, ctxt.part, pos >> log2blksz,
+			pos & (ctxt.desc->blksz - 1), len, buf))
+		return -EIO;
+
+	return 0;
+}
+
+/* Get a decompressed metadata block */
+static struct sqfs_cache_entry *sqfs_meta_block(u64 pos)
+{
+	struct sqfs_cache_entry *entry;
+	u32 len, csize, dlen;
+	u16 header;
+
+	entry = sqfs_cache_get(&ctxt.meta_cache, pos);
+	if (entry)
+		return entry;
+
+	if (pos + sizeof(header) > ctxt.bytes_used)
+		return NULL;
+	len = min_t(u64, sizeof(header) + SQFS_METADATA_SIZE,
+		    ctxt.bytes_used - pos);
+	if (sqfs_disk_read(pos, len, ctxt.scratch))
+		return NULL;
+
+	header = get_unaligned_le16(ctxt.scratch);
+	csize = header & SQFS_META_SIZE_MASK;
+	if (csize > SQFS_METADATA_SIZE || csize + sizeof(header) > len) {
+		printf("%s: invalid metadata block at %llu\n", __func__, pos);
+		return NULL;
+	}
+
+	entry = sqfs_cache_slot(&ctxt.meta_cache);
+	if (!entry)
+		return NULL;
+
+	dlen = SQFS_METADATA_SIZE;
+	if (header & SQFS_META_UNCOMPRESSED) {
+		memcpy(entry->data, ctxt.scratch + sizeof(header), csize);
+		dlen = csize;
+	} else if (sqfs_decompress(ctxt.comp, entry->data, &dlen,
+				   ctxt.scratch + sizeof(header), csize)) {
+		printf("%s: cannot decompress metadata block at %llu\n",
+		       __func__, pos);
+		return NULL;
+	}
+
+	entry->key = pos;
+	entry->next = pos + sizeof(header) + csize;
+	entry->len = dlen;
+
+	return entry;
+}
+
+/**
+ * sqfs_read_meta() - Read from a metadata table
+ *
+ * @pos:	position to read from, moved past the data read
+ * @buf:	buffer for the data
+ * @len:	number of bytes to read
+ * @return 0 if OK, -ve on error
+ */
+int sqfs_read_meta(struct sqfs_meta_pos *pos, void *buf, u32 len)
+{
+	struct sqfs_cache_entry *entry;
+	u32 n;
+
+	while (len) {
+		entry = sqfs_meta_block(pos->block);
+		if (!entry)
+			return -EIO;
+		if (pos->offset >= entry->len) {
+			/* only the last block of a table is short */
+			if (entry->len != SQFS_METADATA_SIZE)
+				return -EINVAL;
+			pos->block = entry->next;
+			pos->offset -= entry->len;
+			continue;
+		}
+
+		n = min(len, entry->len - pos->offset);
+		memcpy(buf, entry->data + pos->offset, n);
+		buf += n;
+		len -= n;
+		pos->offset += n;
+		if (pos->offset == entry->len) {
+			pos->block = entry->next;
+			pos->offset = 0;
+		}
+	}
+
+	return 0;
+}
+
+/* Get a decompressed data or fragment block, @size as in the block list */
+static struct sqfs_cache_entry *sqfs_data_block(u64 pos, u32 size)
+{
+	struct sqfs_cache_entry *entry;
+	u32 csize = size & SQFS_BLOCK_SIZE_MASK;
+	u32 dlen = ctxt.block_size;
+
+	entry = sqfs_cache_get(&ctxt.block_cache, pos);
+	if (entry)
+		return entry;
+
+	if (csize > ctxt.block_size)
+		return NULL;
+	entry = sqfs_cache_slot(&ctxt.block_cache);
+	if (!entry)
+		return NULL;
+
+	if (size & SQFS_BLOCK_UNCOMPRESSED) {
+		if (sqfs_disk_read(pos, csize, entry->data))
+			return NULL;
+		dlen = csize;
+	} else if (sqfs_disk_read(pos, csize, ctxt.scratch) ||
+		   sqfs_decompress(ctxt.comp, entry->data, &dlen, ctxt.scratch,
+				   csize)) {
+		printf("%s: cannot read block at %llu\n", __func__, pos);
+		return NULL;
+	}
+
+	entry->key = pos;
+	entry->next = pos + csize;
+	entry->len = dlen;
+
+	return entry;
+}
+
+/* Get the decompressed fragment block @frag */
+static struct sqfs_cache_entry *sqfs_frag_block(u32 frag)
+{
+	u64 start = le64_to_cpu(ctxt.sb.fragment_table_start);
+	u32 nindex = DIV_ROUND_UP(ctxt.frags, SQFS_FRAGS_PER_META);
+	struct sqfs_fragment_entry fe;
+	struct sqfs_meta_pos pos;
+	int i;
+
+	if (frag >= ctxt.frags)
+		return NULL;
+
+	/* the index of the fragment table is small, read it once */
+	if (!ctxt.frag_index) {
+		ctxt.frag_index = malloc(nindex * sizeof(u64));
+		if (!ctxt.frag_index)
+			return NULL;
+		if (sqfs_disk_read(start, nindex * sizeof(u64),
+				   ctxt.frag_index)) {
+			free(ctxt.frag_index);
+			ctxt.frag_index = NULL;
+			return NULL;
+		}
+		for (i = 0; i < nindex; i++)
+			ctxt.frag_index[i] = le64_to_cpu(ctxt.frag_index[i]);
+	}
+
+	pos.block = ctxt.frag_index[frag / SQFS_FRAGS_PER_META];
+	pos.offset = frag % SQFS_FRAGS_PER_META * sizeof(fe);
+	if (sqfs_read_meta(&pos, &fe, sizeof(fe)))
+		return NULL;
+
+	return sqfs_data_block(le64_to_cpu(fe.start_block),
+			       le32_to_cpu(fe.size));
+}
+
+/**
+ * sqfs_read_inode() - Read an inode
+ *
+ * @ref:	inode reference, the metadata block in the inode table in the
+ *		upper bits and the offset in that block in the lower 16 bits
+ * @inode:	returns the inode
+ * @return 0 if OK, -ve on error
+ */
+int sqfs_read_inode(u64 ref, struct sqfs_inode *inode)
+{
+	union sqfs_inode_raw raw;
+	struct sqfs_meta_pos pos;
+	u32 len;
+	int ret;
+
+	pos.block = ctxt.inode_table + (ref >> 16);
+	pos.offset = ref & 0xffff;
+	ret = sqfs_read_meta(&pos, &raw.base, sizeof(raw.base));
+	if (ret)
+		return ret;
+
+	memset(inode, '\0', sizeof(*inode));
+	inode->mode = le16_to_cpu(raw.base.mode);
+	inode->frag = SQFS_INVALID_FRAG;
+
+	switch (le16_to_cpu(raw.base.inode_type)) {
+	case SQFS_DIR_TYPE:
+		len = sizeof(raw.dir) - sizeof(raw.base);
+		ret = sqfs_read_meta(&pos, &raw.base + 1, len);
+		inode->type = SQFS_DIR_TYPE;
+		/* the size includes "." and ".." which are not stored */
+		inode->size = max_t(u32, le16_to_cpu(raw.dir.file_size), 3) - 3;
+		inode->start = ctxt.dir_table +
+			       le32_to_cpu(raw.dir.start_block);
+		inode->offset = le16_to_cpu(raw.dir.offset);
+		break;
+	case SQFS_LDIR_TYPE:
+		len = sizeof(raw.ldir) - sizeof(raw.base);
+		ret = sqfs_read_meta(&pos, &raw.base + 1, len);
+		inode->type = SQFS_DIR_TYPE;
+		inode->size = max(le32_to_cpu(raw.ldir.file_size), 3U) - 3;
+		inode->start = ctxt.dir_table +
+			       le32_to_cpu(raw.ldir.start_block);
+		inode->offset = le16_to_cpu(raw.ldir.offset);
+		inode->i_count = le16_to_cpu(raw.ldir.i_count);
+		break;
+	case SQFS_REG_TYPE:
+		len = sizeof(raw.reg) - sizeof(raw.base);
+		ret = sqfs_read_meta(&pos, &raw.base + 1, len);
+		inode->type = SQFS_REG_TYPE;
+		inode->size = le32_to_cpu(raw.reg.file_size);
+		inode->start = le32_to_cpu(raw.reg.start_block);
+		inode->frag = le32_to_cpu(raw.reg.fragment);
+		inode->frag_offset = le32_to_cpu(raw.reg.offset);
+		break;
+	case SQFS_LREG_TYPE:
+		len = sizeof(raw.lreg) - sizeof(raw.base);
+		ret = sqfs_read_meta(&pos, &raw.base + 1, len);
+		inode->type = SQFS_REG_TYPE;
+		inode->size = le64_to_cpu(raw.lreg.file_size);
+		inode->start = le64_to_cpu(raw.lreg.start_block);
+		inode->frag = le32_to_cpu(raw.lreg.fragment);
+		inode->frag_offset = le32_to_cpu(raw.lreg.offset);
+		break;
+	case SQFS_SYMLINK_TYPE:
+	case SQFS_LSYMLINK_TYPE:
+		len = sizeof(raw.symlink) - sizeof(raw.base);
+		ret = sqfs_read_meta(&pos, &raw.base + 1, len);
+		inode->type = SQFS_SYMLINK_TYPE;
+		inode->size = le32_to_cpu(raw.symlink.symlink_size);
+		break;
+	case SQFS_BLKDEV_TYPE ... SQFS_SOCKET_TYPE:
+		inode->type = le16_to_cpu(raw.base.inode_type);
+		break;
+	case SQFS_LBLKDEV_TYPE ... SQFS_LSOCKET_TYPE:
+		inode->type = le16_to_cpu(raw.base.inode_type) -
+			      SQFS_LDIR_TYPE + SQFS_DIR_TYPE;
+		break;
+	default:
+		printf("%s: unknown inode type %d\n", __func__,
+		       le16_to_cpu(raw.base.inode_type));
+		return -EINVAL;
+	}
+	inode->tail = pos;
+
+	return ret;
+}
+
+/* Disk offset of the directory table, which directory indexes refer to */
+u64 sqfs_dir_table(void)
+{
+	return ctxt.dir_table;
+}
+
+/* Read the target of a symbolic link into a new string */
+static char *sqfs_read_link(const struct sqfs_inode *inode)
+{
+	struct sqfs_meta_pos pos = inode->tail;
+	char *target;
+
+	if (inode->size >= SQFS_MAX_LINK_LEN)
+		return NULL;
+	target = malloc(inode->size + 1);
+	if (!target)
+		return NULL;
+	if (sqfs_read_meta(&pos, target, inode->size)) {
+		free(target);
+		return NULL;
+	}
+	target[inode->size] = '\0';
+
+	return target;
+}
+
+/**
+ * sqfs_lookup() - Look up a path, following symbolic links
+ *
+ * @filename:	path, relative to the root directory
+ * @inode:	returns the inode found
+ * @return 0 if OK, -ve on error
+ */
+static int sqfs_lookup(const char *filename, struct sqfs_inode *inode)
+{
+	u64 stack[SQFS_MAX_DEPTH], ref;
+	char *path, *next, *target;
+	struct sqfs_inode child;
+	int depth = 0, links = 0;
+	const char *p;
+	size_t len;
+	int ret;
+
+	path = strdup(filename);
+	if (!path)
+		return -ENOMEM;
+
+	stack[0] = le64_to_cpu(ctxt.sb.root_inode);
+	ret = sqfs_read_inode(stack[0], inode);
+
+	for (p = path; !ret; p += len) {
+		p += strspn(p, "/");
+		len = strcspn(p, "/");
+		if (!len)
+			break;
+
+		if (len == 1 && p[0] == '.')
+			continue;
+		if (len == 2 && p[0] == '.' && p[1] == '.') {
+			if (depth)
+				depth--;
+			ret = sqfs_read_inode(stack[depth], inode);
+			continue;
+		}
+
+		if (inode->type != SQFS_DIR_TYPE) {
+			ret = -ENOTDIR;
+			break;
+		}
+
+		next = strndup(p, len);
+		if (!next) {
+			ret = -ENOMEM;
+			break;
+		}
+		ret = sqfs_dir_find(inode, next, &ref);
+		free(next);
+		if (!ret)
+			ret = sqfs_read_inode(ref, &child);
+		if (ret)
+			break;
+
+		if (child.type == SQFS_SYMLINK_TYPE) {
+			if (++links > SQFS_MAX_LINKS) {
+				ret = -ELOOP;
+				break;
+			}
+			target = sqfs_read_link(&child);
+			if (!target) {
+				ret = -EIO;
+				break;
+			}
+
+			/* go on with the target followed by the rest */
+			next = malloc(strlen(target) + strlen(p + len) + 1);
+			if (!next) {
+				free(target);
+				ret = -ENOMEM;
+				break;
+			}
+			strcpy(next, target);
+			strcat(next, p + len);
+			if (target[0] == '/') {
+				depth = 0;
+				ret = sqfs_read_inode(stack[0], inode);
+			}
+			free(target);
+			free(path);
+			path = next;
+			p = path;
+			len = 0;
+			continue;
+		}
+
+		if (child.type == SQFS_DIR_TYPE) {
+			if (depth + 1 == SQFS_MAX_DEPTH) {
+				ret = -ENAMETOOLONG;
+				break;
+			}
+			stack[++depth] = ref;
+		}
+		*inode = child;
+	}
+
+	free(path);
+
+	return ret;
+}
+
+int sqfs_probe(struct blk_desc *fs_dev_desc, disk_partition_t *fs_partition)
+{
+	struct sqfs_super_block sb;
+	u32 block_size;
+	int ret;
+
+	sqfs_close();
+	ctxt.desc = fs_dev_desc;
+	ctxt.part = fs_partition;
+	ctxt.bytes_used = sizeof(sb);
+	ret = sqfs_disk_read(0, sizeof(sb), &sb);
+	if (ret)
+		return ret;
+
+	block_size = le32_to_cpu(sb.block_size);
+	if (le32_to_cpu(sb.s_magic) != SQFS_MAGIC)
+		return -EINVAL;
+	if (le16_to_cpu(sb.s_major) != SQFS_MAJOR ||
+	    block_size < SQFS_MIN_BLOCK_SIZE ||
+	    block_size > SQFS_MAX_BLOCK_SIZE ||
+	    block_size != 1 << le16_to_cpu(sb.block_log)) {
+		printf("SquashFS: unsupported version or invalid superblock\n");
+		return -EINVAL;
+	}
+	ret = sqfs_decompressor_check(le16_to_cpu(sb.compression));
+	if (ret)
+		return ret;
+
+	ctxt.scratch = malloc_cache_aligned(max_t(u32, block_size,
+						  SQFS_METADATA_SIZE + 2));
+	if (!ctxt.scratch ||
+	    sqfs_cache_init(&ctxt.meta_cache, CONFIG_SQUASHFS_META_CACHE_SIZE,
+			    SQFS_METADATA_SIZE) ||
+	    sqfs_cache_init(&ctxt.block_cache,
+			    CONFIG_SQUASHFS_BLOCK_CACHE_SIZE, block_size)) {
+		sqfs_cache_free(&ctxt.meta_cache);
+		free(ctxt.scratch);
+		ctxt.scratch = NULL;
+		return -ENOMEM;
+	}
+
+	ctxt.sb = sb;
+	ctxt.comp = le16_to_cpu(sb.compression);
+	ctxt.block_size = block_size;
+	ctxt.inode_table = le64_to_cpu(sb.inode_table_start);
+	ctxt.dir_table = le64_to_cpu(sb.directory_table_start);
+	ctxt.frags = le32_to_cpu(sb.fragments);
+	ctxt.bytes_used = le64_to_cpu(sb.bytes_used);
+
+	return 0;
+}
+
+void sqfs_close(void)
+{
+	sqfs_cache_free(&ctxt.meta_cache);
+	sqfs_cache_free(&ctxt.block_cache);
+	free(ctxt.scratch);
+	ctxt.scratch = NULL;
+	free(ctxt.frag_index);
+	ctxt.frag_index = NULL;
+	ctxt.desc = NULL;
+}
+
+int sqfs_opendir(const char *filename, struct fs_dir_stream **dirsp)
+{
+	struct sqfs_dir_stream *dirs;
+	struct sqfs_inode inode;
+	int ret;
+
+	ret = sqfs_lookup(filename, &inode);
+	if (ret)
+		return ret;
+	if (inode.type != SQFS_DIR_TYPE)
+		return -ENOTDIR;
+
+	dirs = calloc(1, sizeof(*dirs));
+	if (!dirs)
+		return -ENOMEM;
+	sqfs_dir_iter_init(&dirs->it, &inode);
+	*dirsp = &dirs->parent;
+
+	return 0;
+}
+
+int sqfs_readdir(struct fs_dir_stream *fs_dirs, struct fs_dirent **dentp)
+{
+	struct sqfs_dir_stream *dirs = container_of(fs_dirs,
+						    struct sqfs_dir_stream,
+						    parent);
+	struct fs_dirent *dent = &dirs->dirent;
+	char name[SQFS_NAME_LEN + 1];
+	struct sqfs_inode inode;
+	int ret, type;
+	u64 ref;
+
+	ret = sqfs_dir_next(&dirs->it, name, &ref, &type);
+	if (ret <= 0)
+		return ret ? ret : -ENOENT;
+
+	memset(dent, '\0', sizeof(*dent));
+	strlcpy(dent->name, name, sizeof(dent->name));
+	switch (type) {
+	case SQFS_DIR_TYPE:
+		dent->type = FS_DT_DIR;
+		*dentp = dent;
+		return 0;
+	case SQFS_SYMLINK_TYPE:
+		dent->type = FS_DT_LNK;
+		break;
+	default:
+		dent->type = FS_DT_REG;
+		break;
+	}
+
+	ret = sqfs_read_inode(ref, &inode);
+	if (ret)
+		return ret;
+	if (inode.type == SQFS_REG_TYPE || inode.type == SQFS_SYMLINK_TYPE)
+		dent->size = inode.size;
+	*dentp = dent;
+
+	return 0;
+}
+
+void sqfs_closedir(struct fs_dir_stream *dirs)
+{
+	free(container_of(dirs, struct sqfs_dir_stream, parent));
+}
+
+int sqfs_open_file(const char *filename, struct fs_file **filep)
+{
+	struct sqfs_meta_pos pos;
+	struct sqfs_file *file;
+	u64 start;
+	int i, ret;
+
+	file = calloc(1, sizeof(*file));
+	if (!file)
+		return -ENOMEM;
+
+	ret = sqfs_lookup(filename, &file->inode);
+	if (!ret && file->inode.type != SQFS_REG_TYPE)
+		ret = file->inode.type == SQFS_DIR_TYPE ? -EISDIR : -EINVAL;
+	if (ret)
+		goto err;
+
+	/* the tail of the file may be stored in a fragment */
+	if (file->inode.frag == SQFS_INVALID_FRAG)
+		file->nblocks = DIV_ROUND_UP(file->inode.size,
+					     ctxt.block_size);
+	else
+		file->nblocks = file->inode.size / ctxt.block_size;
+
+	ret = -ENOMEM;
+	file->sizes = malloc(file->nblocks * sizeof(u32));
+	file->starts = malloc(file->nblocks * sizeof(u64));
+	if (file->nblocks && (!file->sizes || !file->starts))
+		goto err;
+
+	pos = file->inode.tail;
+	ret = sqfs_read_meta(&pos, file->sizes, file->nblocks * sizeof(u32));
+	if (ret)
+		goto err;
+
+	start = file->inode.start;
+	for (i = 0; i < file->nblocks; i++) {
+		file->sizes[i] = le32_to_cpu(file->sizes[i]);
+		file->starts[i] = start;
+		start += file->sizes[i] & SQFS_BLOCK_SIZE_MASK;
+	}
+
+	file->parent.size = file->inode.size;
+	*filep = &file->parent;
+
+	return 0;
+
+err:
+	sqfs_close_file(&file->parent);
+	return ret;
+}
+
+/* Copy part of block @index of @file, which is @blen bytes long */
+static int sqfs_read_block(struct sqfs_file *file, u32 index, u32 blen,
+			   u32 boff, u32 len, void *buf)
+{
+	struct sqfs_cache_entry *entry;
+	u32 size, csize, dlen;
+	u64 start;
+
+	/* the tail of the file, stored in a fragment */
+	if (index == file->nblocks) {
+		entry = sqfs_frag_block(file->inode.frag);
+		if (!entry || file->inode.frag_offset + blen > entry->len)
+			return -EIO;
+		memcpy(buf, entry->data + file->inode.frag_offset + boff, len);
+		return 0;
+	}
+
+	size = file->sizes[index];
+	start = file->starts[index];
+	csize = size & SQFS_BLOCK_SIZE_MASK;
+
+	/* sparse block */
+	if (!csize) {
+		memset(buf, '\0', len);
+		return 0;
+	}
+
+	if (size & SQFS_BLOCK_UNCOMPRESSED)
+		return sqfs_disk_read(start + boff, len, buf);
+
+	/* whole blocks are decompressed straight into the caller's buffer */
+	if (!boff && len == blen) {
+		dlen = blen;
+		if (csize > ctxt.block_size ||
+		    sqfs_disk_read(start, csize, ctxt.scratch) ||
+		    sqfs_decompress(ctxt.comp, buf, &dlen, ctxt.scratch,
+				    csize) || dlen != blen)
+			return -EIO;
+		return 0;
+	}
+
+	entry = sqfs_data_block(start, size);
+	if (!entry || boff + len > entry->len)
+		return -EIO;
+	memcpy(buf, entry->data + boff, len);
+
+	return 0;
+}
+
+int sqfs_read_at(struct fs_file *fs_file, void *buf, loff_t offset,
+		 loff_t len, loff_t *actread)
+{
+	struct sqfs_file *file = container_of(fs_file, struct sqfs_file,
+					      parent);
+	u64 size = file->inode.size, pos = offset;
+	u32 index, boff, blen, n;
+	int ret;
+
+	*actread = 0;
+	if (pos >= size)
+		return 0;
+	if (!len || len > size - pos)
+		len = size - pos;
+
+	while (len) {
+		index = pos / ctxt.block_size;
+		boff = pos % ctxt.block_size;
+		blen = min_t(u64, ctxt.block_size,
+			     size - (u64)index * ctxt.block_size);
+		n = min_t(u64, blen - boff, len);
+
+		ret = sqfs_read_block(file, index, blen, boff, n, buf);
+		if (ret) {
+			printf("%s: cannot read block %u\n", __func__, index);
+			return ret;
+		}
+		buf += n;
+		pos += n;
+		len -= n;
+		*actread += n;
+	}
+
+	return 0;
+}
+
+void sqfs_close_file(struct fs_file *fs_file)
+{
+	struct sqfs_file *file = container_of(fs_file, struct sqfs_file,
+					      parent);
+
+	free(file->sizes);
+	free(file->starts);
+	free(file);
+}
+
+int sqfs_exists(const char *filename)
+{
+	struct sqfs_inode inode;
+
+	return !sqfs_lookup(filename, &inode);
+}
+
+int sqfs_size(const char *filename, loff_t *size)
+{
+	struct sqfs_inode inode;
+	int ret;
+
+	ret = sqfs_lookup(filename, &inode);
+	if (ret)
+		return ret;
+	if (inode.type != SQFS_REG_TYPE)
+		return -EINVAL;
+	*size = inode.size;
+
+	return 0;
+}
+
+int sqfs_read(const char *filename, void *buf, loff_t offset, loff_t len,
+	      loff_t *actread)
+{
+	struct fs_file *file;
+	int ret;
+
+	ret = sqfs_open_file(filename, &file);
+	if (ret) {
+		printf("** File not found %s **\n", filename);
+		return ret;
+	}
+
+	if (offset > file->size)
+		ret = -EINVAL;
+	else
+		ret = sqfs_read_at(file, buf, offset, len, actread);
+	sqfs_close_file(file);
+
+	return ret;
+}
@@ -0,0 +1,82 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * SquashFS filesystem implementation for U-Boot
+ *
+ * Decompression of metadata, fragment and data blocks
+ */
+
+#include <common.h>
+#include <errno.h>
+#include <gzip.h>
+#include <lz4.h>
+#include <zstd.h>
+#include "sqfs_filesystem.h"
+
+int sqfs_decompressor_check(int comp)
+{
+	switch (comp) {
+	case SQFS_COMP_ZLIB:
+#if CONFIG_IS_ENABLED(SQUASHFS_LZ4)
+	case SQFS_COMP_LZ4:
+#endif
+#if CONFIG_IS_ENABLED(SQUASHFS_ZSTD)
+	case SQFS_COMP_ZSTD:
+#endif
+		return 0;
+	default:
+		printf("SquashFS: compression type %d is not supported\n",
+		       comp);
+		return -EPROTONOSUPPORT;
+	}
+}
+
+/**
+ * sqfs_decompress() - Decompress a block
+ *
+ * @comp:	compression type (SQFS_COMP_...)
+ * @dst:	buffer for the decompressed data
+ * @dst_len:	size of @dst, returns the size of the decompressed data
+ * @src:	compressed data
+ * @src_len:	size of the compressed data
+ * @return 0 if OK, -ve on error
+ */
+int sqfs_decompress(int comp, void *dst, u32 *dst_len, const void *src,
+		    u32 src_len)
+{
+	unsigned long len = src_len;
+	int ret;
+
+	switch (comp) {
+	case SQFS_COMP_ZLIB:
+		/* skip the two bytes of zlib header, there is no dictionary */
+		if (src_len < 2)
+			return -EINVAL;
+		ret = zunzip(dst, *dst_len, (unsigned char *)src, &len, 1, 2);
+		if (ret)
+			return -EINVAL;
+		*dst_len = len;
+		return 0;
+#if CONFIG_IS_ENABLED(SQUASHFS_LZ4)
+	case SQFS_COMP_LZ4:
+		ret = LZ4_decompress_safe(src, dst, src_len, *dst_len);
+		if (ret < 0)
+			return -EINVAL;
+		*dst_len = ret;
+		return 0;
+#endif
+#if CONFIG_IS_ENABLED(SQUASHFS_ZSTD)
+	case SQFS_COMP_ZSTD: {
+		/* each block is a separate frame */
+		size_t size = *dst_len;
+
+		ret = zstd_decompress(src, src_len, dst, &size);
+		if (ret)
+			return ret == -ENOMEM ? ret : -EINVAL;
+		*dst_len = size;
+		return 0;
+	}
+#endif
+	default:
+		return -EPROTONOSUPPORT;
+	}
+}
@@ -0,0 +1,141 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * SquashFS filesystem implementation for U-Boot
+ *
+ * Directory listings and lookups
+ */
+
+#include <common.h>
+#include <errno.h>
+#include "sqfs_filesystem.h"
+
+void sqfs_dir_iter_init(struct sqfs_dir_iter *it, const struct sqfs_inode *dir)
+{
+	memset(it, '\0', sizeof(*it));
+	it->pos.block = dir->start;
+	it->pos.offset = dir->offset;
+	it->left = dir->size;
+}
+
+/**
+ * sqfs_dir_next() - Get the next entry of a directory listing
+ *
+ * @it:		position in the listing
+ * @name:	returns the name, SQFS_NAME_LEN + 1 bytes
+ * @ref:	returns the inode reference
+ * @type:	returns the basic inode type
+ * @return 1 if an entry was read, 0 at the end of the listing, -ve on error
+ */
+int sqfs_dir_next(struct sqfs_dir_iter *it, char *name, u64 *ref, int *type)
+{
+	struct sqfs_dir_header header;
+	struct sqfs_dir_entry entry;
+	u32 len;
+	int ret;
+
+	if (!it->entries) {
+		if (it->left < sizeof(header) + sizeof(entry))
+			return 0;
+		ret = sqfs_read_meta(&it->pos, &header, sizeof(header));
+		if (ret)
+			return ret;
+		it->left -= sizeof(header);
+		it->entries = le32_to_cpu(header.count) + 1;
+		it->start_block = le32_to_cpu(header.start_block);
+		if (it->entries > SQFS_DIR_COUNT)
+			return -EINVAL;
+	}
+
+	if (it->left < sizeof(entry))
+		return -EINVAL;
+	ret = sqfs_read_meta(&it->pos, &entry, sizeof(entry));
+	if (ret)
+		return ret;
+	len = le16_to_cpu(entry.size) + 1;
+	if (len > SQFS_NAME_LEN || it->left < sizeof(entry) + len)
+		return -EINVAL;
+	ret = sqfs_read_meta(&it->pos, name, len);
+	if (ret)
+		return ret;
+	name[len] = '\0';
+	it->left -= sizeof(entry) + len;
+	it->entries--;
+
+	*ref = (u64)it->start_block << 16 | le16_to_cpu(entry.offset);
+	*type = le16_to_cpu(entry.type);
+	if (*type >= SQFS_LDIR_TYPE)
+		*type -= SQFS_LDIR_TYPE - SQFS_DIR_TYPE;
+
+	return 1;
+}
+
+/*
+ * Use the index of a large directory to skip to the part of the listing
+ * which may hold @name. The index names are in the same order as the
+ * listing, so take the last one which is not after @name.
+ */
+static int sqfs_dir_seek(struct sqfs_dir_iter *it,
+			 const struct sqfs_inode *dir, const char *name)
+{
+	struct sqfs_meta_pos pos = dir->tail;
+	struct sqfs_dir_index idx;
+	char iname[SQFS_NAME_LEN + 1];
+	u32 i, len, index;
+	int ret;
+
+	for (i = 0; i < dir->i_count; i++) {
+		ret = sqfs_read_meta(&pos, &idx, sizeof(idx));
+		if (ret)
+			return ret;
+		len = le32_to_cpu(idx.size) + 1;
+		if (len > SQFS_NAME_LEN)
+			return -EINVAL;
+		ret = sqfs_read_meta(&pos, iname, len);
+		if (ret)
+			return ret;
+		iname[len] = '\0';
+		if (strcmp(iname, name) > 0)
+			break;
+
+		index = le32_to_cpu(idx.index);
+		if (index > dir->size)
+			return -EINVAL;
+		it->pos.block = sqfs_dir_table() + le32_to_cpu(idx.start_block);
+		it->pos.offset = (dir->offset + index) % SQFS_METADATA_SIZE;
+		it->left = dir->size - index;
+		it->entries = 0;
+	}
+
+	return 0;
+}
+
+/**
+ * sqfs_dir_find() - Find an entry in a directory
+ *
+ * @dir:	directory inode
+ * @name:	name of the entry
+ * @ref:	returns the inode reference of the entry
+ * @return 0 if OK, -ENOENT if not found, other -ve on error
+ */
+int sqfs_dir_find(const struct sqfs_inode *dir, const char *name, u64 *ref)
+{
+	char ename[SQFS_NAME_LEN + 1];
+	struct sqfs_dir_iter it;
+	int ret, type, cmp;
+
+	sqfs_dir_iter_init(&it, dir);
+	ret = sqfs_dir_seek(&it, dir, name);
+	if (ret)
+		return ret;
+
+	/* entries are sorted, stop once past @name */
+	while ((ret = sqfs_dir_next(&it, ename, ref, &type)) > 0) {
+		cmp = strcmp(name, ename);
+		if (!cmp)
+			return 0;
+		if (cmp < 0)
+			break;
+	}
+
+	return ret < 0 ? ret : -ENOENT;
+}
@@ -0,0 +1,247 @@
+/* SPDX-License-Identifier: GPL-2.0+ */
+/*
+ * SquashFS filesystem implementation for U-Boot
+ *
+ * On-disk format (version 4.0) and internal interfaces
+ */
+
+#ifndef __SQFS_FILESYSTEM_H__
+#define __SQFS_FILESYSTEM_H__
+
+#include <part.h>
+#include <linux/bitops.h>
+#include <linux/types.h>
+
+#define SQFS_MAGIC		0x73717368
+#define SQFS_MAJOR		4
+#define SQFS_MIN_BLOCK_SIZE	4096
+#define SQFS_MAX_BLOCK_SIZE	(1 << 20)
+/* Uncompressed size of a metadata block */
+#define SQFS_METADATA_SIZE	8192
+#define SQFS_NAME_LEN		256
+/* Maximum number of entries following a directory header */
+#define SQFS_DIR_COUNT		256
+#define SQFS_INVALID_FRAG	0xffffffff
+
+/* Metadata blocks start with a 16-bit header */
+#define SQFS_META_UNCOMPRESSED	BIT(15)
+#define SQFS_META_SIZE_MASK	(SQFS_META_UNCOMPRESSED - 1)
+/* Sizes of data and fragment blocks */
+#define SQFS_BLOCK_UNCOMPRESSED	BIT(24)
+#define SQFS_BLOCK_SIZE_MASK	(SQFS_BLOCK_UNCOMPRESSED - 1)
+
+#define SQFS_FRAGS_PER_META	(SQFS_METADATA_SIZE / \
+				 sizeof(struct sqfs_fragment_entry))
+
+enum sqfs_compression {
+	SQFS_COMP_ZLIB = 1,
+	SQFS_COMP_LZMA,
+	SQFS_COMP_LZO,
+	SQFS_COMP_XZ,
+	SQFS_COMP_LZ4,
+	SQFS_COMP_ZSTD,
+};
+
+enum sqfs_inode_type {
+	SQFS_DIR_TYPE = 1,
+	SQFS_REG_TYPE,
+	SQFS_SYMLINK_TYPE,
+	SQFS_BLKDEV_TYPE,
+	SQFS_CHRDEV_TYPE,
+	SQFS_FIFO_TYPE,
+	SQFS_SOCKET_TYPE,
+	SQFS_LDIR_TYPE,
+	SQFS_LREG_TYPE,
+	SQFS_LSYMLINK_TYPE,
+	SQFS_LBLKDEV_TYPE,
+	SQFS_LCHRDEV_TYPE,
+	SQFS_LFIFO_TYPE,
+	SQFS_LSOCKET_TYPE,
+};
+
+struct sqfs_super_block {
+	__le32 s_magic;
+	__le32 inodes;
+	__le32 mkfs_time;
+	__le32 block_size;
+	__le32 fragments;
+	__le16 compression;
+	__le16 block_log;
+	__le16 flags;
+	__le16 no_ids;
+	__le16 s_major;
+	__le16 s_minor;
+	__le64 root_inode;
+	__le64 bytes_used;
+	__le64 id_table_start;
+	__le64 xattr_id_table_start;
+	__le64 inode_table_start;
+	__le64 directory_table_start;
+	__le64 fragment_table_start;
+	__le64 lookup_table_start;
+} __packed;
+
+struct sqfs_base_inode {
+	__le16 inode_type;
+	__le16 mode;
+	__le16 uid;
+	__le16 guid;
+	__le32 mtime;
+	__le32 inode_number;
+} __packed;
+
+struct sqfs_dir_inode {
+	struct sqfs_base_inode base;
+	__le32 start_block;
+	__le32 nlink;
+	__le16 file_size;
+	__le16 offset;
+	__le32 parent_inode;
+} __packed;
+
+/* followed by i_count struct sqfs_dir_index */
+struct sqfs_ldir_inode {
+	struct sqfs_base_inode base;
+	__le32 nlink;
+	__le32 file_size;
+	__le32 start_block;
+	__le32 parent_inode;
+	__le16 i_count;
+	__le16 offset;
+	__le32 xattr;
+} __packed;
+
+/* followed by the block list */
+struct sqfs_reg_inode {
+	struct sqfs_base_inode base;
+	__le32 start_block;
+	__le32 fragment;
+	__le32 offset;
+	__le32 file_size;
+} __packed;
+
+/* followed by the block list */
+struct sqfs_lreg_inode {
+	struct sqfs_base_inode base;
+	__le64 start_block;
+	__le64 file_size;
+	__le64 sparse;
+	__le32 nlink;
+	__le32 fragment;
+	__le32 offset;
+	__le32 xattr;
+} __packed;
+
+/* followed by the link target */
+struct sqfs_symlink_inode {
+	struct sqfs_base_inode base;
+	__le32 nlink;
+	__le32 symlink_size;
+} __packed;
+
+union sqfs_inode_raw {
+	struct sqfs_base_inode base;
+	struct sqfs_dir_inode dir;
+	struct sqfs_ldir_inode ldir;
+	struct sqfs_reg_inode reg;
+	struct sqfs_lreg_inode lreg;
+	struct sqfs_symlink_inode symlink;
+};
+
+/*
+ * Directory index entry: the listing from byte @index on starts in the
+ * metadata block at @start_block, and its first name is the index name.
+ */
+struct sqfs_dir_index {
+	__le32 index;
+	__le32 start_block;
+	__le32 size;	/* name length - 1 */
+} __packed;
+
+/* followed by count + 1 struct sqfs_dir_entry */
+struct sqfs_dir_header {
+	__le32 count;
+	__le32 start_block;
+	__le32 inode_number;
+} __packed;
+
+/* followed by the name */
+struct sqfs_dir_entry {
+	__le16 offset;
+	__le16 inode_offset;
+	__le16 type;
+	__le16 size;	/* name length - 1 */
+} __packed;
+
+struct sqfs_fragment_entry {
+	__le64 start_block;
+	__le32 size;
+	__le32 unused;
+} __packed;
+
+/* Position in a metadata table */
+struct sqfs_meta_pos {
+	u64 block;	/* disk offset of the metadata block */
+	u32 offset;	/* offset in the uncompressed block */
+};
+
+/**
+ * struct sqfs_inode - Inode in CPU byte order
+ *
+ * @type:	basic inode type (SQFS_DIR_TYPE, SQFS_REG_TYPE, ...), also for
+ *		extended inodes
+ * @mode:	file mode
+ * @size:	file size, length of a directory listing or of a link target
+ * @start:	disk offset of the first data block, or of the metadata block
+ *		holding the start of a directory listing
+ * @offset:	offset of a directory listing in its metadata block
+ * @frag:	fragment holding the file tail, SQFS_INVALID_FRAG for none
+ * @frag_offset: offset of the file tail in its fragment
+ * @i_count:	number of directory index entries
+ * @tail:	position of the block list, directory index or link target
+ */
+struct sqfs_inode {
+	int type;
+	u16 mode;
+	u64 size;
+	u64 start;
+	u32 offset;
+	u32 frag;
+	u32 frag_offset;
+	u32 i_count;
+	struct sqfs_meta_pos tail;
+};
+
+/**
+ * struct sqfs_dir_iter - Position in a directory listing
+ *
+ * @pos:	position of the next header or entry
+ * @left:	number of bytes left in the listing
+ * @entries:	number of entries left under the current header
+ * @start_block: metadata block of the inodes under the current header
+ */
+struct sqfs_dir_iter {
+	struct sqfs_meta_pos pos;
+	u64 left;
+	u32 entries;
+	u32 start_block;
+};
+
+/* sqfs.c */
+int sqfs_read_meta(struct sqfs_meta_pos *pos, void *buf, u32 len);
+int sqfs_read_inode(u64 ref, struct sqfs_inode *inode);
+u64 sqfs_dir_table(void);
+
+/* sqfs_dir.c */
+void sqfs_dir_iter_init(struct sqfs_dir_iter *it,
+			const struct sqfs_inode *dir);
+int sqfs_dir_next(struct sqfs_dir_iter *it, char *name, u64 *ref,
+		  int *type);
+int sqfs_dir_find(const struct sqfs_inode *dir, const char *name, u64 *ref);
+
+/* sqfs_decompressor.c */
+int sqfs_decompressor_check(int comp);
+int sqfs_decompress(int comp, void *dst, u32 *dst_len, const void *src,
+		    u32 src_len);
+
+#endif /* __SQFS_FILESYSTEM_H__ */
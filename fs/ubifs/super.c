@@ -1214,6 +1214,8 @@ static int ubifs_parse_options(struct ubifs_info *c, char *options,
 				c->mount_opts.compr_type = UBIFS_COMPR_LZO;
 			else if (!strcmp(name, "zlib"))
 				c->mount_opts.compr_type = UBIFS_COMPR_ZLIB;
+			else if (!strcmp(name, "zstd"))
+				c->mount_opts.compr_type = UBIFS_COMPR_ZSTD;
 			else {
 				ubifs_err(c, "unknown compressor \"%s\"", name); //FIXME: is c ready?
 				kfree(name);
@@ -2251,6 +2253,13 @@ static int ubifs_fill_super(struct super_block *sb, void *data, int silent)
 #else
 	/* U-Boot read only mode */
 	c->ubi = ubi_open_volume(c->vi.ubi_num, c->vi.vol_id, UBI_READONLY);
+
+	/*
+	 * The page cache contention which makes bulk-read a mount option in
+	 * Linux does not exist here and files are read sequentially, so
+	 * always use it
+	 */
+	c->bulk_read = 1;
 #endif
 
 	if (IS_ERR(c->ubi)) {
@@ -13,11 +13,13 @@
 
 #include <common.h>
 #include <env.h>
+#include <fs.h>
 #include <gzip.h>
 #include <malloc.h>
 #include <memalign.h>
 #include "ubifs.h"
 #include <dm/devres.h>
+#include <zstd.h>
 #include <u-boot/zlib.h>
 
 #include <linux/compat.h>
@@ -39,6 +41,15 @@ static int gzip_decompress(const unsigned char *in, size_t in_len,
 		      (unsigned long *)out_len, 0, 0);
 }
 
+#if CONFIG_IS_ENABLED(UBIFS_ZSTD)
+/* Each data node is a separate zstd frame */
+static int ubifs_zstd_decompress(const unsigned char *in, size_t in_len,
+				 unsigned char *out, size_t *out_len)
+{
+	return zstd_decompress(in, in_len, out, out_len);
+}
+#endif
+
 /* Fake description object for the "none" compressor */
 static struct ubifs_compressor none_compr = {
 	.compr_type = UBIFS_COMPR_NONE,
@@ -68,6 +79,15 @@ static struct ubifs_compressor zlib_compr = {
 	.decompress = gzip_decompress,
 };
 
+static struct ubifs_compressor zstd_compr = {
+	.compr_type = UBIFS_COMPR_ZSTD,
+	.name = "zstd",
+#if CONFIG_IS_ENABLED(UBIFS_ZSTD)
+	.capi_name = "zstd",
+	.decompress = ubifs_zstd_decompress,
+#endif
+};
+
 /* All UBIFS compressors */
 struct ubifs_compressor *ubifs_compressors[UBIFS_COMPR_TYPES_CNT];
 
@@ -88,7 +108,7 @@ static inline struct crypto_comp
 	ptr = malloc_cache_aligned(sizeof(struct crypto_comp));
 	while (i < UBIFS_COMPR_TYPES_CNT) {
 		comp = ubifs_compressors[i];
-		if (!comp) {
+		if (!comp || !comp->capi_name) {
 			i++;
 			continue;
 		}
@@ -200,8 +220,13 @@ static int __init compr_init(struct ubifs_compressor *compr)
 
 #ifdef CONFIG_NEEDS_MANUAL_RELOC
 	ubifs_compressors[compr->compr_type]->name += gd->reloc_off;
-	ubifs_compressors[compr->compr_type]->capi_name += gd->reloc_off;
-	ubifs_compressors[compr->compr_type]->decompress += gd->reloc_off;
+	/* A compressor which is not compiled in has no capi_name */
+	if (compr->capi_name)
+		ubifs_compressors[compr->compr_type]->capi_name +=
+			gd->reloc_off;
+	if (compr->decompress)
+		ubifs_compressors[compr->compr_type]->decompress +=
+			gd->reloc_off;
 #endif
 
 	if (compr->capi_name) {
@@ -235,6 +260,10 @@ int __init ubifs_compressors_init(void)
 	if (err)
 		return err;
 
+	err = compr_init(&zstd_compr);
+	if (err)
+		return err;
+
 	err = compr_init(&none_compr);
 	if (err)
 		return err;
@@ -669,35 +698,26 @@ static inline void *kmap(struct page *page)
 	return page->addr;
 }
 
-static int read_block(struct inode *inode, void *addr, unsigned int block,
-		      struct ubifs_data_node *dn)
+/*
+ * Decompress data node @dn into the block at @addr, zeroing the part of the
+ * block beyond the data
+ */
+static int read_data_node(struct ubifs_info *c, struct ubifs_data_node *dn,
+			  void *addr)
 {
-	struct ubifs_info *c = inode->i_sb->s_fs_info;
 	int err, len, out_len;
-	union ubifs_key key;
 	unsigned int dlen;
 
-	data_key_init(c, &key, inode->i_ino, block);
-	err = ubifs_tnc_lookup(c, &key, dn);
-	if (err) {
-		if (err == -ENOENT)
-			/* Not found, so it must be a hole */
-			memset(addr, 0, UBIFS_BLOCK_SIZE);
-		return err;
-	}
-
-	ubifs_assert(le64_to_cpu(dn->ch.sqnum) > ubifs_inode(inode)->creat_sqnum);
-
 	len = le32_to_cpu(dn->size);
 	if (len <= 0 || len > UBIFS_BLOCK_SIZE)
-		goto dump;
+		return -EINVAL;
 
 	dlen = le32_to_cpu(dn->ch.len) - UBIFS_DATA_NODE_SZ;
 	out_len = UBIFS_BLOCK_SIZE;
 	err = ubifs_decompress(c, &dn->data, dlen, addr, &out_len,
 			       le16_to_cpu(dn->compr_type));
 	if (err || len != out_len)
-		goto dump;
+		return -EINVAL;
 
 	/*
 	 * Data length can be less than a full block, even for blocks that are
@@ -708,6 +728,31 @@ static int read_block(struct inode *inode, void *addr, unsigned int block,
 		memset(addr + len, 0, UBIFS_BLOCK_SIZE - len);
 
 	return 0;
+}
+
+static int read_block(struct inode *inode, void *addr, unsigned int block,
+		      struct ubifs_data_node *dn)
+{
+	struct ubifs_info *c = inode->i_sb->s_fs_info;
+	int err;
+	union ubifs_key key;
+
+	data_key_init(c, &key, inode->i_ino, block);
+	err = ubifs_tnc_lookup(c, &key, dn);
+	if (err) {
+		if (err == -ENOENT)
+			/* Not found, so it must be a hole */
+			memset(addr, 0, UBIFS_BLOCK_SIZE);
+		return err;
+	}
+
+	ubifs_assert(le64_to_cpu(dn->ch.sqnum) > ubifs_inode(inode)->creat_sqnum);
+
+	err = read_data_node(c, dn, addr);
+	if (err)
+		goto dump;
+
+	return 0;
 
 dump:
 	ubifs_err(c, "bad data node (block %u, inode %lu)",
@@ -716,6 +761,63 @@ dump:
 	return -EINVAL;
 }
 
+/**
+ * read_blocks_bulk - read consecutive blocks with a single flash read.
+ * @c: UBIFS file-system description object
+ * @inode: inode to read from
+ * @addr: where to put the data, room for @count full blocks
+ * @block: first block to read
+ * @count: maximum number of blocks to read
+ *
+ * This looks up the data nodes which follow each other in the same LEB,
+ * starting at @block, reads them in one go and decompresses them in turn, like
+ * the bulk-read of the Linux driver. Holes among them are zeroed.
+ *
+ * Returns the number of blocks read, which is %0 if bulk-read does not apply
+ * at @block, or a negative error code on failure.
+ */
+static int read_blocks_bulk(struct ubifs_info *c, struct inode *inode,
+			    void *addr, unsigned int block, int count)
+{
+	struct bu_info *bu = &c->bu;
+	struct ubifs_data_node *dn;
+	int err, n, nn = 0;
+
+	data_key_init(c, &bu->key, inode->i_ino, block);
+	bu->buf_len = c->max_bu_buf_len;
+	err = ubifs_tnc_get_bu_keys(c, bu);
+	if (err)
+		return err;
+	/* A single node is no better than an ordinary lookup */
+	if (bu->cnt < 2)
+		return 0;
+
+	err = ubifs_tnc_bulk_read(c, bu);
+	if (err)
+		return err;
+
+	count = min(count, bu->blk_cnt);
+	for (n = 0; n < count; n++, addr += UBIFS_BLOCK_SIZE) {
+		if (nn == bu->cnt ||
+		    key_block(c, &bu->zbranch[nn].key) != block + n) {
+			/* Not found, so it must be a hole */
+			memset(addr, 0, UBIFS_BLOCK_SIZE);
+			continue;
+		}
+		dn = bu->buf + bu->zbranch[nn].offs - bu->zbranch[0].offs;
+		nn++;
+		err = read_data_node(c, dn, addr);
+		if (err) {
+			ubifs_err(c, "bad data node (block %u, inode %lu)",
+				  block + n, inode->i_ino);
+			ubifs_dump_node(c, dn);
+			return err;
+		}
+	}
+
+	return count;
+}
+
 static int do_readpage(struct ubifs_info *c, struct inode *inode,
 		       struct page *page, int last_block_size)
 {
@@ -827,43 +929,35 @@ error:
 	return err;
 }
 
-int ubifs_read(const char *filename, void *buf, loff_t offset,
-	       loff_t size, loff_t *actread)
+/*
+ * Read from the file with inode number @inum. The UBI volume must have been
+ * opened by the caller.
+ */
+static int ubifs_read_inum(struct ubifs_info *c, unsigned long inum,
+			   void *buf, loff_t offset, loff_t size,
+			   loff_t *actread)
 {
-	struct ubifs_info *c = ubifs_sb->s_fs_info;
-	unsigned long inum;
 	struct inode *inode;
 	struct page page;
+	loff_t pos = offset;
 	int err = 0;
 	int i;
 	int count;
 	int last_block_size = 0;
 
-	*actread = 0;
-
 	if (offset & (PAGE_SIZE - 1)) {
 		printf("ubifs: Error offset must be a multiple of %d\n",
 		       PAGE_SIZE);
 		return -1;
 	}
 
-	c->ubi = ubi_open_volume(c->vi.ubi_num, c->vi.vol_id, UBI_READONLY);
-	/* ubifs_findfile will resolve symlinks, so we know that we get
-	 * the real file here */
-	inum = ubifs_findfile(ubifs_sb, (char *)filename);
-	if (!inum) {
-		err = -1;
-		goto out;
-	}
-
 	/*
 	 * Read file inode
 	 */
 	inode = ubifs_iget(ubifs_sb, inum);
 	if (IS_ERR(inode)) {
 		printf("%s: Error reading inode %ld!\n", __func__, inum);
-		err = PTR_ERR(inode);
-		goto out;
+		return PTR_ERR(inode);
 	}
 
 	if (offset > inode->i_size) {
@@ -886,6 +980,31 @@ int ubifs_read(const char *filename, void *buf, loff_t offset,
 	page.index = offset / PAGE_SIZE;
 	page.inode = inode;
 	for (i = 0; i < count; i++) {
+		/*
+		 * Read runs of whole blocks in bulk. The last block is left to
+		 * do_readpage(), which takes care not to write beyond the
+		 * requested size.
+		 */
+		if (c->bulk_read && i + 1 < count) {
+			int n;
+
+			n = read_blocks_bulk(c, inode, page.addr,
+					     pos >> UBIFS_BLOCK_SHIFT,
+					     count - 1 - i);
+			if (n < 0) {
+				err = n;
+				break;
+			}
+			if (n > 0) {
+				/* Keep the page index in step with the byte position */
+				pos += n * UBIFS_BLOCK_SIZE;
+				page.addr += n * UBIFS_BLOCK_SIZE;
+				page.index = pos >> PAGE_CACHE_SHIFT;
+				i += n - 1;
+				continue;
+			}
+		}
+
 		/*
 		 * Make sure to not read beyond the requested size
 		 */
@@ -896,25 +1015,111 @@ int ubifs_read(const char *filename, void *buf, loff_t offset,
 		if (err)
 			break;
 
+		pos += PAGE_SIZE;
 		page.addr += PAGE_SIZE;
 		page.index++;
 	}
 
-	if (err) {
-		printf("Error reading file '%s'\n", filename);
+	if (err)
 		*actread = i * PAGE_SIZE;
-	} else {
+	else
 		*actread = size;
-	}
 
 put_inode:
 	ubifs_iput(inode);
+	return err;
+}
+
+int ubifs_read(const char *filename, void *buf, loff_t offset,
+	       loff_t size, loff_t *actread)
+{
+	struct ubifs_info *c = ubifs_sb->s_fs_info;
+	unsigned long inum;
+	int err;
+
+	*actread = 0;
+
+	c->ubi = ubi_open_volume(c->vi.ubi_num, c->vi.vol_id, UBI_READONLY);
+	/* ubifs_findfile will resolve symlinks, so we know that we get
+	 * the real file here */
+	inum = ubifs_findfile(ubifs_sb, (char *)filename);
+	if (!inum) {
+		err = -1;
+		goto out;
+	}
+
+	err = ubifs_read_inum(c, inum, buf, offset, size, actread);
+	if (err)
+		printf("Error reading file '%s'\n", filename);
+
+out:
+	ubi_close_volume(c->ubi);
+	return err;
+}
+
+struct ubifs_file {
+	struct fs_file parent;
+	unsigned long inum;
+};
+
+int ubifs_open_file(const char *filename, struct fs_file **filep)
+{
+	struct ubifs_info *c = ubifs_sb->s_fs_info;
+	struct ubifs_file *file;
+	struct inode *inode;
+	int err = 0;
+
+	file = kzalloc(sizeof(*file), 0);
+	if (!file)
+		return -ENOMEM;
+
+	c->ubi = ubi_open_volume(c->vi.ubi_num, c->vi.vol_id, UBI_READONLY);
+	file->inum = ubifs_findfile(ubifs_sb, (char *)filename);
+	if (!file->inum) {
+		err = -ENOENT;
+		goto out;
+	}
+
+	inode = ubifs_iget(ubifs_sb, file->inum);
+	if (IS_ERR(inode)) {
+		err = PTR_ERR(inode);
+		goto out;
+	}
+	file->parent.size = inode->i_size;
+	ubifs_iput(inode);
 
 out:
 	ubi_close_volume(c->ubi);
+	if (err)
+		kfree(file);
+	else
+		*filep = &file->parent;
+
 	return err;
 }
 
+int ubifs_read_at(struct fs_file *filp, void *buf, loff_t offset,
+		  loff_t size, loff_t *actread)
+{
+	struct ubifs_file *file = container_of(filp, struct ubifs_file,
+					       parent);
+	struct ubifs_info *c = ubifs_sb->s_fs_info;
+	int err;
+
+	*actread = 0;
+
+	c->ubi = ubi_open_volume(c->vi.ubi_num, c->vi.vol_id, UBI_READONLY);
+	err = ubifs_read_inum(c, file->inum, buf, offset, size, actread);
+	ubi_close_volume(c->ubi);
+
+	return err;
+}
+
+void ubifs_close_file(struct fs_file *filp)
+{
+	kfree(container_of(filp, struct ubifs_file, parent));
+}
+
 void ubifs_close(void)
 {
 }
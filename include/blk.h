@@ -8,6 +8,7 @@
 #define BLK_H
 
 #include <efi.h>
+#include <linux/list.h>
 
 #ifdef CONFIG_SYS_64BIT_LBA
 typedef uint64_t lbaint_t;
@@ -106,12 +107,130 @@ struct blk_desc {
 				       lbaint_t blkcnt);
 	void		*priv;		/* driver private struct pointer */
 #endif
+#if CONFIG_IS_ENABLED(PARTITION_CACHE)
+	struct part_cache *part_cache;	/* parsed partition table */
+#endif
+#if CONFIG_IS_ENABLED(BLOCK_WRITEBACK)
+	struct blk_wb *wb;		/* blocks written but not flushed */
+#endif
 };
 
 #define BLOCK_CNT(size, blk_desc) (PAD_COUNT(size, blk_desc->blksz))
 #define PAD_TO_BLOCKSIZE(size, blk_desc) \
 	(PAD_SIZE(size, blk_desc->blksz))
 
+#if CONFIG_IS_ENABLED(PARTITION_CACHE)
+/**
+ * part_cache_drop() - discard the cached partition table of a device
+ *
+ * @dev_desc:	Block device descriptor
+ */
+void part_cache_drop(struct blk_desc *dev_desc);
+
+/**
+ * part_cache_invalidate() - discard the cached partition table of a device
+ * if a set of blocks overlaps it, because of a write or erase
+ *
+ * @dev_desc:	Block device descriptor
+ * @start:	First block written
+ * @blkcnt:	Number of blocks written
+ */
+void part_cache_invalidate(struct blk_desc *dev_desc, lbaint_t start,
+			   lbaint_t blkcnt);
+#else
+static inline void part_cache_drop(struct blk_desc *dev_desc) {}
+static inline void part_cache_invalidate(struct blk_desc *dev_desc,
+					 lbaint_t start, lbaint_t blkcnt) {}
+#endif
+
+#if CONFIG_IS_ENABLED(BLOCK_WRITEBACK)
+/**
+ * blkwb_write() - write blocks into the write-back cache
+ *
+ * Small writes are kept in the cache until the next flush. Larger ones
+ * must be sent to the device by the caller, and replace any cached data
+ * for the same blocks.
+ *
+ * @desc:	Block device descriptor
+ * @start:	First block to write
+ * @blkcnt:	Number of blocks to write
+ * @buffer:	Data to write
+ * @return number of blocks cached, 0 if the write must go to the device,
+ *	or -ve on error
+ */
+long blkwb_write(struct blk_desc *desc, lbaint_t start, lbaint_t blkcnt,
+		 const void *buffer);
+
+/**
+ * blkwb_read() - update blocks read from a device with cached writes
+ *
+ * @desc:	Block device descriptor
+ * @start:	First block read
+ * @blkcnt:	Number of blocks read
+ * @buffer:	Data read from the device, updated in place
+ */
+void blkwb_read(struct blk_desc *desc, lbaint_t start, lbaint_t blkcnt,
+		void *buffer);
+
+/**
+ * blkwb_discard() - drop cached writes to a set of blocks
+ *
+ * @desc:	Block device descriptor
+ * @start:	First block
+ * @blkcnt:	Number of blocks
+ */
+void blkwb_discard(struct blk_desc *desc, lbaint_t start, lbaint_t blkcnt);
+
+/**
+ * blk_flush() - write cached blocks of a device to it
+ *
+ * Adjacent blocks are written with a single request.
+ *
+ * @desc:	Block device descriptor
+ * @return 0 if OK, -EIO if a write failed
+ */
+int blk_flush(struct blk_desc *desc);
+
+/**
+ * blk_flush_all() - write cached blocks of all devices
+ *
+ * This must be called before handing the devices over to an OS or
+ * resetting.
+ *
+ * @return 0 if OK, -EIO if a write failed
+ */
+int blk_flush_all(void);
+
+/**
+ * blkwb_free() - flush and free the write-back cache of a device
+ *
+ * @desc:	Block device descriptor
+ */
+void blkwb_free(struct blk_desc *desc);
+#else
+static inline long blkwb_write(struct blk_desc *desc, lbaint_t start,
+			       lbaint_t blkcnt, const void *buffer)
+{
+	return 0;
+}
+
+static inline void blkwb_read(struct blk_desc *desc, lbaint_t start,
+			      lbaint_t blkcnt, void *buffer) {}
+static inline void blkwb_discard(struct blk_desc *desc, lbaint_t start,
+				 lbaint_t blkcnt) {}
+static inline int blk_flush(struct blk_desc *desc)
+{
+	return 0;
+}
+
+static inline int blk_flush_all(void)
+{
+	return 0;
+}
+
+static inline void blkwb_free(struct blk_desc *desc) {}
+#endif
+
 #if CONFIG_IS_ENABLED(BLOCK_CACHE)
 
 /**
@@ -160,6 +279,18 @@ void blkcache_fill(int iftype, int dev,
  */
 void blkcache_invalidate(int iftype, int dev);
 
+/**
+ * blkcache_invalidate_range() - discard the cache for the blocks of a
+ * device which overlap a write or erase
+ *
+ * @param iftype - IF_TYPE_x for type of device
+ * @param dev - device index of particular type
+ * @param start - first block written
+ * @param blkcnt - number of blocks written
+ */
+void blkcache_invalidate_range(int iftype, int dev, lbaint_t start,
+			       lbaint_t blkcnt);
+
 /**
  * blkcache_configure() - configure block cache
  *
@@ -200,9 +331,91 @@ static inline void blkcache_fill(int iftype, int dev,
 				 unsigned long blksz, void const *buffer) {}
 
 static inline void blkcache_invalidate(int iftype, int dev) {}
+static inline void blkcache_invalidate_range(int iftype, int dev,
+					     lbaint_t start,
+					     lbaint_t blkcnt) {}
 
 #endif
 
+/**
+ * struct blk_request - an asynchronous block device request
+ *
+ * This is set up by the caller of blk_dsubmit(), which then owns it again
+ * once @complete has been called.
+ *
+ * @desc:	Block device the request is for, set by blk_dsubmit()
+ * @start:	Start block number (0=first)
+ * @blkcnt:	Number of blocks to transfer
+ * @buffer:	Destination buffer for a read, source buffer for a write
+ * @write:	true to write to the device, false to read from it
+ * @result:	Number of blocks transferred or -ve error number, valid
+ *		once @complete is called
+ * @complete:	Called once the request has completed
+ * @priv:	Private data for the submitter
+ * @node:	Private data for the driver while the request is queued
+ */
+struct blk_request {
+	struct blk_desc *desc;
+	lbaint_t start;
+	lbaint_t blkcnt;
+	void *buffer;
+	bool write;
+	long result;
+	void (*complete)(struct blk_request *req);
+	void *priv;
+	struct list_head node;
+};
+
+/**
+ * blk_request_done() - complete an asynchronous request
+ *
+ * This is called by drivers once a request passed to them via blk_dsubmit()
+ * has finished. It sets the result and calls the submitter back.
+ *
+ * @req:	Request that has completed
+ * @result:	Number of blocks transferred, or -ve error number
+ */
+void blk_request_done(struct blk_request *req, long result);
+
+/**
+ * blk_dsubmit() - start an asynchronous read or write
+ *
+ * If the driver cannot queue requests, the transfer is carried out at once
+ * and @req->complete is called before this function returns.
+ *
+ * @block_dev:	Block device to access
+ * @req:	Request to submit, with @start, @blkcnt, @buffer, @write and
+ *		@complete set up
+ * @return 0 if the request was accepted, in which case @req->complete will
+ * be called, -ve error number otherwise
+ */
+int blk_dsubmit(struct blk_desc *block_dev, struct blk_request *req);
+
+/**
+ * blk_dpoll() - make progress with asynchronous requests
+ *
+ * U-Boot does not use interrupts, so drivers which queue requests complete
+ * them from here. Callers waiting for a request should call this until
+ * @req->complete has been called.
+ *
+ * @block_dev:	Block device to poll
+ * @return number of requests still outstanding, or -ve error number
+ */
+int blk_dpoll(struct blk_desc *block_dev);
+
+/**
+ * struct blk_vec - one run of a vectored block request
+ *
+ * @start:	Start block number (0=first)
+ * @blkcnt:	Number of blocks in the run
+ * @buffer:	Destination buffer for a read, source buffer for a write
+ */
+struct blk_vec {
+	lbaint_t start;
+	lbaint_t blkcnt;
+	void *buffer;
+};
+
 #if CONFIG_IS_ENABLED(BLK)
 struct udevice;
 
@@ -264,6 +477,59 @@ struct blk_ops {
 	 * @return 0 if OK, -ve on error
 	 */
 	int (*select_hwpart)(struct udevice *dev, int hwpart);
+
+	/**
+	 * submit() - queue a read or write request
+	 *
+	 * This is optional. Without it, blk_dsubmit() uses read() or write()
+	 * and completes the request at once.
+	 *
+	 * The driver must call blk_request_done() once the request has
+	 * finished, typically from poll().
+	 *
+	 * @dev:	Device to access
+	 * @req:	Request to queue
+	 * @return 0 if queued, -ve on error (the request is then not
+	 * completed)
+	 */
+	int (*submit)(struct udevice *dev, struct blk_request *req);
+
+	/**
+	 * poll() - make progress with queued requests
+	 *
+	 * @dev:	Device to poll
+	 * @return number of requests still outstanding, or -ve on error
+	 */
+	int (*poll)(struct udevice *dev);
+
+	/**
+	 * readv() - read several runs of blocks in one go
+	 *
+	 * This is optional. Without it, blk_dreadv() uses read() for each
+	 * run. The runs are sorted by start block and do not overlap, so
+	 * runs which are adjacent on the device can be sent as a single
+	 * scatter-gather request.
+	 *
+	 * @dev:	Device to read from
+	 * @vecs:	Runs to read
+	 * @count:	Number of runs
+	 * @return number of blocks read, or -ve error number
+	 */
+	unsigned long (*readv)(struct udevice *dev, const struct blk_vec *vecs,
+			       int count);
+
+	/**
+	 * writev() - write several runs of blocks in one go
+	 *
+	 * This is optional, see readv()
+	 *
+	 * @dev:	Device to write to
+	 * @vecs:	Runs to write
+	 * @count:	Number of runs
+	 * @return number of blocks written, or -ve error number
+	 */
+	unsigned long (*writev)(struct udevice *dev, const struct blk_vec *vecs,
+				int count);
 };
 
 #define blk_get_ops(dev)	((struct blk_ops *)(dev)->driver->ops)
@@ -281,6 +547,46 @@ unsigned long blk_dwrite(struct blk_desc *block_dev, lbaint_t start,
 unsigned long blk_derase(struct blk_desc *block_dev, lbaint_t start,
 			 lbaint_t blkcnt);
 
+/**
+ * blk_merge_vecs() - sort runs of blocks and merge neighbours
+ *
+ * Runs are sorted by start block. A run which follows on from the previous
+ * one both on the device and in memory is merged into it.
+ *
+ * @vecs:	Runs to sort and merge, updated in place
+ * @count:	Number of runs
+ * @blksz:	Block size in bytes
+ * @return new number of runs
+ */
+int blk_merge_vecs(struct blk_vec *vecs, int count, unsigned long blksz);
+
+/**
+ * blk_dreadv() - read several runs of blocks
+ *
+ * The runs must not overlap. They are merged with blk_merge_vecs() first,
+ * so @vecs may be reordered.
+ *
+ * @block_dev:	Block device to read from
+ * @vecs:	Runs to read
+ * @count:	Number of runs
+ * @return total number of blocks read, or -ve error number
+ */
+unsigned long blk_dreadv(struct blk_desc *block_dev, struct blk_vec *vecs,
+			 int count);
+
+/**
+ * blk_dwritev() - write several runs of blocks
+ *
+ * See blk_dreadv()
+ *
+ * @block_dev:	Block device to write to
+ * @vecs:	Runs to write
+ * @count:	Number of runs
+ * @return total number of blocks written, or -ve error number
+ */
+unsigned long blk_dwritev(struct blk_desc *block_dev, struct blk_vec *vecs,
+			  int count);
+
 /**
  * blk_find_device() - Find a block device
  *
@@ -425,6 +731,7 @@ struct blk_desc *blk_get_by_device(struct udevice *dev);
 
 #else
 #include <errno.h>
+#include <linux/err.h>
 /*
  * These functions should take struct udevice instead of struct blk_desc,
  * but this is convenient for migration to driver model. Add a 'd' prefix
@@ -455,17 +762,55 @@ static inline ulong blk_dread(struct blk_desc *block_dev, lbaint_t start,
 static inline ulong blk_dwrite(struct blk_desc *block_dev, lbaint_t start,
 			       lbaint_t blkcnt, const void *buffer)
 {
-	blkcache_invalidate(block_dev->if_type, block_dev->devnum);
+	blkcache_invalidate_range(block_dev->if_type, block_dev->devnum,
+				  start, blkcnt);
+	part_cache_invalidate(block_dev, start, blkcnt);
 	return block_dev->block_write(block_dev, start, blkcnt, buffer);
 }
 
 static inline ulong blk_derase(struct blk_desc *block_dev, lbaint_t start,
 			       lbaint_t blkcnt)
 {
-	blkcache_invalidate(block_dev->if_type, block_dev->devnum);
+	blkcache_invalidate_range(block_dev->if_type, block_dev->devnum,
+				  start, blkcnt);
+	part_cache_invalidate(block_dev, start, blkcnt);
 	return block_dev->block_erase(block_dev, start, blkcnt);
 }
 
+static inline ulong blk_dreadv(struct blk_desc *block_dev,
+			       struct blk_vec *vecs, int count)
+{
+	ulong n, total = 0;
+	int i;
+
+	for (i = 0; i < count; i++) {
+		n = blk_dread(block_dev, vecs[i].start, vecs[i].blkcnt,
+			      vecs[i].buffer);
+		if (n != vecs[i].blkcnt)
+			return IS_ERR_VALUE(n) ? n : total + n;
+		total += n;
+	}
+
+	return total;
+}
+
+static inline ulong blk_dwritev(struct blk_desc *block_dev,
+				struct blk_vec *vecs, int count)
+{
+	ulong n, total = 0;
+	int i;
+
+	for (i = 0; i < count; i++) {
+		n = blk_dwrite(block_dev, vecs[i].start, vecs[i].blkcnt,
+			       vecs[i].buffer);
+		if (n != vecs[i].blkcnt)
+			return IS_ERR_VALUE(n) ? n : total + n;
+		total += n;
+	}
+
+	return total;
+}
+
 /**
  * struct blk_driver - Driver for block interface types
  *
@@ -196,7 +196,9 @@ enum bootstage_id {
 	BOOTSTAGE_ID_ACCUM_LCD,
 	BOOTSTAGE_ID_ACCUM_SCSI,
 	BOOTSTAGE_ID_ACCUM_SPI,
-	BOOTSTAGE_ID_ACCUM_DECOMP,
+	BOOTSTAGE_ID_ACCUM_DECOMP_GZIP,
+	BOOTSTAGE_ID_ACCUM_DECOMP_LZ4,
+	BOOTSTAGE_ID_ACCUM_DECOMP_ZSTD,
 	BOOTSTAGE_ID_ACCUM_OF_LIVE,
 	BOOTSTAGE_ID_FPGA_INIT,
 	BOOTSTATE_ID_ACCUM_DM_SPL,
@@ -205,6 +207,7 @@ enum bootstage_id {
 	BOOTSTATE_ID_ACCUM_FSP_M,
 	BOOTSTATE_ID_ACCUM_FSP_S,
 	BOOTSTAGE_ID_ACCUM_MMAP_SPI,
+	BOOTSTAGE_ID_ACCUM_SPL_FIT_READ,
 
 	/* a few spare for the user, from here */
 	BOOTSTAGE_ID_USER,
@@ -8,13 +8,19 @@
 #ifndef __U_BOOT_BTRFS_H__
 #define __U_BOOT_BTRFS_H__
 
+struct fs_file;
+
 int btrfs_probe(struct blk_desc *, disk_partition_t *);
 int btrfs_ls(const char *);
 int btrfs_exists(const char *);
 int btrfs_size(const char *, loff_t *);
 int btrfs_read(const char *, void *, loff_t, loff_t, loff_t *);
 void btrfs_close(void);
+int btrfs_open_file(const char *, struct fs_file **);
+int btrfs_read_at(struct fs_file *, void *, loff_t, loff_t, loff_t *);
+void btrfs_close_file(struct fs_file *);
 int btrfs_uuid(char *);
 void btrfs_list_subvols(void);
+void btrfs_show_cache_stats(void);
 
 #endif /* __U_BOOT_BTRFS_H__ */
@@ -126,6 +126,34 @@ struct ext2_sblock {
 	__le32 raid_stripe_width;
 	uint8_t log2_groups_per_flex;
 	uint8_t checksum_type;
+	uint8_t encryption_level;
+	uint8_t reserved_pad;
+	__le64 kbytes_written;
+	__le32 snapshot_inum;
+	__le32 snapshot_id;
+	__le64 snapshot_r_blocks_count;
+	__le32 snapshot_list;
+	__le32 error_count;
+	__le32 first_error_time;
+	__le32 first_error_ino;
+	__le64 first_error_block;
+	uint8_t first_error_func[32];
+	__le32 first_error_line;
+	__le32 last_error_time;
+	__le32 last_error_ino;
+	__le32 last_error_line;
+	__le64 last_error_block;
+	uint8_t last_error_func[32];
+	uint8_t mount_opts[64];
+	__le32 usr_quota_inum;
+	__le32 grp_quota_inum;
+	__le32 overhead_blocks;
+	__le32 backup_bgs[2];
+	uint8_t encrypt_algos[4];
+	uint8_t encrypt_pw_salt[16];
+	__le32 lpf_ino;
+	__le32 prj_quota_inum;
+	__le32 checksum_seed;
 };
 
 struct ext2_block_group {
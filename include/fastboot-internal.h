@@ -33,4 +33,77 @@ extern void (*fastboot_progress_callback)(const char *msg);
  */
 void fastboot_getvar(char *cmd_parameter, char *response);
 
+#if CONFIG_IS_ENABLED(FASTBOOT_FLASH_STREAM)
+/**
+ * fastboot_stream_arm() - Select the partition to stream downloads to
+ *
+ * @part_name: Partition to write following downloads to, or NULL or an
+ *	empty string to go back to buffered downloads
+ * @response: Pointer to fastboot response buffer
+ */
+void fastboot_stream_arm(const char *part_name, char *response);
+
+/**
+ * fastboot_stream_armed() - Check whether downloads should be streamed
+ *
+ * Return: true if a partition has been selected with fastboot_stream_arm()
+ */
+bool fastboot_stream_armed(void);
+
+/**
+ * fastboot_stream_active() - Check whether a streamed download is running
+ *
+ * Return: true if received data must go to fastboot_stream_data()
+ */
+bool fastboot_stream_active(void);
+
+/**
+ * fastboot_stream_start() - Start writing a download to the armed partition
+ *
+ * @size: Size of the download in bytes
+ * @response: Pointer to fastboot response buffer, set on error
+ * Return: 0 if OK, -ve on error
+ */
+int fastboot_stream_start(u32 size, char *response);
+
+/**
+ * fastboot_stream_data() - Write the next piece of a streamed download
+ *
+ * Errors are recorded and reported by fastboot_stream_flash(), so that the
+ * transport can complete the data phase normally.
+ *
+ * @data: Pointer to received data
+ * @len: Length of received data
+ */
+void fastboot_stream_data(const void *data, u32 len);
+
+/**
+ * fastboot_stream_complete() - Write out the end of a streamed download
+ */
+void fastboot_stream_complete(void);
+
+/**
+ * fastboot_stream_flash() - Report the result of a streamed download
+ *
+ * @part_name: Partition named in the flash command
+ * @response: Pointer to fastboot response buffer
+ * Return: true if the last download was streamed and @response has been
+ *	set, false if the image must be flashed from the download buffer
+ */
+bool fastboot_stream_flash(const char *part_name, char *response);
+#else
+static inline bool fastboot_stream_active(void)
+{
+	return false;
+}
+
+static inline void fastboot_stream_data(const void *data, u32 len)
+{
+}
+
+static inline void fastboot_stream_complete(void)
+{
+}
+#endif
+
 #endif
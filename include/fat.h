@@ -126,6 +126,22 @@ typedef struct volume_info
 	/* Boot sign comes last, 2 bytes */
 } volume_info;
 
+/* FAT32 FSInfo sector signatures and unknown value */
+#define FSINFO_LEAD_SIGN	0x41615252
+#define FSINFO_STRUCT_SIGN	0x61417272
+#define FSINFO_TRAIL_SIGN	0xaa550000
+#define FSINFO_UNKNOWN		0xffffffff
+
+struct fsinfo_sector {
+	__u32	lead_sign;	/* FSINFO_LEAD_SIGN */
+	__u8	reserved1[480];	/* Unused */
+	__u32	struct_sign;	/* FSINFO_STRUCT_SIGN */
+	__u32	free_count;	/* Number of free clusters, or FSINFO_UNKNOWN */
+	__u32	next_free;	/* Hint where to look for a free cluster */
+	__u8	reserved2[12];	/* Unused */
+	__u32	trail_sign;	/* FSINFO_TRAIL_SIGN */
+};
+
 /* see dir_entry::lcase: */
 #define CASE_LOWER_BASE	8	/* base (name) is lower case */
 #define CASE_LOWER_EXT	16	/* extension is lower case */
@@ -175,6 +191,12 @@ typedef struct {
 	__u32	root_cluster;	/* First cluster of root dir for FAT32 */
 	u32	total_sect;	/* Number of sectors */
 	int	fats;		/* Number of FATs */
+	__u32	max_clust;	/* Highest valid cluster number */
+	__u8	*clust_map;	/* Bitmap of clusters in use, built on write */
+	__u32	free_clust;	/* Number of free clusters in clust_map */
+	__u32	next_free;	/* Cluster to start looking for free ones at */
+	__u16	fsinfo_sect;	/* FAT32 FSInfo sector, 0 if there is none */
+	__u8	fsinfo_dirty;	/* Set if FSInfo needs to be updated */
 } fsdata;
 
 static inline u32 clust_to_sect(fsdata *fsdata, u32 clust)
@@ -203,6 +225,10 @@ int fat_read_file(const char *filename, void *buf, loff_t offset, loff_t len,
 int fat_opendir(const char *filename, struct fs_dir_stream **dirsp);
 int fat_readdir(struct fs_dir_stream *dirs, struct fs_dirent **dentp);
 void fat_closedir(struct fs_dir_stream *dirs);
+int fat_open_file(const char *filename, struct fs_file **filep);
+int fat_read_at(struct fs_file *file, void *buf, loff_t offset, loff_t len,
+		loff_t *actread);
+void fat_close_file(struct fs_file *file);
 int fat_unlink(const char *filename);
 int fat_mkdir(const char *dirname);
 void fat_close(void);
@@ -6,6 +6,8 @@
 #ifndef _FB_MMC_H_
 #define _FB_MMC_H_
 
+struct sparse_storage;
+
 /**
  * fastboot_mmc_get_part_info() - Lookup eMMC partion by name
  *
@@ -35,4 +37,16 @@ void fastboot_mmc_flash_write(const char *cmd, void *download_buffer,
  * @response: Pointer to fastboot response buffer
  */
 void fastboot_mmc_erase(const char *cmd, char *response);
+
+/**
+ * fastboot_mmc_stream_storage() - Describe an eMMC partition for streaming
+ *
+ * @part_name: Named partition the image is streamed to
+ * @storage: Pointer to returned storage description
+ * @response: Pointer to fastboot response buffer, set on error
+ * Return: 0 if OK, -ve on error
+ */
+int fastboot_mmc_stream_storage(const char *part_name,
+				struct sparse_storage *storage,
+				char *response);
 #endif
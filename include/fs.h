@@ -13,6 +13,7 @@
 #define FS_TYPE_SANDBOX	3
 #define FS_TYPE_UBIFS	4
 #define FS_TYPE_BTRFS	5
+#define FS_TYPE_SQUASHFS 6
 
 /**
  * do_fat_fsload - Run the fatload command
@@ -68,8 +69,13 @@ int fs_set_blk_dev_with_part(struct blk_desc *desc, int part);
  * Many file functions implicitly call fs_close(), e.g. fs_closedir(),
  * fs_exist(), fs_ln(), fs_ls(), fs_mkdir(), fs_read(), fs_size(), fs_write(),
  * fs_unlink().
+ *
+ * Blocks the file system left in the write-back cache are written to the
+ * device.
+ *
+ * Return:	0 on success, -EIO if cached blocks could not be written
  */
-void fs_close(void);
+int fs_close(void);
 
 /**
  * fs_get_type() - Get type of current filesystem
@@ -141,7 +147,8 @@ int fs_read(const char *filename, ulong addr, loff_t offset, loff_t len,
  * @offset:	offset in the file from where to start writing
  * @len:	the number of bytes to write
  * @actwrite:	returns the actual number of bytes written
- * Return:	0 if OK with valid *actwrite, -1 on error conditions
+ * Return:	0 if OK with valid *actwrite, -1 on error conditions, -EIO if
+ *		the data could not be written back to the device
  */
 int fs_write(const char *filename, ulong addr, loff_t offset, loff_t len,
 	     loff_t *actwrite);
@@ -202,13 +209,71 @@ struct fs_dirent *fs_readdir(struct fs_dir_stream *dirs);
  */
 void fs_closedir(struct fs_dir_stream *dirs);
 
+/*
+ * An open file, returned by fs_open_file(). The file system keeps what it
+ * needs to find the file's data (inode, directory entry, ...), so reading
+ * through it does not look up the path again.
+ *
+ * Note: apart from 'size', fs_file should be treated as opaque to the user
+ * of fs layer.
+ */
+struct fs_file {
+	loff_t size;         /* size in bytes */
+	/* private to fs. layer: */
+	struct blk_desc *desc;
+	int part;
+	int fstype;
+};
+
+/*
+ * fs_open_file - Open a regular file for reading
+ *
+ * Like the other fs functions this works on the partition previously set by
+ * fs_set_blk_dev(). Unlike them it leaves the file system set up, so that
+ * fs_read_at() does not have to probe it again. The returned handle stays
+ * valid until fs_close_file() is called.
+ *
+ * @filename: full path of the file to open
+ * @return a pointer to the file or NULL on error and errno set
+ *    appropriately
+ */
+struct fs_file *fs_open_file(const char *filename);
+
+/*
+ * fs_read_at - Read from an open file
+ *
+ * If another fs function was used since the file was opened, the partition
+ * the file was opened on is set up again for the read. There is no need to
+ * call fs_set_blk_dev() first.
+ *
+ * @file: the file
+ * @addr: address of the buffer to write to
+ * @offset: offset in the file from where to start reading
+ * @len: the number of bytes to read. Use 0 to read up to the end of the file.
+ * @actread: returns the actual number of bytes read, 0 at or beyond the end
+ *    of the file
+ * @return 0 if OK with valid *actread, negative on error
+ */
+int fs_read_at(struct fs_file *file, ulong addr, loff_t offset, loff_t len,
+	       loff_t *actread);
+
+/*
+ * fs_close_file - close a file opened by fs_open_file()
+ *
+ * This also closes the file system, if it is still set up for the file.
+ *
+ * @file: the file, may be NULL
+ */
+void fs_close_file(struct fs_file *file);
+
 /*
  * fs_unlink - delete a file or directory
  *
  * If a given name is a directory, it will be deleted only if it's empty
  *
  * @filename: Name of file or directory to delete
- * @return 0 on success, -1 on error conditions
+ * @return 0 on success, -1 on error conditions, -EIO if the change could
+ * not be written back to the device
  */
 int fs_unlink(const char *filename);
 
@@ -216,7 +281,8 @@ int fs_unlink(const char *filename);
  * fs_mkdir - Create a directory
  *
  * @filename: Name of directory to create
- * @return 0 on success, -1 on error conditions
+ * @return 0 on success, -1 on error conditions, -EIO if the change could
+ * not be written back to the device
  */
 int fs_mkdir(const char *filename);
 
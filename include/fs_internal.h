@@ -13,4 +13,17 @@
 int fs_devread(struct blk_desc *, disk_partition_t *, lbaint_t, int, int,
 	       char *);
 
+/**
+ * fs_devreadv() - read several runs of whole sectors from a partition
+ *
+ * @blk:	block device to read from
+ * @partition:	partition being read
+ * @vecs:	runs to read, with start sectors relative to @partition.
+ *		These are converted to device sectors and may be reordered.
+ * @count:	number of runs
+ * @return 1 if OK, 0 on error (like fs_devread())
+ */
+int fs_devreadv(struct blk_desc *blk, disk_partition_t *partition,
+		struct blk_vec *vecs, int count);
+
 #endif /* __U_BOOT_FS_INTERNAL_H__ */
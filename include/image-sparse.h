@@ -39,3 +39,85 @@ static inline int is_sparse_image(void *buf)
 
 int write_sparse_image(struct sparse_storage *info, const char *part_name,
 		       void *data, char *response);
+
+/**
+ * struct sparse_stream - state of an incremental sparse image writer
+ *
+ * Unlike write_sparse_image(), which needs the whole image in memory, a
+ * sparse stream accepts the image in arbitrarily sized pieces as they
+ * arrive (e.g. from a fastboot download) and issues the storage writes as
+ * soon as enough data is available.
+ *
+ * @info: Storage backend to write to
+ * @part_name: Partition name, used for messages
+ * @response: Response buffer handed to info->mssg() on error
+ * @state: Parser state (enum sparse_stream_state in image-sparse.c)
+ * @sparse_header: Copy of the sparse file header
+ * @chunk_header: Copy of the current chunk header
+ * @fill_val: Fill value of the current CHUNK_TYPE_FILL chunk
+ * @hdr_len: Number of header bytes collected so far for the current state
+ * @skip: Number of input bytes still to be skipped
+ * @chunk: Index of the current chunk
+ * @blk: Next storage block to be written
+ * @raw_left: Bytes of raw chunk data still to be consumed
+ * @total_blocks: Number of sparse blocks processed so far
+ * @bytes_written: Number of bytes written to storage so far
+ * @blk_buf: Bounce buffer for raw data which straddles a call boundary
+ * @blk_fill: Number of bytes held in @blk_buf
+ */
+struct sparse_stream {
+	struct sparse_storage *info;
+	const char *part_name;
+	char *response;
+	int state;
+	sparse_header_t sparse_header;
+	chunk_header_t chunk_header;
+	u32 fill_val;
+	u32 hdr_len;
+	u32 skip;
+	u32 chunk;
+	lbaint_t blk;
+	u64 raw_left;
+	u32 total_blocks;
+	u32 bytes_written;
+	void *blk_buf;
+	u32 blk_fill;
+};
+
+/**
+ * sparse_stream_init() - Prepare to write a sparse image incrementally
+ *
+ * @stream: Stream state to initialise
+ * @info: Storage backend to write to
+ * @part_name: Partition name, used for messages
+ * @response: Response buffer handed to info->mssg() on error
+ * @return 0 if OK, -ENOMEM if the bounce buffer cannot be allocated
+ */
+int sparse_stream_init(struct sparse_stream *stream,
+		       struct sparse_storage *info, const char *part_name,
+		       char *response);
+
+/**
+ * sparse_stream_write() - Feed the next piece of a sparse image
+ *
+ * Parses as much of @data as possible and writes the resulting blocks to
+ * storage. Partial headers and blocks are kept until the next call.
+ *
+ * @stream: Stream state
+ * @data: Next piece of the sparse image
+ * @len: Length of @data in bytes
+ * @return 0 if OK, -1 on error (in which case info->mssg() was called)
+ */
+int sparse_stream_write(struct sparse_stream *stream, const void *data,
+			size_t len);
+
+/**
+ * sparse_stream_finish() - Complete an incremental sparse image write
+ *
+ * Checks that the whole image has been consumed and releases the stream
+ * resources. This must be called even if sparse_stream_write() failed.
+ *
+ * @stream: Stream state
+ * @return 0 if the complete image was written, -1 otherwise
+ */
+int sparse_stream_finish(struct sparse_stream *stream);
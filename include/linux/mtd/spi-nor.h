@@ -286,6 +286,11 @@ struct flash_info;
  * @write_proto:	the SPI protocol for write operations
  * @reg_proto		the SPI protocol for read_reg/write_reg/erase operations
  * @cmd_buf:		used by the write_reg
+ * @dirmap_rdesc:	direct mapping used for data reads, if any
+ * @ra_buf:		read-ahead buffer of CONFIG_SPI_FLASH_READAHEAD_SIZE
+ *			bytes, or NULL if read-ahead is disabled
+ * @ra_from:		flash offset of the data held in @ra_buf
+ * @ra_len:		number of valid bytes in @ra_buf, 0 if it is empty
  * @prepare:		[OPTIONAL] do some preparations for the
  *			read/write/erase/lock/unlock operations
  * @unprepare:		[OPTIONAL] do some post work after the
@@ -327,6 +332,12 @@ struct spi_nor {
 	bool			sst_write_second;
 	u32			flags;
 	u8			cmd_buf[SPI_NOR_MAX_CMD_SIZE];
+#ifdef CONFIG_SPI_FLASH_DIRMAP
+	struct spi_mem_dirmap_desc *dirmap_rdesc;
+#endif
+	u8			*ra_buf;
+	loff_t			ra_from;
+	size_t			ra_len;
 
 	int (*prepare)(struct spi_nor *nor, enum spi_nor_ops ops);
 	void (*unprepare)(struct spi_nor *nor, enum spi_nor_ops ops);
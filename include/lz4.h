@@ -6,6 +6,89 @@
 #ifndef __LZ4_H
 #define __LZ4_H
 
+#include <linux/xxhash.h>
+
+/**
+ * struct lz4_stream - state of a streaming LZ4 frame decoder
+ *
+ * The input can be passed in pieces of any size, e.g. as it is read from
+ * storage. The output goes to a single buffer, which also holds the history
+ * needed by frames with linked blocks.
+ *
+ * All fields are private to the decoder.
+ *
+ * @dst:		start of the output buffer
+ * @out:		next byte to write
+ * @end:		end of the output buffer
+ * @state:		what is being read (enum lz4_stream_state)
+ * @hdr_len:		number of bytes wanted in @hdr
+ * @pos:		number of bytes of the current field or block read so
+ *			far
+ * @hdr:		frame header, block header or checksum being read
+ * @flags:		flags byte of the frame header
+ * @block_max:		largest block size allowed by the frame header
+ * @block_size:		size of the data of the current block
+ * @raw:		the current block is stored uncompressed
+ * @content_size:	size of the decompressed data, if the frame has it
+ * @buf:		buffer for a compressed block which arrives in pieces
+ * @content_xxh:	checksum of the output
+ * @block_xxh:		checksum of the current block
+ */
+struct lz4_stream {
+	u8 *dst;
+	u8 *out;
+	u8 *end;
+	int state;
+	int hdr_len;
+	u32 pos;
+	u8 hdr[15];
+	u8 flags;
+	u32 block_max;
+	u32 block_size;
+	bool raw;
+	u64 content_size;
+	u8 *buf;
+	struct xxh32_state content_xxh;
+	struct xxh32_state block_xxh;
+};
+
+/**
+ * ulz4_stream_init() - set up to decompress an LZ4 frame
+ *
+ * @s: Decoder state to set up
+ * @dst: Destination for uncompressed data
+ * @dstn: Size of the destination buffer
+ */
+void ulz4_stream_init(struct lz4_stream *s, void *dst, size_t dstn);
+
+/**
+ * ulz4_stream_decompress() - decompress the next piece of an LZ4 frame
+ *
+ * @s: Decoder state
+ * @src: Next piece of the compressed data
+ * @srcn: Length of @src, updated to the number of bytes used. Bytes after
+ *	the end of the frame are not used.
+ * @return 1 if the end of the frame has been reached, 0 if more input is
+ *	needed, or a -ve error number as for ulz4fn(). -ENOMEM is returned if
+ *	a compressed block is split between pieces and there is not enough
+ *	memory to collect it.
+ */
+int ulz4_stream_decompress(struct lz4_stream *s, const void *src,
+			   size_t *srcn);
+
+/**
+ * ulz4_stream_finish() - finish decompressing an LZ4 frame
+ *
+ * This must be called once decompression is done, whether it succeeded or
+ * not, to free the memory used by the decoder.
+ *
+ * @s: Decoder state
+ * @dstn: Returns length of uncompressed data
+ * @return 0 if the whole frame was decompressed, -EINVAL if the input ended
+ *	early
+ */
+int ulz4_stream_finish(struct lz4_stream *s, size_t *dstn);
+
 /**
  * ulz4fn() - Decompress LZ4 data
  *
@@ -13,12 +96,32 @@
  * @srcn: Length of source data
  * @dst: Destination for uncompressed data
  * @dstn: Returns length of uncompressed data
+ * Both independent and linked blocks are supported. Block and content
+ * checksums are verified when the frame has them.
+ *
  * @return 0 if OK, -EPROTONOSUPPORT if the magic number or version number are
- *	not recognised or independent blocks are used, -EINVAL if the reserved
+ *	not recognised or a dictionary is used, -EINVAL if the reserved
  *	fields are non-zero, or input is overrun, -EENOBUFS if the destination
  *	buffer is overrun, -EEPROTO if the compressed data causes an error in
- *	the decompression algorithm
+ *	the decompression algorithm, -EBADMSG if a checksum or the content size
+ *	does not match
  */
 int ulz4fn(const void *src, size_t srcn, void *dst, size_t *dstn);
 
+/**
+ * LZ4_decompress_safe() - Decompress a raw LZ4 block
+ *
+ * This is for data compressed as a single block, without the frame format
+ * handled by ulz4fn(), as used by SquashFS.
+ *
+ * @source: Compressed data
+ * @dest: Destination for uncompressed data
+ * @inputSize: Length of the compressed data
+ * @maxDecompressedSize: Size of the destination buffer
+ * @return number of bytes decompressed, or -ve if the data is malformed or
+ *	does not fit into the destination buffer
+ */
+int LZ4_decompress_safe(const char *source, char *dest, int inputSize,
+			int maxDecompressedSize);
+
 #endif
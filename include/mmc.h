@@ -73,6 +73,8 @@ struct bd_info;
 #define MMC_CAP_NONREMOVABLE	BIT(14)
 #define MMC_CAP_NEEDS_POLL	BIT(15)
 #define MMC_CAP_CD_ACTIVE_HIGH  BIT(16)
+#define MMC_CAP_CMD23		BIT(17)	/* Host can send SET_BLOCK_COUNT */
+#define MMC_CAP_CQE		BIT(18)	/* Host has a command queue engine */
 
 #define MMC_MODE_8BIT		BIT(30)
 #define MMC_MODE_4BIT		BIT(29)
@@ -144,6 +146,8 @@ static inline bool mmc_is_tuning_cmd(uint cmdidx)
 #define SD_HIGHSPEED_BUSY	0x00020000
 #define SD_HIGHSPEED_SUPPORTED	0x00020000
 
+#define SD_SCR_CMD23_SUPPORT	BIT(1)	/* in scr[0] */
+
 #define UHS_SDR12_BUS_SPEED	0
 #define HIGH_SPEED_BUS_SPEED	1
 #define UHS_SDR25_BUS_SPEED	1
@@ -211,6 +215,7 @@ static inline bool mmc_is_tuning_cmd(uint cmdidx)
 /*
  * EXT_CSD fields
  */
+#define EXT_CSD_CMDQ_MODE_EN		15	/* R/W */
 #define EXT_CSD_ENH_START_ADDR		136	/* R/W */
 #define EXT_CSD_ENH_SIZE_MULT		140	/* R/W */
 #define EXT_CSD_GP_SIZE_MULT		143	/* R/W */
@@ -240,6 +245,8 @@ static inline bool mmc_is_tuning_cmd(uint cmdidx)
 #define EXT_CSD_HC_ERASE_GRP_SIZE	224	/* RO */
 #define EXT_CSD_BOOT_MULT		226	/* RO */
 #define EXT_CSD_GENERIC_CMD6_TIME       248     /* RO */
+#define EXT_CSD_CMDQ_DEPTH		307	/* RO */
+#define EXT_CSD_CMDQ_SUPPORT		308	/* RO */
 #define EXT_CSD_BKOPS_SUPPORT		502	/* RO */
 
 /*
@@ -295,6 +302,10 @@ static inline bool mmc_is_tuning_cmd(uint cmdidx)
 #define EXT_CSD_EXTRACT_BOOT_PART(x)		(((x) >> 3) & 0x7)
 #define EXT_CSD_EXTRACT_PARTITION_ACCESS(x)	((x) & 0x7)
 
+#define EXT_CSD_CMDQ_MODE_ENABLED	BIT(0)
+#define EXT_CSD_CMDQ_DEPTH_MASK		0x1f	/* queue depth minus one */
+#define EXT_CSD_CMDQ_SUPPORTED		BIT(0)
+
 #define EXT_CSD_BOOT_BUS_WIDTH_MODE(x)	(x << 3)
 #define EXT_CSD_BOOT_BUS_WIDTH_RESET(x)	(x << 2)
 #define EXT_CSD_BOOT_BUS_WIDTH_WIDTH(x)	(x)
@@ -353,6 +364,13 @@ enum mmc_voltage {
 /* Maximum block size for MMC */
 #define MMC_MAX_BLOCK_LEN	512
 
+/* Largest transfer that can be announced with CMD23 (SET_BLOCK_COUNT) */
+#define MMC_MAX_SET_BLOCK_COUNT	0xffff
+
+/* Command queue limits: number of task slots and blocks per queued task */
+#define MMC_CQE_MAX_DEPTH	32
+#define MMC_CQE_MAX_TASK_BLKS	2048
+
 /* The number of MMC physical partitions.  These consist of:
  * boot partitions (2), general purpose partitions (4) in MMC v4.4.
  */
@@ -407,6 +425,21 @@ struct mmc_data {
 	uint blocksize;
 };
 
+/**
+ * struct mmc_cqe_task - a read queued on the card's command queue
+ *
+ * The task's tag is its index in the array passed to cqe_request().
+ *
+ * @blk_addr:	First block to read (cards using CQE are block-addressed)
+ * @blocks:	Number of 512-byte blocks, at most MMC_CQE_MAX_TASK_BLKS
+ * @dest:	Destination buffer
+ */
+struct mmc_cqe_task {
+	u32 blk_addr;
+	uint blocks;
+	void *dest;
+};
+
 /* forward decl. */
 struct mmc;
 
@@ -504,6 +537,23 @@ struct dm_mmc_ops {
 	 * @return maximum number of blocks for this transfer
 	 */
 	int (*get_b_max)(struct udevice *dev, void *dst, lbaint_t blkcnt);
+
+#if CONFIG_IS_ENABLED(MMC_CQE)
+	/**
+	 * cqe_request() - Run a batch of tasks on the command queue engine
+	 *
+	 * The card has command queueing enabled when this is called. All
+	 * tasks are queued before waiting for any of them, so that the card
+	 * is free to service them back to back.
+	 *
+	 * @dev:	Device to use
+	 * @tasks:	Tasks to run, tagged by their index
+	 * @count:	Number of tasks, at most the card's queue depth
+	 * @return 0 if all tasks completed, -ve on error
+	 */
+	int (*cqe_request)(struct udevice *dev, struct mmc_cqe_task *tasks,
+			   int count);
+#endif
 };
 
 #define mmc_get_ops(dev)        ((struct dm_mmc_ops *)(dev)->driver->ops)
@@ -518,6 +568,8 @@ int dm_mmc_wait_dat0(struct udevice *dev, int state, int timeout_us);
 int dm_mmc_host_power_cycle(struct udevice *dev);
 int dm_mmc_deferred_probe(struct udevice *dev);
 int dm_mmc_get_b_max(struct udevice *dev, void *dst, lbaint_t blkcnt);
+int dm_mmc_cqe_request(struct udevice *dev, struct mmc_cqe_task *tasks,
+		       int count);
 
 /* Transition functions for compatibility */
 int mmc_set_ios(struct mmc *mmc);
@@ -529,6 +581,7 @@ int mmc_set_enhanced_strobe(struct mmc *mmc);
 int mmc_host_power_cycle(struct mmc *mmc);
 int mmc_deferred_probe(struct mmc *mmc);
 int mmc_get_b_max(struct mmc *mmc, void *dst, lbaint_t blkcnt);
+int mmc_cqe_request(struct mmc *mmc, struct mmc_cqe_task *tasks, int count);
 
 #else
 struct mmc_ops {
@@ -650,6 +703,11 @@ struct mmc {
 	u8 part_config;
 	u8 gen_cmd6_time;	/* units: 10 ms */
 	u8 part_switch_time;	/* units: 10 ms */
+	bool cmd23;		/* use SET_BLOCK_COUNT for multi-block I/O */
+#if CONFIG_IS_ENABLED(MMC_CQE)
+	u8 cqe_depth;		/* queue depth if command queueing is usable */
+	bool cqe_on;		/* true if the card is in command queue mode */
+#endif
 	uint tran_speed;
 	uint legacy_speed; /* speed for the legacy mode provided by the card */
 	uint read_bl_len;
@@ -713,6 +771,33 @@ struct mmc_hwpart_conf {
 	} gp_part[4];
 };
 
+/* Number of MMC devices whose negotiation results can be recorded */
+#define MMC_INIT_CACHE_SIZE	4
+
+/**
+ * struct mmc_init_rec - negotiation result recorded for fast re-init
+ *
+ * This is kept in the bloblist, so it is passed from SPL to U-Boot proper and
+ * is still there for a later 'mmc rescan'.
+ *
+ * @cid:	Card identification, to check that the same card is present
+ * @seq:	Sequence number of the MMC controller
+ * @is_sd:	1 if this is an SD card, 0 for (e)MMC
+ * @mode:	Bus mode selected (enum bus_mode)
+ * @bus_width:	Bus width selected (1, 4 or 8), 0 if this record is unused
+ */
+struct mmc_init_rec {
+	u32 cid[4];
+	u8 seq;
+	u8 is_sd;
+	u8 mode;
+	u8 bus_width;
+};
+
+struct mmc_init_cache {
+	struct mmc_init_rec rec[MMC_INIT_CACHE_SIZE];
+};
+
 enum mmc_hwpart_conf_mode {
 	MMC_HWPART_CONF_CHECK,
 	MMC_HWPART_CONF_SET,
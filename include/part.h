@@ -84,6 +84,36 @@ struct disk_part {
 	struct list_head list;
 };
 
+/**
+ * struct part_cache - partition table of a block device, parsed once
+ *
+ * This is kept in struct blk_desc and dropped on a rescan or when a write
+ * touches the blocks holding the table.
+ *
+ * @part_type:	Type of the partition table (PART_TYPE_...)
+ * @hwpart:	Hardware partition the table was read from
+ * @count:	Number of entries in @parts
+ * @parts:	Entry n describes partition n + 1; its size is 0 if unused
+ * @nr_used:	Number of used entries in @parts
+ * @by_name:	Used entries sorted by name, then by partition number
+ * @by_uuid:	Used entries sorted by UUID, then by partition number
+ * @table_end:	First block after the primary partition table
+ * @backup_start: First block of the backup partition table, or 0 if none
+ */
+struct part_cache {
+	int part_type;
+	int hwpart;
+	int count;
+	disk_partition_t *parts;
+	int nr_used;
+	disk_partition_t **by_name;
+#if CONFIG_IS_ENABLED(PARTITION_UUIDS)
+	disk_partition_t **by_uuid;
+#endif
+	lbaint_t table_end;
+	lbaint_t backup_start;
+};
+
 /* Misc _get_dev functions */
 #ifdef CONFIG_PARTITIONS
 /**
@@ -210,6 +240,18 @@ int part_get_info_by_name_type(struct blk_desc *dev_desc, const char *name,
 int part_get_info_by_name(struct blk_desc *dev_desc,
 			      const char *name, disk_partition_t *info);
 
+/**
+ * part_get_info_by_uuid() - Search for a partition by its UUID
+ *
+ * @dev_desc:	Block device descriptor
+ * @uuid:	Partition UUID as a string, in any case
+ * @info:	Returns the disk partition info
+ * @return the partition number on match (starting on 1), -1 on no match,
+ *	otherwise error
+ */
+int part_get_info_by_uuid(struct blk_desc *dev_desc, const char *uuid,
+			  disk_partition_t *info);
+
 /**
  * Get partition info from dev number + part name, or dev number + part number.
  *
@@ -303,6 +345,19 @@ struct part_driver {
 	int (*get_info)(struct blk_desc *dev_desc, int part,
 			disk_partition_t *info);
 
+	/**
+	 * get_all() - Get information about all partitions at once
+	 *
+	 * This is optional. It lets the partition table be cached with a
+	 * single read instead of one per partition. The driver allocates
+	 * @cache->parts and fills in @count, @table_end and @backup_start.
+	 *
+	 * @dev_desc:	Block device descriptor
+	 * @cache:	Returns the partitions
+	 * @return 0 if OK, -ve on error
+	 */
+	int (*get_all)(struct blk_desc *dev_desc, struct part_cache *cache);
+
 	/**
 	 * print() - Print partition information
 	 *
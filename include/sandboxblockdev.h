@@ -12,6 +12,9 @@ struct host_block_dev {
 #endif
 	char *filename;
 	int fd;
+#ifdef CONFIG_BLK
+	struct list_head queue;		/* requests waiting for poll() */
+#endif
 };
 
 int host_dev_bind(int dev, char *filename);
@@ -120,6 +120,7 @@
 #define  SDHCI_INT_CARD_INSERT	BIT(6)
 #define  SDHCI_INT_CARD_REMOVE	BIT(7)
 #define  SDHCI_INT_CARD_INT	BIT(8)
+#define  SDHCI_INT_CQE		BIT(14)
 #define  SDHCI_INT_ERROR	BIT(15)
 #define  SDHCI_INT_TIMEOUT	BIT(16)
 #define  SDHCI_INT_CRC		BIT(17)
@@ -302,6 +303,57 @@ struct sdhci_adma_desc {
 #endif
 } __packed;
 #endif
+
+#if CONFIG_IS_ENABLED(MMC_SDHCI_CQE)
+/*
+ * Command queue engine (CQHCI) registers, relative to sdhci_host.cqe_base
+ */
+#define CQHCI_CFG		0x08
+#define  CQHCI_ENABLE		BIT(0)
+#define  CQHCI_TASK_DESC_SZ	BIT(8)	/* 128-bit task descriptors */
+#define  CQHCI_DCMD		BIT(12)
+#define CQHCI_CTL		0x0C
+#define  CQHCI_HALT		BIT(0)
+#define  CQHCI_CLEAR_ALL_TASKS	BIT(8)
+#define CQHCI_IS		0x10
+#define  CQHCI_IS_HAC		BIT(0)
+#define  CQHCI_IS_TCC		BIT(1)
+#define  CQHCI_IS_RED		BIT(2)
+#define  CQHCI_IS_TCL		BIT(3)
+#define  CQHCI_IS_GCE		BIT(4)
+#define  CQHCI_IS_ICCE		BIT(5)
+#define  CQHCI_IS_MASK		(CQHCI_IS_HAC | CQHCI_IS_TCC | \
+				 CQHCI_IS_RED | CQHCI_IS_TCL | \
+				 CQHCI_IS_GCE | CQHCI_IS_ICCE)
+#define  CQHCI_IS_ERROR		(CQHCI_IS_RED | CQHCI_IS_GCE | CQHCI_IS_ICCE)
+#define CQHCI_ISTE		0x14
+#define CQHCI_ISGE		0x18
+#define CQHCI_TDLBA		0x20
+#define CQHCI_TDLBAU		0x24
+#define CQHCI_TDBR		0x28
+#define CQHCI_TCN		0x2C
+#define CQHCI_TCLR		0x38
+#define CQHCI_SSC2		0x44
+#define CQHCI_TERRI		0x54
+
+/* Task descriptor fields */
+#define CQHCI_TD_VALID		BIT_ULL(0)
+#define CQHCI_TD_END		BIT_ULL(1)
+#define CQHCI_TD_INT		BIT_ULL(2)
+#define CQHCI_TD_ACT_TASK	(0x5ULL << 3)
+#define CQHCI_TD_DATA_DIR_READ	BIT_ULL(12)
+#define CQHCI_TD_BLK_COUNT(x)	((u64)((x) & 0xffff) << 16)
+#define CQHCI_TD_BLK_ADDR(x)	((u64)(x) << 32)
+
+#define CQHCI_NUM_SLOTS		MMC_CQE_MAX_DEPTH
+/* Each slot holds a task descriptor and a link descriptor, both this size */
+#define CQHCI_SLOT_SZ		(2 * ADMA_DESC_LEN)
+#define CQHCI_TDL_SZ		(CQHCI_NUM_SLOTS * CQHCI_SLOT_SZ)
+#define CQHCI_SLOT_DESCS	DIV_ROUND_UP(MMC_CQE_MAX_TASK_BLKS * \
+					     MMC_MAX_BLOCK_LEN, ADMA_MAX_LEN)
+#define CQHCI_TRANS_SZ		(CQHCI_NUM_SLOTS * CQHCI_SLOT_DESCS * \
+				 ADMA_DESC_LEN)
+#endif
 struct sdhci_host {
 	const char *name;
 	void *ioaddr;
@@ -335,6 +387,11 @@ struct sdhci_host {
 	struct sdhci_adma_desc *adma_desc_table;
 	uint desc_slot;
 #endif
+#if CONFIG_IS_ENABLED(MMC_SDHCI_CQE)
+	void *cqe_base;			/* CQHCI registers, NULL if none */
+	u8 *cqe_tdl;			/* Task descriptor list */
+	u8 *cqe_trans;			/* Per-slot transfer lists */
+#endif
 };
 
 #ifdef CONFIG_MMC_SDHCI_IO_ACCESSORS
@@ -120,4 +120,18 @@ void crc32c_init(uint32_t *crc32c_table, uint32_t pol);
 uint32_t crc32c_cal(uint32_t crc, const char *data, int length,
 		    uint32_t *crc32c_table);
 
+/**
+ * crc32c() - Perform CRC32C (Castagnoli) on a buffer
+ *
+ * This uses the CRC32C instructions of the CPU when it has them, and
+ * slice-by-8 tables otherwise. As with crc32c_cal(), no inversion is done
+ * on the input or result.
+ *
+ * @crc: Previous crc (use ~0 at start for the standard CRC32C)
+ * @data: Data bytes to checksum
+ * @length: Number of bytes to process
+ * @return checksum value
+ */
+uint32_t crc32c(uint32_t crc, const void *data, size_t length);
+
 #endif /* _UBOOT_CRC_H */
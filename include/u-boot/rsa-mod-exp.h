@@ -8,6 +8,14 @@
 
 #include <errno.h>
 #include <image.h>
+#include <u-boot/rsa.h>
+
+#if defined(__SIZEOF_INT128__)
+/* Montgomery multiplication can use 64-bit limbs */
+#define RSA_MONT_64
+#endif
+
+struct rsa_mod_exp_ctx;
 
 /**
  * struct key_prop - holder for a public key properties
@@ -24,6 +32,44 @@ struct key_prop {
 	uint32_t n0inv;		/* -1 / modulus[0] mod 2^32 */
 	int num_bits;		/* Key length in bits */
 	uint32_t exp_len;	/* Exponent length in number of uint8_t */
+	/* Where to keep prepared state for the key between uses, or NULL */
+	struct rsa_mod_exp_ctx **ctxp;
+};
+
+/**
+ * struct rsa_mod_exp_ctx - prepared key for software exponentiation
+ *
+ * This holds a public key in the form used by the Montgomery arithmetic,
+ * together with working storage, so that verifying several signatures with
+ * the same key only sets it up once. It is allocated as a single block by
+ * rsa_mod_exp_ctx_new() and released with free().
+ *
+ * @key:	Key, with modulus and R^2 as little-endian 32-bit word arrays
+ * @wide:	true to use 64-bit limbs. This is set when supported, but may
+ *		be cleared to use the plain 32-bit binary method instead
+ * @exp_bits:	Number of bits in the public exponent
+ * @window:	Maximum number of exponent bits handled per 64-bit
+ *		multiplication
+ * @modulus:	Storage for @key.modulus
+ * @rr:		Storage for @key.rr
+ * @n0inv64:	-1 / modulus mod 2^64
+ * @modulus64:	Modulus as little-endian array of 64-bit limbs
+ * @rr64:	R^2 as little-endian array of 64-bit limbs
+ * @scratch:	Working storage for rsa_mod_exp_ctx()
+ */
+struct rsa_mod_exp_ctx {
+	struct rsa_public_key key;
+	bool wide;
+	int exp_bits;
+	int window;
+	uint32_t modulus[RSA_MAX_KEY_BITS / 32];
+	uint32_t rr[RSA_MAX_KEY_BITS / 32];
+#ifdef RSA_MONT_64
+	uint64_t n0inv64;
+	uint64_t modulus64[RSA_MAX_KEY_BITS / 64];
+	uint64_t rr64[RSA_MAX_KEY_BITS / 64];
+#endif
+	uint64_t scratch[];
 };
 
 /**
@@ -62,6 +108,30 @@ void rsa_free_key_prop(struct key_prop *prop);
 int rsa_mod_exp_sw(const uint8_t *sig, uint32_t sig_len,
 		struct key_prop *node, uint8_t *out);
 
+/**
+ * rsa_mod_exp_ctx_new() - Prepare a key for software exponentiation
+ *
+ * @prop:	Key properties
+ * @ctxp:	Returns the new context, to be freed with free()
+ * @return 0 if OK, -ENOMEM if out of memory, other -ve if the key is invalid
+ */
+int rsa_mod_exp_ctx_new(struct key_prop *prop, struct rsa_mod_exp_ctx **ctxp);
+
+/**
+ * rsa_mod_exp_ctx() - Perform RSA Modular Exponentiation with a prepared key
+ *
+ * Operation: out[] = sig ^ exponent % modulus
+ *
+ * @ctx:	Context from rsa_mod_exp_ctx_new()
+ * @sig:	RSA PKCS1.5 signature
+ * @sig_len:	Length of signature in number of bytes, which must match the
+ *		key length
+ * @out:	Result in form of byte array of len equal to sig_len
+ * @return 0 if OK, -ve on error
+ */
+int rsa_mod_exp_ctx(struct rsa_mod_exp_ctx *ctx, const uint8_t *sig,
+		    uint32_t sig_len, uint8_t *out);
+
 int rsa_mod_exp(struct udevice *dev, const uint8_t *sig, uint32_t sig_len,
 		struct key_prop *node, uint8_t *out);
 
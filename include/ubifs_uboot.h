@@ -14,6 +14,8 @@
 #ifndef __UBIFS_UBOOT_H__
 #define __UBIFS_UBOOT_H__
 
+struct fs_file;
+
 int ubifs_init(void);
 int uboot_ubifs_mount(char *vol_name);
 void uboot_ubifs_umount(void);
@@ -27,5 +29,9 @@ int ubifs_size(const char *filename, loff_t *size);
 int ubifs_read(const char *filename, void *buf, loff_t offset,
 	       loff_t size, loff_t *actread);
 void ubifs_close(void);
+int ubifs_open_file(const char *filename, struct fs_file **filep);
+int ubifs_read_at(struct fs_file *file, void *buf, loff_t offset,
+		  loff_t size, loff_t *actread);
+void ubifs_close_file(struct fs_file *file);
 
 #endif /* __UBIFS_UBOOT_H__ */
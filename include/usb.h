@@ -15,6 +15,7 @@
 #include <usb_defs.h>
 #include <linux/usb/ch9.h>
 #include <asm/cache.h>
+#include <linux/list.h>
 #include <part.h>
 
 /*
@@ -156,6 +157,36 @@ struct usb_device {
 
 struct int_queue;
 
+/**
+ * struct usb_bulk_req - an asynchronous bulk transfer
+ *
+ * Requests are queued with usb_bulk_submit() and completed with
+ * usb_bulk_reap(). Several requests may be outstanding on the same endpoint,
+ * in which case they complete in the order in which they were submitted.
+ *
+ * @pipe:	Bulk pipe to transfer on
+ * @buffer:	Buffer to send/receive. This should be DMA-aligned
+ * @length:	Buffer length in bytes
+ * @act_len:	Number of bytes transferred, valid once @done is set
+ * @status:	USB_ST_... status of the transfer, valid once @done is set
+ * @done:	true once the transfer has completed (or was cancelled)
+ * @hc_node:	Controller private: node in the list of outstanding requests
+ * @hc_priv:	Controller private data
+ * @hc_count:	Controller private data
+ */
+struct usb_bulk_req {
+	unsigned long pipe;
+	void *buffer;
+	int length;
+	int act_len;
+	unsigned long status;
+	bool done;
+
+	struct list_head hc_node;
+	void *hc_priv;
+	int hc_count;
+};
+
 /*
  * You can initialize platform's USB host or device
  * ports by passing this enum as an argument to
@@ -194,6 +225,13 @@ int destroy_int_queue(struct usb_device *dev, struct int_queue *queue);
 void *poll_int_queue(struct usb_device *dev, struct int_queue *queue);
 #endif
 
+#if CONFIG_IS_ENABLED(DM_USB)
+int submit_bulk_req(struct usb_device *dev, struct usb_bulk_req *req);
+int reap_bulk_req(struct usb_device *dev, struct usb_bulk_req *req,
+		  int timeout);
+int cancel_bulk_req(struct usb_device *dev, struct usb_bulk_req *req);
+#endif
+
 /* Defines */
 #define USB_UHCI_VEND_ID	0x8086
 #define USB_UHCI_DEV_ID		0x7112
@@ -269,6 +307,49 @@ int usb_bulk_msg(struct usb_device *dev, unsigned int pipe,
 			void *data, int len, int *actual_length, int timeout);
 int usb_int_msg(struct usb_device *dev, unsigned long pipe,
 		void *buffer, int transfer_len, int interval, bool nonblock);
+
+/**
+ * usb_bulk_submit() - Queue an asynchronous bulk transfer
+ *
+ * The caller must fill in @req->pipe, @req->buffer and @req->length. The
+ * request is handed to the controller and this function returns without
+ * waiting for it to complete. If the controller does not support queueing
+ * bulk transfers, the transfer is carried out synchronously by
+ * usb_bulk_reap() instead, so callers need not care.
+ *
+ * @dev:	USB device to transfer with
+ * @req:	Request to queue. This must stay valid until it is reaped or
+ *		cancelled
+ * @return 0 if OK, -ve on error
+ */
+int usb_bulk_submit(struct usb_device *dev, struct usb_bulk_req *req);
+
+/**
+ * usb_bulk_reap() - Wait for an asynchronous bulk transfer to complete
+ *
+ * Any other requests which completed in the meantime are retired as well, so
+ * reaping several requests in submission order is cheap.
+ *
+ * @dev:	USB device the request was submitted to
+ * @req:	Request to wait for
+ * @timeout:	Timeout in milliseconds
+ * @return 0 if the transfer succeeded, -ETIMEDOUT if it did not complete in
+ * time (it is left queued), -EIO if it failed (see @req->status)
+ */
+int usb_bulk_reap(struct usb_device *dev, struct usb_bulk_req *req,
+		  int timeout);
+
+/**
+ * usb_bulk_cancel() - Cancel an asynchronous bulk transfer
+ *
+ * This cancels @req along with any other requests still outstanding on the
+ * same endpoint. Cancelling a request which already completed does nothing.
+ *
+ * @dev:	USB device the request was submitted to
+ * @req:	Request to cancel
+ * @return 0 if OK, -ve on error
+ */
+int usb_bulk_cancel(struct usb_device *dev, struct usb_bulk_req *req);
 int usb_lock_async(struct usb_device *dev, int lock);
 int usb_disable_asynch(int disable);
 int usb_maxpacket(struct usb_device *dev, unsigned long pipe);
@@ -762,6 +843,43 @@ struct dm_usb_ops {
 	int (*destroy_int_queue)(struct udevice *bus, struct usb_device *udev,
 				 struct int_queue *queue);
 
+	/**
+	 * submit_bulk_req() - Queue an asynchronous bulk transfer
+	 *
+	 * Queue @req on its endpoint and start it, without waiting for it to
+	 * complete. Several requests may be queued on one endpoint.
+	 *
+	 * @req: request to queue
+	 *
+	 * @return 0 if OK, -EBUSY if the endpoint cannot take any more
+	 *	   requests until some are reaped, other -ve on error
+	 */
+	int (*submit_bulk_req)(struct udevice *bus, struct usb_device *udev,
+			       struct usb_bulk_req *req);
+
+	/**
+	 * reap_bulk_req() - Wait for a queued bulk transfer to complete
+	 *
+	 * Retire completed requests, in batches, until @req is done or
+	 * @timeout milliseconds have passed. The result is recorded in
+	 * @req->act_len and @req->status.
+	 *
+	 * @return 0 if @req is done, -ETIMEDOUT if not
+	 */
+	int (*reap_bulk_req)(struct udevice *bus, struct usb_device *udev,
+			     struct usb_bulk_req *req, int timeout);
+
+	/**
+	 * cancel_bulk_req() - Cancel queued bulk transfers
+	 *
+	 * Remove @req and any other request still queued on the same endpoint
+	 * from the controller, marking them done with USB_ST_NOT_PROC.
+	 *
+	 * @return 0 if OK, -ve on error
+	 */
+	int (*cancel_bulk_req)(struct udevice *bus, struct usb_device *udev,
+			       struct usb_bulk_req *req);
+
 	/**
 	 * alloc_device() - Allocate a new device context (XHCI)
 	 *
@@ -0,0 +1,140 @@
+/* SPDX-License-Identifier: GPL-2.0+ */
+/*
+ * USB Attached SCSI (UAS) information units and descriptors
+ *
+ * Based on the USB Attached SCSI Protocol revision 4 (T10/2095-D)
+ */
+
+#ifndef __USB_UAS_H
+#define __USB_UAS_H
+
+#include <linux/types.h>
+
+struct usb_device;
+
+/* Information unit identifiers */
+enum {
+	UAS_IU_ID_COMMAND	= 0x01,
+	UAS_IU_ID_STATUS	= 0x03,
+	UAS_IU_ID_RESPONSE	= 0x04,
+	UAS_IU_ID_TASK_MGMT	= 0x05,
+	UAS_IU_ID_READ_READY	= 0x06,
+	UAS_IU_ID_WRITE_READY	= 0x07,
+};
+
+/* Pipe usage descriptor, following each endpoint of a UAS interface */
+#define USB_DT_PIPE_USAGE	0x24
+
+enum {
+	UAS_PIPE_ID_CMD		= 1,
+	UAS_PIPE_ID_STATUS	= 2,
+	UAS_PIPE_ID_DATA_IN	= 3,
+	UAS_PIPE_ID_DATA_OUT	= 4,
+};
+
+struct __packed usb_pipe_usage_descriptor {
+	u8 bLength;
+	u8 bDescriptorType;
+	u8 bPipeID;
+	u8 reserved;
+};
+
+/* Task attributes of a command IU */
+enum {
+	UAS_TASK_SIMPLE		= 0,
+	UAS_TASK_HEAD_OF_QUEUE	= 1,
+	UAS_TASK_ORDERED	= 2,
+	UAS_TASK_ACA		= 4,
+};
+
+/*
+ * 16-byte READ/WRITE opcodes, used for LBAs beyond 32 bits. These differ from
+ * SCSI_READ16 in scsi.h, which holds a value private to the AHCI driver.
+ */
+#define UAS_SCSI_READ16		0x88
+#define UAS_SCSI_WRITE16	0x8a
+
+#define UAS_MAX_CDB_LEN		16
+#define UAS_MAX_SENSE_LEN	96
+
+/**
+ * struct uas_command_iu - command information unit (host to device)
+ *
+ * @iu_id:	UAS_IU_ID_COMMAND
+ * @tag:	Command tag, unique among commands outstanding on the device
+ * @prio_attr:	Priority (bits 6:3) and task attribute (bits 2:0)
+ * @len:	Additional CDB length in units of 4 bytes, beyond 16 bytes
+ * @lun:	Logical unit number, in SAM-style 8-byte format
+ * @cdb:	SCSI command descriptor block
+ */
+struct __packed uas_command_iu {
+	u8 iu_id;
+	u8 rsvd1;
+	__be16 tag;
+	u8 prio_attr;
+	u8 rsvd5;
+	u8 len;
+	u8 rsvd7;
+	u8 lun[8];
+	u8 cdb[UAS_MAX_CDB_LEN];
+};
+
+/**
+ * struct uas_sense_iu - sense information unit (device to host)
+ *
+ * This completes a command. It is also used as the common header for the
+ * READ READY and WRITE READY IUs, which consist of the first four bytes only.
+ *
+ * @iu_id:	UAS_IU_ID_STATUS, UAS_IU_ID_READ_READY or UAS_IU_ID_WRITE_READY
+ * @tag:	Tag of the command this IU relates to
+ * @status_qual: Status qualifier
+ * @status:	SCSI status byte (0 for GOOD)
+ * @len:	Number of valid bytes in @sense
+ * @sense:	Sense data
+ */
+struct __packed uas_sense_iu {
+	u8 iu_id;
+	u8 rsvd1;
+	__be16 tag;
+	__be16 status_qual;
+	u8 status;
+	u8 rsvd7[7];
+	__be16 len;
+	u8 sense[UAS_MAX_SENSE_LEN];
+};
+
+/* Size of a READ READY / WRITE READY IU */
+#define UAS_READY_IU_LEN	4
+
+/**
+ * struct uas_response_iu - response information unit (device to host)
+ *
+ * Sent in reply to a task management IU, or when a command IU is malformed.
+ *
+ * @iu_id:	UAS_IU_ID_RESPONSE
+ * @tag:	Tag of the IU this responds to
+ * @add_response_info: Additional response information
+ * @response_code: Response code (0 for TASK MANAGEMENT FUNCTION COMPLETE)
+ */
+struct __packed uas_response_iu {
+	u8 iu_id;
+	u8 rsvd1;
+	__be16 tag;
+	u8 add_response_info[3];
+	u8 response_code;
+};
+
+/**
+ * usb_uas_probe_device() - Probe a USB device for UAS support
+ *
+ * This looks for a UAS alternate setting on the device. If one is found it is
+ * selected and a block device is created for LUN 0.
+ *
+ * @udev:	USB device to probe
+ * @devnum:	Block device number to use
+ * @return 0 if OK, -ENODEV if the device cannot be driven via UAS (so that
+ *	the caller can fall back to bulk-only transport), other -ve on error
+ */
+int usb_uas_probe_device(struct usb_device *udev, int devnum);
+
+#endif
@@ -1070,6 +1070,12 @@ struct xhci_virt_ep {
 #define EP_HAS_STREAMS		(1 << 4)
 /* Transitioning the endpoint to not using streams, don't enqueue URBs */
 #define EP_GETTING_NO_STREAMS	(1 << 5)
+	/* Asynchronous bulk requests (struct usb_bulk_req) in flight */
+	struct list_head		bulk_reqs;
+	/* Number of TRBs used by bulk_reqs */
+	int				bulk_trbs;
+	/* Last TRB of a TD that completed early on a short packet */
+	union xhci_trb			*short_trb;
 };
 
 #define CTX_SIZE(_hcc) (HCC_64BYTE_CONTEXT(_hcc) ? 64 : 32)
@@ -1258,6 +1264,10 @@ void xhci_acknowledge_event(struct xhci_ctrl *ctrl);
 union xhci_trb *xhci_wait_for_event(struct xhci_ctrl *ctrl, trb_type expected);
 int xhci_bulk_tx(struct usb_device *udev, unsigned long pipe,
 		 int length, void *buffer);
+int xhci_bulk_submit(struct usb_device *udev, struct usb_bulk_req *req);
+int xhci_bulk_reap(struct usb_device *udev, struct usb_bulk_req *req,
+		   int timeout);
+int xhci_bulk_cancel(struct usb_device *udev, struct usb_bulk_req *req);
 int xhci_ctrl_tx(struct usb_device *udev, unsigned long pipe,
 		 struct devrequest *req, int length, void *buffer);
 int xhci_check_maxpacket(struct usb_device *udev);
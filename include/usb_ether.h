@@ -7,6 +7,10 @@
 #define __USB_ETHER_H__
 
 #include <net.h>
+#include <usb.h>
+
+/* Number of bulk-in transfers kept queued to receive packets */
+#define USB_ETHER_RX_QUEUE	4
 
 /* TODO(sjg@chromium.org): Remove @pusb_dev when all boards use CONFIG_DM_ETH */
 struct ueth_data {
@@ -16,6 +20,10 @@ struct ueth_data {
 	int rxsize;
 	int rxlen;			/* Total bytes available in rxbuf */
 	int rxptr;			/* Current position in rxbuf */
+	uint8_t *rxbufs;		/* One buffer for each rxreq */
+	struct usb_bulk_req rxreq[USB_ETHER_RX_QUEUE];
+	int rxhead;			/* Oldest queued rxreq */
+	int rxqueued;			/* Number of queued rxreqs */
 #else
 	struct eth_device eth_dev;	/* used with eth_register */
 	/* driver private */
@@ -58,7 +66,9 @@ int usb_ether_deregister(struct ueth_data *ueth);
 /**
  * usb_ether_receive() - recieve a packet from the bulk in endpoint
  *
- * The packet is stored in the internal buffer ready for processing.
+ * The packet is stored in the internal buffer ready for processing. Up to
+ * USB_ETHER_RX_QUEUE transfers are kept queued on the endpoint, so packets
+ * arriving while the previous one is processed are not lost.
  *
  * @ueth:	USB Ethernet device
  * @rxsize:	Maximum size to receive
@@ -0,0 +1,97 @@
+/* SPDX-License-Identifier: GPL-2.0+ */
+/*
+ * Zstandard decompression with a shared workspace
+ */
+
+#ifndef __ZSTD_H
+#define __ZSTD_H
+
+#include <linux/zstd.h>
+
+/* Largest window accepted by zstd_stream_init() */
+#define ZSTD_WINDOW_MAX		(1UL << CONFIG_ZSTD_WINDOW_LOG_MAX)
+
+/**
+ * struct zstd_stream - state of a streaming zstd decoder
+ *
+ * Frames are decoded through a window buffer, so the memory used is bounded
+ * by the window size given to zstd_stream_init() rather than by the size of
+ * the data. A frame which is passed whole, has its content size and fits in
+ * the output is decoded straight into the output instead.
+ *
+ * All fields are private to the decoder.
+ *
+ * @ds:		decoder, in @workspace
+ * @workspace:	memory used by the decoder
+ * @shared:	@workspace is the shared workspace, which must be released
+ *		rather than freed
+ */
+struct zstd_stream {
+	ZSTD_DStream *ds;
+	void *workspace;
+	bool shared;
+};
+
+/**
+ * zstd_stream_init() - set up to decompress zstd frames
+ *
+ * A workspace is kept between streams, so that decompressing many small
+ * frames (e.g. filesystem extents) does not allocate each time. It is only
+ * reallocated when a larger window is needed. A stream set up while the
+ * shared workspace is in use gets its own.
+ *
+ * @zs: Decoder state to set up
+ * @max_window: Largest window size to accept, or 0 for ZSTD_WINDOW_MAX.
+ *	Frames with a larger window are rejected with -EFBIG.
+ * @return 0 if OK, -E2BIG if @max_window is larger than ZSTD_WINDOW_MAX,
+ *	-ENOMEM if there is not enough memory for the workspace
+ */
+int zstd_stream_init(struct zstd_stream *zs, size_t max_window);
+
+/**
+ * zstd_stream_decompress() - decompress the next piece of zstd data
+ *
+ * Input and output may be passed in pieces of any size. Once a frame is
+ * complete, any further input starts a new frame.
+ *
+ * @zs: Decoder state
+ * @src: Next piece of the compressed data
+ * @srcn: Length of @src, updated to the number of bytes used
+ * @dst: Space for the next piece of uncompressed data
+ * @dstn: Size of @dst, updated to the number of bytes written
+ * @return 1 if the end of a frame has been reached, 0 if more input or
+ *	output space is needed, or a -ve error number as for
+ *	zstd_decompress()
+ */
+int zstd_stream_decompress(struct zstd_stream *zs, const void *src,
+			   size_t *srcn, void *dst, size_t *dstn);
+
+/**
+ * zstd_stream_finish() - finish decompressing zstd data
+ *
+ * This must be called once decompression is done, whether it succeeded or
+ * not, to release the workspace.
+ *
+ * @zs: Decoder state
+ */
+void zstd_stream_finish(struct zstd_stream *zs);
+
+/**
+ * zstd_decompress() - Decompress zstd data
+ *
+ * All the frames in @src are decoded directly into @dst, using a
+ * decompression context which is set up once and then reused.
+ *
+ * @src: Source data to decompress
+ * @srcn: Length of source data
+ * @dst: Destination for uncompressed data
+ * @dstn: Size of @dst, updated to the length of the uncompressed data
+ * @return 0 if OK, -ENOBUFS if the destination buffer is overrun, -EBADMSG
+ *	if a checksum does not match, -EFBIG if the window is too large,
+ *	-ENOMEM if there is not enough memory, -EPROTONOSUPPORT if the data is
+ *	not zstd or uses an unsupported feature, -EINVAL if the input is
+ *	overrun and -EPROTO for other errors in the compressed data
+ */
+int zstd_decompress(const void *src, size_t srcn, void *dst, size_t *dstn);
+
+#endif
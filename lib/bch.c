@@ -85,6 +85,7 @@
 #define kzalloc(size, flags)	calloc(1, size)
 #define kfree free
 #define ARRAY_SIZE(arr) (sizeof(arr) / sizeof((arr)[0]))
+#define BITS_PER_LONG (__SIZEOF_LONG__ * 8)
 #endif
 
 #include <asm/byteorder.h>
@@ -103,6 +104,16 @@
 #define BCH_ECC_WORDS(_p)      DIV_ROUND_UP(GF_M(_p)*GF_T(_p), 32)
 #define BCH_ECC_BYTES(_p)      DIV_ROUND_UP(GF_M(_p)*GF_T(_p), 8)
 
+/*
+ * number of remainder lookup tables: 64-bit machines encode 8 data bytes per
+ * step, which halves the number of passes over the ecc words
+ */
+#if BITS_PER_LONG == 64
+#define BCH_MOD8_TABLES        8
+#else
+#define BCH_MOD8_TABLES        4
+#endif
+
 #ifndef dbg
 #define dbg(_fmt, args...)     do {} while (0)
 #endif
@@ -242,6 +253,14 @@ void encode_bch(struct bch_control *bch, const uint8_t *data,
 	const uint32_t * const tab2 = tab1 + 256*(l+1);
 	const uint32_t * const tab3 = tab2 + 256*(l+1);
 	const uint32_t *pdata, *p0, *p1, *p2, *p3;
+#if BCH_MOD8_TABLES == 8
+	uint32_t w2;
+	const uint32_t * const tab4 = tab3 + 256*(l+1);
+	const uint32_t * const tab5 = tab4 + 256*(l+1);
+	const uint32_t * const tab6 = tab5 + 256*(l+1);
+	const uint32_t * const tab7 = tab6 + 256*(l+1);
+	const uint32_t *p4, *p5, *p6, *p7;
+#endif
 
 	if (ecc) {
 		/* load ecc parity bytes into internal 32-bit buffer */
@@ -277,6 +296,32 @@ void encode_bch(struct bch_control *bch, const uint8_t *data,
 	 * xxxxxxxx  00000000  00000000  00000000  mod g = r3 (precomputed)
 	 * xxxxxxxx  yyyyyyyy  zzzzzzzz  tttttttt  mod g = r0^r1^r2^r3
 	 */
+#if BCH_MOD8_TABLES == 8
+	/*
+	 * same with two words at a time: bytes of the first word are 32 bits
+	 * further from the end of the step and use tables r4..r7
+	 */
+	for (; mlen >= 2; mlen -= 2) {
+		w  = r[0]^cpu_to_be32(pdata[0]);
+		w2 = (l ? r[1] : 0)^cpu_to_be32(pdata[1]);
+		pdata += 2;
+		p0 = tab0 + (l+1)*((w2 >>  0) & 0xff);
+		p1 = tab1 + (l+1)*((w2 >>  8) & 0xff);
+		p2 = tab2 + (l+1)*((w2 >> 16) & 0xff);
+		p3 = tab3 + (l+1)*((w2 >> 24) & 0xff);
+		p4 = tab4 + (l+1)*((w >>  0) & 0xff);
+		p5 = tab5 + (l+1)*((w >>  8) & 0xff);
+		p6 = tab6 + (l+1)*((w >> 16) & 0xff);
+		p7 = tab7 + (l+1)*((w >> 24) & 0xff);
+
+		for (i = 0; i+2 <= l; i++)
+			r[i] = r[i+2]^p0[i]^p1[i]^p2[i]^p3[i]^
+				p4[i]^p5[i]^p6[i]^p7[i];
+
+		for (; i <= l; i++)
+			r[i] = p0[i]^p1[i]^p2[i]^p3[i]^p4[i]^p5[i]^p6[i]^p7[i];
+	}
+#endif
 	while (mlen--) {
 		/* input data is read in big-endian format */
 		w = r[0]^cpu_to_be32(*pdata++);
@@ -1044,6 +1089,11 @@ int decode_bch(struct bch_control *bch, const uint8_t *data, unsigned int len,
 	if (8*len > (bch->n-bch->ecc_bits))
 		return -EINVAL;
 
+	/* clean page: received ecc matches calculated ecc, nothing to do */
+	if (!syn && calc_ecc && recv_ecc &&
+	    !memcmp(recv_ecc, calc_ecc, bch->ecc_bytes))
+		return 0;
+
 	/* if caller does not provide syndromes, compute them */
 	if (!syn) {
 		if (!calc_ecc) {
@@ -1059,14 +1109,14 @@ int decode_bch(struct bch_control *bch, const uint8_t *data, unsigned int len,
 		if (recv_ecc) {
 			load_ecc8(bch, bch->ecc_buf2, recv_ecc);
 			/* XOR received and calculated ecc */
-			for (i = 0, sum = 0; i < (int)ecc_words; i++) {
+			for (i = 0; i < (int)ecc_words; i++)
 				bch->ecc_buf[i] ^= bch->ecc_buf2[i];
-				sum |= bch->ecc_buf[i];
-			}
-			if (!sum)
-				/* no error found */
-				return 0;
 		}
+		for (i = 0, sum = 0; i < (int)ecc_words; i++)
+			sum |= bch->ecc_buf[i];
+		if (!sum)
+			/* no error found, all syndromes would be zero */
+			return 0;
 		compute_syndromes(bch, bch->ecc_buf, bch->syn);
 		syn = bch->syn;
 	}
@@ -1127,11 +1177,12 @@ static void build_mod8_tables(struct bch_control *bch, const uint32_t *g)
 {
 	int i, j, b, d;
 	uint32_t data, hi, lo, *tab;
+	const uint32_t *src, *p;
 	const int l = BCH_ECC_WORDS(bch);
 	const int plen = DIV_ROUND_UP(bch->ecc_bits+1, 32);
 	const int ecclen = DIV_ROUND_UP(bch->ecc_bits, 32);
 
-	memset(bch->mod8_tab, 0, 4*256*l*sizeof(*bch->mod8_tab));
+	memset(bch->mod8_tab, 0, BCH_MOD8_TABLES*256*l*sizeof(*bch->mod8_tab));
 
 	for (i = 0; i < 256; i++) {
 		/* p(X)=i is a small polynomial of weight <= 8 */
@@ -1152,6 +1203,25 @@ static void build_mod8_tables(struct bch_control *bch, const uint32_t *g)
 			}
 		}
 	}
+
+	/*
+	 * remaining tables hold the same remainders multiplied by X^32 mod g,
+	 * obtained by shifting each entry through one step of zero data
+	 */
+	for (b = 4; b < BCH_MOD8_TABLES; b++) {
+		for (i = 0; i < 256; i++) {
+			src = bch->mod8_tab + ((b-4)*256+i)*l;
+			tab = bch->mod8_tab + (b*256+i)*l;
+			for (d = 0; d < 4; d++) {
+				data = (src[0] >> (8*d)) & 0xff;
+				p = bch->mod8_tab + (d*256+data)*l;
+				for (j = 0; j < l; j++)
+					tab[j] ^= p[j];
+			}
+			for (j = 0; j+1 < l; j++)
+				tab[j] ^= src[j+1];
+		}
+	}
 }
 
 /*
@@ -1345,7 +1415,8 @@ struct bch_control *init_bch(int m, int t, unsigned int prim_poly)
 	bch->ecc_bytes = DIV_ROUND_UP(m*t, 8);
 	bch->a_pow_tab = bch_alloc((1+bch->n)*sizeof(*bch->a_pow_tab), &err);
 	bch->a_log_tab = bch_alloc((1+bch->n)*sizeof(*bch->a_log_tab), &err);
-	bch->mod8_tab  = bch_alloc(words*1024*sizeof(*bch->mod8_tab), &err);
+	bch->mod8_tab  = bch_alloc(words*BCH_MOD8_TABLES*256*
+				   sizeof(*bch->mod8_tab), &err);
 	bch->ecc_buf   = bch_alloc(words*sizeof(*bch->ecc_buf), &err);
 	bch->ecc_buf2  = bch_alloc(words*sizeof(*bch->ecc_buf2), &err);
 	bch->xi_tab    = bch_alloc(m*sizeof(*bch->xi_tab), &err);
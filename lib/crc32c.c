@@ -12,6 +12,7 @@
 
 #include <common.h>
 #include <compiler.h>
+#include <asm/unaligned.h>
 
 uint32_t crc32c_cal(uint32_t crc, const char *data, int length,
 		    uint32_t *crc32c_table)
@@ -36,3 +37,138 @@ void crc32c_init(uint32_t *crc32c_table, uint32_t pol)
 		crc32c_table[i] = v;
 	}
 }
+
+#define CRC32C_POLY	0x82F63B78
+
+/*
+ * Slice-by-8 tables: crc32c_tables[0] is the usual byte table and
+ * crc32c_tables[k][i] is the CRC of byte i followed by k zero bytes, so that
+ * eight bytes can be folded in with eight independent lookups.
+ */
+static uint32_t crc32c_tables[8][256];
+static bool crc32c_inited;
+/* Set when the CPU has CRC32C instructions */
+static bool crc32c_use_hw;
+
+#if defined(__x86_64__) || defined(__i386__)
+/* The crc32 instruction comes with SSE4.2 */
+static bool crc32c_hw_probe(void)
+{
+	uint32_t eax = 1, ebx, ecx = 0, edx;
+
+	asm volatile("cpuid" : "+a" (eax), "=b" (ebx), "+c" (ecx), "=d" (edx));
+
+	return ecx & (1 << 20);
+}
+
+static uint32_t crc32c_hw(uint32_t crc, const u8 *p, size_t length)
+{
+#ifdef __x86_64__
+	unsigned long c = crc;
+	u64 v;
+
+	for (; length >= 8; length -= 8, p += 8) {
+		v = get_unaligned((u64 *)p);
+		asm("crc32q %1, %0" : "+r" (c) : "rm" (v));
+	}
+	crc = c;
+#endif
+	for (; length >= 4; length -= 4, p += 4) {
+		u32 w = get_unaligned((u32 *)p);
+
+		asm("crc32l %1, %0" : "+r" (crc) : "rm" (w));
+	}
+	while (length--)
+		asm("crc32b %1, %0" : "+r" (crc) : "rm" (*p++));
+
+	return crc;
+}
+#elif defined(__aarch64__)
+/* The CRC32 instructions are optional before ARMv8.1 */
+static bool crc32c_hw_probe(void)
+{
+	u64 isar0;
+
+	asm("mrs %0, id_aa64isar0_el1" : "=r" (isar0));
+
+	return (isar0 >> 16) & 0xf;
+}
+
+static uint32_t crc32c_hw(uint32_t crc, const u8 *p, size_t length)
+{
+	for (; length >= 8; length -= 8, p += 8)
+		asm(".arch_extension crc\n"
+		    "crc32cx %w0, %w0, %x1" : "+r" (crc)
+		    : "r" (get_unaligned((u64 *)p)));
+	if (length >= 4) {
+		asm(".arch_extension crc\n"
+		    "crc32cw %w0, %w0, %w1" : "+r" (crc)
+		    : "r" (get_unaligned((u32 *)p)));
+		length -= 4;
+		p += 4;
+	}
+	while (length--)
+		asm(".arch_extension crc\n"
+		    "crc32cb %w0, %w0, %w1" : "+r" (crc) : "r" (*p++));
+
+	return crc;
+}
+#else
+static bool crc32c_hw_probe(void)
+{
+	return false;
+}
+
+static uint32_t crc32c_hw(uint32_t crc, const u8 *p, size_t length)
+{
+	return crc;
+}
+#endif
+
+static void crc32c_setup(void)
+{
+	uint32_t (*t)[256] = crc32c_tables;
+	int i, k;
+
+	crc32c_init(t[0], CRC32C_POLY);
+	for (i = 0; i < 256; i++) {
+		for (k = 1; k < 8; k++)
+			t[k][i] = (t[k - 1][i] >> 8) ^ t[0][t[k - 1][i] & 0xff];
+	}
+	crc32c_use_hw = crc32c_hw_probe();
+	crc32c_inited = true;
+}
+
+static uint32_t crc32c_sw(uint32_t crc, const u8 *p, size_t length)
+{
+	uint32_t (*t)[256] = crc32c_tables;
+	uint32_t lo, hi;
+
+	for (; length && ((uintptr_t)p & 3); length--)
+		crc = t[0][(u8)(crc ^ *p++)] ^ (crc >> 8);
+
+	for (; length >= 8; length -= 8, p += 8) {
+		lo = crc ^ le32_to_cpu(*(u32 *)p);
+		hi = le32_to_cpu(*(u32 *)(p + 4));
+		crc = t[7][lo & 0xff] ^ t[6][(lo >> 8) & 0xff] ^
+		      t[5][(lo >> 16) & 0xff] ^ t[4][lo >> 24] ^
+		      t[3][hi & 0xff] ^ t[2][(hi >> 8) & 0xff] ^
+		      t[1][(hi >> 16) & 0xff] ^ t[0][hi >> 24];
+	}
+
+	while (length--)
+		crc = t[0][(u8)(crc ^ *p++)] ^ (crc >> 8);
+
+	return crc;
+}
+
+uint32_t crc32c(uint32_t crc, const void *data, size_t length)
+{
+	if (!crc32c_inited)
+		crc32c_setup();
+
+	if (crc32c_use_hw)
+		return crc32c_hw(crc, data, length);
+
+	return crc32c_sw(crc, data, length);
+}
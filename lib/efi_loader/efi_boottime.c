@@ -6,6 +6,7 @@
  */
 
 #include <common.h>
+#include <blk.h>
 #include <div64.h>
 #include <efi_loader.h>
 #include <irq_func.h>
@@ -1987,6 +1988,9 @@ static efi_status_t EFIAPI efi_exit_boot_services(efi_handle_t image_handle,
 			list_del(&evt->link);
 	}
 
+	/* The OS takes over the disks, write back the cached blocks */
+	blk_flush_all();
+
 	board_quiesce_devices();
 
 	/* Patch out unsupported runtime function */
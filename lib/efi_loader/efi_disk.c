@@ -16,12 +16,14 @@
 struct efi_system_partition efi_system_partition;
 
 const efi_guid_t efi_block_io_guid = EFI_BLOCK_IO_PROTOCOL_GUID;
+const efi_guid_t efi_block_io2_guid = EFI_BLOCK_IO2_PROTOCOL_GUID;
 
 /**
  * struct efi_disk_obj - EFI disk object
  *
  * @header:	EFI object header
  * @ops:	EFI disk I/O protocol interface
+ * @ops2:	EFI disk I/O 2 protocol interface
  * @ifname:	interface name for block device
  * @dev_index:	device index of block device
  * @media:	block I/O media information
@@ -30,10 +32,14 @@ const efi_guid_t efi_block_io_guid = EFI_BLOCK_IO_PROTOCOL_GUID;
  * @volume:	simple file system protocol of the partition
  * @offset:	offset into disk for simple partition
  * @desc:	internal block device descriptor
+ * @requests:	outstanding EFI_BLOCK_IO2_PROTOCOL requests, in the order
+ *		they were made
+ * @busy_link:	link in the list of disks polled for completions
  */
 struct efi_disk_obj {
 	struct efi_object header;
 	struct efi_block_io ops;
+	struct efi_block_io2 ops2;
 	const char *ifname;
 	int dev_index;
 	struct efi_block_io_media media;
@@ -42,8 +48,33 @@ struct efi_disk_obj {
 	struct efi_simple_file_system_protocol *volume;
 	lbaint_t offset;
 	struct blk_desc *desc;
+	struct list_head requests;
+	struct list_head busy_link;
 };
 
+/**
+ * struct efi_disk_request - request made via the EFI_BLOCK_IO2_PROTOCOL
+ *
+ * @link:	link in the list of requests of the disk
+ * @blk:	block device request, not used for a flush
+ * @diskobj:	disk the request was made on
+ * @token:	token to complete
+ * @flush:	FlushBlocksEx() request
+ */
+struct efi_disk_request {
+	struct list_head link;
+	struct blk_request blk;
+	struct efi_disk_obj *diskobj;
+	struct efi_block_io2_token *token;
+	bool flush;
+};
+
+/* Disks with outstanding requests */
+static LIST_HEAD(efi_disk_busy);
+
+/* Timer event used to poll the disks in efi_disk_busy */
+static struct efi_event *efi_disk_poll_event;
+
 /**
  * efi_disk_reset() - reset block device
  *
@@ -71,6 +102,39 @@ enum efi_disk_direction {
 	EFI_DISK_WRITE,
 };
 
+/**
+ * efi_disk_check_rw() - check the parameters of a read or write
+ *
+ * @this:		pointer to the BLOCK_IO_PROTOCOL
+ * @media_id:		id of the medium to be accessed
+ * @lba:		starting logical block
+ * @buffer_size:	size of the buffer
+ * @buffer:		pointer to the buffer
+ * @direction:		read or write
+ * Return:		status code
+ */
+static efi_status_t efi_disk_check_rw(struct efi_block_io *this, u32 media_id,
+				      u64 lba, efi_uintn_t buffer_size,
+				      void *buffer,
+				      enum efi_disk_direction direction)
+{
+	if (direction == EFI_DISK_WRITE && this->media->read_only)
+		return EFI_WRITE_PROTECTED;
+	/* TODO: check for media changes */
+	if (media_id != this->media->media_id)
+		return EFI_MEDIA_CHANGED;
+	if (!this->media->media_present)
+		return EFI_NO_MEDIA;
+	/* media->io_align is a power of 2 */
+	if ((uintptr_t)buffer & (this->media->io_align - 1))
+		return EFI_INVALID_PARAMETER;
+	if (lba * this->media->block_size + buffer_size >
+	    this->media->last_block * this->media->block_size)
+		return EFI_INVALID_PARAMETER;
+
+	return EFI_SUCCESS;
+}
+
 static efi_status_t efi_disk_rw_blocks(struct efi_block_io *this,
 			u32 media_id, u64 lba, unsigned long buffer_size,
 			void *buffer, enum efi_disk_direction direction)
@@ -134,17 +198,10 @@ static efi_status_t EFIAPI efi_disk_read_blocks(struct efi_block_io *this,
 
 	if (!this)
 		return EFI_INVALID_PARAMETER;
-	/* TODO: check for media changes */
-	if (media_id != this->media->media_id)
-		return EFI_MEDIA_CHANGED;
-	if (!this->media->media_present)
-		return EFI_NO_MEDIA;
-	/* media->io_align is a power of 2 */
-	if ((uintptr_t)buffer & (this->media->io_align - 1))
-		return EFI_INVALID_PARAMETER;
-	if (lba * this->media->block_size + buffer_size >
-	    this->media->last_block * this->media->block_size)
-		return EFI_INVALID_PARAMETER;
+	r = efi_disk_check_rw(this, media_id, lba, buffer_size, buffer,
+			      EFI_DISK_READ);
+	if (r != EFI_SUCCESS)
+		return r;
 
 #ifdef CONFIG_EFI_LOADER_BOUNCE_BUFFER
 	if (buffer_size > EFI_LOADER_BOUNCE_BUFFER_SIZE) {
@@ -199,19 +256,10 @@ static efi_status_t EFIAPI efi_disk_write_blocks(struct efi_block_io *this,
 
 	if (!this)
 		return EFI_INVALID_PARAMETER;
-	if (this->media->read_only)
-		return EFI_WRITE_PROTECTED;
-	/* TODO: check for media changes */
-	if (media_id != this->media->media_id)
-		return EFI_MEDIA_CHANGED;
-	if (!this->media->media_present)
-		return EFI_NO_MEDIA;
-	/* media->io_align is a power of 2 */
-	if ((uintptr_t)buffer & (this->media->io_align - 1))
-		return EFI_INVALID_PARAMETER;
-	if (lba * this->media->block_size + buffer_size >
-	    this->media->last_block * this->media->block_size)
-		return EFI_INVALID_PARAMETER;
+	r = efi_disk_check_rw(this, media_id, lba, buffer_size, buffer,
+			      EFI_DISK_WRITE);
+	if (r != EFI_SUCCESS)
+		return r;
 
 #ifdef CONFIG_EFI_LOADER_BOUNCE_BUFFER
 	if (buffer_size > EFI_LOADER_BOUNCE_BUFFER_SIZE) {
@@ -247,7 +295,7 @@ static efi_status_t EFIAPI efi_disk_write_blocks(struct efi_block_io *this,
  * This function implements the FlushBlocks service of the
  * EFI_BLOCK_IO_PROTOCOL.
  *
- * As we always write synchronously nothing is done here.
+ * Blocks held in the write-back cache of the block device are written.
  *
  * See the Unified Extensible Firmware Interface (UEFI) specification for
  * details.
@@ -257,7 +305,14 @@ static efi_status_t EFIAPI efi_disk_write_blocks(struct efi_block_io *this,
  */
 static efi_status_t EFIAPI efi_disk_flush_blocks(struct efi_block_io *this)
 {
+	struct efi_disk_obj *diskobj;
+
 	EFI_ENTRY("%p", this);
+
+	diskobj = container_of(this, struct efi_disk_obj, ops);
+	if (blk_flush(diskobj->desc))
+		return EFI_EXIT(EFI_DEVICE_ERROR);
+
 	return EFI_EXIT(EFI_SUCCESS);
 }
 
@@ -268,6 +323,367 @@ static const struct efi_block_io block_io_disk_template = {
 	.flush_blocks = &efi_disk_flush_blocks,
 };
 
+/**
+ * efi_disk_signal() - complete the token of a request and free it
+ *
+ * @req:	request
+ * @status:	transaction status
+ */
+static void efi_disk_signal(struct efi_disk_request *req, efi_status_t status)
+{
+	req->token->transaction_status = status;
+	efi_signal_event(req->token->event);
+	free(req);
+}
+
+/**
+ * efi_disk_complete() - complete an EFI_BLOCK_IO2_PROTOCOL request
+ *
+ * Flushes waiting for the request are completed too.
+ *
+ * @req:	request
+ * @status:	transaction status
+ */
+static void efi_disk_complete(struct efi_disk_request *req,
+			      efi_status_t status)
+{
+	struct efi_disk_obj *diskobj = req->diskobj;
+
+	list_del(&req->link);
+	efi_disk_signal(req, status);
+
+	/* A flush is done once all requests made before it are */
+	while (!list_empty(&diskobj->requests)) {
+		req = list_first_entry(&diskobj->requests,
+				       struct efi_disk_request, link);
+		if (!req->flush)
+			break;
+		list_del(&req->link);
+		efi_disk_signal(req, EFI_SUCCESS);
+	}
+}
+
+/**
+ * efi_disk_blk_complete() - completion callback of block device requests
+ *
+ * @blk:	block device request
+ */
+static void efi_disk_blk_complete(struct blk_request *blk)
+{
+	struct efi_disk_request *req = blk->priv;
+
+	efi_disk_complete(req, blk->result == blk->blkcnt ?
+			  EFI_SUCCESS : EFI_DEVICE_ERROR);
+}
+
+/**
+ * efi_disk_poll_notify() - notification function of the disk poll timer
+ *
+ * Block devices do not interrupt us, so their outstanding requests are
+ * completed from a timer event. The timer is stopped once all requests have
+ * completed.
+ *
+ * @event:	timer event
+ * @context:	not used
+ */
+static void EFIAPI efi_disk_poll_notify(struct efi_event *event,
+					void *context)
+{
+	struct efi_disk_obj *diskobj, *next;
+
+	EFI_ENTRY("%p, %p", event, context);
+
+	list_for_each_entry(diskobj, &efi_disk_busy, busy_link)
+		blk_dpoll(diskobj->desc);
+
+	list_for_each_entry_safe(diskobj, next, &efi_disk_busy, busy_link) {
+		if (list_empty(&diskobj->requests))
+			list_del_init(&diskobj->busy_link);
+	}
+	if (list_empty(&efi_disk_busy))
+		efi_set_timer(efi_disk_poll_event, EFI_TIMER_STOP, 0);
+
+	EFI_EXIT(EFI_SUCCESS);
+}
+
+/**
+ * efi_disk_queue() - add a request to the outstanding ones of a disk
+ *
+ * Start polling the disk for completions if this is the first request.
+ *
+ * @diskobj:	disk object
+ * @req:	request
+ * Return:	status code
+ */
+static efi_status_t efi_disk_queue(struct efi_disk_obj *diskobj,
+				   struct efi_disk_request *req)
+{
+	efi_status_t ret;
+
+	if (!efi_disk_poll_event) {
+		ret = efi_create_event(EVT_TIMER | EVT_NOTIFY_SIGNAL,
+				       TPL_CALLBACK, efi_disk_poll_notify,
+				       NULL, NULL, &efi_disk_poll_event);
+		if (ret != EFI_SUCCESS)
+			return ret;
+	}
+	if (list_empty(&efi_disk_busy)) {
+		/* Poll whenever events are checked */
+		ret = efi_set_timer(efi_disk_poll_event, EFI_TIMER_PERIODIC, 0);
+		if (ret != EFI_SUCCESS)
+			return ret;
+	}
+	if (list_empty(&diskobj->busy_link))
+		list_add_tail(&diskobj->busy_link, &efi_disk_busy);
+
+	req->diskobj = diskobj;
+	list_add_tail(&req->link, &diskobj->requests);
+
+	return EFI_SUCCESS;
+}
+
+/**
+ * efi_disk_rw_blocks_ex() - read or write blocks asynchronously
+ *
+ * Without an event in the token the request is carried out synchronously
+ * via the EFI_BLOCK_IO_PROTOCOL. The same is done if a bounce buffer is
+ * needed, as that is shared by all requests.
+ *
+ * @this:		pointer to the BLOCK_IO2_PROTOCOL
+ * @media_id:		id of the medium to be accessed
+ * @lba:		starting logical block
+ * @token:		token signalled on completion, may be NULL
+ * @buffer_size:	size of the buffer
+ * @buffer:		pointer to the buffer
+ * @direction:		read or write
+ * Return:		status code
+ */
+static efi_status_t efi_disk_rw_blocks_ex(struct efi_block_io2 *this,
+					  u32 media_id, u64 lba,
+					  struct efi_block_io2_token *token,
+					  efi_uintn_t buffer_size, void *buffer,
+					  enum efi_disk_direction direction)
+{
+	struct efi_disk_obj *diskobj;
+	struct efi_disk_request *req;
+	efi_status_t ret;
+
+	if (!this)
+		return EFI_INVALID_PARAMETER;
+	diskobj = container_of(this, struct efi_disk_obj, ops2);
+
+	if (!token || !token->event ||
+	    IS_ENABLED(CONFIG_EFI_LOADER_BOUNCE_BUFFER)) {
+		if (direction == EFI_DISK_READ)
+			ret = EFI_CALL(efi_disk_read_blocks(&diskobj->ops,
+							    media_id, lba,
+							    buffer_size,
+							    buffer));
+		else
+			ret = EFI_CALL(efi_disk_write_blocks(&diskobj->ops,
+							     media_id, lba,
+							     buffer_size,
+							     buffer));
+		if (ret == EFI_SUCCESS && token && token->event) {
+			token->transaction_status = EFI_SUCCESS;
+			efi_signal_event(token->event);
+		}
+		return ret;
+	}
+
+	ret = efi_disk_check_rw(&diskobj->ops, media_id, lba, buffer_size,
+				buffer, direction);
+	if (ret != EFI_SUCCESS)
+		return ret;
+	if (buffer_size & (diskobj->media.block_size - 1))
+		return EFI_BAD_BUFFER_SIZE;
+
+	req = calloc(1, sizeof(*req));
+	if (!req)
+		return EFI_OUT_OF_RESOURCES;
+	req->token = token;
+	ret = efi_disk_queue(diskobj, req);
+	if (ret != EFI_SUCCESS) {
+		free(req);
+		return ret;
+	}
+	if (!buffer_size) {
+		efi_disk_complete(req, EFI_SUCCESS);
+		return EFI_SUCCESS;
+	}
+
+	req->blk.start = lba + diskobj->offset;
+	req->blk.blkcnt = buffer_size / diskobj->media.block_size;
+	req->blk.buffer = buffer;
+	req->blk.write = direction == EFI_DISK_WRITE;
+	req->blk.complete = efi_disk_blk_complete;
+	req->blk.priv = req;
+
+	EFI_PRINT("blocks=%lx lba=%llx dir=%d\n", (ulong)req->blk.blkcnt,
+		  lba, direction);
+
+	/* The request may already have been completed when this returns */
+	if (blk_dsubmit(diskobj->desc, &req->blk)) {
+		list_del(&req->link);
+		free(req);
+		return EFI_DEVICE_ERROR;
+	}
+
+	return EFI_SUCCESS;
+}
+
+/**
+ * efi_disk_reset_ex() - reset block device
+ *
+ * This function implements the Reset service of the EFI_BLOCK_IO2_PROTOCOL.
+ *
+ * See the Unified Extensible Firmware Interface (UEFI) specification for
+ * details.
+ *
+ * @this:			pointer to the BLOCK_IO2_PROTOCOL
+ * @extended_verification:	extended verification
+ * Return:			status code
+ */
+static efi_status_t EFIAPI efi_disk_reset_ex(struct efi_block_io2 *this,
+					     char extended_verification)
+{
+	EFI_ENTRY("%p, %x", this, extended_verification);
+	return EFI_EXIT(EFI_SUCCESS);
+}
+
+/**
+ * efi_disk_read_blocks_ex() - reads blocks from device
+ *
+ * This function implements the ReadBlocksEx service of the
+ * EFI_BLOCK_IO2_PROTOCOL.
+ *
+ * See the Unified Extensible Firmware Interface (UEFI) specification for
+ * details.
+ *
+ * @this:			pointer to the BLOCK_IO2_PROTOCOL
+ * @media_id:			id of the medium to be read from
+ * @lba:			starting logical block for reading
+ * @token:			token signalled on completion, may be NULL
+ * @buffer_size:		size of the read buffer
+ * @buffer:			pointer to the destination buffer
+ * Return:			status code
+ */
+static efi_status_t EFIAPI efi_disk_read_blocks_ex(
+			struct efi_block_io2 *this, u32 media_id, u64 lba,
+			struct efi_block_io2_token *token,
+			efi_uintn_t buffer_size, void *buffer)
+{
+	EFI_ENTRY("%p, %x, %llx, %p, %zx, %p", this, media_id, lba, token,
+		  buffer_size, buffer);
+
+	return EFI_EXIT(efi_disk_rw_blocks_ex(this, media_id, lba, token,
+					      buffer_size, buffer,
+					      EFI_DISK_READ));
+}
+
+/**
+ * efi_disk_write_blocks_ex() - writes blocks to device
+ *
+ * This function implements the WriteBlocksEx service of the
+ * EFI_BLOCK_IO2_PROTOCOL.
+ *
+ * See the Unified Extensible Firmware Interface (UEFI) specification for
+ * details.
+ *
+ * @this:			pointer to the BLOCK_IO2_PROTOCOL
+ * @media_id:			id of the medium to be written to
+ * @lba:			starting logical block for writing
+ * @token:			token signalled on completion, may be NULL
+ * @buffer_size:		size of the write buffer
+ * @buffer:			pointer to the source buffer
+ * Return:			status code
+ */
+static efi_status_t EFIAPI efi_disk_write_blocks_ex(
+			struct efi_block_io2 *this, u32 media_id, u64 lba,
+			struct efi_block_io2_token *token,
+			efi_uintn_t buffer_size, void *buffer)
+{
+	EFI_ENTRY("%p, %x, %llx, %p, %zx, %p", this, media_id, lba, token,
+		  buffer_size, buffer);
+
+	return EFI_EXIT(efi_disk_rw_blocks_ex(this, media_id, lba, token,
+					      buffer_size, buffer,
+					      EFI_DISK_WRITE));
+}
+
+/**
+ * efi_disk_flush_blocks_ex() - flushes modified data to the device
+ *
+ * This function implements the FlushBlocksEx service of the
+ * EFI_BLOCK_IO2_PROTOCOL.
+ *
+ * The flush completes once all requests made before it have completed.
+ *
+ * See the Unified Extensible Firmware Interface (UEFI) specification for
+ * details.
+ *
+ * @this:			pointer to the BLOCK_IO2_PROTOCOL
+ * @token:			token signalled on completion, may be NULL
+ * Return:			status code
+ */
+static efi_status_t EFIAPI efi_disk_flush_blocks_ex(
+			struct efi_block_io2 *this,
+			struct efi_block_io2_token *token)
+{
+	struct efi_disk_obj *diskobj;
+	struct efi_disk_request *req;
+	efi_status_t ret = EFI_SUCCESS;
+
+	EFI_ENTRY("%p, %p", this, token);
+
+	if (!this) {
+		ret = EFI_INVALID_PARAMETER;
+		goto out;
+	}
+	diskobj = container_of(this, struct efi_disk_obj, ops2);
+
+	/* Synchronous writes may still be in the write-back cache */
+	if (blk_flush(diskobj->desc)) {
+		ret = EFI_DEVICE_ERROR;
+		goto out;
+	}
+
+	if (!token || !token->event) {
+		while (!list_empty(&diskobj->requests)) {
+			if (blk_dpoll(diskobj->desc) < 0) {
+				ret = EFI_DEVICE_ERROR;
+				goto out;
+			}
+		}
+		goto out;
+	}
+	if (list_empty(&diskobj->requests)) {
+		token->transaction_status = EFI_SUCCESS;
+		efi_signal_event(token->event);
+		goto out;
+	}
+
+	req = calloc(1, sizeof(*req));
+	if (!req) {
+		ret = EFI_OUT_OF_RESOURCES;
+		goto out;
+	}
+	req->token = token;
+	req->flush = true;
+	ret = efi_disk_queue(diskobj, req);
+	if (ret != EFI_SUCCESS)
+		free(req);
+out:
+	return EFI_EXIT(ret);
+}
+
+static const struct efi_block_io2 block_io2_disk_template = {
+	.reset = &efi_disk_reset_ex,
+	.read_blocks_ex = &efi_disk_read_blocks_ex,
+	.write_blocks_ex = &efi_disk_write_blocks_ex,
+	.flush_blocks_ex = &efi_disk_flush_blocks_ex,
+};
+
 /**
  * efi_fs_from_path() - retrieve simple file system protocol
  *
@@ -383,6 +799,10 @@ static efi_status_t efi_disk_add_dev(
 			       &diskobj->ops);
 	if (ret != EFI_SUCCESS)
 		return ret;
+	ret = efi_add_protocol(&diskobj->header, &efi_block_io2_guid,
+			       &diskobj->ops2);
+	if (ret != EFI_SUCCESS)
+		return ret;
 	ret = efi_add_protocol(&diskobj->header, &efi_guid_device_path,
 			       diskobj->dp);
 	if (ret != EFI_SUCCESS)
@@ -399,6 +819,9 @@ static efi_status_t efi_disk_add_dev(
 			return ret;
 	}
 	diskobj->ops = block_io_disk_template;
+	diskobj->ops2 = block_io2_disk_template;
+	INIT_LIST_HEAD(&diskobj->requests);
+	INIT_LIST_HEAD(&diskobj->busy_link);
 	diskobj->ifname = if_typename;
 	diskobj->dev_index = dev_index;
 	diskobj->offset = offset;
@@ -418,6 +841,7 @@ static efi_status_t efi_disk_add_dev(
 	if (part)
 		diskobj->media.logical_partition = 1;
 	diskobj->ops.media = &diskobj->media;
+	diskobj->ops2.media = &diskobj->media;
 	if (disk)
 		*disk = diskobj;
 
@@ -37,6 +37,9 @@ struct file_handle {
 	struct fs_dir_stream *dirs;
 	struct fs_dirent *dent;
 
+	/* for reading a file, opened on first use: */
+	struct fs_file *file;
+
 	char path[0];
 };
 #define to_fh(x) container_of(x, struct file_handle, base)
@@ -296,6 +299,7 @@ out:
 static efi_status_t file_close(struct file_handle *fh)
 {
 	fs_closedir(fh->dirs);
+	fs_close_file(fh->file);
 	free(fh);
 	return EFI_SUCCESS;
 }
@@ -331,6 +335,11 @@ static efi_status_t EFIAPI efi_file_delete(struct efi_file_handle *file)
 static efi_status_t efi_get_file_size(struct file_handle *fh,
 				      loff_t *file_size)
 {
+	if (fh->file) {
+		*file_size = fh->file->size;
+		return EFI_SUCCESS;
+	}
+
 	if (set_blk_dev(fh))
 		return EFI_DEVICE_ERROR;
 
@@ -354,11 +363,19 @@ static efi_status_t file_read(struct file_handle *fh, u64 *buffer_size,
 		ret = EFI_DEVICE_ERROR;
 		return ret;
 	}
+	if (!*buffer_size)
+		return EFI_SUCCESS;
 
-	if (set_blk_dev(fh))
-		return EFI_DEVICE_ERROR;
-	if (fs_read(fh->path, map_to_sysmem(buffer), fh->offset,
-		    *buffer_size, &actread))
+	/* Keep the file open so that sequential reads need no lookup */
+	if (!fh->file) {
+		if (set_blk_dev(fh))
+			return EFI_DEVICE_ERROR;
+		fh->file = fs_open_file(fh->path);
+		if (!fh->file)
+			return EFI_DEVICE_ERROR;
+	}
+	if (fs_read_at(fh->file, map_to_sysmem(buffer), fh->offset,
+		       *buffer_size, &actread))
 		return EFI_DEVICE_ERROR;
 
 	*buffer_size = actread;
@@ -511,6 +528,10 @@ static efi_status_t EFIAPI efi_file_write(struct efi_file_handle *file,
 	*buffer_size = actwrite;
 	fh->offset += actwrite;
 
+	/* The size and block mapping seen by the open file may have changed */
+	fs_close_file(fh->file);
+	fh->file = NULL;
+
 out:
 	return EFI_EXIT(ret);
 }
@@ -11,7 +11,7 @@
 #include <malloc.h>
 #include <mapmem.h>
 #include <watchdog.h>
-#include <linux/list_sort.h>
+#include <linux/rbtree_augmented.h>
 #include <linux/sizes.h>
 
 DECLARE_GLOBAL_DATA_PTR;
@@ -19,19 +19,42 @@ DECLARE_GLOBAL_DATA_PTR;
 /* Magic number identifying memory allocated from pool */
 #define EFI_ALLOC_POOL_MAGIC 0x1fe67ddf6491caa2
 
+/* Pool allocations up to this size (including header) are served by slabs */
+#define EFI_POOL_MIN_SLOT_SHIFT	6
+#define EFI_POOL_MAX_SLOT_SHIFT	12
+#define EFI_POOL_NUM_CLASSES	(EFI_POOL_MAX_SLOT_SHIFT - \
+				 EFI_POOL_MIN_SLOT_SHIFT + 1)
+/* Slabs are carved out of chunks of this many pages */
+#define EFI_POOL_CHUNK_PAGES	16
+#define EFI_POOL_CHUNK_SIZE	(EFI_POOL_CHUNK_PAGES << EFI_PAGE_SHIFT)
+/* Marks the num_pages field of an allocation as a slab slot offset */
+#define EFI_POOL_SLOT		BIT_ULL(63)
+
 efi_uintn_t efi_memory_map_key;
 
-struct efi_mem_list {
-	struct list_head link;
+/**
+ * struct efi_mem_node - memory map entry
+ *
+ * The memory map is kept in a red-black tree sorted by start address.
+ * Entries never overlap and adjacent entries with the same type and
+ * attributes are merged. Each node records the largest free entry in its
+ * subtree, so that free memory can be found without visiting every entry.
+ *
+ * @node:		node in efi_mem
+ * @desc:		memory descriptor
+ * @max_free_pages:	number of pages of the largest EFI_CONVENTIONAL_MEMORY
+ *			entry in the subtree rooted at this node
+ */
+struct efi_mem_node {
+	struct rb_node node;
 	struct efi_mem_desc desc;
+	u64 max_free_pages;
 };
 
-#define EFI_CARVE_NO_OVERLAP		-1
-#define EFI_CARVE_LOOP_AGAIN		-2
-#define EFI_CARVE_OVERLAPS_NONRAM	-3
-
-/* This list contains all memory map items */
-LIST_HEAD(efi_mem);
+/* This tree contains all memory map items */
+static struct rb_root efi_mem = RB_ROOT;
+/* Number of entries in efi_mem */
+static efi_uintn_t efi_mem_entries;
 
 #ifdef CONFIG_EFI_LOADER_BOUNCE_BUFFER
 void *efi_bounce_buffer;
@@ -40,13 +63,16 @@ void *efi_bounce_buffer;
 /**
  * struct efi_pool_allocation - memory block allocated from pool
  *
- * @num_pages:	number of pages allocated
+ * @num_pages:	number of pages allocated, or EFI_POOL_SLOT ORed with the
+ *		offset of the slot in its chunk for slab allocations. For a
+ *		free slot this holds the offset of the next free slot.
  * @checksum:	checksum
  * @data:	allocated pool memory
  *
- * U-Boot services each UEFI AllocatePool() request as a separate
- * (multiple) page allocation. We have to track the number of pages
- * to be able to free the correct amount later.
+ * Small UEFI AllocatePool() requests are served from a slab of equally
+ * sized slots, see struct efi_pool_chunk. Larger requests are serviced as
+ * a separate (multiple) page allocation. We have to track the number of
+ * pages to be able to free the correct amount later.
  *
  * The checksum calculated in function checksum() is used in FreePool() to avoid
  * freeing memory not allocated by AllocatePool() and duplicate freeing.
@@ -76,156 +102,201 @@ static u64 checksum(struct efi_pool_allocation *alloc)
 	return ret;
 }
 
-/*
- * Sorts the memory list from highest address to lowest address
+/**
+ * struct efi_pool_slab - pool slots of one size and memory type
  *
- * When allocating memory we should always start from the highest
- * address chunk, so sort the memory list such that the first list
- * iterator gets the highest address and goes lower from there.
+ * @chunks:	chunks which still have a free slot
  */
-static int efi_mem_cmp(void *priv, struct list_head *a, struct list_head *b)
-{
-	struct efi_mem_list *mema = list_entry(a, struct efi_mem_list, link);
-	struct efi_mem_list *memb = list_entry(b, struct efi_mem_list, link);
+struct efi_pool_slab {
+	struct list_head chunks;
+};
 
-	if (mema->desc.physical_start == memb->desc.physical_start)
-		return 0;
-	else if (mema->desc.physical_start < memb->desc.physical_start)
-		return 1;
-	else
-		return -1;
-}
+/**
+ * struct efi_pool_chunk - page allocation divided into pool slots
+ *
+ * The header occupies the first slot(s) of the chunk. Slots which have not
+ * been handed out yet are taken from @next_unused onwards so that a new
+ * chunk does not have to be initialised slot by slot.
+ *
+ * @link:	entry in the chunk list of @slab
+ * @slab:	slab this chunk belongs to
+ * @slot_size:	size of each slot in bytes, including the allocation header
+ * @in_use:	number of slots currently allocated
+ * @free:	offset of the first freed slot, 0 if none
+ * @next_unused: offset of the first slot never handed out
+ */
+struct efi_pool_chunk {
+	struct list_head link;
+	struct efi_pool_slab *slab;
+	u32 slot_size;
+	u32 in_use;
+	u32 free;
+	u32 next_unused;
+};
+
+static struct efi_pool_slab efi_pool_slabs[EFI_MAX_MEMORY_TYPE]
+					  [EFI_POOL_NUM_CLASSES];
 
 static uint64_t desc_get_end(struct efi_mem_desc *desc)
 {
 	return desc->physical_start + (desc->num_pages << EFI_PAGE_SHIFT);
 }
 
-static void efi_mem_sort(void)
+static struct efi_mem_node *efi_mem_entry(struct rb_node *node)
 {
-	struct list_head *lhandle;
-	struct efi_mem_list *prevmem = NULL;
-	bool merge_again = true;
-
-	list_sort(NULL, &efi_mem, efi_mem_cmp);
-
-	/* Now merge entries that can be merged */
-	while (merge_again) {
-		merge_again = false;
-		list_for_each(lhandle, &efi_mem) {
-			struct efi_mem_list *lmem;
-			struct efi_mem_desc *prev = &prevmem->desc;
-			struct efi_mem_desc *cur;
-			uint64_t pages;
-
-			lmem = list_entry(lhandle, struct efi_mem_list, link);
-			if (!prevmem) {
-				prevmem = lmem;
-				continue;
-			}
+	return node ? rb_entry(node, struct efi_mem_node, node) : NULL;
+}
 
-			cur = &lmem->desc;
-
-			if ((desc_get_end(cur) == prev->physical_start) &&
-			    (prev->type == cur->type) &&
-			    (prev->attribute == cur->attribute)) {
-				/* There is an existing map before, reuse it */
-				pages = cur->num_pages;
-				prev->num_pages += pages;
-				prev->physical_start -= pages << EFI_PAGE_SHIFT;
-				prev->virtual_start -= pages << EFI_PAGE_SHIFT;
-				list_del(&lmem->link);
-				free(lmem);
-
-				merge_again = true;
-				break;
-			}
+static struct efi_mem_node *efi_mem_next(struct efi_mem_node *mem)
+{
+	return efi_mem_entry(rb_next(&mem->node));
+}
 
-			prevmem = lmem;
-		}
+static struct efi_mem_node *efi_mem_prev(struct efi_mem_node *mem)
+{
+	return efi_mem_entry(rb_prev(&mem->node));
+}
+
+static u64 efi_mem_compute_free(struct efi_mem_node *mem)
+{
+	struct rb_node *left = mem->node.rb_left;
+	struct rb_node *right = mem->node.rb_right;
+	u64 ret = 0;
+
+	if (mem->desc.type == EFI_CONVENTIONAL_MEMORY)
+		ret = mem->desc.num_pages;
+	if (left)
+		ret = max(ret, efi_mem_entry(left)->max_free_pages);
+	if (right)
+		ret = max(ret, efi_mem_entry(right)->max_free_pages);
+
+	return ret;
+}
+
+RB_DECLARE_CALLBACKS(static, efi_mem_cb, struct efi_mem_node, node, u64,
+		     max_free_pages, efi_mem_compute_free)
+
+/**
+ * efi_mem_update() - update the tree after an entry has been resized
+ *
+ * The start address of the entry may only be changed within the gap to its
+ * neighbours, so that the order of the tree is kept.
+ *
+ * @mem:	changed entry
+ */
+static void efi_mem_update(struct efi_mem_node *mem)
+{
+	efi_mem_cb_propagate(&mem->node, NULL);
+}
+
+static void efi_mem_insert(struct efi_mem_node *mem)
+{
+	struct rb_node **link = &efi_mem.rb_node;
+	struct rb_node *parent = NULL;
+
+	while (*link) {
+		parent = *link;
+		if (mem->desc.physical_start <
+		    efi_mem_entry(parent)->desc.physical_start)
+			link = &parent->rb_left;
+		else
+			link = &parent->rb_right;
 	}
+
+	mem->max_free_pages = 0;
+	rb_link_node(&mem->node, parent, link);
+	efi_mem_update(mem);
+	rb_insert_augmented(&mem->node, &efi_mem, &efi_mem_cb);
+	++efi_mem_entries;
+}
+
+static void efi_mem_remove(struct efi_mem_node *mem)
+{
+	rb_erase_augmented(&mem->node, &efi_mem, &efi_mem_cb);
+	--efi_mem_entries;
+	free(mem);
 }
 
-/** efi_mem_carve_out - unmap memory region
- *
- * @map:		memory map
- * @carve_desc:		memory region to unmap
- * @overlap_only_ram:	the carved out region may only overlap RAM
- * Return Value:	the number of overlapping pages which have been
- *			removed from the map,
- *			EFI_CARVE_NO_OVERLAP, if the regions don't overlap,
- *			EFI_CARVE_OVERLAPS_NONRAM, if the carve and map overlap,
- *			and the map contains anything but free ram
- *			(only when overlap_only_ram is true),
- *			EFI_CARVE_LOOP_AGAIN, if the mapping list should be
- *			traversed again, as it has been altered.
- *
- * Unmaps all memory occupied by the carve_desc region from the list entry
- * pointed to by map.
- *
- * In case of EFI_CARVE_OVERLAPS_NONRAM it is the callers responsibility
- * to re-add the already carved out pages to the mapping.
+/**
+ * efi_mem_lookup() - find the first memory map entry ending above an address
+ *
+ * @addr:	address
+ * Return:	entry containing @addr or, if there is none, the first entry
+ *		above @addr, NULL if there is no such entry either
  */
-static s64 efi_mem_carve_out(struct efi_mem_list *map,
-			     struct efi_mem_desc *carve_desc,
-			     bool overlap_only_ram)
+static struct efi_mem_node *efi_mem_lookup(u64 addr)
 {
-	struct efi_mem_list *newmap;
-	struct efi_mem_desc *map_desc = &map->desc;
-	uint64_t map_start = map_desc->physical_start;
-	uint64_t map_end = map_start + (map_desc->num_pages << EFI_PAGE_SHIFT);
-	uint64_t carve_start = carve_desc->physical_start;
-	uint64_t carve_end = carve_start +
-			     (carve_desc->num_pages << EFI_PAGE_SHIFT);
-
-	/* check whether we're overlapping */
-	if ((carve_end <= map_start) || (carve_start >= map_end))
-		return EFI_CARVE_NO_OVERLAP;
-
-	/* We're overlapping with non-RAM, warn the caller if desired */
-	if (overlap_only_ram && (map_desc->type != EFI_CONVENTIONAL_MEMORY))
-		return EFI_CARVE_OVERLAPS_NONRAM;
-
-	/* Sanitize carve_start and carve_end to lie within our bounds */
-	carve_start = max(carve_start, map_start);
-	carve_end = min(carve_end, map_end);
-
-	/* Carving at the beginning of our map? Just move it! */
-	if (carve_start == map_start) {
-		if (map_end == carve_end) {
-			/* Full overlap, just remove map */
-			list_del(&map->link);
-			free(map);
+	struct rb_node *node = efi_mem.rb_node;
+	struct efi_mem_node *ret = NULL;
+
+	while (node) {
+		struct efi_mem_node *mem = efi_mem_entry(node);
+
+		if (desc_get_end(&mem->desc) > addr) {
+			ret = mem;
+			node = node->rb_left;
 		} else {
-			map->desc.physical_start = carve_end;
-			map->desc.virtual_start = carve_end;
-			map->desc.num_pages = (map_end - carve_end)
-					      >> EFI_PAGE_SHIFT;
+			node = node->rb_right;
 		}
-
-		return (carve_end - carve_start) >> EFI_PAGE_SHIFT;
 	}
 
-	/*
-	 * Overlapping maps, just split the list map at carve_start,
-	 * it will get moved or removed in the next iteration.
-	 *
-	 * [ map_desc |__carve_start__| newmap ]
-	 */
-
-	/* Create a new map from [ carve_start ... map_end ] */
-	newmap = calloc(1, sizeof(*newmap));
-	newmap->desc = map->desc;
-	newmap->desc.physical_start = carve_start;
-	newmap->desc.virtual_start = carve_start;
-	newmap->desc.num_pages = (map_end - carve_start) >> EFI_PAGE_SHIFT;
-	/* Insert before current entry (descending address order) */
-	list_add_tail(&newmap->link, &map->link);
+	return ret;
+}
 
-	/* Shrink the map to [ map_start ... carve_start ] */
-	map_desc->num_pages = (carve_start - map_start) >> EFI_PAGE_SHIFT;
+/* Check if the entry @next directly follows @prev and can be merged */
+static bool efi_mem_can_merge(struct efi_mem_desc *prev,
+			      struct efi_mem_desc *next)
+{
+	return desc_get_end(prev) == next->physical_start &&
+	       prev->type == next->type && prev->attribute == next->attribute;
+}
 
-	return EFI_CARVE_LOOP_AGAIN;
+/**
+ * efi_mem_carve_out() - unmap memory region
+ *
+ * Removes the region from all entries of the memory map overlapping it.
+ * Entries are shrunk or removed; an entry extending beyond both ends of the
+ * region is split in two, using @split for the upper part.
+ *
+ * @start:	start address of the region
+ * @end:	end address of the region
+ * @split:	spare entry, set to NULL if it has been used
+ */
+static void efi_mem_carve_out(u64 start, u64 end, struct efi_mem_node **split)
+{
+	struct efi_mem_node *mem = efi_mem_lookup(start);
+
+	while (mem && mem->desc.physical_start < end) {
+		struct efi_mem_node *next = efi_mem_next(mem);
+		struct efi_mem_desc *desc = &mem->desc;
+		u64 mem_end = desc_get_end(desc);
+
+		if (desc->physical_start < start) {
+			if (mem_end > end) {
+				/* [ mem | carve | split ] */
+				(*split)->desc = *desc;
+				(*split)->desc.physical_start = end;
+				(*split)->desc.virtual_start = end;
+				(*split)->desc.num_pages = (mem_end - end) >>
+							   EFI_PAGE_SHIFT;
+				efi_mem_insert(*split);
+				*split = NULL;
+			}
+			desc->num_pages = (start - desc->physical_start) >>
+					  EFI_PAGE_SHIFT;
+			efi_mem_update(mem);
+		} else if (mem_end > end) {
+			/* Carving at the beginning of our map? Just move it! */
+			desc->physical_start = end;
+			desc->virtual_start = end;
+			desc->num_pages = (mem_end - end) >> EFI_PAGE_SHIFT;
+			efi_mem_update(mem);
+		} else {
+			/* Full overlap, just remove map */
+			efi_mem_remove(mem);
+		}
+		mem = next;
+	}
 }
 
 /**
@@ -240,10 +311,9 @@ static s64 efi_mem_carve_out(struct efi_mem_list *map,
 efi_status_t efi_add_memory_map(uint64_t start, uint64_t pages, int memory_type,
 				bool overlap_only_ram)
 {
-	struct list_head *lhandle;
-	struct efi_mem_list *newlist;
-	bool carve_again;
-	uint64_t carved_pages = 0;
+	u64 end = start + (pages << EFI_PAGE_SHIFT);
+	struct efi_mem_node *newmem, *mem, *split = NULL;
+	u64 overlap = 0;
 	struct efi_event *evt;
 
 	EFI_PRINT("%s: 0x%llx 0x%llx %d %s\n", __func__,
@@ -255,80 +325,79 @@ efi_status_t efi_add_memory_map(uint64_t start, uint64_t pages, int memory_type,
 	if (!pages)
 		return EFI_SUCCESS;
 
+	/* Check the entries we are going to carve from before changing any */
+	for (mem = efi_mem_lookup(start); mem && mem->desc.physical_start < end;
+	     mem = efi_mem_next(mem)) {
+		/*
+		 * The user requested to only have RAM overlaps, but we hit a
+		 * non-RAM region. Error out.
+		 */
+		if (overlap_only_ram &&
+		    mem->desc.type != EFI_CONVENTIONAL_MEMORY)
+			return EFI_NO_MAPPING;
+		overlap += min(desc_get_end(&mem->desc), end) -
+			   max(mem->desc.physical_start, start);
+	}
+	if (overlap_only_ram && overlap != end - start) {
+		/*
+		 * The payload wanted to have RAM overlaps, but we overlapped
+		 * with an unallocated region. Error out.
+		 */
+		return EFI_NO_MAPPING;
+	}
+
+	/* An entry extending beyond both ends of the new map gets split */
+	mem = efi_mem_lookup(start);
+	if (mem && mem->desc.physical_start < start &&
+	    desc_get_end(&mem->desc) > end) {
+		split = calloc(1, sizeof(*split));
+		if (!split)
+			return EFI_OUT_OF_RESOURCES;
+	}
+	newmem = calloc(1, sizeof(*newmem));
+	if (!newmem) {
+		free(split);
+		return EFI_OUT_OF_RESOURCES;
+	}
+
 	++efi_memory_map_key;
-	newlist = calloc(1, sizeof(*newlist));
-	newlist->desc.type = memory_type;
-	newlist->desc.physical_start = start;
-	newlist->desc.virtual_start = start;
-	newlist->desc.num_pages = pages;
+	newmem->desc.type = memory_type;
+	newmem->desc.physical_start = start;
+	newmem->desc.virtual_start = start;
+	newmem->desc.num_pages = pages;
 
 	switch (memory_type) {
 	case EFI_RUNTIME_SERVICES_CODE:
 	case EFI_RUNTIME_SERVICES_DATA:
-		newlist->desc.attribute = EFI_MEMORY_WB | EFI_MEMORY_RUNTIME;
+		newmem->desc.attribute = EFI_MEMORY_WB | EFI_MEMORY_RUNTIME;
 		break;
 	case EFI_MMAP_IO:
-		newlist->desc.attribute = EFI_MEMORY_RUNTIME;
+		newmem->desc.attribute = EFI_MEMORY_RUNTIME;
 		break;
 	default:
-		newlist->desc.attribute = EFI_MEMORY_WB;
+		newmem->desc.attribute = EFI_MEMORY_WB;
 		break;
 	}
 
-	/* Add our new map */
-	do {
-		carve_again = false;
-		list_for_each(lhandle, &efi_mem) {
-			struct efi_mem_list *lmem;
-			s64 r;
-
-			lmem = list_entry(lhandle, struct efi_mem_list, link);
-			r = efi_mem_carve_out(lmem, &newlist->desc,
-					      overlap_only_ram);
-			switch (r) {
-			case EFI_CARVE_OVERLAPS_NONRAM:
-				/*
-				 * The user requested to only have RAM overlaps,
-				 * but we hit a non-RAM region. Error out.
-				 */
-				return EFI_NO_MAPPING;
-			case EFI_CARVE_NO_OVERLAP:
-				/* Just ignore this list entry */
-				break;
-			case EFI_CARVE_LOOP_AGAIN:
-				/*
-				 * We split an entry, but need to loop through
-				 * the list again to actually carve it.
-				 */
-				carve_again = true;
-				break;
-			default:
-				/* We carved a number of pages */
-				carved_pages += r;
-				carve_again = true;
-				break;
-			}
-
-			if (carve_again) {
-				/* The list changed, we need to start over */
-				break;
-			}
-		}
-	} while (carve_again);
-
-	if (overlap_only_ram && (carved_pages != pages)) {
-		/*
-		 * The payload wanted to have RAM overlaps, but we overlapped
-		 * with an unallocated region. Error out.
-		 */
-		return EFI_NO_MAPPING;
+	efi_mem_carve_out(start, end, &split);
+	free(split);
+
+	/* Add our new map and merge it with its neighbours */
+	efi_mem_insert(newmem);
+	mem = efi_mem_prev(newmem);
+	if (mem && efi_mem_can_merge(&mem->desc, &newmem->desc)) {
+		efi_mem_remove(newmem);
+		mem->desc.num_pages += pages;
+		efi_mem_update(mem);
+		newmem = mem;
+	}
+	mem = efi_mem_next(newmem);
+	if (mem && efi_mem_can_merge(&newmem->desc, &mem->desc)) {
+		pages = mem->desc.num_pages;
+		efi_mem_remove(mem);
+		newmem->desc.num_pages += pages;
+		efi_mem_update(newmem);
 	}
-
-	/* Add our new map */
-        list_add_tail(&newlist->link, &efi_mem);
-
-	/* And make sure memory is listed in descending order */
-	efi_mem_sort();
 
 	/* Notify that the memory map was changed */
 	list_for_each_entry(evt, &efi_events, link) {
@@ -360,64 +429,60 @@ efi_status_t efi_add_memory_map(uint64_t start, uint64_t pages, int memory_type,
  */
 static efi_status_t efi_check_allocated(u64 addr, bool must_be_allocated)
 {
-	struct efi_mem_list *item;
-
-	list_for_each_entry(item, &efi_mem, link) {
-		u64 start = item->desc.physical_start;
-		u64 end = start + (item->desc.num_pages << EFI_PAGE_SHIFT);
-
-		if (addr >= start && addr < end) {
-			if (must_be_allocated ^
-			    (item->desc.type == EFI_CONVENTIONAL_MEMORY))
-				return EFI_SUCCESS;
-			else
-				return EFI_NOT_FOUND;
-		}
+	struct efi_mem_node *mem = efi_mem_lookup(addr);
+
+	if (!mem || mem->desc.physical_start > addr)
+		return EFI_NOT_FOUND;
+
+	if (must_be_allocated ^ (mem->desc.type == EFI_CONVENTIONAL_MEMORY))
+		return EFI_SUCCESS;
+	else
+		return EFI_NOT_FOUND;
+}
+
+/**
+ * efi_mem_find_free() - find free memory in a subtree of the memory map
+ *
+ * Subtrees without a large enough free entry are skipped, as are entries
+ * starting at or above @max_addr.
+ *
+ * @node:	root of the subtree
+ * @len:	number of bytes needed, a multiple of EFI_PAGE_SIZE
+ * @max_addr:	page aligned address the memory must end below
+ * Return:	highest suitable address, 0 if none is found
+ */
+static u64 efi_mem_find_free(struct rb_node *node, u64 len, u64 max_addr)
+{
+	struct efi_mem_node *mem = efi_mem_entry(node);
+	u64 ret;
+
+	if (!mem || (mem->max_free_pages << EFI_PAGE_SHIFT) < len)
+		return 0;
+
+	if (mem->desc.physical_start < max_addr) {
+		ret = efi_mem_find_free(node->rb_right, len, max_addr);
+		if (ret)
+			return ret;
+
+		/* Return the highest address in this map within bounds */
+		ret = min(max_addr, desc_get_end(&mem->desc));
+		if (mem->desc.type == EFI_CONVENTIONAL_MEMORY &&
+		    ret - mem->desc.physical_start >= len)
+			return ret - len;
 	}
 
-	return EFI_NOT_FOUND;
+	return efi_mem_find_free(node->rb_left, len, max_addr);
 }
 
 static uint64_t efi_find_free_memory(uint64_t len, uint64_t max_addr)
 {
-	struct list_head *lhandle;
-
 	/*
 	 * Prealign input max address, so we simplify our matching
 	 * logic below and can just reuse it as return pointer.
 	 */
 	max_addr &= ~EFI_PAGE_MASK;
 
-	list_for_each(lhandle, &efi_mem) {
-		struct efi_mem_list *lmem = list_entry(lhandle,
-			struct efi_mem_list, link);
-		struct efi_mem_desc *desc = &lmem->desc;
-		uint64_t desc_len = desc->num_pages << EFI_PAGE_SHIFT;
-		uint64_t desc_end = desc->physical_start + desc_len;
-		uint64_t curmax = min(max_addr, desc_end);
-		uint64_t ret = curmax - len;
-
-		/* We only take memory from free RAM */
-		if (desc->type != EFI_CONVENTIONAL_MEMORY)
-			continue;
-
-		/* Out of bounds for max_addr */
-		if ((ret + len) > max_addr)
-			continue;
-
-		/* Out of bounds for upper map limit */
-		if ((ret + len) > desc_end)
-			continue;
-
-		/* Out of bounds for lower map limit */
-		if (ret < desc->physical_start)
-			continue;
-
-		/* Return the highest address in this map within bounds */
-		return ret;
-	}
-
-	return 0;
+	return efi_mem_find_free(efi_mem.rb_node, len, max_addr);
 }
 
 /*
@@ -523,6 +588,124 @@ efi_status_t efi_free_pages(uint64_t memory, efi_uintn_t pages)
 	return ret;
 }
 
+static bool efi_pool_chunk_full(struct efi_pool_chunk *chunk)
+{
+	return !chunk->free &&
+	       chunk->next_unused + chunk->slot_size > EFI_POOL_CHUNK_SIZE;
+}
+
+/**
+ * efi_pool_get_slab() - find the slab serving a pool allocation
+ *
+ * @pool_type:	type of the pool from which memory is to be allocated
+ * @size:	number of bytes to be allocated, including the header
+ * @slot_size:	returns the slot size of the slab
+ * Return:	slab, or NULL if the allocation must use whole pages
+ */
+static struct efi_pool_slab *efi_pool_get_slab(int pool_type, u64 size,
+					       u32 *slot_size)
+{
+	struct efi_pool_slab *slab;
+	int cls;
+
+	if (pool_type < 0 || pool_type >= EFI_MAX_MEMORY_TYPE ||
+	    size > 1 << EFI_POOL_MAX_SLOT_SHIFT)
+		return NULL;
+
+	for (cls = 0; size > 1 << (cls + EFI_POOL_MIN_SLOT_SHIFT); cls++)
+		;
+	slab = &efi_pool_slabs[pool_type][cls];
+	if (!slab->chunks.next)
+		INIT_LIST_HEAD(&slab->chunks);
+	*slot_size = 1 << (cls + EFI_POOL_MIN_SLOT_SHIFT);
+
+	return slab;
+}
+
+/**
+ * efi_pool_alloc_slot() - allocate a slot from a slab
+ *
+ * A new chunk is added to the memory map if all chunks of the slab are in
+ * full use.
+ *
+ * @slab:	slab to allocate from
+ * @pool_type:	memory type of the slab
+ * @slot_size:	slot size of the slab
+ * @allocp:	returns the allocation header of the slot
+ * Return:	status code
+ */
+static efi_status_t efi_pool_alloc_slot(struct efi_pool_slab *slab,
+					int pool_type, u32 slot_size,
+					struct efi_pool_allocation **allocp)
+{
+	struct efi_pool_allocation *alloc;
+	struct efi_pool_chunk *chunk;
+	efi_status_t r;
+	u32 offset;
+	u64 addr;
+
+	if (list_empty(&slab->chunks)) {
+		r = efi_allocate_pages(EFI_ALLOCATE_ANY_PAGES, pool_type,
+				       EFI_POOL_CHUNK_PAGES, &addr);
+		if (r != EFI_SUCCESS)
+			return r;
+		chunk = (struct efi_pool_chunk *)(uintptr_t)addr;
+		chunk->slab = slab;
+		chunk->slot_size = slot_size;
+		chunk->in_use = 0;
+		chunk->free = 0;
+		chunk->next_unused = roundup(sizeof(*chunk), slot_size);
+		list_add(&chunk->link, &slab->chunks);
+	}
+	chunk = list_first_entry(&slab->chunks, struct efi_pool_chunk, link);
+
+	if (chunk->free) {
+		offset = chunk->free;
+		alloc = (void *)chunk + offset;
+		chunk->free = alloc->num_pages;
+	} else {
+		offset = chunk->next_unused;
+		alloc = (void *)chunk + offset;
+		chunk->next_unused += slot_size;
+	}
+	chunk->in_use++;
+	if (efi_pool_chunk_full(chunk))
+		list_del(&chunk->link);
+
+	alloc->num_pages = EFI_POOL_SLOT | offset;
+	*allocp = alloc;
+
+	return EFI_SUCCESS;
+}
+
+/**
+ * efi_pool_free_slot() - return a slot to its slab
+ *
+ * The chunk is removed from the memory map once none of its slots is in
+ * use, unless it is the last chunk of the slab with free slots.
+ *
+ * @alloc:	allocation header of the slot
+ * Return:	status code
+ */
+static efi_status_t efi_pool_free_slot(struct efi_pool_allocation *alloc)
+{
+	u32 offset = alloc->num_pages & ~EFI_POOL_SLOT;
+	struct efi_pool_chunk *chunk = (void *)alloc - offset;
+	struct efi_pool_slab *slab = chunk->slab;
+
+	if (efi_pool_chunk_full(chunk))
+		list_add(&chunk->link, &slab->chunks);
+	alloc->num_pages = chunk->free;
+	chunk->free = offset;
+	chunk->in_use--;
+
+	if (chunk->in_use || list_is_singular(&slab->chunks))
+		return EFI_SUCCESS;
+	list_del(&chunk->link);
+
+	return efi_free_pages((uintptr_t)chunk, EFI_POOL_CHUNK_PAGES);
+}
+
 /**
  * efi_allocate_pool - allocate memory from pool
  *
@@ -536,6 +719,8 @@ efi_status_t efi_allocate_pool(int pool_type, efi_uintn_t size, void **buffer)
 	efi_status_t r;
 	u64 addr;
 	struct efi_pool_allocation *alloc;
+	struct efi_pool_slab *slab;
+	u32 slot_size;
 	u64 num_pages = efi_size_in_pages(size +
 					  sizeof(struct efi_pool_allocation));
 
@@ -547,6 +732,18 @@ efi_status_t efi_allocate_pool(int pool_type, efi_uintn_t size, void **buffer)
 		return EFI_SUCCESS;
 	}
 
+	slab = efi_pool_get_slab(pool_type,
+				 size + sizeof(struct efi_pool_allocation),
+				 &slot_size);
+	if (slab) {
+		r = efi_pool_alloc_slot(slab, pool_type, slot_size, &alloc);
+		if (r == EFI_SUCCESS) {
+			alloc->checksum = checksum(alloc);
+			*buffer = alloc->data;
+		}
+		return r;
+	}
+
 	r = efi_allocate_pages(EFI_ALLOCATE_ANY_PAGES, pool_type, num_pages,
 			       &addr);
 	if (r == EFI_SUCCESS) {
@@ -580,14 +777,18 @@ efi_status_t efi_free_pool(void *buffer)
 	alloc = container_of(buffer, struct efi_pool_allocation, data);
 
 	/* Check that this memory was allocated by efi_allocate_pool() */
-	if (((uintptr_t)alloc & EFI_PAGE_MASK) ||
-	    alloc->checksum != checksum(alloc)) {
+	if (alloc->checksum != checksum(alloc) ||
+	    (!(alloc->num_pages & EFI_POOL_SLOT) &&
+	     ((uintptr_t)alloc & EFI_PAGE_MASK))) {
 		printf("%s: illegal free 0x%p\n", __func__, buffer);
 		return EFI_INVALID_PARAMETER;
 	}
 	/* Avoid double free */
 	alloc->checksum = 0;
 
+	if (alloc->num_pages & EFI_POOL_SLOT)
+		return efi_pool_free_slot(alloc);
+
 	ret = efi_free_pages((uintptr_t)alloc, alloc->num_pages);
 
 	return ret;
@@ -611,8 +812,7 @@ efi_status_t efi_get_memory_map(efi_uintn_t *memory_map_size,
 				uint32_t *descriptor_version)
 {
 	efi_uintn_t map_size = 0;
-	int map_entries = 0;
-	struct list_head *lhandle;
+	struct rb_node *node;
 	efi_uintn_t provided_map_size;
 
 	if (!memory_map_size)
@@ -620,10 +820,7 @@ efi_status_t efi_get_memory_map(efi_uintn_t *memory_map_size,
 
 	provided_map_size = *memory_map_size;
 
-	list_for_each(lhandle, &efi_mem)
-		map_entries++;
-
-	map_size = map_entries * sizeof(struct efi_mem_desc);
+	map_size = efi_mem_entries * sizeof(struct efi_mem_desc);
 
 	*memory_map_size = map_size;
 
@@ -639,16 +836,9 @@ efi_status_t efi_get_memory_map(efi_uintn_t *memory_map_size,
 	if (!memory_map)
 		return EFI_INVALID_PARAMETER;
 
-	/* Copy list into array */
-	/* Return the list in ascending order */
-	memory_map = &memory_map[map_entries - 1];
-	list_for_each(lhandle, &efi_mem) {
-		struct efi_mem_list *lmem;
-
-		lmem = list_entry(lhandle, struct efi_mem_list, link);
-		*memory_map = lmem->desc;
-		memory_map--;
-	}
+	/* Copy tree into array, the tree is sorted in ascending order */
+	for (node = rb_first(&efi_mem); node; node = rb_next(node))
+		*memory_map++ = efi_mem_entry(node)->desc;
 
 	if (map_key)
 		*map_key = efi_memory_map_key;
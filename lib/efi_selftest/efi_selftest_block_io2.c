@@ -0,0 +1,578 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * efi_selftest_block_io2
+ *
+ * This test checks the EFI_BLOCK_IO2_PROTOCOL of the EFI disks.
+ *
+ * A disk image is created in memory and exposed via the block IO protocol.
+ * ConnectController is used to create the U-Boot block device and the EFI
+ * disk for its partition. Blocks of the partition are written and read
+ * with tokens while the TPL is raised. The events must only be notified
+ * once the TPL is restored, in the order in which the requests were made,
+ * and a flush must complete after the requests made before it.
+ */
+
+#include <efi_selftest.h>
+#include "efi_selftest_disk_image.h"
+
+/* Block size of compressed disk image */
+#define COMPRESSED_DISK_IMAGE_BLOCK_SIZE 8
+
+/* Binary logarithm of the block size */
+#define LB_BLOCK_SIZE 9
+
+/* First block of the partition in the disk image */
+#define PARTITION_START 1
+
+/* Block of the partition used for the test and number of blocks */
+#define TEST_LBA 0x40
+#define TEST_BLOCKS 2
+#define TEST_SIZE (TEST_BLOCKS << LB_BLOCK_SIZE)
+
+static struct efi_boot_services *boottime;
+
+static const efi_guid_t block_io_protocol_guid = EFI_BLOCK_IO_PROTOCOL_GUID;
+static const efi_guid_t block_io2_protocol_guid = EFI_BLOCK_IO2_PROTOCOL_GUID;
+static const efi_guid_t guid_device_path = EFI_DEVICE_PATH_PROTOCOL_GUID;
+static efi_guid_t guid_vendor =
+	EFI_GUID(0x5a7c1f7e, 0x3c1b, 0x4b39,
+		 0x91, 0x0e, 0x1d, 0x6c, 0x5f, 0x3e, 0x8a, 0x21);
+
+static struct efi_device_path *dp;
+
+/* One 8 byte block of the compressed disk image */
+struct line {
+	size_t addr;
+	char *line;
+};
+
+/* Compressed disk image */
+struct compressed_disk_image {
+	size_t length;
+	struct line lines[];
+};
+
+static const struct compressed_disk_image img = EFI_ST_DISK_IMG;
+
+/* Decompressed disk image */
+static u8 *image;
+
+/* Buffers for the test, aligned to pages */
+static u64 buffers;
+
+/* Events of the write and read tokens */
+static struct efi_event *events[2];
+static unsigned int indexes[] = {0, 1};
+
+/* Event of the flush token */
+static struct efi_event *flush_event;
+
+/* Number of notifications and the order in which they were received */
+static unsigned int notified;
+static unsigned int order[2];
+
+/*
+ * Reset service of the block IO protocol.
+ *
+ * @this	block IO protocol
+ * @return	status code
+ */
+static efi_status_t EFIAPI reset(
+			struct efi_block_io *this,
+			char extended_verification)
+{
+	return EFI_SUCCESS;
+}
+
+/*
+ * Read service of the block IO protocol.
+ *
+ * @this	block IO protocol
+ * @media_id	media id
+ * @lba		start of the read in logical blocks
+ * @buffer_size	number of bytes to read
+ * @buffer	target buffer
+ * @return	status code
+ */
+static efi_status_t EFIAPI read_blocks(
+			struct efi_block_io *this, u32 media_id, u64 lba,
+			efi_uintn_t buffer_size, void *buffer)
+{
+	if ((lba << LB_BLOCK_SIZE) + buffer_size > img.length)
+		return EFI_INVALID_PARAMETER;
+
+	boottime->copy_mem(buffer, image + (lba << LB_BLOCK_SIZE),
+			   buffer_size);
+
+	return EFI_SUCCESS;
+}
+
+/*
+ * Write service of the block IO protocol.
+ *
+ * @this	block IO protocol
+ * @media_id	media id
+ * @lba		start of the write in logical blocks
+ * @buffer_size	number of bytes to read
+ * @buffer	source buffer
+ * @return	status code
+ */
+static efi_status_t EFIAPI write_blocks(
+			struct efi_block_io *this, u32 media_id, u64 lba,
+			efi_uintn_t buffer_size, void *buffer)
+{
+	if ((lba << LB_BLOCK_SIZE) + buffer_size > img.length)
+		return EFI_INVALID_PARAMETER;
+
+	boottime->copy_mem(image + (lba << LB_BLOCK_SIZE), buffer,
+			   buffer_size);
+
+	return EFI_SUCCESS;
+}
+
+/*
+ * Flush service of the block IO protocol.
+ *
+ * @this	block IO protocol
+ * @return	status code
+ */
+static efi_status_t EFIAPI flush_blocks(struct efi_block_io *this)
+{
+	return EFI_SUCCESS;
+}
+
+/*
+ * Decompress the disk image.
+ *
+ * @image	decompressed disk image
+ * @return	status code
+ */
+static efi_status_t decompress(u8 **image)
+{
+	u8 *buf;
+	size_t i;
+	size_t addr;
+	size_t len;
+	efi_status_t ret;
+
+	ret = boottime->allocate_pool(EFI_LOADER_DATA, img.length,
+				      (void **)&buf);
+	if (ret != EFI_SUCCESS) {
+		efi_st_error("Out of memory\n");
+		return ret;
+	}
+	boottime->set_mem(buf, img.length, 0);
+
+	for (i = 0; ; ++i) {
+		if (!img.lines[i].line)
+			break;
+		addr = img.lines[i].addr;
+		len = COMPRESSED_DISK_IMAGE_BLOCK_SIZE;
+		if (addr + len > img.length)
+			len = img.length - addr;
+		boottime->copy_mem(buf + addr, img.lines[i].line, len);
+	}
+	*image = buf;
+	return ret;
+}
+
+static struct efi_block_io_media media;
+
+static struct efi_block_io block_io = {
+	.media = &media,
+	.reset = reset,
+	.read_blocks = read_blocks,
+	.write_blocks = write_blocks,
+	.flush_blocks = flush_blocks,
+};
+
+/* Handle for the block IO device */
+static efi_handle_t disk_handle;
+
+/*
+ * Notification function recording the order of completions.
+ *
+ * @event	notified event
+ * @context	pointer to the index of the request
+ */
+static void EFIAPI notify(struct efi_event *event, void *context)
+{
+	unsigned int *index = context;
+
+	if (notified < ARRAY_SIZE(order))
+		order[notified] = *index;
+	++notified;
+}
+
+/*
+ * Setup unit test.
+ *
+ * @handle:	handle of the loaded image
+ * @systable:	system table
+ * @return:	EFI_ST_SUCCESS for success
+ */
+static int setup(const efi_handle_t handle,
+		 const struct efi_system_table *systable)
+{
+	efi_status_t ret;
+	struct efi_device_path_vendor vendor_node;
+	struct efi_device_path end_node;
+	int i;
+
+	boottime = systable->boottime;
+
+	if (decompress(&image) != EFI_SUCCESS)
+		return EFI_ST_FAILURE;
+
+	ret = boottime->allocate_pages(EFI_ALLOCATE_ANY_PAGES,
+				       EFI_LOADER_DATA, 1, &buffers);
+	if (ret != EFI_SUCCESS) {
+		efi_st_error("Out of memory\n");
+		return EFI_ST_FAILURE;
+	}
+
+	for (i = 0; i < ARRAY_SIZE(events); ++i) {
+		ret = boottime->create_event(EVT_NOTIFY_SIGNAL, TPL_CALLBACK,
+					     notify, &indexes[i], &events[i]);
+		if (ret != EFI_SUCCESS) {
+			efi_st_error("could not create event\n");
+			return EFI_ST_FAILURE;
+		}
+	}
+	ret = boottime->create_event(0, TPL_CALLBACK, NULL, NULL,
+				     &flush_event);
+	if (ret != EFI_SUCCESS) {
+		efi_st_error("could not create event\n");
+		return EFI_ST_FAILURE;
+	}
+
+	block_io.media->block_size = 1 << LB_BLOCK_SIZE;
+	block_io.media->last_block = img.length >> LB_BLOCK_SIZE;
+
+	ret = boottime->install_protocol_interface(
+				&disk_handle, &block_io_protocol_guid,
+				EFI_NATIVE_INTERFACE, &block_io);
+	if (ret != EFI_SUCCESS) {
+		efi_st_error("Failed to install block I/O protocol\n");
+		return EFI_ST_FAILURE;
+	}
+
+	ret = boottime->allocate_pool(EFI_LOADER_DATA,
+				      sizeof(struct efi_device_path_vendor) +
+				      sizeof(struct efi_device_path),
+				      (void **)&dp);
+	if (ret != EFI_SUCCESS) {
+		efi_st_error("Out of memory\n");
+		return EFI_ST_FAILURE;
+	}
+	vendor_node.dp.type = DEVICE_PATH_TYPE_HARDWARE_DEVICE;
+	vendor_node.dp.sub_type = DEVICE_PATH_SUB_TYPE_VENDOR;
+	vendor_node.dp.length = sizeof(struct efi_device_path_vendor);
+
+	boottime->copy_mem(&vendor_node.guid, &guid_vendor,
+			   sizeof(efi_guid_t));
+	boottime->copy_mem(dp, &vendor_node,
+			   sizeof(struct efi_device_path_vendor));
+	end_node.type = DEVICE_PATH_TYPE_END;
+	end_node.sub_type = DEVICE_PATH_SUB_TYPE_END;
+	end_node.length = sizeof(struct efi_device_path);
+
+	boottime->copy_mem((char *)dp + sizeof(struct efi_device_path_vendor),
+			   &end_node, sizeof(struct efi_device_path));
+	ret = boottime->install_protocol_interface(&disk_handle,
+						   &guid_device_path,
+						   EFI_NATIVE_INTERFACE,
+						   dp);
+	if (ret != EFI_SUCCESS) {
+		efi_st_error("InstallProtocolInterface failed\n");
+		return EFI_ST_FAILURE;
+	}
+	return EFI_ST_SUCCESS;
+}
+
+/*
+ * Tear down unit test.
+ *
+ * @return:	EFI_ST_SUCCESS for success
+ */
+static int teardown(void)
+{
+	efi_status_t r = EFI_ST_SUCCESS;
+	int i;
+
+	if (disk_handle) {
+		r = boottime->uninstall_protocol_interface(disk_handle,
+							   &guid_device_path,
+							   dp);
+		if (r != EFI_SUCCESS) {
+			efi_st_error("Uninstall device path failed\n");
+			return EFI_ST_FAILURE;
+		}
+		r = boottime->uninstall_protocol_interface(
+				disk_handle, &block_io_protocol_guid,
+				&block_io);
+		if (r != EFI_SUCCESS) {
+			efi_st_error(
+				"Failed to uninstall block I/O protocol\n");
+			return EFI_ST_FAILURE;
+		}
+	}
+
+	for (i = 0; i < ARRAY_SIZE(events); ++i) {
+		if (events[i] &&
+		    boottime->close_event(events[i]) != EFI_SUCCESS) {
+			efi_st_error("could not close event\n");
+			return EFI_ST_FAILURE;
+		}
+	}
+	if (flush_event && boottime->close_event(flush_event) != EFI_SUCCESS) {
+		efi_st_error("could not close event\n");
+		return EFI_ST_FAILURE;
+	}
+
+	if (buffers) {
+		r = boottime->free_pages(buffers, 1);
+		if (r != EFI_SUCCESS) {
+			efi_st_error("Failed to free buffers\n");
+			return EFI_ST_FAILURE;
+		}
+	}
+
+	if (image) {
+		r = boottime->free_pool(image);
+		if (r != EFI_SUCCESS) {
+			efi_st_error("Failed to free image\n");
+			return EFI_ST_FAILURE;
+		}
+	}
+	return r;
+}
+
+/*
+ * Get length of device path without end tag.
+ *
+ * @dp		device path
+ * @return	length of device path in bytes
+ */
+static efi_uintn_t dp_size(struct efi_device_path *dp)
+{
+	struct efi_device_path *pos = dp;
+
+	while (pos->type != DEVICE_PATH_TYPE_END)
+		pos = (struct efi_device_path *)((char *)pos + pos->length);
+	return (char *)pos - (char *)dp;
+}
+
+/*
+ * Find the block IO 2 protocol of the partition on the virtual disk.
+ *
+ * @block_io2	receives the protocol interface
+ * @return:	EFI_ST_SUCCESS for success
+ */
+static int find_partition(struct efi_block_io2 **block_io2)
+{
+	efi_status_t ret;
+	efi_uintn_t no_handles, i, len;
+	efi_handle_t *handles;
+	efi_handle_t handle_partition = NULL;
+	struct efi_device_path *dp_partition;
+
+	ret = boottime->locate_handle_buffer(
+				BY_PROTOCOL, &block_io2_protocol_guid, NULL,
+				&no_handles, &handles);
+	if (ret != EFI_SUCCESS) {
+		efi_st_error("Failed to locate handles\n");
+		return EFI_ST_FAILURE;
+	}
+	len = dp_size(dp);
+	for (i = 0; i < no_handles; ++i) {
+		ret = boottime->open_protocol(handles[i], &guid_device_path,
+					      (void **)&dp_partition,
+					      NULL, NULL,
+					      EFI_OPEN_PROTOCOL_GET_PROTOCOL);
+		if (ret != EFI_SUCCESS)
+			continue;
+		if (len >= dp_size(dp_partition))
+			continue;
+		if (memcmp(dp, dp_partition, len))
+			continue;
+		handle_partition = handles[i];
+		break;
+	}
+	ret = boottime->free_pool(handles);
+	if (ret != EFI_SUCCESS) {
+		efi_st_error("Failed to free pool memory\n");
+		return EFI_ST_FAILURE;
+	}
+	if (!handle_partition) {
+		efi_st_error("Partition handle not found\n");
+		return EFI_ST_FAILURE;
+	}
+
+	ret = boottime->open_protocol(handle_partition,
+				      &block_io2_protocol_guid,
+				      (void **)block_io2, NULL, NULL,
+				      EFI_OPEN_PROTOCOL_GET_PROTOCOL);
+	if (ret != EFI_SUCCESS) {
+		efi_st_error("Failed to open block IO 2 protocol\n");
+		return EFI_ST_FAILURE;
+	}
+	return EFI_ST_SUCCESS;
+}
+
+/*
+ * Execute unit test.
+ *
+ * @return:	EFI_ST_SUCCESS for success
+ */
+static int execute(void)
+{
+	struct efi_block_io2 *block_io2;
+	struct efi_block_io2_token tokens[2], flush_token;
+	u8 *wbuf = (u8 *)(uintptr_t)buffers;
+	u8 *rbuf = wbuf + TEST_SIZE;
+	u32 media_id;
+	efi_uintn_t old_tpl;
+	efi_status_t ret;
+	int i;
+
+	/* Connect controller to virtual disk */
+	ret = boottime->connect_controller(disk_handle, NULL, NULL, 1);
+	if (ret != EFI_SUCCESS) {
+		efi_st_error("Failed to connect controller\n");
+		return EFI_ST_FAILURE;
+	}
+	if (find_partition(&block_io2) != EFI_ST_SUCCESS)
+		return EFI_ST_FAILURE;
+	media_id = block_io2->media->media_id;
+
+	for (i = 0; i < ARRAY_SIZE(tokens); ++i)
+		tokens[i].event = events[i];
+	flush_token.event = flush_event;
+	for (i = 0; i < TEST_SIZE; ++i)
+		wbuf[i] = i * 7 + 3;
+
+	/* Invalid requests must fail without signalling the event */
+	notified = 0;
+	ret = block_io2->read_blocks_ex(block_io2, media_id, TEST_LBA,
+					&tokens[0], TEST_SIZE - 1, rbuf);
+	if (ret != EFI_BAD_BUFFER_SIZE) {
+		efi_st_error("ReadBlocksEx accepted a partial block\n");
+		return EFI_ST_FAILURE;
+	}
+	ret = block_io2->read_blocks_ex(block_io2, media_id + 1, TEST_LBA,
+					&tokens[0], TEST_SIZE, rbuf);
+	if (ret != EFI_MEDIA_CHANGED) {
+		efi_st_error("ReadBlocksEx ignored the media id\n");
+		return EFI_ST_FAILURE;
+	}
+	if (notified) {
+		efi_st_error("Event signalled for a failed request\n");
+		return EFI_ST_FAILURE;
+	}
+
+	/* Queue a write, a read of the same blocks, and a flush */
+	old_tpl = boottime->raise_tpl(TPL_CALLBACK);
+	tokens[0].transaction_status = EFI_NOT_READY;
+	tokens[1].transaction_status = EFI_NOT_READY;
+	ret = block_io2->write_blocks_ex(block_io2, media_id, TEST_LBA,
+					 &tokens[0], TEST_SIZE, wbuf);
+	if (ret != EFI_SUCCESS) {
+		boottime->restore_tpl(old_tpl);
+		efi_st_error("WriteBlocksEx failed\n");
+		return EFI_ST_FAILURE;
+	}
+	ret = block_io2->read_blocks_ex(block_io2, media_id, TEST_LBA,
+					&tokens[1], TEST_SIZE, rbuf);
+	if (ret != EFI_SUCCESS) {
+		boottime->restore_tpl(old_tpl);
+		efi_st_error("ReadBlocksEx failed\n");
+		return EFI_ST_FAILURE;
+	}
+	ret = block_io2->flush_blocks_ex(block_io2, &flush_token);
+	if (ret != EFI_SUCCESS) {
+		boottime->restore_tpl(old_tpl);
+		efi_st_error("FlushBlocksEx failed\n");
+		return EFI_ST_FAILURE;
+	}
+	if (notified) {
+		boottime->restore_tpl(old_tpl);
+		efi_st_error("Event notified while the TPL was raised\n");
+		return EFI_ST_FAILURE;
+	}
+	boottime->restore_tpl(old_tpl);
+
+	ret = boottime->wait_for_event(1, &flush_event, NULL);
+	if (ret != EFI_SUCCESS) {
+		efi_st_error("WaitForEvent failed\n");
+		return EFI_ST_FAILURE;
+	}
+	if (flush_token.transaction_status != EFI_SUCCESS) {
+		efi_st_error("Flush failed\n");
+		return EFI_ST_FAILURE;
+	}
+	if (notified != 2) {
+		efi_st_error("Flush completed before the requests\n");
+		return EFI_ST_FAILURE;
+	}
+	if (order[0] != 0 || order[1] != 1) {
+		efi_st_error("Requests completed out of order\n");
+		return EFI_ST_FAILURE;
+	}
+	if (tokens[0].transaction_status != EFI_SUCCESS ||
+	    tokens[1].transaction_status != EFI_SUCCESS) {
+		efi_st_error("Transfer failed\n");
+		return EFI_ST_FAILURE;
+	}
+	if (memcmp(rbuf, wbuf, TEST_SIZE) ||
+	    memcmp(image + ((PARTITION_START + TEST_LBA) << LB_BLOCK_SIZE),
+		   wbuf, TEST_SIZE)) {
+		efi_st_error("Data not written\n");
+		return EFI_ST_FAILURE;
+	}
+
+	/* Without an event the read is blocking */
+	notified = 0;
+	boottime->set_mem(rbuf, TEST_SIZE, 0);
+	tokens[0].event = NULL;
+	ret = block_io2->read_blocks_ex(block_io2, media_id, TEST_LBA,
+					&tokens[0], TEST_SIZE, rbuf);
+	if (ret != EFI_SUCCESS || memcmp(rbuf, wbuf, TEST_SIZE)) {
+		efi_st_error("Blocking ReadBlocksEx failed\n");
+		return EFI_ST_FAILURE;
+	}
+	ret = block_io2->read_blocks_ex(block_io2, media_id, TEST_LBA,
+					NULL, TEST_SIZE, rbuf);
+	if (ret != EFI_SUCCESS) {
+		efi_st_error("ReadBlocksEx without token failed\n");
+		return EFI_ST_FAILURE;
+	}
+
+	/* An empty request completes with success */
+	tokens[1].transaction_status = EFI_NOT_READY;
+	ret = block_io2->read_blocks_ex(block_io2, media_id, TEST_LBA,
+					&tokens[1], 0, rbuf);
+	if (ret != EFI_SUCCESS) {
+		efi_st_error("Empty ReadBlocksEx failed\n");
+		return EFI_ST_FAILURE;
+	}
+	ret = block_io2->flush_blocks_ex(block_io2, NULL);
+	if (ret != EFI_SUCCESS) {
+		efi_st_error("Blocking FlushBlocksEx failed\n");
+		return EFI_ST_FAILURE;
+	}
+	if (notified != 1 || tokens[1].transaction_status != EFI_SUCCESS) {
+		efi_st_error("Empty request not completed\n");
+		return EFI_ST_FAILURE;
+	}
+
+	return EFI_ST_SUCCESS;
+}
+
+EFI_UNIT_TEST(blkio2) = {
+	.name = "block io 2",
+	.phase = EFI_EXECUTE_BEFORE_BOOTTIME_EXIT,
+	.setup = setup,
+	.execute = execute,
+	.teardown = teardown,
+};
@@ -5,14 +5,16 @@
  * Copyright (c) 2018 Heinrich Schuchardt <xypron.glpk@gmx.de>
  *
  * This unit test checks the following boottime services:
- * AllocatePages, FreePages, GetMemoryMap
+ * AllocatePages, FreePages, GetMemoryMap, AllocatePool, FreePool
  *
  * The memory type used for the device tree is checked.
+ * It is checked that small pool allocations do not grow the memory map.
  */
 
 #include <efi_selftest.h>
 
 #define EFI_ST_NUM_PAGES 8
+#define EFI_ST_NUM_POOLS 64
 
 static const efi_guid_t fdt_guid = EFI_FDT_GUID;
 static struct efi_boot_services *boottime;
@@ -93,6 +95,85 @@ static int find_in_memory_map(efi_uintn_t map_size,
 	return EFI_ST_SUCCESS;
 }
 
+/**
+ * get_map_size() - get the size of the memory map
+ *
+ * @map_size:	returns the size of the memory map in bytes
+ * Return:	EFI_ST_SUCCESS for success
+ */
+static int get_map_size(efi_uintn_t *map_size)
+{
+	efi_uintn_t map_key;
+	efi_uintn_t desc_size;
+	u32 desc_version;
+	efi_status_t ret;
+
+	*map_size = 0;
+	ret = boottime->get_memory_map(map_size, NULL, &map_key, &desc_size,
+				       &desc_version);
+	if (ret != EFI_BUFFER_TOO_SMALL) {
+		efi_st_error
+			("GetMemoryMap did not return EFI_BUFFER_TOO_SMALL\n");
+		return EFI_ST_FAILURE;
+	}
+	return EFI_ST_SUCCESS;
+}
+
+/**
+ * test_small_pools() - check small pool allocations
+ *
+ * Small pool allocations are carved out of shared chunks. Once a chunk
+ * exists further allocations of the same type must not change the memory
+ * map.
+ *
+ * Return:	EFI_ST_SUCCESS for success
+ */
+static int test_small_pools(void)
+{
+	u8 *pools[EFI_ST_NUM_POOLS];
+	efi_uintn_t map_size, size;
+	efi_status_t ret;
+	size_t i, j;
+
+	for (i = 0; i < EFI_ST_NUM_POOLS; ++i) {
+		ret = boottime->allocate_pool(EFI_LOADER_DATA, 24,
+					      (void **)&pools[i]);
+		if (ret != EFI_SUCCESS) {
+			efi_st_error
+				("AllocatePool did not return EFI_SUCCESS\n");
+			return EFI_ST_FAILURE;
+		}
+		if ((uintptr_t)pools[i] & 7) {
+			efi_st_error("Pool memory is not 8 byte aligned\n");
+			return EFI_ST_FAILURE;
+		}
+		/* The first allocation may add a chunk to the memory map */
+		if (!i && get_map_size(&map_size) != EFI_ST_SUCCESS)
+			return EFI_ST_FAILURE;
+		boottime->set_mem(pools[i], 24, i);
+	}
+	if (get_map_size(&size) != EFI_ST_SUCCESS)
+		return EFI_ST_FAILURE;
+	if (size != map_size) {
+		efi_st_error("Small pool allocations changed the memory map\n");
+		return EFI_ST_FAILURE;
+	}
+	for (i = 0; i < EFI_ST_NUM_POOLS; ++i) {
+		for (j = 0; j < 24; ++j) {
+			if (pools[i][j] != (u8)i) {
+				efi_st_error("Pool allocations overlap\n");
+				return EFI_ST_FAILURE;
+			}
+		}
+		ret = boottime->free_pool(pools[i]);
+		if (ret != EFI_SUCCESS) {
+			efi_st_error("FreePool did not return EFI_SUCCESS\n");
+			return EFI_ST_FAILURE;
+		}
+	}
+	return EFI_ST_SUCCESS;
+}
+
 /*
  * execute() - execute unit test
  *
@@ -181,7 +262,7 @@ static int execute(void)
 			("Device tree not marked as ACPI reclaim memory\n");
 		return EFI_ST_FAILURE;
 	}
-	return EFI_ST_SUCCESS;
+	return test_small_pools();
 }
 
 EFI_UNIT_TEST(memory) = {
@@ -0,0 +1,280 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * efi_selftest_memory_map
+ *
+ * This unit test stresses the memory map with many cycles of the
+ * AllocatePages and FreePages boottime services.
+ *
+ * After each batch of allocations the memory map returned by GetMemoryMap
+ * is checked for consistency. When all pages have been freed the memory
+ * map must be the same as before the test.
+ */
+
+#include <efi_selftest.h>
+
+/* Pages used for each of the two memory map buffers */
+#define EFI_ST_MAP_PAGES 8
+#define EFI_ST_MAP_SIZE (EFI_ST_MAP_PAGES << EFI_PAGE_SHIFT)
+#define EFI_ST_SLOTS 32
+#define EFI_ST_MAX_PAGES 16
+#define EFI_ST_CYCLES 4096
+#define EFI_ST_CHECK_INTERVAL 256
+
+static struct efi_boot_services *boottime;
+static u64 map_pages;
+static struct {
+	u64 addr;
+	efi_uintn_t pages;
+	int memory_type;
+} slots[EFI_ST_SLOTS];
+static u32 seed;
+
+/**
+ * rnd() - pseudo random number
+ *
+ * Return:	next value of a linear congruential generator
+ */
+static u32 rnd(void)
+{
+	seed = seed * 1103515245 + 12345;
+	return seed >> 16;
+}
+
+/**
+ * setup() - setup unit test
+ *
+ * @handle:	handle of the loaded image
+ * @systable:	system table
+ * Return:	EFI_ST_SUCCESS for success
+ */
+static int setup(const efi_handle_t handle,
+		 const struct efi_system_table *systable)
+{
+	efi_status_t ret;
+
+	boottime = systable->boottime;
+	seed = 1;
+
+	ret = boottime->allocate_pages(EFI_ALLOCATE_ANY_PAGES,
+				       EFI_LOADER_DATA, 2 * EFI_ST_MAP_PAGES,
+				       &map_pages);
+	if (ret != EFI_SUCCESS) {
+		efi_st_error("AllocatePages did not return EFI_SUCCESS\n");
+		return EFI_ST_FAILURE;
+	}
+	return EFI_ST_SUCCESS;
+}
+
+/**
+ * teardown() - tear down unit test
+ *
+ * Return:	EFI_ST_SUCCESS for success
+ */
+static int teardown(void)
+{
+	efi_status_t ret;
+
+	if (!map_pages)
+		return EFI_ST_SUCCESS;
+	ret = boottime->free_pages(map_pages, 2 * EFI_ST_MAP_PAGES);
+	map_pages = 0;
+	if (ret != EFI_SUCCESS) {
+		efi_st_error("FreePages did not return EFI_SUCCESS\n");
+		return EFI_ST_FAILURE;
+	}
+	return EFI_ST_SUCCESS;
+}
+
+/**
+ * get_map() - get and check the memory map
+ *
+ * The entries must be sorted by address, must not overlap, and must cover
+ * all pages allocated by the test with the memory type used.
+ *
+ * @memory_map:	buffer for the memory map
+ * @map_size:	returns the size of the memory map
+ * Return:	EFI_ST_SUCCESS for success
+ */
+static int get_map(struct efi_mem_desc *memory_map, efi_uintn_t *map_size)
+{
+	efi_uintn_t map_key;
+	efi_uintn_t desc_size;
+	u32 desc_version;
+	efi_uintn_t i, j, entries;
+	efi_status_t ret;
+
+	*map_size = EFI_ST_MAP_SIZE;
+	ret = boottime->get_memory_map(map_size, memory_map, &map_key,
+				       &desc_size, &desc_version);
+	if (ret != EFI_SUCCESS) {
+		efi_st_error("GetMemoryMap did not return EFI_SUCCESS\n");
+		return EFI_ST_FAILURE;
+	}
+	if (desc_size != sizeof(struct efi_mem_desc)) {
+		efi_st_error("Unexpected descriptor size\n");
+		return EFI_ST_FAILURE;
+	}
+	entries = *map_size / desc_size;
+
+	for (i = 0; i < entries; ++i) {
+		struct efi_mem_desc *entry = &memory_map[i];
+
+		if (!entry->num_pages ||
+		    entry->physical_start != entry->virtual_start) {
+			efi_st_error("Invalid memory map entry\n");
+			return EFI_ST_FAILURE;
+		}
+		if (i && entry->physical_start <
+			 memory_map[i - 1].physical_start +
+			 (memory_map[i - 1].num_pages << EFI_PAGE_SHIFT)) {
+			efi_st_error("Memory map entries overlap\n");
+			return EFI_ST_FAILURE;
+		}
+	}
+
+	for (j = 0; j < EFI_ST_SLOTS; ++j) {
+		u64 start = slots[j].addr;
+		u64 end = start + (slots[j].pages << EFI_PAGE_SHIFT);
+
+		if (!slots[j].pages)
+			continue;
+		for (i = 0; i < entries; ++i) {
+			struct efi_mem_desc *entry = &memory_map[i];
+
+			if (start >= entry->physical_start &&
+			    end <= entry->physical_start +
+				   (entry->num_pages << EFI_PAGE_SHIFT))
+				break;
+		}
+		if (i == entries ||
+		    memory_map[i].type != slots[j].memory_type) {
+			efi_st_error("Allocation %p not in memory map\n",
+				     (void *)(uintptr_t)start);
+			return EFI_ST_FAILURE;
+		}
+	}
+
+	return EFI_ST_SUCCESS;
+}
+
+/**
+ * allocate_slot() - allocate pages for a slot
+ *
+ * Either any pages or pages below the map buffers are requested. The new
+ * allocation must not overlap any other one made by the test.
+ *
+ * @slot:	index of the slot
+ * Return:	EFI_ST_SUCCESS for success
+ */
+static int allocate_slot(int slot)
+{
+	efi_uintn_t pages = 1 + rnd() % EFI_ST_MAX_PAGES;
+	int memory_type = rnd() & 1 ? EFI_LOADER_DATA : EFI_BOOT_SERVICES_DATA;
+	int type = EFI_ALLOCATE_ANY_PAGES;
+	u64 addr = 0;
+	efi_status_t ret;
+	int i;
+
+	if (rnd() & 1) {
+		type = EFI_ALLOCATE_MAX_ADDRESS;
+		addr = map_pages - 1;
+	}
+	ret = boottime->allocate_pages(type, memory_type, pages, &addr);
+	if (ret == EFI_OUT_OF_RESOURCES && type == EFI_ALLOCATE_MAX_ADDRESS)
+		return EFI_ST_SUCCESS;
+	if (ret != EFI_SUCCESS) {
+		efi_st_error("AllocatePages did not return EFI_SUCCESS\n");
+		return EFI_ST_FAILURE;
+	}
+	if (type == EFI_ALLOCATE_MAX_ADDRESS &&
+	    addr + (pages << EFI_PAGE_SHIFT) > map_pages) {
+		efi_st_error("AllocatePages ignored the maximum address\n");
+		return EFI_ST_FAILURE;
+	}
+	for (i = 0; i < EFI_ST_SLOTS; ++i) {
+		if (slots[i].pages &&
+		    addr < slots[i].addr + (slots[i].pages << EFI_PAGE_SHIFT) &&
+		    slots[i].addr < addr + (pages << EFI_PAGE_SHIFT)) {
+			efi_st_error("AllocatePages returned used memory\n");
+			return EFI_ST_FAILURE;
+		}
+	}
+	slots[slot].addr = addr;
+	slots[slot].pages = pages;
+	slots[slot].memory_type = memory_type;
+
+	return EFI_ST_SUCCESS;
+}
+
+/**
+ * free_slot() - free the pages of a slot
+ *
+ * @slot:	index of the slot
+ * Return:	EFI_ST_SUCCESS for success
+ */
+static int free_slot(int slot)
+{
+	efi_status_t ret;
+
+	ret = boottime->free_pages(slots[slot].addr, slots[slot].pages);
+	slots[slot].pages = 0;
+	if (ret != EFI_SUCCESS) {
+		efi_st_error("FreePages did not return EFI_SUCCESS\n");
+		return EFI_ST_FAILURE;
+	}
+	return EFI_ST_SUCCESS;
+}
+
+/*
+ * execute() - execute unit test
+ *
+ * Return:	EFI_ST_SUCCESS for success
+ */
+static int execute(void)
+{
+	struct efi_mem_desc *initial_map = (void *)(uintptr_t)map_pages;
+	struct efi_mem_desc *memory_map = (void *)(uintptr_t)(map_pages +
+							      EFI_ST_MAP_SIZE);
+	efi_uintn_t initial_size, map_size;
+	int i, slot, r;
+
+	if (get_map(initial_map, &initial_size) != EFI_ST_SUCCESS)
+		return EFI_ST_FAILURE;
+
+	for (i = 0; i < EFI_ST_CYCLES; ++i) {
+		slot = rnd() % EFI_ST_SLOTS;
+		if (slots[slot].pages)
+			r = free_slot(slot);
+		else
+			r = allocate_slot(slot);
+		if (r != EFI_ST_SUCCESS)
+			return r;
+		if (!((i + 1) % EFI_ST_CHECK_INTERVAL) &&
+		    get_map(memory_map, &map_size) != EFI_ST_SUCCESS)
+			return EFI_ST_FAILURE;
+	}
+
+	for (slot = 0; slot < EFI_ST_SLOTS; ++slot) {
+		if (slots[slot].pages && free_slot(slot) != EFI_ST_SUCCESS)
+			return EFI_ST_FAILURE;
+	}
+
+	/* Freed memory must be merged into the original entries again */
+	if (get_map(memory_map, &map_size) != EFI_ST_SUCCESS)
+		return EFI_ST_FAILURE;
+	if (map_size != initial_size ||
+	    memcmp(memory_map, initial_map, map_size)) {
+		efi_st_error("Memory map differs after freeing all pages\n");
+		return EFI_ST_FAILURE;
+	}
+
+	return EFI_ST_SUCCESS;
+}
+
+EFI_UNIT_TEST(memory_map) = {
+	.name = "memory map",
+	.phase = EFI_EXECUTE_BEFORE_BOOTTIME_EXIT,
+	.setup = setup,
+	.execute = execute,
+	.teardown = teardown,
+};
@@ -46,6 +46,65 @@
 
 static void default_log(const char *ignored, char *response) {}
 
+/**
+ * write_sparse_fill() - Write a CHUNK_TYPE_FILL chunk to storage
+ *
+ * @info: Storage backend to write to
+ * @blkp: Pointer to the first block to write, updated on return
+ * @blkcnt: Number of storage blocks to fill
+ * @fill_val: 32-bit pattern to fill the blocks with
+ * @response: Response buffer handed to info->mssg() on error
+ * @return 0 if OK, -1 on error
+ */
+static int write_sparse_fill(struct sparse_storage *info, lbaint_t *blkp,
+			     lbaint_t blkcnt, uint32_t fill_val,
+			     char *response)
+{
+	lbaint_t blk = *blkp;
+	lbaint_t blks;
+	uint32_t *fill_buf;
+	int fill_buf_num_blks;
+	int i;
+	int j;
+
+	fill_buf_num_blks = CONFIG_IMAGE_SPARSE_FILLBUF_SIZE / info->blksz;
+
+	fill_buf = (uint32_t *)
+		   memalign(ARCH_DMA_MINALIGN,
+			    ROUNDUP(info->blksz * fill_buf_num_blks,
+				    ARCH_DMA_MINALIGN));
+	if (!fill_buf) {
+		info->mssg("Malloc failed for: CHUNK_TYPE_FILL", response);
+		return -1;
+	}
+
+	for (i = 0;
+	     i < (info->blksz * fill_buf_num_blks / sizeof(fill_val));
+	     i++)
+		fill_buf[i] = fill_val;
+
+	for (i = 0; i < blkcnt;) {
+		j = blkcnt - i;
+		if (j > fill_buf_num_blks)
+			j = fill_buf_num_blks;
+		blks = info->write(info, blk, j, fill_buf);
+		/* blks might be > j (eg. NAND bad-blocks) */
+		if (blks < j) {
+			printf("%s: %s " LBAFU " [%d]\n", __func__,
+			       "Write failed, block #", blk, j);
+			info->mssg("flash write failure", response);
+			free(fill_buf);
+			return -1;
+		}
+		blk += blks;
+		i += j;
+	}
+	free(fill_buf);
+	*blkp = blk;
+
+	return 0;
+}
+
 int write_sparse_image(struct sparse_storage *info,
 		       const char *part_name, void *data, char *response)
 {
@@ -56,16 +115,10 @@ int write_sparse_image(struct sparse_storage *info,
 	unsigned int chunk;
 	unsigned int offset;
 	unsigned int chunk_data_sz;
-	uint32_t *fill_buf = NULL;
 	uint32_t fill_val;
 	sparse_header_t *sparse_header;
 	chunk_header_t *chunk_header;
 	uint32_t total_blocks = 0;
-	int fill_buf_num_blks;
-	int i;
-	int j;
-
-	fill_buf_num_blks = CONFIG_IMAGE_SPARSE_FILLBUF_SIZE / info->blksz;
 
 	/* Read and skip over sparse image header */
 	sparse_header = (sparse_header_t *)data;
@@ -171,26 +224,9 @@ int write_sparse_image(struct sparse_storage *info,
 				return -1;
 			}
 
-			fill_buf = (uint32_t *)
-				   memalign(ARCH_DMA_MINALIGN,
-					    ROUNDUP(
-						info->blksz * fill_buf_num_blks,
-						ARCH_DMA_MINALIGN));
-			if (!fill_buf) {
-				info->mssg("Malloc failed for: CHUNK_TYPE_FILL",
-					   response);
-				return -1;
-			}
-
 			fill_val = *(uint32_t *)data;
 			data = (char *)data + sizeof(uint32_t);
 
-			for (i = 0;
-			     i < (info->blksz * fill_buf_num_blks /
-				  sizeof(fill_val));
-			     i++)
-				fill_buf[i] = fill_val;
-
 			if (blk + blkcnt > info->start + info->size) {
 				printf(
 				    "%s: Request would exceed partition size!\n",
@@ -200,28 +236,11 @@ int write_sparse_image(struct sparse_storage *info,
 				return -1;
 			}
 
-			for (i = 0; i < blkcnt;) {
-				j = blkcnt - i;
-				if (j > fill_buf_num_blks)
-					j = fill_buf_num_blks;
-				blks = info->write(info, blk, j, fill_buf);
-				/* blks might be > j (eg. NAND bad-blocks) */
-				if (blks < j) {
-					printf("%s: %s " LBAFU " [%d]\n",
-					       __func__,
-					       "Write failed, block #",
-					       blk, j);
-					info->mssg("flash write failure",
-						   response);
-					free(fill_buf);
-					return -1;
-				}
-				blk += blks;
-				i += j;
-			}
+			if (write_sparse_fill(info, &blk, blkcnt, fill_val,
+					      response))
+				return -1;
 			bytes_written += blkcnt * info->blksz;
 			total_blocks += chunk_data_sz / sparse_header->blk_sz;
-			free(fill_buf);
 			break;
 
 		case CHUNK_TYPE_DONT_CARE:
@@ -259,3 +278,328 @@ int write_sparse_image(struct sparse_storage *info,
 
 	return 0;
 }
+
+enum sparse_stream_state {
+	SPARSE_STREAM_FILE_HDR,
+	SPARSE_STREAM_CHUNK_HDR,
+	SPARSE_STREAM_RAW,
+	SPARSE_STREAM_FILL,
+	SPARSE_STREAM_DONE,
+	SPARSE_STREAM_ERROR,
+};
+
+int sparse_stream_init(struct sparse_stream *stream,
+		       struct sparse_storage *info, const char *part_name,
+		       char *response)
+{
+	memset(stream, '\0', sizeof(*stream));
+	if (!info->mssg)
+		info->mssg = default_log;
+	stream->info = info;
+	stream->part_name = part_name;
+	stream->response = response;
+	stream->state = SPARSE_STREAM_FILE_HDR;
+	stream->blk = info->start;
+	stream->blk_buf = memalign(ARCH_DMA_MINALIGN,
+				   ROUNDUP(info->blksz, ARCH_DMA_MINALIGN));
+	if (!stream->blk_buf) {
+		info->mssg("Malloc failed for sparse stream", response);
+		return -ENOMEM;
+	}
+
+	return 0;
+}
+
+/**
+ * sparse_stream_collect() - Gather a header which may span several calls
+ *
+ * @stream: Stream state
+ * @hdr: Buffer to collect the header into
+ * @size: Size of the header in bytes
+ * @datap: Pointer to the input pointer, advanced on return
+ * @lenp: Pointer to the input length, reduced on return
+ * @return true if the header is complete, false if more data is needed
+ */
+static bool sparse_stream_collect(struct sparse_stream *stream, void *hdr,
+				  u32 size, const u8 **datap, size_t *lenp)
+{
+	u32 n = min_t(size_t, size - stream->hdr_len, *lenp);
+
+	memcpy(hdr + stream->hdr_len, *datap, n);
+	stream->hdr_len += n;
+	*datap += n;
+	*lenp -= n;
+	if (stream->hdr_len < size)
+		return false;
+	stream->hdr_len = 0;
+
+	return true;
+}
+
+static int sparse_stream_fail(struct sparse_stream *stream, const char *msg)
+{
+	stream->info->mssg(msg, stream->response);
+	stream->state = SPARSE_STREAM_ERROR;
+
+	return -1;
+}
+
+static void sparse_stream_next_chunk(struct sparse_stream *stream)
+{
+	if (++stream->chunk < stream->sparse_header.total_chunks)
+		stream->state = SPARSE_STREAM_CHUNK_HDR;
+	else
+		stream->state = SPARSE_STREAM_DONE;
+}
+
+static int sparse_stream_file_hdr(struct sparse_stream *stream)
+{
+	sparse_header_t *sparse_header = &stream->sparse_header;
+	unsigned int offset;
+
+	if (!is_sparse_image(sparse_header))
+		return sparse_stream_fail(stream, "invalid sparse image");
+	if (sparse_header->file_hdr_sz < sizeof(sparse_header_t) ||
+	    sparse_header->chunk_hdr_sz < sizeof(chunk_header_t))
+		return sparse_stream_fail(stream, "sparse image header issue");
+
+	div_u64_rem(sparse_header->blk_sz, stream->info->blksz, &offset);
+	if (!sparse_header->blk_sz || offset) {
+		printf("%s: Sparse image block size issue [%u]\n",
+		       __func__, sparse_header->blk_sz);
+		return sparse_stream_fail(stream,
+					  "sparse image block size issue");
+	}
+
+	puts("Flashing Sparse Image\n");
+
+	/* Skip the remaining bytes of a header longer than we expected */
+	stream->skip = sparse_header->file_hdr_sz - sizeof(sparse_header_t);
+	stream->chunk = 0;
+	if (sparse_header->total_chunks)
+		stream->state = SPARSE_STREAM_CHUNK_HDR;
+	else
+		stream->state = SPARSE_STREAM_DONE;
+
+	return 0;
+}
+
+static int sparse_stream_chunk_hdr(struct sparse_stream *stream)
+{
+	struct sparse_storage *info = stream->info;
+	sparse_header_t *sparse_header = &stream->sparse_header;
+	chunk_header_t *chunk_header = &stream->chunk_header;
+	u64 chunk_data_sz;
+	lbaint_t blkcnt;
+
+	debug("=== Chunk Header ===\n");
+	debug("chunk_type: 0x%x\n", chunk_header->chunk_type);
+	debug("chunk_data_sz: 0x%x\n", chunk_header->chunk_sz);
+	debug("total_size: 0x%x\n", chunk_header->total_sz);
+
+	stream->skip = sparse_header->chunk_hdr_sz - sizeof(chunk_header_t);
+	chunk_data_sz = (u64)sparse_header->blk_sz * chunk_header->chunk_sz;
+	blkcnt = lldiv(chunk_data_sz, info->blksz);
+
+	switch (chunk_header->chunk_type) {
+	case CHUNK_TYPE_RAW:
+		if (chunk_header->total_sz !=
+		    sparse_header->chunk_hdr_sz + chunk_data_sz)
+			return sparse_stream_fail(stream,
+					"Bogus chunk size for chunk type Raw");
+		if (stream->blk + blkcnt > info->start + info->size) {
+			printf("%s: Request would exceed partition size!\n",
+			       __func__);
+			return sparse_stream_fail(stream,
+					"Request would exceed partition size!");
+		}
+		stream->raw_left = chunk_data_sz;
+		stream->total_blocks += chunk_header->chunk_sz;
+		if (stream->raw_left)
+			stream->state = SPARSE_STREAM_RAW;
+		else
+			sparse_stream_next_chunk(stream);
+		break;
+
+	case CHUNK_TYPE_FILL:
+		if (chunk_header->total_sz !=
+		    sparse_header->chunk_hdr_sz + sizeof(uint32_t))
+			return sparse_stream_fail(stream,
+					"Bogus chunk size for chunk type FILL");
+		if (stream->blk + blkcnt > info->start + info->size) {
+			printf("%s: Request would exceed partition size!\n",
+			       __func__);
+			return sparse_stream_fail(stream,
+					"Request would exceed partition size!");
+		}
+		stream->state = SPARSE_STREAM_FILL;
+		break;
+
+	case CHUNK_TYPE_DONT_CARE:
+		stream->blk += info->reserve(info, stream->blk, blkcnt);
+		stream->total_blocks += chunk_header->chunk_sz;
+		sparse_stream_next_chunk(stream);
+		break;
+
+	case CHUNK_TYPE_CRC32:
+		if (chunk_header->total_sz != sparse_header->chunk_hdr_sz)
+			return sparse_stream_fail(stream,
+					"Bogus chunk size for chunk type Dont Care");
+		stream->skip += chunk_data_sz;
+		stream->total_blocks += chunk_header->chunk_sz;
+		sparse_stream_next_chunk(stream);
+		break;
+
+	default:
+		printf("%s: Unknown chunk type: %x\n", __func__,
+		       chunk_header->chunk_type);
+		return sparse_stream_fail(stream, "Unknown chunk type");
+	}
+
+	return 0;
+}
+
+static int sparse_stream_write_blocks(struct sparse_stream *stream,
+				      const void *buffer, lbaint_t blkcnt)
+{
+	struct sparse_storage *info = stream->info;
+	lbaint_t blks;
+
+	blks = info->write(info, stream->blk, blkcnt, buffer);
+	/* blks might be > blkcnt (eg. NAND bad-blocks) */
+	if (blks < blkcnt) {
+		printf("%s: %s" LBAFU " [" LBAFU "]\n", __func__,
+		       "Write failed, block #", stream->blk, blks);
+		return sparse_stream_fail(stream, "flash write failure");
+	}
+	stream->blk += blks;
+	stream->bytes_written += blkcnt * info->blksz;
+
+	return 0;
+}
+
+/**
+ * sparse_stream_raw() - Write the next piece of a CHUNK_TYPE_RAW chunk
+ *
+ * Whole blocks are written straight from the input; a block which is split
+ * across calls is gathered in the bounce buffer first.
+ *
+ * @stream: Stream state
+ * @datap: Pointer to the input pointer, advanced on return
+ * @lenp: Pointer to the input length, reduced on return
+ * @return 0 if OK, -1 on error
+ */
+static int sparse_stream_raw(struct sparse_stream *stream, const u8 **datap,
+			     size_t *lenp)
+{
+	u32 blksz = stream->info->blksz;
+	size_t avail = min_t(u64, *lenp, stream->raw_left);
+	size_t n;
+
+	if (stream->blk_fill || avail < blksz) {
+		n = min_t(size_t, blksz - stream->blk_fill, avail);
+		memcpy(stream->blk_buf + stream->blk_fill, *datap, n);
+		stream->blk_fill += n;
+		if (stream->blk_fill == blksz) {
+			if (sparse_stream_write_blocks(stream,
+						       stream->blk_buf, 1))
+				return -1;
+			stream->blk_fill = 0;
+		}
+	} else {
+		n = avail - (avail % blksz);
+		if (sparse_stream_write_blocks(stream, *datap, n / blksz))
+			return -1;
+	}
+
+	*datap += n;
+	*lenp -= n;
+	stream->raw_left -= n;
+	if (!stream->raw_left)
+		sparse_stream_next_chunk(stream);
+
+	return 0;
+}
+
+int sparse_stream_write(struct sparse_stream *stream, const void *data,
+			size_t len)
+{
+	const u8 *ptr = data;
+	size_t n;
+
+	while (len && stream->state != SPARSE_STREAM_ERROR) {
+		if (stream->skip) {
+			n = min_t(size_t, stream->skip, len);
+			ptr += n;
+			len -= n;
+			stream->skip -= n;
+			continue;
+		}
+
+		switch (stream->state) {
+		case SPARSE_STREAM_FILE_HDR:
+			if (sparse_stream_collect(stream,
+						  &stream->sparse_header,
+						  sizeof(sparse_header_t),
+						  &ptr, &len))
+				sparse_stream_file_hdr(stream);
+			break;
+		case SPARSE_STREAM_CHUNK_HDR:
+			if (sparse_stream_collect(stream, &stream->chunk_header,
+						  sizeof(chunk_header_t),
+						  &ptr, &len))
+				sparse_stream_chunk_hdr(stream);
+			break;
+		case SPARSE_STREAM_RAW:
+			sparse_stream_raw(stream, &ptr, &len);
+			break;
+		case SPARSE_STREAM_FILL:
+			if (!sparse_stream_collect(stream, &stream->fill_val,
+						   sizeof(uint32_t),
+						   &ptr, &len))
+				break;
+			if (write_sparse_fill(stream->info, &stream->blk,
+				lldiv((u64)stream->sparse_header.blk_sz *
+				      stream->chunk_header.chunk_sz,
+				      stream->info->blksz),
+				stream->fill_val, stream->response)) {
+				stream->state = SPARSE_STREAM_ERROR;
+				break;
+			}
+			stream->bytes_written += stream->sparse_header.blk_sz *
+						 stream->chunk_header.chunk_sz;
+			stream->total_blocks += stream->chunk_header.chunk_sz;
+			sparse_stream_next_chunk(stream);
+			break;
+		case SPARSE_STREAM_DONE:
+			/* Ignore anything after the last chunk */
+			len = 0;
+			break;
+		}
+	}
+
+	return stream->state == SPARSE_STREAM_ERROR ? -1 : 0;
+}
+
+int sparse_stream_finish(struct sparse_stream *stream)
+{
+	free(stream->blk_buf);
+	stream->blk_buf = NULL;
+
+	if (stream->state == SPARSE_STREAM_ERROR)
+		return -1;
+
+	debug("Wrote %d blocks, expected to write %d blocks\n",
+	      stream->total_blocks, stream->sparse_header.total_blks);
+	printf("........ wrote %u bytes to '%s'\n", stream->bytes_written,
+	       stream->part_name);
+
+	if (stream->state != SPARSE_STREAM_DONE ||
+	    stream->total_blocks != stream->sparse_header.total_blks) {
+		stream->info->mssg("sparse image write failure",
+				   stream->response);
+		return -1;
+	}
+
+	return 0;
+}
@@ -7,6 +7,9 @@
 #include <compiler.h>
 #include <image.h>
 #include <lz4.h>
+#include <malloc.h>
+#include <asm/unaligned.h>
+#include <linux/bitops.h>
 #include <linux/kernel.h>
 #include <linux/types.h>
 
@@ -30,7 +33,8 @@ struct lz4_frame_header {
 	union {
 		u8 flags;
 		struct {
-			u8 reserved0:2;
+			u8 has_dict_id:1;
+			u8 reserved0:1;
 			u8 has_content_checksum:1;
 			u8 has_content_size:1;
 			u8 has_block_checksum:1;
@@ -62,77 +66,270 @@ struct lz4_block_header {
 	/* + u32 block_checksum iff has_block_checksum is set */
 } __packed;
 
-int ulz4fn(const void *src, size_t srcn, void *dst, size_t *dstn)
+enum lz4_stream_state {
+	LZ4S_HEADER,		/* frame header */
+	LZ4S_BLOCK,		/* block header */
+	LZ4S_DATA,		/* block data */
+	LZ4S_BLOCK_CHECKSUM,
+	LZ4S_CONTENT_CHECKSUM,
+	LZ4S_DONE,
+};
+
+/* Part of the frame header needed to know how long the rest is */
+#define LZ4S_HEADER_START	6
+
+/* Frame header flags kept in struct lz4_stream */
+#define LZ4S_CONTENT_CHECKSUM_FLAG	BIT(2)
+#define LZ4S_CONTENT_SIZE_FLAG		BIT(3)
+#define LZ4S_BLOCK_CHECKSUM_FLAG	BIT(4)
+#define LZ4S_INDEPENDENT_FLAG		BIT(5)
+
+void ulz4_stream_init(struct lz4_stream *s, void *dst, size_t dstn)
 {
-	const void *end = dst + *dstn;
-	const void *in = src;
-	void *out = dst;
-	int has_block_checksum;
-	int ret;
-	*dstn = 0;
+	memset(s, '\0', sizeof(*s));
+	s->dst = dst;
+	s->out = dst;
+	s->end = dst + dstn;
+	s->state = LZ4S_HEADER;
+	s->hdr_len = LZ4S_HEADER_START;
+}
 
-	{ /* With in-place decompression the header may become invalid later. */
-		const struct lz4_frame_header *h = in;
+/* Start the next field, of @len bytes, to be read into s->hdr */
+static void lz4s_next(struct lz4_stream *s, int state, int len)
+{
+	s->state = state;
+	s->hdr_len = len;
+	s->pos = 0;
+}
 
-		if (srcn < sizeof(*h) + sizeof(u64) + sizeof(u8))
-			return -EINVAL;	/* input overrun */
+static int lz4s_parse_header(struct lz4_stream *s)
+{
+	const struct lz4_frame_header *h = (void *)s->hdr;
+	u8 csum;
 
-		/* We assume there's always only a single, standard frame. */
-		if (le32_to_cpu(h->magic) != LZ4F_MAGIC || h->version != 1)
-			return -EPROTONOSUPPORT;	/* unknown format */
-		if (h->reserved0 || h->reserved1 || h->reserved2)
-			return -EINVAL;	/* reserved must be zero */
-		if (!h->independent_blocks)
-			return -EPROTONOSUPPORT; /* we can't support this yet */
-		has_block_checksum = h->has_block_checksum;
+	if (le32_to_cpu(h->magic) != LZ4F_MAGIC || h->version != 1)
+		return -EPROTONOSUPPORT;	/* unknown format */
+	if (h->reserved0 || h->reserved1 || h->reserved2)
+		return -EINVAL;	/* reserved must be zero */
+	if (h->has_dict_id)
+		return -EPROTONOSUPPORT;	/* no dictionary to use */
+	if (h->max_block_size < 4)
+		return -EINVAL;
 
-		in += sizeof(*h);
+	/* now read the rest of the header */
+	if (s->hdr_len == LZ4S_HEADER_START) {
+		s->hdr_len = sizeof(*h) + sizeof(u8);
 		if (h->has_content_size)
-			in += sizeof(u64);
-		in += sizeof(u8);
+			s->hdr_len += sizeof(u64);
+		return 0;
 	}
 
-	while (1) {
-		struct lz4_block_header b;
+	/* second byte of the hash of the descriptor, without the magic */
+	csum = xxh32(s->hdr + 4, s->hdr_len - 5, 0) >> 8;
+	if (csum != s->hdr[s->hdr_len - 1])
+		return -EBADMSG;
 
-		b.raw = le32_to_cpu(*(u32 *)in);
-		in += sizeof(struct lz4_block_header);
+	s->flags = h->flags;
+	s->block_max = 1 << (8 + 2 * h->max_block_size);
+	if (h->has_content_size)
+		s->content_size = get_unaligned_le64(s->hdr + sizeof(*h));
+	xxh32_reset(&s->content_xxh, 0);
+	lz4s_next(s, LZ4S_BLOCK, sizeof(struct lz4_block_header));
 
-		if (in - src + b.size > srcn) {
-			ret = -EINVAL;		/* input overrun */
-			break;
-		}
+	return 0;
+}
+
+/* Decompress a whole block from @src */
+static int lz4s_decode(struct lz4_stream *s, const void *src)
+{
+	const u8 *low;
+	int ret;
+
+	/*
+	 * Linked blocks may refer back into the previous blocks, which are
+	 * just before s->out in the output buffer. The decoder is given all
+	 * of the remaining output space rather than the block size, so its
+	 * wild copies run up to the end of each block and only the last bytes
+	 * of the buffer need the careful path.
+	 */
+	low = (s->flags & LZ4S_INDEPENDENT_FLAG) ? s->out : s->dst;
 
-		if (!b.size) {
-			ret = 0;	/* decompression successful */
-			break;
+	/* constant folding essential, do not touch params! */
+	ret = LZ4_decompress_generic(src, (char *)s->out, s->block_size,
+				     s->end - s->out, endOnInputSize, full, 0,
+				     noDict, low, NULL, 0);
+	if (ret < 0 || ret > s->block_max)
+		return -EPROTO;	/* decompression error */
+	if (s->flags & LZ4S_CONTENT_CHECKSUM_FLAG)
+		xxh32_update(&s->content_xxh, s->out, ret);
+	s->out += ret;
+
+	return 0;
+}
+static int lz4s_parse_block(struct lz4_stream *s)
+{
+	struct lz4_block_header b;
+
+	b.raw = get_unaligned_le32(s->hdr);
+	if (!b.raw) {
+		/* end mark */
+		if (s->flags & LZ4S_CONTENT_CHECKSUM_FLAG)
+			lz4s_next(s, LZ4S_CONTENT_CHECKSUM, sizeof(u32));
+		else
+			lz4s_next(s, LZ4S_DONE, 0);
+		return 0;
+	}
+	if (b.size > s->block_max)
+		return -EINVAL;
+
+	s->block_size = b.size;
+	s->raw = b.not_compressed;
+	xxh32_reset(&s->block_xxh, 0);
+	lz4s_next(s, LZ4S_DATA, 0);
+
+	return 0;
+}
+
+/* Handle a field once all of it is in s->hdr */
+static int lz4s_parse(struct lz4_stream *s)
+{
+	u32 csum = get_unaligned_le32(s->hdr);
+
+	switch (s->state) {
+	case LZ4S_HEADER:
+		return lz4s_parse_header(s);
+	case LZ4S_BLOCK:
+		return lz4s_parse_block(s);
+	case LZ4S_BLOCK_CHECKSUM:
+		if (csum != xxh32_digest(&s->block_xxh))
+			return -EBADMSG;
+		lz4s_next(s, LZ4S_BLOCK, sizeof(struct lz4_block_header));
+		return 0;
+	case LZ4S_CONTENT_CHECKSUM:
+		if (csum != xxh32_digest(&s->content_xxh))
+			return -EBADMSG;
+		lz4s_next(s, LZ4S_DONE, 0);
+		return 0;
+	}
+
+	return -EINVAL;
+}
+
+/* Take up to @len bytes of block data, returns number used or -ve error */
+static int lz4s_data(struct lz4_stream *s, const u8 *in, size_t len)
+{
+	size_t n = min_t(size_t, len, s->block_size - s->pos);
+	const u8 *data = NULL;
+	int ret = 0;
+
+	if (s->flags & LZ4S_BLOCK_CHECKSUM_FLAG)
+		xxh32_update(&s->block_xxh, in, n);
+
+	if (s->raw) {
+		size_t size = min_t(size_t, n, s->end - s->out);
+
+		/* the input may be further on in the same buffer */
+		memmove(s->out, in, size);
+		if (s->flags & LZ4S_CONTENT_CHECKSUM_FLAG)
+			xxh32_update(&s->content_xxh, s->out, size);
+		s->out += size;
+		if (size < n)
+			return -ENOBUFS;	/* output overrun */
+	} else if (!s->pos && n == s->block_size) {
+		/* the whole block is here, no need to copy it */
+		data = in;
+	} else {
+		if (!s->buf) {
+			s->buf = malloc(s->block_max);
+			if (!s->buf)
+				return -ENOMEM;
 		}
+		memcpy(s->buf + s->pos, in, n);
+		if (s->pos + n == s->block_size)
+			data = s->buf;
+	}
+	s->pos += n;
 
-		if (b.not_compressed) {
-			size_t size = min((ptrdiff_t)b.size, end - out);
-			memcpy(out, in, size);
-			out += size;
-			if (size < b.size) {
-				ret = -ENOBUFS;	/* output overrun */
-				break;
-			}
-		} else {
-			/* constant folding essential, do not touch params! */
-			ret = LZ4_decompress_generic(in, out, b.size,
-					end - out, endOnInputSize,
-					full, 0, noDict, out, NULL, 0);
-			if (ret < 0) {
-				ret = -EPROTO;	/* decompression error */
+	if (s->pos == s->block_size) {
+		if (data)
+			ret = lz4s_decode(s, data);
+		if (s->flags & LZ4S_BLOCK_CHECKSUM_FLAG)
+			lz4s_next(s, LZ4S_BLOCK_CHECKSUM, sizeof(u32));
+		else
+			lz4s_next(s, LZ4S_BLOCK,
+				  sizeof(struct lz4_block_header));
+	}
+
+	return ret ? ret : n;
+}
+
+int ulz4_stream_decompress(struct lz4_stream *s, const void *src,
+			   size_t *srcn)
+{
+	const u8 *in = src;
+	size_t n, left = *srcn;
+	int ret = 0;
+
+	/* @srcn may be a huge value when the caller does not know the size */
+	while (left && s->state != LZ4S_DONE) {
+		if (s->state == LZ4S_DATA) {
+			ret = lz4s_data(s, in, left);
+			if (ret < 0)
 				break;
-			}
-			out += ret;
+			in += ret;
+			left -= ret;
+			ret = 0;
+			continue;
 		}
 
-		in += b.size;
-		if (has_block_checksum)
-			in += sizeof(u32);
+		n = min_t(size_t, left, s->hdr_len - s->pos);
+		memcpy(s->hdr + s->pos, in, n);
+		in += n;
+		left -= n;
+		s->pos += n;
+		if (s->pos == s->hdr_len) {
+			ret = lz4s_parse(s);
+			if (ret)
+				break;
+		}
 	}
+	*srcn = in - (const u8 *)src;
+	if (ret)
+		return ret;
+
+	return s->state == LZ4S_DONE;
+}
+
+int ulz4_stream_finish(struct lz4_stream *s, size_t *dstn)
+{
+	free(s->buf);
+	s->buf = NULL;
+	*dstn = s->out - s->dst;
+	if (s->state != LZ4S_DONE)
+		return -EINVAL;	/* input overrun */
+	if ((s->flags & LZ4S_CONTENT_SIZE_FLAG) && s->content_size != *dstn)
+		return -EBADMSG;
+
+	return 0;
+}
 
-	*dstn = out - dst;
-	return ret;
+int ulz4fn(const void *src, size_t srcn, void *dst, size_t *dstn)
+{
+	struct lz4_stream s;
+	int ret, err;
+
+	ulz4_stream_init(&s, dst, *dstn);
+	ret = ulz4_stream_decompress(&s, src, &srcn);
+	err = ulz4_stream_finish(&s, dstn);
+
+	return ret < 0 ? ret : err;
+}
+
+int LZ4_decompress_safe(const char *source, char *dest, int inputSize,
+			int maxDecompressedSize)
+{
+	/* constant folding essential, do not touch params! */
+	return LZ4_decompress_generic(source, dest, inputSize,
+				      maxDecompressedSize, endOnInputSize,
+				      full, 0, noDict, (BYTE *)dest, NULL, 0);
 }
@@ -11,6 +11,7 @@
 #include <linux/errno.h>
 #include <asm/types.h>
 #include <asm/unaligned.h>
+#include <malloc.h>
 #else
 #include "fdt_host.h"
 #include "mkimage.h"
@@ -27,6 +28,14 @@
 /* Default public exponent for backward compatibility */
 #define RSA_DEFAULT_PUBEXP	65537
 
+/*
+ * Exponents longer than this are processed with a sliding window of up to
+ * RSA_WINDOW_BITS bits, using a table of odd powers of the signature. Short
+ * exponents such as 65537 have too few set bits for that to pay off.
+ */
+#define RSA_WINDOW_MIN_EXP_BITS	24
+#define RSA_WINDOW_BITS		4
+
 /**
  * subtract_modulus() - subtract modulus from the given value
  *
@@ -238,6 +247,302 @@ static int pow_mod(const struct rsa_public_key *key, uint32_t *inout)
 	return 0;
 }
 
+#ifdef RSA_MONT_64
+/**
+ * subtract_modulus64() - subtract modulus from the given value
+ *
+ * @ctx:	Context containing modulus to subtract
+ * @num:	Number to subtract modulus from, as little endian limb array
+ */
+static void subtract_modulus64(const struct rsa_mod_exp_ctx *ctx,
+			       uint64_t num[])
+{
+	uint64_t borrow = 0, m;
+	uint i;
+
+	for (i = 0; i < ctx->key.len / 2; i++) {
+		m = ctx->modulus64[i] + borrow;
+		borrow = m < borrow;
+		borrow |= num[i] < m;
+		num[i] -= m;
+	}
+}
+
+/**
+ * greater_equal_modulus64() - check if a value is >= modulus
+ *
+ * @ctx:	Context containing modulus to check
+ * @num:	Number to check against modulus, as little endian limb array
+ * @return 0 if num < modulus, 1 if num >= modulus
+ */
+static int greater_equal_modulus64(const struct rsa_mod_exp_ctx *ctx,
+				   const uint64_t num[])
+{
+	int i;
+
+	for (i = (int)ctx->key.len / 2 - 1; i >= 0; i--) {
+		if (num[i] < ctx->modulus64[i])
+			return 0;
+		if (num[i] > ctx->modulus64[i])
+			return 1;
+	}
+
+	return 1;  /* equal */
+}
+
+/**
+ * montgomery_mul_add_step64() - Perform montgomery multiply-add step
+ *
+ * This is montgomery_mul_add_step() with 64-bit limbs, so it needs a quarter
+ * of the multiplications for the same key.
+ *
+ * Operation: montgomery result[] += a * b[] / n0inv % modulus
+ *
+ * @ctx:	Prepared RSA key
+ * @result:	Place to put result, as little endian limb array
+ * @a:		Multiplier
+ * @b:		Multiplicand, as little endian limb array
+ */
+static void montgomery_mul_add_step64(const struct rsa_mod_exp_ctx *ctx,
+				      uint64_t result[], const uint64_t a,
+				      const uint64_t b[])
+{
+	const uint64_t *modulus = ctx->modulus64;
+	const uint len = ctx->key.len / 2;
+	__uint128_t acc_a, acc_b;
+	uint64_t d0;
+	uint i;
+
+	acc_a = (__uint128_t)a * b[0] + result[0];
+	d0 = (uint64_t)acc_a * ctx->n0inv64;
+	acc_b = (__uint128_t)d0 * modulus[0] + (uint64_t)acc_a;
+	for (i = 1; i < len; i++) {
+		acc_a = (acc_a >> 64) + (__uint128_t)a * b[i] + result[i];
+		acc_b = (acc_b >> 64) + (__uint128_t)d0 * modulus[i] +
+				(uint64_t)acc_a;
+		result[i - 1] = (uint64_t)acc_b;
+	}
+
+	acc_a = (acc_a >> 64) + (acc_b >> 64);
+
+	result[i - 1] = (uint64_t)acc_a;
+
+	if (acc_a >> 64)
+		subtract_modulus64(ctx, result);
+}
+
+/**
+ * montgomery_mul64() - Perform montgomery mutitply with 64-bit limbs
+ *
+ * Operation: montgomery result[] = a[] * b[] / n0inv % modulus
+ *
+ * @ctx:	Prepared RSA key
+ * @result:	Place to put result, as little endian limb array
+ * @a:		Multiplier, as little endian limb array
+ * @b:		Multiplicand, as little endian limb array
+ */
+static void montgomery_mul64(const struct rsa_mod_exp_ctx *ctx,
+			     uint64_t result[], const uint64_t a[],
+			     const uint64_t b[])
+{
+	uint i;
+
+	for (i = 0; i < ctx->key.len / 2; ++i)
+		result[i] = 0;
+	for (i = 0; i < ctx->key.len / 2; ++i)
+		montgomery_mul_add_step64(ctx, result, a[i], b);
+}
+
+/**
+ * rsa_n0inv64() - Calculate -1 / n0 mod 2^64
+ *
+ * @n0:		Lowest limb of the modulus, which is odd
+ * @return -1 / n0 mod 2^64
+ */
+static uint64_t rsa_n0inv64(uint64_t n0)
+{
+	uint64_t inv = n0;	/* n0 * n0 == 1 mod 8 for odd n0 */
+	int i;
+
+	/* Each Newton step doubles the number of correct bits */
+	for (i = 0; i < 5; i++)
+		inv *= 2 - n0 * inv;
+
+	return -inv;
+}
+
+/* Set @num to the value 1 */
+static void rsa_set_one64(const struct rsa_mod_exp_ctx *ctx, uint64_t *num)
+{
+	memset(num, '\0', ctx->key.len / 2 * sizeof(uint64_t));
+	num[0] = 1;
+}
+
+static uint64_t rsa_get_be64(const uint8_t *p)
+{
+	uint64_t val = 0;
+	int i;
+
+	for (i = 0; i < 8; i++)
+		val = val << 8 | *p++;
+
+	return val;
+}
+
+static void rsa_put_be64(uint8_t *p, uint64_t val)
+{
+	int i;
+
+	for (i = 7; i >= 0; i--) {
+		p[i] = (uint8_t)val;
+		val >>= 8;
+	}
+}
+
+/* Convert a big endian byte array to a little endian limb array */
+static void rsa_load64(const struct rsa_mod_exp_ctx *ctx, uint64_t *num,
+		       const uint8_t *in)
+{
+	const uint words = ctx->key.len / 2;
+	uint i;
+
+	for (i = 0; i < words; i++)
+		num[i] = rsa_get_be64(in + (words - 1 - i) * 8);
+}
+
+/* Reduce a little endian limb array below the modulus and store it */
+static void rsa_store64(const struct rsa_mod_exp_ctx *ctx, uint8_t *out,
+			uint64_t *num)
+{
+	const uint words = ctx->key.len / 2;
+	uint i;
+
+	/* Make sure result < mod; result is at most 1x mod too large. */
+	if (greater_equal_modulus64(ctx, num))
+		subtract_modulus64(ctx, num);
+	for (i = 0; i < words; i++)
+		rsa_put_be64(out + (words - 1 - i) * 8, num[i]);
+}
+
+/**
+ * rsa_mod_exp_wide() - exponentiation with 64-bit limbs
+ *
+ * This uses a sliding window for long exponents. For exponents ending in an
+ * isolated set bit, the last multiplication is by the unscaled signature,
+ * which also leaves Montgomery form.
+ *
+ * @ctx:	Prepared key, with @ctx->wide set
+ * @sig:	Signature, as a big endian byte array
+ * @out:	Result, as a big endian byte array
+ */
+static void rsa_mod_exp_wide(struct rsa_mod_exp_ctx *ctx, const uint8_t *sig,
+			     uint8_t *out)
+{
+	const uint64_t exponent = ctx->key.exponent;
+	const uint words = ctx->key.len / 2;
+	uint64_t *val, *acc, *tmp, *table, *swap;
+	bool started = false, reduced = false;
+	int bit, low, i;
+	uint value;
+
+	val = ctx->scratch;
+	acc = val + words;
+	tmp = acc + words;
+	table = tmp + words;
+
+#define RSA_MUL(a, b) do {			\
+	montgomery_mul64(ctx, tmp, a, b);	\
+	swap = acc;				\
+	acc = tmp;				\
+	tmp = swap;				\
+} while (0)
+
+	/* table[i] = a^(2i + 1) * R mod n */
+	rsa_load64(ctx, val, sig);
+	montgomery_mul64(ctx, table, val, ctx->rr64);
+	if (ctx->window > 1) {
+		montgomery_mul64(ctx, acc, table, table);
+		for (i = 1; i < 1 << (ctx->window - 1); i++)
+			montgomery_mul64(ctx, table + i * words,
+					 table + (i - 1) * words, acc);
+	}
+
+	/* Work down from the top bit, which is set */
+	for (bit = ctx->exp_bits - 1; bit >= 0; bit = low - 1) {
+		if (!((exponent >> bit) & 1)) {
+			RSA_MUL(acc, acc);
+			low = bit;
+			continue;
+		}
+
+		/* Find the longest window ending in a set bit */
+		low = bit >= ctx->window ? bit - ctx->window + 1 : 0;
+		while (!((exponent >> low) & 1))
+			low++;
+		value = (exponent >> low) & ((1U << (bit - low + 1)) - 1);
+
+		if (!started) {
+			memcpy(acc, table + (value >> 1) * words,
+			       words * sizeof(uint64_t));
+			started = true;
+			continue;
+		}
+		for (i = bit; i >= low; i--)
+			RSA_MUL(acc, acc);
+
+		/*
+		 * Multiplying by the unscaled signature leaves Montgomery form,
+		 * which saves a final multiplication for exponents ending in
+		 * an isolated set bit, such as 65537.
+		 */
+		if (!low && value == 1) {
+			RSA_MUL(acc, val);
+			reduced = true;
+		} else {
+			RSA_MUL(acc, table + (value >> 1) * words);
+		}
+	}
+#undef RSA_MUL
+
+	if (!reduced) {
+		rsa_set_one64(ctx, val);
+		montgomery_mul64(ctx, tmp, acc, val);
+		acc = tmp;
+	}
+	rsa_store64(ctx, out, acc);
+}
+#endif /* RSA_MONT_64 */
+
+int rsa_mod_exp_ctx(struct rsa_mod_exp_ctx *ctx, const uint8_t *sig,
+		    uint32_t sig_len, uint8_t *out)
+{
+	uint32_t *buf = (uint32_t *)ctx->scratch;
+	int ret;
+
+	if (sig_len != ctx->key.len * sizeof(uint32_t)) {
+		debug("Signature is of incorrect length %u\n", sig_len);
+		return -EINVAL;
+	}
+
+#ifdef RSA_MONT_64
+	if (ctx->wide) {
+		rsa_mod_exp_wide(ctx, sig, out);
+		return 0;
+	}
+#endif
+	/*
+	 * With 32-bit limbs the plain binary method is faster, since there
+	 * is no table to set up and no final multiplication
+	 */
+	memcpy(buf, sig, sig_len);
+	ret = pow_mod(&ctx->key, buf);
+	if (ret)
+		return ret;
+	memcpy(out, buf, sig_len);
+
+	return 0;
+}
+
 static void rsa_convert_big_endian(uint32_t *dst, const uint32_t *src, int len)
 {
 	int i;
@@ -246,16 +551,108 @@ static void rsa_convert_big_endian(uint32_t *dst, const uint32_t *src, int len)
 		dst[i] = fdt32_to_cpu(src[len - 1 - i]);
 }
 
-int rsa_mod_exp_sw(const uint8_t *sig, uint32_t sig_len,
-		struct key_prop *prop, uint8_t *out)
+static void rsa_get_exponent(struct key_prop *prop, uint64_t *exponent)
+{
+	if (!prop->public_exponent)
+		*exponent = RSA_DEFAULT_PUBEXP;
+	else
+		rsa_convert_big_endian((uint32_t *)exponent,
+				       prop->public_exponent, 2);
+}
+
+int rsa_mod_exp_ctx_new(struct key_prop *prop, struct rsa_mod_exp_ctx **ctxp)
+{
+	struct rsa_mod_exp_ctx *ctx;
+	uint64_t exponent;
+	int exp_bits, window;
+	uint len, words;
+
+	if (!prop->num_bits || !prop->modulus || !prop->rr) {
+		debug("%s: Missing RSA key info", __func__);
+		return -EFAULT;
+	}
+	if (prop->num_bits > RSA_MAX_KEY_BITS ||
+	    prop->num_bits < RSA_MIN_KEY_BITS) {
+		debug("RSA key bits %u outside allowed range %d..%d\n",
+		      prop->num_bits, RSA_MIN_KEY_BITS, RSA_MAX_KEY_BITS);
+		return -EFAULT;
+	}
+	len = prop->num_bits / 32;
+	words = (len + 1) / 2;
+
+	rsa_get_exponent(prop, &exponent);
+	if (!(exponent & 1) || exponent < 3) {
+		debug("RSA public exponent must be odd and at least 3\n");
+		return -EINVAL;
+	}
+	for (exp_bits = 0; exp_bits < 64 && exponent >> exp_bits; exp_bits++)
+		;
+	window = exp_bits > RSA_WINDOW_MIN_EXP_BITS ? RSA_WINDOW_BITS : 1;
+
+	/* Signature, accumulator, temporary and odd powers of the signature */
+	ctx = malloc(sizeof(*ctx) +
+		     (3 + (1 << (window - 1))) * words * sizeof(uint64_t));
+	if (!ctx)
+		return -ENOMEM;
+
+	ctx->key.len = len;
+	ctx->key.n0inv = prop->n0inv;
+	ctx->key.exponent = exponent;
+	ctx->key.modulus = ctx->modulus;
+	ctx->key.rr = ctx->rr;
+	rsa_convert_big_endian(ctx->modulus, prop->modulus, len);
+	rsa_convert_big_endian(ctx->rr, prop->rr, len);
+	ctx->exp_bits = exp_bits;
+	ctx->window = window;
+	ctx->wide = false;
+
+#ifdef RSA_MONT_64
+	/* R is the same for both limb sizes if there are whole 64-bit limbs */
+	if (!(len & 1)) {
+		uint i;
+
+		for (i = 0; i < words; i++) {
+			ctx->modulus64[i] = (uint64_t)ctx->modulus[2 * i + 1] <<
+					    32 | ctx->modulus[2 * i];
+			ctx->rr64[i] = (uint64_t)ctx->rr[2 * i + 1] << 32 |
+				       ctx->rr[2 * i];
+		}
+		ctx->n0inv64 = rsa_n0inv64(ctx->modulus64[0]);
+		ctx->wide = true;
+	}
+#endif
+	*ctxp = ctx;
+
+	return 0;
+}
+
+/* Check that a prepared key still matches the given key properties */
+static bool rsa_mod_exp_ctx_match(struct rsa_mod_exp_ctx *ctx,
+				  struct key_prop *prop)
+{
+	const uint32_t *modulus = prop->modulus;
+	const uint len = ctx->key.len;
+	uint64_t exponent;
+	uint i;
+
+	rsa_get_exponent(prop, &exponent);
+	if (len * 32 != prop->num_bits || ctx->key.exponent != exponent)
+		return false;
+	for (i = 0; i < len; i++) {
+		if (ctx->modulus[i] != fdt32_to_cpu(modulus[len - 1 - i]))
+			return false;
+	}
+
+	return true;
+}
+
+/* Exponentiation with working storage on the stack, if malloc() fails */
+static int rsa_mod_exp_stack(const uint8_t *sig, uint32_t sig_len,
+			     struct key_prop *prop, uint8_t *out)
 {
 	struct rsa_public_key key;
 	int ret;
 
-	if (!prop) {
-		debug("%s: Skipping invalid prop", __func__);
-		return -EBADF;
-	}
 	key.n0inv = prop->n0inv;
 	key.len = prop->num_bits;
 
@@ -301,6 +698,38 @@ int rsa_mod_exp_sw(const uint8_t *sig, uint32_t sig_len,
 	return 0;
 }
 
+int rsa_mod_exp_sw(const uint8_t *sig, uint32_t sig_len,
+		struct key_prop *prop, uint8_t *out)
+{
+	struct rsa_mod_exp_ctx *ctx;
+	int ret;
+
+	if (!prop) {
+		debug("%s: Skipping invalid prop", __func__);
+		return -EBADF;
+	}
+
+	if (prop->ctxp && *prop->ctxp && prop->modulus &&
+	    rsa_mod_exp_ctx_match(*prop->ctxp, prop))
+		return rsa_mod_exp_ctx(*prop->ctxp, sig, sig_len, out);
+
+	ret = rsa_mod_exp_ctx_new(prop, &ctx);
+	if (ret == -ENOMEM)
+		return rsa_mod_exp_stack(sig, sig_len, prop, out);
+	if (ret)
+		return ret;
+
+	ret = rsa_mod_exp_ctx(ctx, sig, sig_len, out);
+	if (prop->ctxp) {
+		free(*prop->ctxp);
+		*prop->ctxp = ctx;
+	} else {
+		free(ctx);
+	}
+
+	return ret;
+}
+
 #if defined(CONFIG_CMD_ZYNQ_RSA)
 /**
  * zynq_pow_mod - in-place public exponentiation
@@ -401,6 +401,72 @@ static int rsa_verify_with_pkey(struct image_sign_info *info,
 }
 #endif
 
+#if CONFIG_IS_ENABLED(FIT_SIGNATURE) && CONFIG_RSA_VERIFY_KEY_CACHE > 0
+#ifndef USE_HOSTCC
+DECLARE_GLOBAL_DATA_PTR;
+#endif
+
+/**
+ * struct rsa_key_cache - prepared key for a key node
+ *
+ * Each boot usually checks several signatures against the same few keys, so
+ * the prepared form of recently used keys is kept, saving the set-up for each
+ * further signature.
+ *
+ * @blob:	Device tree holding the key node
+ * @node:	Offset of the key node
+ * @ctx:	Prepared key, or NULL if not yet set up
+ */
+static struct rsa_key_cache {
+	const void *blob;
+	int node;
+	struct rsa_mod_exp_ctx *ctx;
+} rsa_key_cache[CONFIG_RSA_VERIFY_KEY_CACHE];
+
+static int rsa_key_cache_next;
+
+/**
+ * rsa_key_cache_slot() - Find where to keep the prepared key for a key node
+ *
+ * If the node is not in the cache, the oldest entry is replaced.
+ *
+ * @blob:	Device tree holding the key node
+ * @node:	Offset of the key node
+ * @return pointer to the slot for the prepared key, or NULL if no cache
+ */
+static struct rsa_mod_exp_ctx **rsa_key_cache_slot(const void *blob, int node)
+{
+	struct rsa_key_cache *entry;
+	int i;
+
+#ifndef USE_HOSTCC
+	/* BSS is not available before relocation */
+	if (!IS_ENABLED(CONFIG_SPL_BUILD) && !(gd->flags & GD_FLG_RELOC))
+		return NULL;
+#endif
+	for (i = 0; i < ARRAY_SIZE(rsa_key_cache); i++) {
+		entry = &rsa_key_cache[i];
+		if (entry->blob == blob && entry->node == node)
+			return &entry->ctx;
+	}
+
+	entry = &rsa_key_cache[rsa_key_cache_next];
+	rsa_key_cache_next = (rsa_key_cache_next + 1) %
+			     ARRAY_SIZE(rsa_key_cache);
+	free(entry->ctx);
+	entry->blob = blob;
+	entry->node = node;
+	entry->ctx = NULL;
+
+	return &entry->ctx;
+}
+#else
+static struct rsa_mod_exp_ctx **rsa_key_cache_slot(const void *blob, int node)
+{
+	return NULL;
+}
+#endif
+
 #if CONFIG_IS_ENABLED(FIT_SIGNATURE)
 /**
  * rsa_verify_with_keynode() - Verify a signature against some data using
@@ -445,6 +511,8 @@ static int rsa_verify_with_keynode(struct image_sign_info *info,
 
 	prop.rr = fdt_getprop(blob, node, "rsa,r-squared", NULL);
 
+	prop.ctxp = rsa_key_cache_slot(blob, node);
+
 	if (!prop.num_bits || !prop.modulus || !prop.rr) {
 		debug("%s: Missing RSA key info", __func__);
 		return -EFAULT;
@@ -0,0 +1,151 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Zstandard decompression with a shared workspace
+ *
+ * Setting up a decoder costs far more than decompressing a small frame, and
+ * a streaming decoder needs a workspace as large as the window. Keep both
+ * around, so that filesystems and image loading do not allocate per call.
+ */
+
+#include <common.h>
+#include <errno.h>
+#include <malloc.h>
+#include <zstd.h>
+
+/**
+ * struct zstd_shared - workspace kept between streams
+ *
+ * @buf:	workspace, NULL if none yet
+ * @size:	size of @buf
+ * @busy:	a stream is using @buf
+ */
+static struct zstd_shared {
+	void *buf;
+	size_t size;
+	bool busy;
+} zstd_shared;
+
+static int zstd_errno(size_t ret)
+{
+	switch (ZSTD_getErrorCode(ret)) {
+	case ZSTD_error_prefix_unknown:
+	case ZSTD_error_version_unsupported:
+	case ZSTD_error_frameParameter_unsupported:
+	case ZSTD_error_frameParameter_unsupportedBy32bits:
+	case ZSTD_error_dictionary_wrong:
+		return -EPROTONOSUPPORT;
+	case ZSTD_error_frameParameter_windowTooLarge:
+		return -EFBIG;
+	case ZSTD_error_memory_allocation:
+		return -ENOMEM;
+	case ZSTD_error_dstSize_tooSmall:
+		return -ENOBUFS;
+	case ZSTD_error_srcSize_wrong:
+		return -EINVAL;
+	case ZSTD_error_checksum_wrong:
+		return -EBADMSG;
+	default:
+		return -EPROTO;
+	}
+}
+
+/* Get a workspace of at least @size bytes, preferably the shared one */
+static void *zstd_workspace_get(size_t size, bool *shared)
+{
+	struct zstd_shared *zsh = &zstd_shared;
+
+	*shared = false;
+	if (zsh->busy)
+		return malloc(size);
+
+	if (zsh->size < size) {
+		free(zsh->buf);
+		zsh->buf = malloc(size);
+		zsh->size = zsh->buf ? size : 0;
+		if (!zsh->buf)
+			return NULL;
+	}
+	zsh->busy = true;
+	*shared = true;
+
+	return zsh->buf;
+}
+
+static void zstd_workspace_put(void *workspace, bool shared)
+{
+	if (shared)
+		zstd_shared.busy = false;
+	else
+		free(workspace);
+}
+
+int zstd_stream_init(struct zstd_stream *zs, size_t max_window)
+{
+	size_t wsize;
+
+	if (!max_window)
+		max_window = ZSTD_WINDOW_MAX;
+	if (max_window > ZSTD_WINDOW_MAX)
+		return -E2BIG;
+
+	wsize = ZSTD_DStreamWorkspaceBound(max_window);
+	zs->workspace = zstd_workspace_get(wsize, &zs->shared);
+	if (!zs->workspace)
+		return -ENOMEM;
+	zs->ds = ZSTD_initDStream(max_window, zs->workspace, wsize);
+	if (!zs->ds) {
+		zstd_workspace_put(zs->workspace, zs->shared);
+		return -ENOMEM;
+	}
+
+	return 0;
+}
+
+int zstd_stream_decompress(struct zstd_stream *zs, const void *src,
+			   size_t *srcn, void *dst, size_t *dstn)
+{
+	ZSTD_inBuffer in = { .src = src, .size = *srcn };
+	ZSTD_outBuffer out = { .dst = dst, .size = *dstn };
+	size_t ret;
+
+	ret = ZSTD_decompressStream(zs->ds, &out, &in);
+	*srcn = in.pos;
+	*dstn = out.pos;
+	if (ZSTD_isError(ret))
+		return zstd_errno(ret);
+
+	return !ret;
+}
+
+void zstd_stream_finish(struct zstd_stream *zs)
+{
+	zstd_workspace_put(zs->workspace, zs->shared);
+	zs->ds = NULL;
+	zs->workspace = NULL;
+}
+
+int zstd_decompress(const void *src, size_t srcn, void *dst, size_t *dstn)
+{
+	static ZSTD_DCtx *dctx;
+	size_t ret;
+
+	if (!dctx) {
+		size_t wsize = ZSTD_DCtxWorkspaceBound();
+		void *workspace = malloc(wsize);
+
+		if (!workspace)
+			return -ENOMEM;
+		dctx = ZSTD_initDCtx(workspace, wsize);
+		if (!dctx) {
+			free(workspace);
+			return -ENOMEM;
+		}
+	}
+
+	ret = ZSTD_decompressDCtx(dctx, dst, *dstn, src, srcn);
+	if (ZSTD_isError(ret))
+		return zstd_errno(ret);
+	*dstn = ret;
+
+	return 0;
+}
@@ -10,6 +10,7 @@
 #include <lz4.h>
 #include <malloc.h>
 #include <mapmem.h>
+#include <zstd.h>
 #include <asm/io.h>
 
 #include <u-boot/zlib.h>
@@ -20,6 +21,7 @@
 #include <lzma/LzmaTools.h>
 
 #include <linux/lzo.h>
+#include <linux/sizes.h>
 #include <test/compression.h>
 #include <test/suites.h>
 #include <test/ut.h>
@@ -119,6 +121,90 @@ static const char lz4_compressed[] =
 	"\x9d\x12\x8c\x9d";
 static const unsigned long lz4_compressed_size = 276;
 
+/*
+ * The plain text repeated 200 times, as linked 64KiB blocks with block
+ * checksums and the content size:
+ * lz4 -B4 -BD -BX --content-size
+ */
+static const char lz4_linked[] =
+	"\x04\x22\x4d\x18\x5c\x40\x70\x11\x01\x00\x00\x00\x00\x00\xe3\x11"
+	"\x02\x00\x00\xff\x19\x49\x20\x61\x6d\x20\x61\x20\x68\x69\x67\x68"
+	"\x6c\x79\x20\x63\x6f\x6d\x70\x72\x65\x73\x73\x61\x62\x6c\x65\x20"
+	"\x62\x69\x74\x20\x6f\x66\x20\x74\x65\x78\x74\x2e\x0a\x28\x00\x3d"
+	"\xf1\x25\x54\x68\x65\x72\x65\x20\x61\x72\x65\x20\x6d\x61\x6e\x79"
+	"\x20\x6c\x69\x6b\x65\x20\x6d\x65\x2c\x20\x62\x75\x74\x20\x74\x68"
+	"\x69\x73\x20\x6f\x6e\x65\x20\x69\x73\x20\x6d\x69\x6e\x65\x2e\x0a"
+	"\x49\x66\x20\x49\x20\x77\x32\x00\xd1\x6e\x79\x20\x73\x68\x6f\x72"
+	"\x74\x65\x72\x2c\x20\x74\x45\x00\xf4\x0b\x77\x6f\x75\x6c\x64\x6e"
+	"\x27\x74\x20\x62\x65\x20\x6d\x75\x63\x68\x20\x73\x65\x6e\x73\x65"
+	"\x20\x69\x6e\x0a\xcf\x00\xf5\x45\x69\x6e\x67\x20\x6d\x65\x20\x69"
+	"\x6e\x20\x74\x68\x65\x20\x66\x69\x72\x73\x74\x20\x70\x6c\x61\x63"
+	"\x65\x2e\x20\x41\x74\x20\x6c\x65\x61\x73\x74\x20\x77\x69\x74\x68"
+	"\x20\x6c\x7a\x6f\x2c\x20\x61\x6e\x79\x77\x61\x79\x2c\x0a\x77\x68"
+	"\x69\x63\x68\x20\x61\x70\x70\x65\x61\x72\x73\x20\x74\x6f\x20\x62"
+	"\x65\x68\x61\x76\x65\x20\x70\x6f\x6f\x72\x6c\x79\x4e\x00\x62\x61"
+	"\x63\x65\x20\x6f\x66\x95\x00\x01\x2d\x01\x9f\x0a\x6d\x65\x73\x73"
+	"\x61\x67\x65\x73\x36\x01\x3f\x0f\x86\x01\x15\x0f\x5e\x01\xff\xff"
+	"\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff"
+	"\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff"
+	"\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff"
+	"\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff"
+	"\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff"
+	"\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff"
+	"\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff"
+	"\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff"
+	"\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff"
+	"\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff"
+	"\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff"
+	"\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff"
+	"\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff"
+	"\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff"
+	"\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff"
+	"\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\x11\x50\x20"
+	"\x61\x6d\x20\x61\x92\x11\x38\xba\x1f\x00\x00\x00\x0f\xfa\xff\x0f"
+	"\x0f\x4c\xfe\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff"
+	"\xff\xff\xff\xff\x47\x50\x67\x65\x73\x2e\x0a\xe0\x59\x07\x6a\x00"
+	"\x00\x00\x00\x8a\x80\xc2\x98";
+static const unsigned long lz4_linked_size = 599;
+
+/* zstd -19 /tmp/plain.txt */
+static const char zstd_compressed[] =
+	"\x28\xb5\x2f\xfd\x64\x5e\x00\xad\x05\x00\x42\x4e\x26\x17\x90\x3b"
+	"\x07\x04\x5a\x13\x8b\xa7\x65\x34\x12\x21\x6d\xb0\x39\xbb\xae\xe8"
+	"\xba\xc9\xcd\x5e\x02\x49\xd0\x2b\xa9\xfa\x96\x92\xe7\x1f\x19\x19"
+	"\x7c\x8f\xf1\x9d\x54\x37\xfc\xd6\x0a\xf3\x0c\x93\x56\xc7\x52\x4f"
+	"\x0a\x62\x3e\xd1\xa5\x83\x17\x31\xab\x5d\x8f\x57\xf3\xcc\x3b\x58"
+	"\xf8\x91\x8c\xf1\x2a\x5c\x89\xdd\xf2\x9b\x15\xb7\x92\x5b\xbe\xba"
+	"\xab\xd5\xd1\x34\xdf\xf0\x02\x0e\x61\xcd\x7b\xd6\x01\xfc\xc2\xa7"
+	"\xd4\xd1\x3d\x26\x9c\x10\x49\xb8\x5b\xcd\xba\x7c\xf7\xac\x4b\xad"
+	"\xb7\x31\x1c\xbc\xf9\xcb\x62\x8e\x2e\x9b\x0f\xd3\x87\x57\x45\x12"
+	"\x16\xfa\x3a\x79\xde\x65\xf8\xcc\x48\xd5\x43\xa6\xbd\xc3\x91\x29"
+	"\x65\x29\xa7\x5b\x9a\x08\x08\x00\x60\x13\x00\x63\xa3\x8e\x28\x94"
+	"\x79\x41\x2a\x78\xc2\x91\x70\x9f\xaa\x6a\x21\x7a\xa1\xaa\x0c\xe4"
+	"\xf4\x6e\xfa";
+static const unsigned long zstd_compressed_size = 195;
+
+/*
+ * The plain text repeated 200 times, with a 128KiB window and no content
+ * size, so that it can only be streamed through the window:
+ * zstd -19 --no-content-size --zstd=wlog=17 < /tmp/plain200.txt
+ */
+static const char zstd_repeated[] =
+	"\x28\xb5\x2f\xfd\x04\x38\xd5\x05\x00\x52\x4e\x26\x17\x80\x6d\x0e"
+	"\x00\x10\x12\x93\xa0\xe5\x3f\xd1\x9e\x20\xf2\xc4\x30\xe6\x6f\x74"
+	"\x95\x0d\xd7\x03\xc0\xa0\x5f\x50\xf5\x0c\x50\x9c\x8f\xa0\xb4\x9e"
+	"\x73\x8d\xff\xa0\xfa\x61\xb7\xd6\x87\x6f\x1a\xb4\x42\x52\x41\x80"
+	"\x20\x21\x24\xb8\x69\x59\x6d\x42\x5e\xc5\x2f\x2f\xe1\xe1\x08\xae"
+	"\xc6\xab\x2f\x15\x5f\xad\x5b\xfa\xcc\x4b\x4b\xa0\xa5\xaf\xed\x6a"
+	"\x85\x38\xcc\x3f\xbc\x41\x4b\x96\xe3\xa0\xb5\xf0\xbe\xcf\x29\xf5"
+	"\xdf\x21\x17\x56\x0a\x60\x78\x4b\x66\x4d\xbf\x39\x6b\xaa\xf5\x3a"
+	"\x87\x85\x33\x9f\xc9\x65\xa9\x21\xf3\x1f\xfa\xef\xca\x00\x86\x8d"
+	"\xbe\x56\x9c\x37\x0f\x7f\x1d\xa8\xfa\xd7\x30\x87\x58\x5a\x6a\x49"
+	"\x65\x34\x43\x17\x01\x09\x00\x0f\x10\x61\x9b\x1d\x6c\x22\x60\x6c"
+	"\x94\x45\x51\xaf\x66\x84\xa2\xc0\x08\x23\xe1\x3a\x42\x65\x41\xf4"
+	"\x42\x55\x19\xc9\x8b\x7c\xc5";
+static const unsigned long zstd_repeated_size = 199;
+
 
 #define TEST_BUFFER_SIZE	512
 
@@ -294,6 +380,40 @@ static int uncompress_using_lz4(struct unit_test_state *uts,
 	return (ret != 0);
 }
 
+static int compress_using_zstd(struct unit_test_state *uts,
+			       void *in, unsigned long in_size,
+			       void *out, unsigned long out_max,
+			       unsigned long *out_size)
+{
+	/* There is no zstd compression in u-boot, so fake it. */
+	ut_asserteq(in_size, strlen(plain));
+	ut_asserteq(0, memcmp(plain, in, in_size));
+
+	if (zstd_compressed_size > out_max)
+		return -1;
+
+	memcpy(out, zstd_compressed, zstd_compressed_size);
+	if (out_size)
+		*out_size = zstd_compressed_size;
+
+	return 0;
+}
+
+static int uncompress_using_zstd(struct unit_test_state *uts,
+				 void *in, unsigned long in_size,
+				 void *out, unsigned long out_max,
+				 unsigned long *out_size)
+{
+	size_t output_size = out_max;
+	int ret;
+
+	ret = zstd_decompress(in, in_size, out, &output_size);
+	if (out_size)
+		*out_size = output_size;
+
+	return (ret != 0);
+}
+
 #define errcheck(statement) if (!(statement)) { \
 	fprintf(stderr, "\tFailed: %s\n", #statement); \
 	ret = 1; \
@@ -438,6 +558,226 @@ static int compression_test_lz4(struct unit_test_state *uts)
 }
 COMPRESSION_TEST(compression_test_lz4, 0);
 
+/* Decompress @src in pieces of @chunk bytes with the streaming decoder */
+static int lz4_stream_pieces(const void *src, size_t srcn, void *dst,
+			     size_t *dstn, size_t chunk)
+{
+	struct lz4_stream s;
+	size_t off, len;
+	int ret = 0, err;
+
+	ulz4_stream_init(&s, dst, *dstn);
+	for (off = 0; off < srcn && !ret; off += len) {
+		len = min(chunk, srcn - off);
+		ret = ulz4_stream_decompress(&s, src + off, &len);
+	}
+	err = ulz4_stream_finish(&s, dstn);
+
+	return ret < 0 ? ret : err;
+}
+
+static int compression_test_lz4_stream(struct unit_test_state *uts)
+{
+	const size_t chunks[] = { 1, 7, 4096, lz4_linked_size };
+	size_t plain_len = strlen(plain), len;
+	char *expect, *buf;
+	int i;
+
+	expect = malloc(plain_len * 200);
+	ut_assertnonnull(expect);
+	buf = malloc(plain_len * 200);
+	ut_assertnonnull(buf);
+	for (i = 0; i < 200; i++)
+		memcpy(expect + i * plain_len, plain, plain_len);
+
+	/* Independent blocks with a content checksum */
+	len = plain_len;
+	ut_assertok(lz4_stream_pieces(lz4_compressed, lz4_compressed_size,
+				      buf, &len, 1));
+	ut_asserteq(plain_len, len);
+	ut_asserteq_mem(plain, buf, plain_len);
+
+	/* Linked blocks, split between pieces in various places */
+	for (i = 0; i < ARRAY_SIZE(chunks); i++) {
+		memset(buf, '\0', plain_len * 200);
+		len = plain_len * 200;
+		ut_assertok(lz4_stream_pieces(lz4_linked, lz4_linked_size,
+					      buf, &len, chunks[i]));
+		ut_asserteq(plain_len * 200, len);
+		ut_asserteq_mem(expect, buf, len);
+	}
+
+	/* A bad block checksum is detected */
+	memcpy(expect, lz4_linked, lz4_linked_size);
+	expect[lz4_linked_size - 9] ^= 1;
+	len = plain_len * 200;
+	ut_asserteq(-EBADMSG, ulz4fn(expect, lz4_linked_size, buf, &len));
+
+	free(buf);
+	free(expect);
+
+	return 0;
+}
+COMPRESSION_TEST(compression_test_lz4_stream, 0);
+
+static int compression_test_zstd(struct unit_test_state *uts)
+{
+	return run_test(uts, "zstd", compress_using_zstd,
+			uncompress_using_zstd);
+}
+COMPRESSION_TEST(compression_test_zstd, 0);
+
+/*
+ * Decompress @src with the streaming decoder, passing input and output in
+ * pieces of @chunk bytes
+ */
+static int zstd_stream_pieces(const void *src, size_t srcn, void *dst,
+			      size_t *dstn, size_t chunk, size_t max_window)
+{
+	size_t in = 0, out = 0, len, space;
+	struct zstd_stream zs;
+	int ret;
+
+	ret = zstd_stream_init(&zs, max_window);
+	if (ret)
+		return ret;
+	do {
+		len = min(chunk, srcn - in);
+		space = min(chunk, *dstn - out);
+		ret = zstd_stream_decompress(&zs, src + in, &len, dst + out,
+					     &space);
+		in += len;
+		out += space;
+	} while (!ret && in < srcn);
+	zstd_stream_finish(&zs);
+	*dstn = out;
+
+	if (ret < 0)
+		return ret;
+
+	return ret ? 0 : -EINVAL;
+}
+
+static int compression_test_zstd_stream(struct unit_test_state *uts)
+{
+	const size_t chunks[] = { 1, 7, 4096, zstd_repeated_size };
+	size_t plain_len = strlen(plain), len;
+	char *expect, *buf;
+	int i;
+
+	expect = malloc(plain_len * 200);
+	ut_assertnonnull(expect);
+	buf = malloc(plain_len * 200);
+	ut_assertnonnull(buf);
+	for (i = 0; i < 200; i++)
+		memcpy(expect + i * plain_len, plain, plain_len);
+
+	/* Whole frame with its content size, decoded in a single pass */
+	len = plain_len;
+	ut_assertok(zstd_stream_pieces(zstd_compressed, zstd_compressed_size,
+				       buf, &len, zstd_compressed_size, 0));
+	ut_asserteq(plain_len, len);
+	ut_asserteq_mem(plain, buf, plain_len);
+
+	/* Through the window, in various pieces */
+	for (i = 0; i < ARRAY_SIZE(chunks); i++) {
+		memset(buf, '\0', plain_len * 200);
+		len = plain_len * 200;
+		ut_assertok(zstd_stream_pieces(zstd_repeated,
+					       zstd_repeated_size, buf, &len,
+					       chunks[i], SZ_128K));
+		ut_asserteq(plain_len * 200, len);
+		ut_asserteq_mem(expect, buf, len);
+	}
+
+	/* The window is larger than allowed */
+	len = plain_len * 200;
+	ut_asserteq(-EFBIG, zstd_stream_pieces(zstd_repeated,
+					       zstd_repeated_size, buf, &len,
+					       zstd_repeated_size, SZ_64K));
+	ut_asserteq(-E2BIG, zstd_stream_pieces(zstd_repeated,
+					       zstd_repeated_size, buf, &len,
+					       zstd_repeated_size,
+					       ZSTD_WINDOW_MAX * 2));
+
+	/* A bad content checksum is detected */
+	memcpy(expect, zstd_repeated, zstd_repeated_size);
+	expect[zstd_repeated_size - 2] ^= 1;
+	len = plain_len * 200;
+	ut_asserteq(-EBADMSG, zstd_decompress(expect, zstd_repeated_size, buf,
+					      &len));
+	len = plain_len * 200;
+	ut_asserteq(-EBADMSG, zstd_stream_pieces(expect, zstd_repeated_size,
+						 buf, &len, 64, 0));
+
+	free(buf);
+	free(expect);
+
+	return 0;
+}
+COMPRESSION_TEST(compression_test_zstd_stream, 0);
+
+/* Decompress @src and check that it gives @orig */
+static int decomp_check(struct unit_test_state *uts, int comp,
+			const void *src, size_t srcn, void *dst,
+			const void *orig, size_t size)
+{
+	unsigned long len;
+	size_t dstn = size;
+
+	memset(dst, '\0', size);
+	switch (comp) {
+	case IH_COMP_GZIP:
+		len = srcn;
+		ut_assertok(gunzip(dst, size, (uchar *)src, &len));
+		dstn = len;
+		break;
+	case IH_COMP_LZ4:
+		ut_assertok(ulz4fn(src, srcn, dst, &dstn));
+		break;
+	case IH_COMP_ZSTD:
+		ut_assertok(zstd_decompress(src, srcn, dst, &dstn));
+		break;
+	}
+	ut_asserteq(size, dstn);
+	ut_asserteq_mem(orig, dst, size);
+
+	return 0;
+}
+
+/* Check gzip, lz4 and zstd against the same long, repetitive data */
+static int compression_test_decomp_repeated(struct unit_test_state *uts)
+{
+	size_t plain_len = strlen(plain), size = plain_len * 200;
+	unsigned long gzip_len = size;
+	char *orig, *gz, *buf;
+	int i;
+
+	orig = malloc(size);
+	ut_assertnonnull(orig);
+	gz = malloc(size);
+	ut_assertnonnull(gz);
+	buf = malloc(size);
+	ut_assertnonnull(buf);
+	for (i = 0; i < 200; i++)
+		memcpy(orig + i * plain_len, plain, plain_len);
+	ut_assertok(gzip(gz, &gzip_len, (uchar *)orig, size));
+
+	ut_assertok(decomp_check(uts, IH_COMP_GZIP, gz, gzip_len, buf, orig,
+				 size));
+	ut_assertok(decomp_check(uts, IH_COMP_LZ4, lz4_linked,
+				 lz4_linked_size, buf, orig, size));
+	ut_assertok(decomp_check(uts, IH_COMP_ZSTD, zstd_repeated,
+				 zstd_repeated_size, buf, orig, size));
+
+	free(buf);
+	free(gz);
+	free(orig);
+
+	return 0;
+}
+COMPRESSION_TEST(compression_test_decomp_repeated, 0);
+
 static int compress_using_none(struct unit_test_state *uts,
 			       void *in, unsigned long in_size,
 			       void *out, unsigned long out_max,
@@ -528,6 +868,12 @@ static int compression_test_bootm_lz4(struct unit_test_state *uts)
 }
 COMPRESSION_TEST(compression_test_bootm_lz4, 0);
 
+static int compression_test_bootm_zstd(struct unit_test_state *uts)
+{
+	return run_bootm_test(uts, IH_COMP_ZSTD, compress_using_zstd);
+}
+COMPRESSION_TEST(compression_test_bootm_zstd, 0);
+
 static int compression_test_bootm_none(struct unit_test_state *uts)
 {
 	return run_bootm_test(uts, IH_COMP_NONE, compress_using_none);
@@ -4,6 +4,8 @@
  */
 
 #include <common.h>
+#include <blk.h>
+#include <command.h>
 #include <dm.h>
 #include <usb.h>
 #include <asm/state.h>
@@ -162,3 +164,154 @@ static int dm_test_blk_get_from_parent(struct unit_test_state *uts)
 	return 0;
 }
 DM_TEST(dm_test_blk_get_from_parent, DM_TESTF_SCAN_PDATA | DM_TESTF_SCAN_FDT);
+
+static void blk_test_complete(struct blk_request *req)
+{
+	int *count = req->priv;
+
+	(*count)++;
+}
+
+/* Test that requests to drivers which cannot queue complete at once */
+static int dm_test_blk_submit(struct unit_test_state *uts)
+{
+	struct blk_request req = {};
+	struct udevice *dev, *blk;
+	struct blk_desc *desc;
+	char buf[1024];
+	int count = 0;
+
+	ut_assertok(uclass_get_device(UCLASS_MMC, 0, &dev));
+	ut_assertok(blk_get_from_parent(dev, &blk));
+	desc = dev_get_uclass_platdata(blk);
+
+	req.start = 0;
+	req.blkcnt = 2;
+	req.buffer = buf;
+	req.complete = blk_test_complete;
+	req.priv = &count;
+	ut_assertok(blk_dsubmit(desc, &req));
+	ut_asserteq(1, count);
+	ut_asserteq(2, req.result);
+	ut_asserteq_ptr(desc, req.desc);
+	ut_asserteq(0, blk_dpoll(desc));
+
+	return 0;
+}
+DM_TEST(dm_test_blk_submit, DM_TESTF_SCAN_PDATA | DM_TESTF_SCAN_FDT);
+
+/* Test vectored reads and writes */
+static int dm_test_blk_vec(struct unit_test_state *uts)
+{
+	struct udevice *dev, *blk;
+	struct blk_desc *desc;
+	struct blk_vec vecs[4];
+	char buf[512 * 4], data[512];
+	int i;
+
+	/* Runs next to each other on the device and in memory are merged */
+	vecs[0] = (struct blk_vec){ 4, 2, buf + 1024 };
+	vecs[1] = (struct blk_vec){ 8, 1, data };
+	vecs[2] = (struct blk_vec){ 0, 1, buf };
+	vecs[3] = (struct blk_vec){ 1, 1, buf + 512 };
+	ut_asserteq(2, blk_merge_vecs(vecs, 4, 512));
+	ut_asserteq(0, vecs[0].start);
+	ut_asserteq(2, vecs[0].blkcnt);
+	ut_asserteq_ptr(buf, vecs[0].buffer);
+	ut_asserteq(4, vecs[1].start);
+
+	ut_assertok(uclass_get_device(UCLASS_MMC, 0, &dev));
+	ut_assertok(blk_get_from_parent(dev, &blk));
+	desc = dev_get_uclass_platdata(blk);
+
+	for (i = 0; i < 10; i++) {
+		memset(data, i, sizeof(data));
+		ut_asserteq(1, blk_dwrite(desc, i, 1, data));
+	}
+
+	/* Runs are read in any order, each into its own buffer */
+	vecs[0] = (struct blk_vec){ 7, 1, buf };
+	vecs[1] = (struct blk_vec){ 1, 2, buf + 512 };
+	vecs[2] = (struct blk_vec){ 3, 1, buf + 1536 };
+	ut_asserteq(4, blk_dreadv(desc, vecs, 3));
+	ut_asserteq(7, buf[0]);
+	ut_asserteq(1, buf[512]);
+	ut_asserteq(2, buf[1024]);
+	ut_asserteq(3, buf[1536]);
+
+	memset(buf, '\x33', 512);
+	memset(data, '\x44', sizeof(data));
+	vecs[0] = (struct blk_vec){ 12, 1, buf };
+	vecs[1] = (struct blk_vec){ 11, 1, data };
+	ut_asserteq(2, blk_dwritev(desc, vecs, 2));
+	ut_asserteq(2, blk_dread(desc, 11, 2, buf + 512));
+	ut_asserteq(0x44, buf[512]);
+	ut_asserteq(0x33, buf[1024]);
+
+	return 0;
+}
+DM_TEST(dm_test_blk_vec, DM_TESTF_SCAN_PDATA | DM_TESTF_SCAN_FDT);
+
+#if CONFIG_IS_ENABLED(BLOCK_WRITEBACK)
+/* Read blocks from the device itself, bypassing the caches */
+static ulong blk_test_read_dev(struct blk_desc *desc, lbaint_t start,
+			       lbaint_t blkcnt, void *buf)
+{
+	return blk_get_ops(desc->bdev)->read(desc->bdev, start, blkcnt, buf);
+}
+
+/* Test that small writes are cached until flushed */
+static int dm_test_blk_writeback(struct unit_test_state *uts)
+{
+	struct udevice *dev, *blk;
+	struct blk_desc *desc;
+	char buf[512 * 64], orig[512], data[512];
+	int i;
+
+	ut_assertok(uclass_get_device(UCLASS_MMC, 0, &dev));
+	ut_assertok(blk_get_from_parent(dev, &blk));
+	desc = dev_get_uclass_platdata(blk);
+	ut_assertok(blk_flush(desc));
+	ut_asserteq(1, blk_test_read_dev(desc, 10, 1, orig));
+
+	/* Writes are seen by reads, but do not reach the device yet */
+	memset(data, '\x5a', sizeof(data));
+	ut_asserteq(1, blk_dwrite(desc, 10, 1, data));
+	ut_asserteq(3, blk_dread(desc, 9, 3, buf));
+	ut_asserteq_mem(data, buf + 512, 512);
+	ut_asserteq(1, blk_test_read_dev(desc, 10, 1, buf));
+	ut_asserteq_mem(orig, buf, 512);
+	ut_assertok(blk_flush(desc));
+	ut_asserteq(1, blk_test_read_dev(desc, 10, 1, buf));
+	ut_asserteq_mem(data, buf, 512);
+
+	/* Large writes go straight to the device, replacing cached blocks */
+	memset(data, '\xa5', sizeof(data));
+	ut_asserteq(1, blk_dwrite(desc, 20, 1, data));
+	memset(buf, '\x11', sizeof(buf));
+	ut_asserteq(64, blk_dwrite(desc, 0, 64, buf));
+	ut_asserteq(1, blk_test_read_dev(desc, 20, 1, data));
+	ut_asserteq(0x11, data[0]);
+	ut_assertok(blk_flush(desc));
+	ut_asserteq(1, blk_test_read_dev(desc, 20, 1, data));
+	ut_asserteq(0x11, data[0]);
+
+	/* Reaching the high-water mark writes everything */
+	for (i = 0; i < CONFIG_BLOCK_WRITEBACK_BLOCKS; i++) {
+		memset(data, i, sizeof(data));
+		ut_asserteq(1, blk_dwrite(desc, i * 3, 1, data));
+	}
+	ut_asserteq(1, blk_test_read_dev(desc, (i - 1) * 3, 1, data));
+	ut_asserteq((char)(i - 1), data[0]);
+
+	/* A command completing flushes */
+	memset(data, '\x77', sizeof(data));
+	ut_asserteq(1, blk_dwrite(desc, 5, 1, data));
+	ut_assertok(run_command("echo", 0));
+	ut_asserteq(1, blk_test_read_dev(desc, 5, 1, buf));
+	ut_asserteq_mem(data, buf, 512);
+
+	return 0;
+}
+DM_TEST(dm_test_blk_writeback, DM_TESTF_SCAN_PDATA | DM_TESTF_SCAN_FDT);
+#endif
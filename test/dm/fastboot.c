@@ -0,0 +1,428 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Tests for streamed fastboot flashing over the UDP transport
+ */
+
+#include <common.h>
+#include <blk.h>
+#include <dm.h>
+#include <env.h>
+#include <fastboot.h>
+#include <malloc.h>
+#include <net.h>
+#include <part.h>
+#include <sparse_format.h>
+#include <asm/eth.h>
+#include <asm/unaligned.h>
+#include <dm/test.h>
+#include <net/fastboot.h>
+#include <test/ut.h>
+
+#define FB_TEST_PORT		5554
+#define FB_TEST_HOST_PORT	5555
+#define FB_TEST_PACKET_SIZE	1024
+#define FB_TEST_DATA_SIZE	(FB_TEST_PACKET_SIZE - 4)
+#define FB_TEST_BUF_SIZE	0x2000
+
+enum {
+	FB_TEST_QUERY = 1,
+	FB_TEST_INIT = 2,
+	FB_TEST_FASTBOOT = 3,
+};
+
+/**
+ * struct fb_test_host - state of the emulated fastboot host
+ *
+ * @dev: Ethernet device the fastboot server listens on
+ * @ip: IP address of the host
+ * @seq: Next sequence number to send
+ * @resp: Payload of the last UDP packet sent by U-Boot
+ * @resp_len: Length of @resp, -1 if nothing has been received
+ * @text: Fastboot response in @resp as a string
+ */
+struct fb_test_host {
+	struct udevice *dev;
+	struct in_addr ip;
+	u16 seq;
+	u8 resp[FB_TEST_PACKET_SIZE];
+	int resp_len;
+	char text[FB_TEST_PACKET_SIZE];
+};
+
+static u8 fb_test_buf[FB_TEST_BUF_SIZE];
+
+/* Capture UDP packets sent by the fastboot server, answer ARP requests */
+static int fb_test_tx_handler(struct udevice *dev, void *packet,
+			      unsigned int len)
+{
+	struct eth_sandbox_priv *priv = dev_get_priv(dev);
+	struct fb_test_host *host = priv->priv;
+	struct ethernet_hdr *eth = packet;
+	struct ip_udp_hdr *ip = packet + ETHER_HDR_SIZE;
+
+	if (!sandbox_eth_arp_req_to_reply(dev, packet, len))
+		return 0;
+	if (ntohs(eth->et_protlen) != PROT_IP || ip->ip_p != IPPROTO_UDP)
+		return 0;
+
+	host->resp_len = ntohs(ip->udp_len) - UDP_HDR_SIZE;
+	memcpy(host->resp, ip + 1, host->resp_len);
+
+	return 0;
+}
+
+/* Inject a fastboot packet from the host and wait for the answer */
+static int fb_test_exchange(struct unit_test_state *uts,
+			    struct fb_test_host *host, u8 id,
+			    const void *data, int len)
+{
+	struct eth_sandbox_priv *priv = dev_get_priv(host->dev);
+	uchar *pkt = priv->recv_packet_buffer[priv->recv_packets];
+	struct ethernet_hdr *eth = (struct ethernet_hdr *)pkt;
+	struct ip_udp_hdr *ip = (struct ip_udp_hdr *)(pkt + ETHER_HDR_SIZE);
+	u8 *hdr = (u8 *)(ip + 1);
+	int i;
+
+	memcpy(eth->et_dest, net_ethaddr, ARP_HLEN);
+	memcpy(eth->et_src, priv->fake_host_hwaddr, ARP_HLEN);
+	eth->et_protlen = htons(PROT_IP);
+	net_set_ip_header((uchar *)ip, net_ip, host->ip,
+			  IP_UDP_HDR_SIZE + 4 + len, IPPROTO_UDP);
+	ip->udp_src = htons(FB_TEST_HOST_PORT);
+	ip->udp_dst = htons(FB_TEST_PORT);
+	ip->udp_len = htons(UDP_HDR_SIZE + 4 + len);
+	ip->udp_xsum = 0;
+
+	hdr[0] = id;
+	hdr[1] = 0;
+	put_unaligned_be16(host->seq, &hdr[2]);
+	if (len)
+		memcpy(&hdr[4], data, len);
+	priv->recv_packet_length[priv->recv_packets++] =
+		ETHER_HDR_SIZE + IP_UDP_HDR_SIZE + 4 + len;
+
+	host->resp_len = -1;
+	for (i = 0; i < 10 && priv->recv_packets; i++)
+		eth_rx();
+
+	ut_assert(host->resp_len >= 4);
+	ut_asserteq(id, host->resp[0]);
+	if (id != FB_TEST_QUERY) {
+		ut_asserteq(host->seq, get_unaligned_be16(&host->resp[2]));
+		host->seq++;
+	}
+	memcpy(host->text, &host->resp[4], host->resp_len - 4);
+	host->text[host->resp_len - 4] = '\0';
+
+	return 0;
+}
+
+/* Open a fastboot session as the host would */
+static int fb_test_connect(struct unit_test_state *uts,
+			   struct fb_test_host *host)
+{
+	static const u8 init[] = { 0x00, 0x01, 0x04, 0x00 };
+
+	ut_assertok(fb_test_exchange(uts, host, FB_TEST_QUERY, NULL, 0));
+	host->seq = get_unaligned_be16(&host->resp[4]);
+	ut_assertok(fb_test_exchange(uts, host, FB_TEST_INIT, init,
+				     sizeof(init)));
+	ut_asserteq(1, get_unaligned_be16(&host->resp[4]));
+	ut_asserteq(FB_TEST_PACKET_SIZE, get_unaligned_be16(&host->resp[6]));
+
+	return 0;
+}
+
+/* Send a command and check the final response */
+static int fb_test_cmd(struct unit_test_state *uts, struct fb_test_host *host,
+		       const char *cmd, const char *expect)
+{
+	ut_assertok(fb_test_exchange(uts, host, FB_TEST_FASTBOOT, cmd,
+				     strlen(cmd)));
+	ut_asserteq_str("", host->text);
+	ut_assertok(fb_test_exchange(uts, host, FB_TEST_FASTBOOT, NULL, 0));
+	ut_asserteq_str(expect, host->text);
+
+	return 0;
+}
+
+/* Download an image to the device */
+static int fb_test_download(struct unit_test_state *uts,
+			    struct fb_test_host *host, const u8 *data,
+			    u32 size)
+{
+	char cmd[32], expect[32];
+	u32 pos, n;
+
+	snprintf(cmd, sizeof(cmd), "download:%08x", size);
+	snprintf(expect, sizeof(expect), "DATA%08x", size);
+	ut_assertok(fb_test_cmd(uts, host, cmd, expect));
+
+	for (pos = 0; pos < size; pos += n) {
+		n = min_t(u32, size - pos, FB_TEST_DATA_SIZE);
+		ut_assertok(fb_test_exchange(uts, host, FB_TEST_FASTBOOT,
+					     data + pos, n));
+		ut_asserteq_str("", host->text);
+	}
+	ut_assertok(fb_test_exchange(uts, host, FB_TEST_FASTBOOT, NULL, 0));
+	ut_asserteq_str("OKAY", host->text);
+
+	return 0;
+}
+
+/* Create the partitions used by the tests on mmc0 */
+static int fb_test_setup_mmc(struct unit_test_state *uts,
+			     struct blk_desc **descp)
+{
+	disk_partition_t parts[2];
+	struct blk_desc *desc;
+	int i;
+
+	ut_assertok(blk_get_device_by_str("mmc", "0", &desc));
+	memset(parts, '\0', sizeof(parts));
+	strcpy((char *)parts[0].name, "boot");
+	parts[0].start = 64;
+	parts[0].size = 256;
+	strcpy((char *)parts[1].name, "system");
+	parts[1].start = 320;
+	parts[1].size = 1024;
+	for (i = 0; i < ARRAY_SIZE(parts); i++) {
+		parts[i].blksz = desc->blksz;
+#if CONFIG_IS_ENABLED(PARTITION_UUIDS)
+		snprintf(parts[i].uuid, sizeof(parts[i].uuid),
+			 "bb8fa4a2-5ad6-4a5a-97f0-1b4b6a7a2c0%d", i);
+#endif
+	}
+	ut_assertok(gpt_restore(desc, "375a56f7-d6c9-4e81-b5f0-09d41ca89efe",
+				parts, ARRAY_SIZE(parts)));
+	part_init(desc);
+	*descp = desc;
+
+	return 0;
+}
+
+static int fb_test_start(struct unit_test_state *uts,
+			 struct fb_test_host *host)
+{
+	memset(host, '\0', sizeof(*host));
+	ut_assertok(uclass_get_device_by_name(UCLASS_ETH, "eth@10002000",
+					      &host->dev));
+	env_set("ethact", host->dev->name);
+	host->ip = string_to_ip("1.2.3.5");
+
+	net_init();
+	eth_halt();
+	eth_set_current();
+	ut_assert(eth_init() >= 0);
+	sandbox_eth_set_tx_handler(0, fb_test_tx_handler);
+	sandbox_eth_set_priv(0, host);
+
+	fastboot_init(fb_test_buf, sizeof(fb_test_buf));
+	fastboot_start_server();
+
+	return fb_test_connect(uts, host);
+}
+
+static void fb_test_stop(struct fb_test_host *host)
+{
+	net_set_udp_handler(NULL);
+	sandbox_eth_set_tx_handler(0, NULL);
+	sandbox_eth_set_priv(0, NULL);
+	eth_halt();
+}
+
+/* Test streaming a raw image which is larger than the download buffer */
+static int dm_test_fastboot_stream_raw(struct unit_test_state *uts)
+{
+	const u32 size = 40 * 1024 + 100;
+	struct fb_test_host host;
+	struct blk_desc *desc;
+	u8 *image, *cmp;
+	lbaint_t blkcnt;
+	int i;
+
+	ut_assertok(fb_test_setup_mmc(uts, &desc));
+	blkcnt = DIV_ROUND_UP(size, desc->blksz);
+	image = malloc(size);
+	cmp = malloc(blkcnt * desc->blksz);
+	ut_assertnonnull(image);
+	ut_assertnonnull(cmp);
+	for (i = 0; i < size; i++)
+		image[i] = i * 7 + (i >> 9);
+	ut_assert(size > FB_TEST_BUF_SIZE);
+
+	ut_assertok(fb_test_start(uts, &host));
+	ut_assertok(fb_test_cmd(uts, &host, "getvar:stream-flash", "OKAYyes"));
+
+	/* Without streaming the image does not fit into the buffer */
+	ut_assertok(fb_test_cmd(uts, &host, "download:0000a064",
+				"FAIL0000a064"));
+
+	ut_assertok(fb_test_cmd(uts, &host, "oem stream:boot", "OKAY"));
+	ut_assertok(fb_test_download(uts, &host, image, size));
+	ut_assertok(fb_test_cmd(uts, &host, "flash:boot", "OKAY"));
+	ut_assertok(fb_test_cmd(uts, &host, "oem stream:",
+				"OKAYstreaming disabled"));
+	fb_test_stop(&host);
+
+	/* The partition starts at block 64; the tail must be zero-padded */
+	ut_asserteq(blkcnt, blk_dread(desc, 64, blkcnt, cmp));
+	ut_assertok(memcmp(image, cmp, size));
+	for (i = size; i < blkcnt * desc->blksz; i++)
+		ut_asserteq(0, cmp[i]);
+
+	free(cmp);
+	free(image);
+
+	return 0;
+}
+DM_TEST(dm_test_fastboot_stream_raw, DM_TESTF_SCAN_FDT);
+
+/* Test that a streamed image cannot be flashed or booted from the buffer */
+static int dm_test_fastboot_stream_reflash(struct unit_test_state *uts)
+{
+	const u32 size = 20 * 1024;
+	struct fb_test_host host;
+	struct blk_desc *desc;
+	u8 *image, *cmp;
+	lbaint_t blkcnt;
+	int i;
+
+	ut_assertok(fb_test_setup_mmc(uts, &desc));
+	blkcnt = size / desc->blksz;
+	image = malloc(size);
+	cmp = malloc(size);
+	ut_assertnonnull(image);
+	ut_assertnonnull(cmp);
+	for (i = 0; i < size; i++)
+		image[i] = i * 11 + 3;
+
+	/* Mark the start of the system partition, which must be left alone */
+	memset(cmp, 0xee, size);
+	ut_asserteq(blkcnt, blk_dwrite(desc, 320, blkcnt, cmp));
+
+	ut_assertok(fb_test_start(uts, &host));
+	ut_assertok(fb_test_cmd(uts, &host, "oem stream:boot", "OKAY"));
+	ut_assertok(fb_test_download(uts, &host, image, size));
+	ut_assertok(fb_test_cmd(uts, &host, "flash:boot", "OKAY"));
+	ut_asserteq(0, env_get_hex("filesize", 1));
+
+	/* Only the first flash reports the streamed write */
+	ut_assertok(fb_test_cmd(uts, &host, "flash:boot",
+				"FAILno image downloaded"));
+	ut_assertok(fb_test_cmd(uts, &host, "boot", "FAILno image downloaded"));
+
+	/* Naming another partition fails, and so does a retry */
+	ut_assertok(fb_test_download(uts, &host, image, size));
+	ut_assertok(fb_test_cmd(uts, &host, "flash:system",
+				"FAILimage was streamed to another partition"));
+	ut_assertok(fb_test_cmd(uts, &host, "flash:system",
+				"FAILno image downloaded"));
+
+	ut_assertok(fb_test_cmd(uts, &host, "oem stream:",
+				"OKAYstreaming disabled"));
+	fb_test_stop(&host);
+
+	ut_asserteq(blkcnt, blk_dread(desc, 64, blkcnt, cmp));
+	ut_assertok(memcmp(image, cmp, size));
+	ut_asserteq(blkcnt, blk_dread(desc, 320, blkcnt, cmp));
+	for (i = 0; i < size; i++)
+		ut_asserteq(0xee, cmp[i]);
+
+	free(cmp);
+	free(image);
+
+	return 0;
+}
+DM_TEST(dm_test_fastboot_stream_reflash, DM_TESTF_SCAN_FDT);
+
+/* Append a chunk header to a sparse image being built */
+static u8 *fb_test_chunk(u8 *ptr, u16 type, u32 blocks, u32 data_sz)
+{
+	chunk_header_t chunk = {
+		.chunk_type = type,
+		.chunk_sz = blocks,
+		.total_sz = sizeof(chunk_header_t) + data_sz,
+	};
+
+	memcpy(ptr, &chunk, sizeof(chunk));
+
+	return ptr + sizeof(chunk);
+}
+
+/* Test streaming an Android sparse image with all chunk types */
+static int dm_test_fastboot_stream_sparse(struct unit_test_state *uts)
+{
+	const u32 blk_sz = 4096;
+	sparse_header_t hdr = {
+		.magic = SPARSE_HEADER_MAGIC,
+		.major_version = 1,
+		.file_hdr_sz = sizeof(sparse_header_t),
+		.chunk_hdr_sz = sizeof(chunk_header_t),
+		.blk_sz = blk_sz,
+		.total_blks = 7,
+		.total_chunks = 4,
+	};
+	const u32 fill = 0x5aa5c33c;
+	struct fb_test_host host;
+	struct blk_desc *desc;
+	u8 *image, *ptr, *cmp;
+	lbaint_t start, blkcnt;
+	u32 *word;
+	int i;
+
+	ut_assertok(fb_test_setup_mmc(uts, &desc));
+	start = 320;
+	blkcnt = 7 * blk_sz / desc->blksz;
+	image = malloc(sizeof(hdr) + 4 * sizeof(chunk_header_t) +
+		       4 * blk_sz + sizeof(fill));
+	cmp = malloc(blkcnt * desc->blksz);
+	ut_assertnonnull(image);
+	ut_assertnonnull(cmp);
+
+	/* Mark the "don't care" block so we can check it is left alone */
+	memset(cmp, 0xee, blk_sz);
+	ut_asserteq(blk_sz / desc->blksz,
+		    blk_dwrite(desc, start + 4 * blk_sz / desc->blksz,
+			       blk_sz / desc->blksz, cmp));
+
+	/* raw (2 blocks), fill (2 blocks), don't care (1), raw (2) */
+	ptr = image;
+	memcpy(ptr, &hdr, sizeof(hdr));
+	ptr += sizeof(hdr);
+	ptr = fb_test_chunk(ptr, CHUNK_TYPE_RAW, 2, 2 * blk_sz);
+	for (i = 0; i < 2 * blk_sz; i++)
+		*ptr++ = i * 3 + 1;
+	ptr = fb_test_chunk(ptr, CHUNK_TYPE_FILL, 2, sizeof(fill));
+	memcpy(ptr, &fill, sizeof(fill));
+	ptr += sizeof(fill);
+	ptr = fb_test_chunk(ptr, CHUNK_TYPE_DONT_CARE, 1, 0);
+	ptr = fb_test_chunk(ptr, CHUNK_TYPE_RAW, 2, 2 * blk_sz);
+	for (i = 0; i < 2 * blk_sz; i++)
+		*ptr++ = i * 5 + 2;
+
+	ut_assertok(fb_test_start(uts, &host));
+	ut_assertok(fb_test_cmd(uts, &host, "oem stream:system", "OKAY"));
+	ut_assertok(fb_test_download(uts, &host, image, ptr - image));
+	ut_assertok(fb_test_cmd(uts, &host, "flash:system", "OKAY"));
+	ut_assertok(fb_test_cmd(uts, &host, "oem stream",
+				"OKAYstreaming disabled"));
+	fb_test_stop(&host);
+
+	ut_asserteq(blkcnt, blk_dread(desc, start, blkcnt, cmp));
+	for (i = 0; i < 2 * blk_sz; i++)
+		ut_asserteq((u8)(i * 3 + 1), cmp[i]);
+	word = (u32 *)(cmp + 2 * blk_sz);
+	for (i = 0; i < 2 * blk_sz / sizeof(u32); i++)
+		ut_asserteq(fill, word[i]);
+	for (i = 4 * blk_sz; i < 5 * blk_sz; i++)
+		ut_asserteq(0xee, cmp[i]);
+	for (i = 0; i < 2 * blk_sz; i++)
+		ut_asserteq((u8)(i * 5 + 2), cmp[5 * blk_sz + i]);
+
+	free(cmp);
+	free(image);
+
+	return 0;
+}
+DM_TEST(dm_test_fastboot_stream_sparse, DM_TESTF_SCAN_FDT);
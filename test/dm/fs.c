@@ -0,0 +1,90 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Tests for reading through open file handles
+ */
+
+#include <common.h>
+#include <dm.h>
+#include <fs.h>
+#include <malloc.h>
+#include <mapmem.h>
+#include <os.h>
+#include <dm/test.h>
+#include <test/ut.h>
+
+#define TEST_FS_FILE	"fs_file_test.bin"
+#define TEST_FS_SIZE	(3 * 4096 + 123)
+
+/* Read @len bytes at @offset and check them against @src */
+static int test_fs_read_at(struct unit_test_state *uts, struct fs_file *file,
+			   const u8 *src, u8 *buf, loff_t offset, loff_t len,
+			   loff_t expect)
+{
+	loff_t actread;
+
+	memset(buf, '\0', TEST_FS_SIZE);
+	ut_assertok(fs_read_at(file, map_to_sysmem(buf), offset, len,
+			       &actread));
+	ut_asserteq(expect, actread);
+	ut_assertok(memcmp(src + offset, buf, expect));
+
+	return 0;
+}
+
+/* Test fs_open_file(), fs_read_at() and fs_close_file() */
+static int dm_test_fs_file(struct unit_test_state *uts)
+{
+	struct fs_file *file;
+	loff_t size;
+	u8 *src, *buf;
+	int i;
+
+	src = malloc(TEST_FS_SIZE);
+	buf = malloc(TEST_FS_SIZE);
+	ut_assertnonnull(src);
+	ut_assertnonnull(buf);
+	for (i = 0; i < TEST_FS_SIZE; i++)
+		src[i] = i * 13 + i / 4096;
+	ut_assertok(os_write_file(TEST_FS_FILE, src, TEST_FS_SIZE));
+
+	ut_assertok(fs_set_blk_dev("hostfs", "-", FS_TYPE_SANDBOX));
+	file = fs_open_file(TEST_FS_FILE);
+	ut_assertnonnull(file);
+	ut_asserteq(TEST_FS_SIZE, file->size);
+
+	/* The file system stays set up between reads */
+	ut_asserteq(FS_TYPE_SANDBOX, fs_get_type());
+	ut_assertok(test_fs_read_at(uts, file, src, buf, 0, 100, 100));
+	ut_assertok(test_fs_read_at(uts, file, src, buf, 4000, 5000, 5000));
+	ut_asserteq(FS_TYPE_SANDBOX, fs_get_type());
+
+	/* Reading to the end, and beyond it */
+	ut_assertok(test_fs_read_at(uts, file, src, buf, TEST_FS_SIZE - 10, 0,
+				    10));
+	ut_assertok(test_fs_read_at(uts, file, src, buf, 100, TEST_FS_SIZE,
+				    TEST_FS_SIZE - 100));
+	ut_assertok(test_fs_read_at(uts, file, src, buf, TEST_FS_SIZE, 1, 0));
+
+	/* Another fs operation closes the file system, which is set up again */
+	ut_assertok(fs_set_blk_dev("hostfs", "-", FS_TYPE_SANDBOX));
+	ut_assertok(fs_size(TEST_FS_FILE, &size));
+	ut_asserteq(TEST_FS_SIZE, size);
+	ut_asserteq(FS_TYPE_ANY, fs_get_type());
+	ut_assertok(test_fs_read_at(uts, file, src, buf, 8192, 1000, 1000));
+	ut_asserteq(FS_TYPE_SANDBOX, fs_get_type());
+
+	fs_close_file(file);
+	ut_asserteq(FS_TYPE_ANY, fs_get_type());
+
+	/* A file which does not exist cannot be opened */
+	ut_assertok(fs_set_blk_dev("hostfs", "-", FS_TYPE_SANDBOX));
+	ut_assertnull(fs_open_file("no_such_file.bin"));
+	ut_asserteq(FS_TYPE_ANY, fs_get_type());
+
+	ut_assertok(os_unlink(TEST_FS_FILE));
+	free(buf);
+	free(src);
+
+	return 0;
+}
+DM_TEST(dm_test_fs_file, 0);
@@ -4,8 +4,11 @@
  */
 
 #include <common.h>
+#include <bloblist.h>
 #include <dm.h>
+#include <malloc.h>
 #include <mmc.h>
+#include <asm/test.h>
 #include <dm/test.h>
 #include <test/ut.h>
 
@@ -41,3 +44,131 @@ static int dm_test_mmc_blk(struct unit_test_state *uts)
 	return 0;
 }
 DM_TEST(dm_test_mmc_blk, DM_TESTF_SCAN_PDATA | DM_TESTF_SCAN_FDT);
+
+/* Multi-block transfers should be announced with CMD23 and not stopped */
+static int dm_test_mmc_cmd23(struct unit_test_state *uts)
+{
+	uint sbc_count, stop_count, max_tasks, old_sbc, old_stop;
+	struct blk_desc *dev_desc;
+	struct udevice *dev;
+	char buf[8 * 512], cmp[8 * 512];
+	int i;
+
+	ut_assertok(uclass_get_device(UCLASS_MMC, 0, &dev));
+	ut_assertok(blk_get_device_by_str("mmc", "0", &dev_desc));
+	ut_assert(mmc_get_mmc_dev(dev)->cmd23);
+
+	for (i = 0; i < sizeof(buf); i++)
+		buf[i] = i;
+	sandbox_mmc_get_counts(dev, &old_sbc, &old_stop, &max_tasks);
+	ut_asserteq(8, blk_dwrite(dev_desc, 16, 8, buf));
+	memset(cmp, '\0', sizeof(cmp));
+	ut_asserteq(8, blk_dread(dev_desc, 16, 8, cmp));
+	ut_asserteq_mem(buf, cmp, sizeof(buf));
+
+	sandbox_mmc_get_counts(dev, &sbc_count, &stop_count, &max_tasks);
+	ut_asserteq(old_sbc + 2, sbc_count);
+	ut_asserteq(old_stop, stop_count);
+
+	return 0;
+}
+DM_TEST(dm_test_mmc_cmd23, DM_TESTF_SCAN_PDATA | DM_TESTF_SCAN_FDT);
+
+#if CONFIG_IS_ENABLED(MMC_CQE)
+/* Large reads from an eMMC device should be queued as several tasks */
+static int dm_test_mmc_cqe(struct unit_test_state *uts)
+{
+	uint sbc_count, stop_count, max_tasks;
+	struct blk_desc *dev_desc;
+	struct udevice *dev;
+	struct mmc *mmc;
+	char *buf, *cmp;
+	int i;
+
+	ut_assertok(uclass_get_device_by_name(UCLASS_MMC, "mmc2", &dev));
+	mmc = mmc_get_mmc_dev(dev);
+	ut_asserteq(16, mmc->cqe_depth);
+	dev_desc = mmc_get_blk_desc(mmc);
+	ut_asserteq(2048, dev_desc->lba);
+
+	buf = malloc(1024 * 512);
+	cmp = malloc(1024 * 512);
+	ut_assertnonnull(buf);
+	ut_assertnonnull(cmp);
+	for (i = 0; i < 1024 * 512; i++)
+		buf[i] = i / 512 + i;
+
+	/* Writes are not queued, reads go through the queue */
+	ut_asserteq(1024, blk_dwrite(dev_desc, 512, 1024, buf));
+	ut_assert(!mmc->cqe_on);
+	memset(cmp, '\0', 1024 * 512);
+	ut_asserteq(1024, blk_dread(dev_desc, 512, 1024, cmp));
+	ut_asserteq_mem(buf, cmp, 1024 * 512);
+	ut_assert(mmc->cqe_on);
+
+	/* 128-block transfers, so all eight tasks fit in one request */
+	sandbox_mmc_get_counts(dev, &sbc_count, &stop_count, &max_tasks);
+	ut_asserteq(8, max_tasks);
+
+	/* Any other data command takes the card out of queue mode first */
+	ut_asserteq(1, blk_dwrite(dev_desc, 512, 1, cmp + 512));
+	ut_assert(!mmc->cqe_on);
+	ut_asserteq(1, blk_dread(dev_desc, 512, 1, cmp));
+	ut_asserteq_mem(buf + 512, cmp, 512);
+	ut_assert(mmc->cqe_on);
+
+	free(cmp);
+	free(buf);
+
+	return 0;
+}
+DM_TEST(dm_test_mmc_cqe, DM_TESTF_SCAN_PDATA | DM_TESTF_SCAN_FDT);
+#endif
+
+#if CONFIG_IS_ENABLED(MMC_FAST_INIT)
+/* A card seen before should go straight to its recorded bus mode */
+static int dm_test_mmc_fast_init(struct unit_test_state *uts)
+{
+	struct mmc_init_cache *cache;
+	struct mmc_init_rec *rec;
+	struct udevice *dev;
+	struct mmc *mmc;
+
+	/* Start with an empty bloblist so that there is no record yet */
+	ut_assertok(bloblist_new(CONFIG_BLOBLIST_ADDR, CONFIG_BLOBLIST_SIZE,
+				 0));
+	ut_assertok(uclass_get_device_by_name(UCLASS_MMC, "mmc2", &dev));
+	mmc = mmc_get_mmc_dev(dev);
+	ut_asserteq(MMC_HS_52, mmc->selected_mode);
+	ut_asserteq(8, mmc->bus_width);
+
+	cache = bloblist_find(BLOBLISTT_MMC_INIT, sizeof(*cache));
+	ut_assertnonnull(cache);
+	rec = &cache->rec[0];
+	ut_asserteq(dev->seq, rec->seq);
+	ut_asserteq(0, rec->is_sd);
+	ut_asserteq(MMC_HS_52, rec->mode);
+	ut_asserteq(8, rec->bus_width);
+	ut_asserteq_mem(mmc->cid, rec->cid, sizeof(rec->cid));
+
+	/* The recorded mode is used even though it is not the best one */
+	rec->mode = MMC_HS;
+	rec->bus_width = 4;
+	mmc->has_init = 0;
+	ut_assertok(mmc_init(mmc));
+	ut_asserteq(MMC_HS, mmc->selected_mode);
+	ut_asserteq(4, mmc->bus_width);
+
+	/* A different card is negotiated in full and replaces the record */
+	rec->cid[0] ^= 1;
+	mmc->has_init = 0;
+	ut_assertok(mmc_init(mmc));
+	ut_asserteq(MMC_HS_52, mmc->selected_mode);
+	ut_asserteq(8, mmc->bus_width);
+	ut_asserteq(MMC_HS_52, rec->mode);
+	ut_asserteq_mem(mmc->cid, rec->cid, sizeof(rec->cid));
+
+	return 0;
+}
+DM_TEST(dm_test_mmc_fast_init, DM_TESTF_SCAN_PDATA | DM_TESTF_SCAN_FDT);
+#endif
@@ -0,0 +1,104 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Tests for the partition table cache
+ */
+
+#include <common.h>
+#include <blk.h>
+#include <dm.h>
+#include <part.h>
+#include <dm/test.h>
+#include <test/ut.h>
+
+#define TEST_PART_DISK_GUID	"375a56f7-d6c9-4e81-b5f0-09d41ca89efe"
+#define TEST_PART_COUNT		3
+
+static const char *const test_part_uuid[TEST_PART_COUNT] = {
+	"a3b5e9a6-1d4c-4a2e-9a43-3c1e9a5b1c01",
+	"a3b5e9a6-1d4c-4a2e-9a43-3c1e9a5b1c02",
+	"a3b5e9a6-1d4c-4a2e-9a43-3c1e9a5b1c03",
+};
+
+/* Write a GPT with three partitions of 64 blocks, named after @names */
+static int test_part_write_gpt(struct unit_test_state *uts,
+			       struct blk_desc *desc,
+			       const char *const names[TEST_PART_COUNT])
+{
+	disk_partition_t parts[TEST_PART_COUNT];
+	char disk_guid[] = TEST_PART_DISK_GUID;
+	int i;
+
+	memset(parts, '\0', sizeof(parts));
+	for (i = 0; i < TEST_PART_COUNT; i++) {
+		parts[i].start = 64 + i * 64;
+		parts[i].size = 64;
+		strcpy((char *)parts[i].name, names[i]);
+		strcpy(parts[i].uuid, test_part_uuid[i]);
+	}
+	ut_assertok(gpt_restore(desc, disk_guid, parts, TEST_PART_COUNT));
+
+	return 0;
+}
+
+/* Lookups by number, name and UUID should be served by the cache */
+static int dm_test_part_cache(struct unit_test_state *uts)
+{
+	static const char *const names[] = { "boot", "system_a", "system_b" };
+	static const char *const renamed[] = { "boot", "vendor_a", "system_a" };
+	struct blk_desc *desc;
+	struct part_cache *cache;
+	struct udevice *dev;
+	disk_partition_t info;
+	char buf[512];
+
+	ut_assertok(uclass_get_device(UCLASS_MMC, 0, &dev));
+	ut_assertok(blk_get_device_by_str("mmc", "0", &desc));
+	ut_assertok(test_part_write_gpt(uts, desc, names));
+	part_init(desc);
+	ut_asserteq(PART_TYPE_EFI, desc->part_type);
+	ut_assertnull(desc->part_cache);
+
+	ut_assertok(part_get_info(desc, 1, &info));
+	ut_asserteq(64, info.start);
+	ut_asserteq(64, info.size);
+	ut_asserteq_str("boot", (char *)info.name);
+	cache = desc->part_cache;
+	ut_assertnonnull(cache);
+	ut_asserteq(TEST_PART_COUNT, cache->nr_used);
+
+	ut_asserteq(-1, part_get_info(desc, TEST_PART_COUNT + 1, &info));
+	ut_asserteq(3, part_get_info_by_name(desc, "system_b", &info));
+	ut_asserteq(192, info.start);
+	ut_asserteq(-1, part_get_info_by_name(desc, "system", &info));
+	ut_asserteq(2, part_get_info_by_uuid(desc,
+					     "A3B5E9A6-1D4C-4A2E-9A43-3C1E9A5B1C02",
+					     &info));
+	ut_asserteq_str("system_a", (char *)info.name);
+	ut_asserteq_ptr(cache, desc->part_cache);
+
+	/* Writing inside a partition keeps the table */
+	memset(buf, '\xa5', sizeof(buf));
+	ut_asserteq(1, blk_dwrite(desc, 100, 1, buf));
+	ut_asserteq_ptr(cache, desc->part_cache);
+
+	/* Rewriting the table drops it */
+	ut_assertok(test_part_write_gpt(uts, desc, renamed));
+	ut_assertnull(desc->part_cache);
+	ut_asserteq(3, part_get_info_by_name(desc, "system_a", &info));
+	ut_asserteq(2, part_get_info_by_name(desc, "vendor_a", &info));
+	ut_asserteq(-1, part_get_info_by_name(desc, "system_b", &info));
+
+	/* So does writing only the backup table */
+	ut_assertnonnull(desc->part_cache);
+	ut_asserteq(1, blk_dwrite(desc, desc->lba - 1, 1, buf));
+	ut_assertnull(desc->part_cache);
+
+	/* A rescan drops it too */
+	ut_assertok(part_get_info(desc, 1, &info));
+	ut_assertnonnull(desc->part_cache);
+	part_init(desc);
+	ut_assertnull(desc->part_cache);
+
+	return 0;
+}
+DM_TEST(dm_test_part_cache, DM_TESTF_SCAN_PDATA | DM_TESTF_SCAN_FDT);
@@ -101,3 +101,56 @@ static int dm_test_spi_flash_func(struct unit_test_state *uts)
 	return 0;
 }
 DM_TEST(dm_test_spi_flash_func, DM_TESTF_SCAN_PDATA | DM_TESTF_SCAN_FDT);
+
+#ifdef CONFIG_SPI_FLASH_DIRMAP
+/* Test reads through the spi-mem direct mapping and the read-ahead buffer */
+static int dm_test_spi_flash_dirmap(struct unit_test_state *uts)
+{
+	struct udevice *dev;
+	int full_size = 0x200000;
+	int size = 0x10000;
+	uint reads;
+	u8 *src, *dst;
+	int i;
+
+	src = map_sysmem(0x20000, full_size);
+	for (i = 0; i < full_size; i++)
+		src[i] = i * 7;
+	ut_assertok(os_write_file("spi.bin", src, full_size));
+	ut_assertok(uclass_first_device_err(UCLASS_SPI_FLASH, &dev));
+	dst = map_sysmem(0x20000 + full_size, full_size);
+
+	/* A large read is served through the direct mapping */
+	reads = sandbox_spi_get_dirmap_reads(dev->parent);
+	ut_assertok(spi_flash_read_dm(dev, 0, size, dst));
+	ut_assertok(memcmp(src, dst, size));
+	ut_assert(sandbox_spi_get_dirmap_reads(dev->parent) > reads);
+
+	/* Small sequential reads only hit the flash when the buffer is empty */
+	reads = sandbox_spi_get_dirmap_reads(dev->parent);
+	for (i = 0; i < 0x800; i += 0x10) {
+		ut_assertok(spi_flash_read_dm(dev, 0x100 + i, 0x10, dst));
+		ut_assertok(memcmp(src + 0x100 + i, dst, 0x10));
+	}
+	ut_asserteq(reads + 1, sandbox_spi_get_dirmap_reads(dev->parent));
+
+	/* Erasing and writing must drop the buffered data */
+	ut_assertok(spi_flash_erase_dm(dev, 0, size));
+	for (i = 0; i < size; i++)
+		src[i] = ~i;
+	ut_assertok(spi_flash_write_dm(dev, 0, size, src));
+	for (i = 0; i < 0x800; i += 0x10) {
+		ut_assertok(spi_flash_read_dm(dev, 0x100 + i, 0x10, dst));
+		ut_assertok(memcmp(src + 0x100 + i, dst, 0x10));
+	}
+
+	/*
+	 * Since we are about to destroy all devices, we must tell sandbox
+	 * to forget the emulation device
+	 */
+	sandbox_sf_unbind_emul(state_get_current(), 0, 0);
+
+	return 0;
+}
+DM_TEST(dm_test_spi_flash_dirmap, DM_TESTF_SCAN_PDATA | DM_TESTF_SCAN_FDT);
+#endif
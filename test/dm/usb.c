@@ -6,6 +6,7 @@
 #include <common.h>
 #include <console.h>
 #include <dm.h>
+#include <malloc.h>
 #include <usb.h>
 #include <asm/io.h>
 #include <asm/state.h>
@@ -61,6 +62,36 @@ static int dm_test_usb_flash(struct unit_test_state *uts)
 }
 DM_TEST(dm_test_usb_flash, DM_TESTF_SCAN_PDATA | DM_TESTF_SCAN_FDT);
 
+/* Test reading the flash stick with the BBB phases queued on the controller */
+static int dm_test_usb_flash_queue(struct unit_test_state *uts)
+{
+	struct udevice *bus, *dev;
+	struct blk_desc *dev_desc;
+	char cmp[1024];
+
+	state_set_skip_delays(true);
+	ut_assertok(usb_init());
+	ut_assertok(uclass_get_device(UCLASS_MASS_STORAGE, 0, &dev));
+	ut_assertok(blk_get_device_by_str("usb", "0", &dev_desc));
+	ut_assertok(uclass_get_device_by_name(UCLASS_USB, "usb@0", &bus));
+	sandbox_usb_set_queue(bus, true);
+
+	/* Make sure the read goes to the device */
+	blkcache_invalidate(dev_desc->if_type, dev_desc->devnum);
+	memset(cmp, '\0', sizeof(cmp));
+	ut_asserteq(2, blk_dread(dev_desc, 0, 2, cmp));
+	ut_assertok(strcmp(cmp, "this is a test"));
+
+	/* The command, data and status were all queued before the first reap */
+	ut_asserteq(3, sandbox_usb_max_queued(bus));
+
+	sandbox_usb_set_queue(bus, false);
+	ut_assertok(usb_stop());
+
+	return 0;
+}
+DM_TEST(dm_test_usb_flash_queue, DM_TESTF_SCAN_PDATA | DM_TESTF_SCAN_FDT);
+
 /* test that we can handle multiple storage devices */
 static int dm_test_usb_multi(struct unit_test_state *uts)
 {
@@ -113,7 +144,7 @@ static int dm_test_usb_stop(struct unit_test_state *uts)
 	ut_assertok(uclass_get_device(UCLASS_MASS_STORAGE, 0, &dev));
 	ut_assertok(uclass_get_device(UCLASS_MASS_STORAGE, 1, &dev));
 	ut_assertok(uclass_get_device(UCLASS_MASS_STORAGE, 2, &dev));
-	ut_asserteq(6, count_usb_devices());
+	ut_asserteq(7, count_usb_devices());
 	ut_assertok(usb_stop());
 	ut_asserteq(0, count_usb_devices());
 
@@ -121,6 +152,63 @@ static int dm_test_usb_stop(struct unit_test_state *uts)
 }
 DM_TEST(dm_test_usb_stop, DM_TESTF_SCAN_PDATA | DM_TESTF_SCAN_FDT);
 
+/*
+ * Test the UAS driver. Writes and reads are split into several commands which
+ * should all be queued on the device at once.
+ */
+static int dm_test_usb_uas(struct unit_test_state *uts)
+{
+	struct udevice *dev, *blk, *emul;
+	struct blk_desc *dev_desc;
+	const int count = 200;
+	char *buf, *cmp;
+	int i;
+
+	state_set_skip_delays(true);
+	ut_assertok(usb_init());
+	ut_assertok(uclass_get_device(UCLASS_MASS_STORAGE, 3, &dev));
+	ut_assertok(device_find_first_child(dev, &blk));
+	ut_assertnonnull(blk);
+	ut_asserteq_str("usb_uas_blk", blk->driver->name);
+	dev_desc = dev_get_uclass_platdata(blk);
+	ut_asserteq(512, dev_desc->blksz);
+	ut_asserteq(2048, dev_desc->lba);
+
+	buf = malloc(count * 512);
+	cmp = malloc(count * 512);
+	ut_assertnonnull(buf);
+	ut_assertnonnull(cmp);
+
+	/* The emulator puts a string in the first block */
+	memset(cmp, '\0', 512);
+	ut_asserteq(1, blk_dread(dev_desc, 0, 1, cmp));
+	ut_assertok(strcmp(cmp, "this is a uas test"));
+
+	for (i = 0; i < count * 512; i++)
+		buf[i] = i * 7 + i / 512;
+	ut_asserteq(count, blk_dwrite(dev_desc, 100, count, buf));
+	memset(cmp, '\0', count * 512);
+	ut_asserteq(count, blk_dread(dev_desc, 100, count, cmp));
+	ut_assertok(memcmp(buf, cmp, count * 512));
+
+	ut_assertok(uclass_get_device_by_name(UCLASS_USB_EMUL, "uas@4",
+					      &emul));
+	ut_assert(sandbox_usb_uas_max_queued(emul) > 1);
+
+	/* A command which moves too little data fails despite a good status */
+	sandbox_usb_uas_short_data(emul);
+	ut_assert(blk_dread(dev_desc, 100, count, cmp) < count);
+	ut_asserteq(count, blk_dread(dev_desc, 100, count, cmp));
+	ut_assertok(memcmp(buf, cmp, count * 512));
+
+	free(cmp);
+	free(buf);
+	ut_assertok(usb_stop());
+
+	return 0;
+}
+DM_TEST(dm_test_usb_uas, DM_TESTF_SCAN_PDATA | DM_TESTF_SCAN_FDT);
+
 /**
  * dm_test_usb_keyb() - test USB keyboard driver
  *
@@ -0,0 +1,309 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Unit tests for the software BCH ECC library
+ *
+ * A 4 KiB page is protected in 512-byte steps with 8-bit correction, as done
+ * by nand_bch for typical large-page NAND.
+ */
+
+#include <common.h>
+#include <malloc.h>
+#include <rand.h>
+#include <linux/bch.h>
+#include <test/lib.h>
+#include <test/test.h>
+#include <test/ut.h>
+
+#define TEST_BCH_M		13
+#define TEST_BCH_T		8
+#define TEST_BCH_STEP_SIZE	512
+#define TEST_BCH_STEPS		8
+#define TEST_BCH_PAGE_SIZE	(TEST_BCH_STEP_SIZE * TEST_BCH_STEPS)
+
+/* Generator polynomial of the test code, without its X^104 term */
+static const u8 test_bch_genpoly[] = {
+	0x15, 0xf9, 0x14, 0xe0, 0x7b, 0x0c, 0x13, 0x87, 0x41, 0xc5, 0xc4, 0xfb,
+	0x23,
+};
+
+/**
+ * test_bch_flip() - Flip random bits in a step and its ECC
+ *
+ * @bch:	BCH control structure
+ * @data:	data of the step
+ * @ecc:	ECC of the step
+ * @count:	number of distinct bits to flip
+ */
+static void test_bch_flip(struct bch_control *bch, u8 *data, u8 *ecc,
+			  int count)
+{
+	const unsigned int nbits = TEST_BCH_STEP_SIZE * 8 + bch->ecc_bits;
+	unsigned int bits[TEST_BCH_T];
+	unsigned int bit;
+	int i, j;
+
+	for (i = 0; i < count; i++) {
+		do {
+			bit = rand() % nbits;
+			for (j = 0; j < i && bits[j] != bit; j++)
+				;
+		} while (j < i);
+		bits[i] = bit;
+
+		if (bit < TEST_BCH_STEP_SIZE * 8) {
+			data[bit / 8] ^= 1 << (bit % 8);
+		} else {
+			bit -= TEST_BCH_STEP_SIZE * 8;
+			ecc[bit / 8] ^= 0x80 >> (bit % 8);
+		}
+	}
+}
+
+/**
+ * test_bch_encode_bits() - Reference encoder, one data bit at a time
+ *
+ * This divides by the generator polynomial in a shift register, as a hardware
+ * encoder would, rather than using the remainder tables of encode_bch().
+ *
+ * @data:	data to encode
+ * @len:	data length in bytes
+ * @ecc:	ECC, updated in place as by encode_bch()
+ */
+static void test_bch_encode_bits(const u8 *data, unsigned int len, u8 *ecc)
+{
+	const int nbytes = sizeof(test_bch_genpoly);
+	int bit, i, feedback;
+
+	for (; len; len--, data++) {
+		for (bit = 7; bit >= 0; bit--) {
+			feedback = ((*data >> bit) ^ (ecc[0] >> 7)) & 1;
+			for (i = 0; i < nbytes - 1; i++)
+				ecc[i] = ecc[i] << 1 | ecc[i + 1] >> 7;
+			ecc[nbytes - 1] <<= 1;
+			if (!feedback)
+				continue;
+			for (i = 0; i < nbytes; i++)
+				ecc[i] ^= test_bch_genpoly[i];
+		}
+	}
+}
+
+/**
+ * test_bch_read_page() - Check and correct a page as a NAND read would
+ *
+ * @bch:	BCH control structure
+ * @page:	page data, corrected in place
+ * @read_ecc:	ECC read along with the page, one entry per step
+ * @errloc:	buffer for error locations
+ * @return number of corrected bits, or -ve on uncorrectable error
+ */
+static int test_bch_read_page(struct bch_control *bch, u8 *page,
+			      const u8 *read_ecc, unsigned int *errloc)
+{
+	u8 calc_ecc[TEST_BCH_T * 2];
+	int step, i, count, total = 0;
+
+	for (step = 0; step < TEST_BCH_STEPS; step++) {
+		u8 *data = page + step * TEST_BCH_STEP_SIZE;
+
+		memset(calc_ecc, 0, bch->ecc_bytes);
+		encode_bch(bch, data, TEST_BCH_STEP_SIZE, calc_ecc);
+		count = decode_bch(bch, NULL, TEST_BCH_STEP_SIZE,
+				   read_ecc + step * bch->ecc_bytes, calc_ecc,
+				   NULL, errloc);
+		if (count < 0)
+			return count;
+		for (i = 0; i < count; i++) {
+			if (errloc[i] < TEST_BCH_STEP_SIZE * 8)
+				data[errloc[i] >> 3] ^= 1 << (errloc[i] & 7);
+		}
+		total += count;
+	}
+
+	return total;
+}
+
+/**
+ * test_bch_setup() - Set up a random page, its ECC and a copy to corrupt
+ *
+ * @uts:	unit test state
+ * @bch:	BCH control structure
+ * @page:	returns the reference page
+ * @ecc:	returns the ECC of the reference page
+ * @buf:	returns a copy of the page
+ * @return 0 if OK, -ve on error
+ */
+static int test_bch_setup(struct unit_test_state *uts, struct bch_control *bch,
+			  u8 **page, u8 **ecc, u8 **buf)
+{
+	int i;
+
+	*page = malloc(TEST_BCH_PAGE_SIZE);
+	*buf = malloc(TEST_BCH_PAGE_SIZE);
+	*ecc = calloc(TEST_BCH_STEPS, bch->ecc_bytes);
+	ut_assertnonnull(*page);
+	ut_assertnonnull(*buf);
+	ut_assertnonnull(*ecc);
+
+	srand(1);
+	for (i = 0; i < TEST_BCH_PAGE_SIZE; i++)
+		(*page)[i] = rand();
+	for (i = 0; i < TEST_BCH_STEPS; i++)
+		encode_bch(bch, *page + i * TEST_BCH_STEP_SIZE,
+			   TEST_BCH_STEP_SIZE, *ecc + i * bch->ecc_bytes);
+	memcpy(*buf, *page, TEST_BCH_PAGE_SIZE);
+
+	return 0;
+}
+
+/* Check that up to t bit errors per step are located and corrected */
+static int lib_test_bch_correct(struct unit_test_state *uts)
+{
+	unsigned int errloc[TEST_BCH_T];
+	struct bch_control *bch;
+	u8 *page, *ref_ecc, *buf, *ecc;
+	int step, count;
+
+	bch = init_bch(TEST_BCH_M, TEST_BCH_T, 0);
+	ut_assertnonnull(bch);
+	ut_assertok(test_bch_setup(uts, bch, &page, &ref_ecc, &buf));
+	ecc = malloc(TEST_BCH_STEPS * bch->ecc_bytes);
+	ut_assertnonnull(ecc);
+
+	/* A clean page needs no correction */
+	ut_asserteq(0, test_bch_read_page(bch, buf, ref_ecc, errloc));
+	ut_asserteq_mem(page, buf, TEST_BCH_PAGE_SIZE);
+
+	for (count = 1; count <= TEST_BCH_T; count++) {
+		memcpy(ecc, ref_ecc, TEST_BCH_STEPS * bch->ecc_bytes);
+		for (step = 0; step < TEST_BCH_STEPS; step++)
+			test_bch_flip(bch, buf + step * TEST_BCH_STEP_SIZE,
+				      ecc + step * bch->ecc_bytes, count);
+
+		/* Letting decode_bch() compute the ECC gives the same result */
+		ut_asserteq(count, decode_bch(bch, buf, TEST_BCH_STEP_SIZE,
+					      ecc, NULL, NULL, errloc));
+
+		ut_asserteq(count * TEST_BCH_STEPS,
+			    test_bch_read_page(bch, buf, ecc, errloc));
+		ut_asserteq_mem(page, buf, TEST_BCH_PAGE_SIZE);
+	}
+
+	free(ecc);
+	free(buf);
+	free(ref_ecc);
+	free(page);
+	free_bch(bch);
+
+	return 0;
+}
+
+LIB_TEST(lib_test_bch_correct, 0);
+
+/* Check the table-driven encoder against the bit-by-bit one */
+static int lib_test_bch_encode(struct unit_test_state *uts)
+{
+	static const unsigned int lens[] = {
+		1, 3, 4, 5, 7, 8, 9, 12, 15, 16, 17, 100, 511,
+		TEST_BCH_STEP_SIZE,
+	};
+	u8 ecc[sizeof(test_bch_genpoly)], ref[sizeof(test_bch_genpoly)];
+	struct bch_control *bch;
+	unsigned int len;
+	int i, offset;
+	u8 *buf;
+
+	bch = init_bch(TEST_BCH_M, TEST_BCH_T, 0);
+	ut_assertnonnull(bch);
+	ut_asserteq(sizeof(test_bch_genpoly) * 8, bch->ecc_bits);
+	ut_asserteq(sizeof(test_bch_genpoly), bch->ecc_bytes);
+	buf = malloc(TEST_BCH_STEP_SIZE + 8);
+	ut_assertnonnull(buf);
+	srand(1);
+	for (i = 0; i < TEST_BCH_STEP_SIZE + 8; i++)
+		buf[i] = rand();
+
+	/* Cover each alignment and a tail after the eight-byte steps */
+	for (offset = 0; offset < 8; offset++) {
+		for (i = 0; i < ARRAY_SIZE(lens); i++) {
+			len = lens[i];
+			memset(ecc, '\0', sizeof(ecc));
+			memset(ref, '\0', sizeof(ref));
+			encode_bch(bch, buf + offset, len, ecc);
+			test_bch_encode_bits(buf + offset, len, ref);
+			ut_asserteq_mem(ref, ecc, sizeof(ecc));
+		}
+	}
+
+	/* Encoding can continue from the ECC of earlier data */
+	memset(ecc, '\0', sizeof(ecc));
+	memset(ref, '\0', sizeof(ref));
+	encode_bch(bch, buf + 1, 37, ecc);
+	encode_bch(bch, buf + 38, TEST_BCH_STEP_SIZE - 37, ecc);
+	test_bch_encode_bits(buf + 1, TEST_BCH_STEP_SIZE, ref);
+	ut_asserteq_mem(ref, ecc, sizeof(ecc));
+
+	free(buf);
+	free_bch(bch);
+
+	return 0;
+}
+
+LIB_TEST(lib_test_bch_encode, 0);
+
+/*
+ * Check that a step with a single bit flipped, in the data or in the ECC, is
+ * not taken as clean and that the bit is located
+ */
+static int lib_test_bch_single(struct unit_test_state *uts)
+{
+	const unsigned int nbits = TEST_BCH_STEP_SIZE * 8;
+	u8 ecc[sizeof(test_bch_genpoly)], calc_ecc[sizeof(test_bch_genpoly)];
+	unsigned int errloc[TEST_BCH_T];
+	struct bch_control *bch;
+	unsigned int bit;
+	u8 *buf;
+
+	bch = init_bch(TEST_BCH_M, TEST_BCH_T, 0);
+	ut_assertnonnull(bch);
+	ut_asserteq(sizeof(ecc), bch->ecc_bytes);
+	buf = malloc(TEST_BCH_STEP_SIZE);
+	ut_assertnonnull(buf);
+	srand(2);
+	for (bit = 0; bit < TEST_BCH_STEP_SIZE; bit++)
+		buf[bit] = rand();
+	memset(ecc, '\0', sizeof(ecc));
+	encode_bch(bch, buf, TEST_BCH_STEP_SIZE, ecc);
+
+	/* A clean step takes the early exit */
+	memcpy(calc_ecc, ecc, sizeof(ecc));
+	ut_asserteq(0, decode_bch(bch, NULL, TEST_BCH_STEP_SIZE, ecc, calc_ecc,
+				  NULL, errloc));
+
+	for (bit = 0; bit < nbits; bit++) {
+		buf[bit / 8] ^= 1 << (bit % 8);
+		memset(calc_ecc, '\0', sizeof(calc_ecc));
+		encode_bch(bch, buf, TEST_BCH_STEP_SIZE, calc_ecc);
+		ut_asserteq(1, decode_bch(bch, NULL, TEST_BCH_STEP_SIZE, ecc,
+					  calc_ecc, NULL, errloc));
+		ut_asserteq(bit, errloc[0]);
+		buf[bit / 8] ^= 1 << (bit % 8);
+	}
+
+	memset(calc_ecc, '\0', sizeof(calc_ecc));
+	encode_bch(bch, buf, TEST_BCH_STEP_SIZE, calc_ecc);
+	for (bit = 0; bit < bch->ecc_bits; bit++) {
+		ecc[bit / 8] ^= 1 << (bit % 8);
+		ut_asserteq(1, decode_bch(bch, NULL, TEST_BCH_STEP_SIZE, ecc,
+					  calc_ecc, NULL, errloc));
+		ut_asserteq(nbits + bit, errloc[0]);
+		ecc[bit / 8] ^= 1 << (bit % 8);
+	}
+
+	free(buf);
+	free_bch(bch);
+
+	return 0;
+}
+
+LIB_TEST(lib_test_bch_single, 0);
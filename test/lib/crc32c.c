@@ -0,0 +1,55 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Unit tests for the CRC32C (Castagnoli) library
+ */
+
+#include <common.h>
+#include <malloc.h>
+#include <rand.h>
+#include <u-boot/crc.h>
+#include <test/lib.h>
+#include <test/test.h>
+#include <test/ut.h>
+
+#define TEST_CRC32C_POLY	0x82F63B78
+#define TEST_CRC32C_BUF_SIZE	0x10000
+
+/* Check crc32c() against known values and the byte-wise crc32c_cal() */
+static int lib_test_crc32c(struct unit_test_state *uts)
+{
+	u32 table[256];
+	u8 *buf;
+	int i, offset, len;
+	u32 crc;
+
+	ut_asserteq(0xe3069283, ~crc32c(~0, "123456789", 9));
+
+	buf = calloc(1, TEST_CRC32C_BUF_SIZE);
+	ut_assertnonnull(buf);
+	ut_asserteq(0x8a9136aa, ~crc32c(~0, buf, 32));
+
+	crc32c_init(table, TEST_CRC32C_POLY);
+	srand(1);
+	for (i = 0; i < TEST_CRC32C_BUF_SIZE; i++)
+		buf[i] = rand();
+
+	/* All alignments and short tails of both implementations */
+	for (i = 0; i < 1000; i++) {
+		offset = rand() % 64;
+		len = rand() % 4096;
+		crc = rand();
+		ut_asserteq(crc32c_cal(crc, (char *)buf + offset, len, table),
+			    crc32c(crc, buf + offset, len));
+	}
+
+	/* Checksumming in pieces gives the same result */
+	crc = crc32c(~0, buf, 1000);
+	crc = crc32c(crc, buf + 1000, TEST_CRC32C_BUF_SIZE - 1000);
+	ut_asserteq(crc, crc32c(~0, buf, TEST_CRC32C_BUF_SIZE));
+
+	free(buf);
+
+	return 0;
+}
+
+LIB_TEST(lib_test_crc32c, 0);
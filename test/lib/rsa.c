@@ -9,10 +9,15 @@
 #include <common.h>
 #include <command.h>
 #include <image.h>
+#include <malloc.h>
+#include <time.h>
 #include <test/lib.h>
 #include <test/test.h>
 #include <test/ut.h>
 #include <u-boot/rsa.h>
+#include <u-boot/rsa-mod-exp.h>
+#include <u-boot/sha256.h>
+#include <asm/unaligned.h>
 
 #ifdef CONFIG_RSA_VERIFY_WITH_PKEY
 /*
@@ -203,4 +208,172 @@ static int lib_rsa_verify_invalid(struct unit_test_state *uts)
 }
 
 LIB_TEST(lib_rsa_verify_invalid, 0);
+
+#ifdef CONFIG_RSA_SOFTWARE_EXP
+/* Number of exponentiations timed for each variant */
+#define RSA_MOD_EXP_LOOPS	20
+
+/**
+ * lib_rsa_mod_exp_time() - time exponentiations with a prepared key
+ *
+ * @ctx:	Prepared key
+ * @wide:	true to use 64-bit limbs, false for the baseline pow_mod()
+ * @out:	Buffer for the result
+ * Return:	average time for one exponentiation in microseconds
+ */
+static ulong lib_rsa_mod_exp_time(struct rsa_mod_exp_ctx *ctx, bool wide,
+				  uint8_t *out)
+{
+	ulong start;
+	int i;
+
+	ctx->wide = wide;
+	start = timer_get_us();
+	for (i = 0; i < RSA_MOD_EXP_LOOPS; i++)
+		rsa_mod_exp_ctx(ctx, data_enc, data_enc_len, out);
+
+	return (timer_get_us() - start) / RSA_MOD_EXP_LOOPS;
+}
+
+/**
+ * lib_rsa_mod_exp() - unit test for the software modular exponentiation
+ *
+ * Check the result of the baseline pow_mod() against the SHA-256 digest of
+ * the signed data, check that the 64-bit code and a cached key give the same
+ * result, and report the time taken by each against the baseline.
+ *
+ * @uts:	unit test state
+ * Return:	0 = success, 1 = failure
+ */
+static int lib_rsa_mod_exp(struct unit_test_state *uts)
+{
+	uint8_t expect[256], out[256], digest[SHA256_SUM_LEN];
+	struct rsa_mod_exp_ctx *ctx, *cached = NULL;
+	ulong base, wide = 0;
+	struct key_prop *prop;
+
+	ut_assertok(rsa_gen_key_prop(public_key, public_key_len, &prop));
+	ut_assertok(rsa_mod_exp_ctx_new(prop, &ctx));
+
+	/* The baseline gives a PKCS#1 v1.5 block ending in the digest */
+	base = lib_rsa_mod_exp_time(ctx, false, expect);
+	ut_asserteq(0, expect[0]);
+	ut_asserteq(1, expect[1]);
+	sha256_csum_wd(data_raw, data_raw_len, digest, CHUNKSZ_SHA256);
+	ut_asserteq_mem(digest, expect + data_enc_len - SHA256_SUM_LEN,
+			SHA256_SUM_LEN);
+
+#ifdef RSA_MONT_64
+	memset(out, '\0', sizeof(out));
+	wide = lib_rsa_mod_exp_time(ctx, true, out);
+	ut_asserteq_mem(expect, out, data_enc_len);
+#endif
+	free(ctx);
+
+	/* A key cached by the caller is set up once, then reused */
+	prop->ctxp = &cached;
+	ut_assertok(rsa_mod_exp_sw(data_enc, data_enc_len, prop, out));
+	ut_assertnonnull(cached);
+	ctx = cached;
+	memset(out, '\0', sizeof(out));
+	ut_assertok(rsa_mod_exp_sw(data_enc, data_enc_len, prop, out));
+	ut_asserteq_ptr(ctx, cached);
+	ut_asserteq_mem(expect, out, data_enc_len);
+	free(ctx);
+	rsa_free_key_prop(prop);
+
+	printf("rsa2048 us/op: pow_mod() %lu, 64-bit limbs %lu\n", base, wide);
+
+	return CMD_RET_SUCCESS;
+}
+
+LIB_TEST(lib_rsa_mod_exp, 0);
+
+/*
+ * Public exponents long enough for the sliding window: isolated end bits,
+ * all bits set and a mix of runs
+ */
+static const uint64_t rsa_long_exponents[] = {
+	0x80000001ULL,
+	0x8000000000000001ULL,
+	0xffffffffffffffffULL,
+	0xc5a396e10f2b7d4bULL,
+};
+
+/*
+ * data_enc ^ 0xc5a396e10f2b7d4b mod n, where n is the modulus of public_key,
+ * computed with Python's pow()
+ */
+static const uint8_t rsa_long_exp_result[] = {
+	0x95, 0x37, 0xaf, 0x21, 0xa5, 0x09, 0xd6, 0x29, 0x2c, 0x4d, 0x62, 0x84,
+	0xe5, 0x83, 0x8e, 0xa5, 0x65, 0x53, 0xe8, 0xfd, 0xec, 0xc9, 0x28, 0x24,
+	0xde, 0x79, 0xa1, 0x89, 0xe5, 0x36, 0x15, 0xdf, 0xbf, 0xd7, 0x16, 0x4b,
+	0x57, 0x9d, 0x91, 0x18, 0x0c, 0x13, 0x3f, 0x81, 0x4f, 0x1f, 0x43, 0xc0,
+	0x17, 0x26, 0xb7, 0x6c, 0x7f, 0x09, 0xf4, 0x81, 0xe4, 0xdb, 0x37, 0x6b,
+	0x89, 0x59, 0xc9, 0x80, 0xf2, 0x7c, 0xf8, 0xfb, 0x44, 0xb3, 0xd1, 0xbf,
+	0x90, 0x20, 0xc8, 0xa2, 0xb0, 0xac, 0xa5, 0x92, 0xa0, 0x09, 0x0c, 0x54,
+	0x57, 0xd1, 0x4a, 0x07, 0x69, 0xee, 0x74, 0x5b, 0x28, 0xe5, 0x7a, 0x13,
+	0x5f, 0x84, 0x88, 0x09, 0xd1, 0xaa, 0x26, 0xce, 0x74, 0x98, 0x0d, 0xb5,
+	0xde, 0xba, 0x97, 0xd6, 0xc8, 0x4d, 0xa5, 0x62, 0x95, 0xb6, 0x50, 0x9e,
+	0x08, 0xf9, 0xaf, 0xdf, 0xc9, 0xab, 0xb3, 0x63, 0x21, 0x54, 0x8e, 0xf2,
+	0x4a, 0x55, 0x2e, 0x7b, 0xf6, 0xbb, 0x76, 0x33, 0xc7, 0xd7, 0xb8, 0xe9,
+	0x13, 0xb5, 0x86, 0x7d, 0x00, 0xf3, 0x41, 0x8c, 0x4a, 0xdb, 0xe6, 0x82,
+	0xf3, 0xdc, 0x76, 0xa1, 0x11, 0x13, 0x8f, 0x9b, 0xd7, 0xf8, 0xdb, 0xb6,
+	0x49, 0x35, 0x2b, 0x60, 0x6b, 0x3a, 0xff, 0x70, 0x6e, 0x33, 0xb4, 0x10,
+	0x65, 0x6d, 0xd9, 0x62, 0x90, 0xbf, 0x1a, 0x82, 0xc7, 0x46, 0xba, 0xc9,
+	0xa8, 0xa4, 0xfb, 0xc5, 0xad, 0xa9, 0x2b, 0x7a, 0xc3, 0xcf, 0xe8, 0x24,
+	0xaf, 0x54, 0x76, 0x3e, 0xed, 0x99, 0xf1, 0x90, 0x75, 0x29, 0xbd, 0x2a,
+	0x1f, 0xf9, 0x8b, 0x01, 0x38, 0xac, 0xb4, 0x52, 0x6d, 0x59, 0xc0, 0x18,
+	0xbd, 0x62, 0x7a, 0x2e, 0xe6, 0x24, 0x97, 0x60, 0x5e, 0xd2, 0x21, 0xb5,
+	0x14, 0x63, 0xdb, 0xb2, 0x01, 0x39, 0x15, 0x56, 0x95, 0xaa, 0xa6, 0x53,
+	0xab, 0x4c, 0x14, 0x06,
+};
+
+/**
+ * lib_rsa_mod_exp_window() - unit test for long public exponents
+ *
+ * Check exponentiation with exponents long enough to use the sliding window,
+ * against pow_mod() and against a known answer.
+ *
+ * @uts:	unit test state
+ * Return:	0 = success, 1 = failure
+ */
+static int lib_rsa_mod_exp_window(struct unit_test_state *uts)
+{
+	uint8_t expect[256], out[256];
+	struct rsa_mod_exp_ctx *ctx;
+	struct key_prop *prop;
+	int i;
+
+	ut_assertok(rsa_gen_key_prop(public_key, public_key_len, &prop));
+	for (i = 0; i < ARRAY_SIZE(rsa_long_exponents); i++) {
+		put_unaligned_be64(rsa_long_exponents[i],
+				   (void *)prop->public_exponent);
+		ut_assertok(rsa_mod_exp_ctx_new(prop, &ctx));
+		ut_assert(ctx->window > 1);
+
+		ctx->wide = false;
+		ut_assertok(rsa_mod_exp_ctx(ctx, data_enc, data_enc_len,
+					    expect));
+#ifdef RSA_MONT_64
+		memset(out, '\0', sizeof(out));
+		ctx->wide = true;
+		ut_assertok(rsa_mod_exp_ctx(ctx, data_enc, data_enc_len, out));
+		ut_asserteq_mem(expect, out, data_enc_len);
+#endif
+		free(ctx);
+	}
+	ut_asserteq_mem(rsa_long_exp_result, expect, data_enc_len);
+
+	/* The whole verification path gives the same answer */
+	memset(out, '\0', sizeof(out));
+	ut_assertok(rsa_mod_exp_sw(data_enc, data_enc_len, prop, out));
+	ut_asserteq_mem(rsa_long_exp_result, out, data_enc_len);
+	rsa_free_key_prop(prop);
+
+	return CMD_RET_SUCCESS;
+}
+
+LIB_TEST(lib_rsa_mod_exp_window, 0);
+#endif /* RSA_SOFTWARE_EXP */
 #endif /* RSA_VERIFY_WITH_PKEY */
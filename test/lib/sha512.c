@@ -0,0 +1,142 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Unit tests for the SHA-384/SHA-512 hash functions
+ *
+ * The known-answer vectors are taken from FIPS 180-2, appendices C and D.
+ */
+
+#include <common.h>
+#include <hash.h>
+#include <malloc.h>
+#include <rand.h>
+#include <test/lib.h>
+#include <test/test.h>
+#include <test/ut.h>
+#include <u-boot/sha512.h>
+
+/* Size of the buffer used for the progressive test */
+#define TEST_SHA512_BUF_SIZE	(1024 * 1024)
+
+struct test_sha512_s {
+	const char *algo;
+	const char *input;
+	u8 digest[SHA512_SUM_LEN];
+};
+
+static const char test_sha512_two_block[] =
+	"abcdefghbcdefghicdefghijdefghijkefghijklfghijklmghijklmn"
+	"hijklmnoijklmnopjklmnopqklmnopqrlmnopqrsmnopqrstnopqrstu";
+
+static struct test_sha512_s test_sha512[] = {
+	{
+		"sha384", "abc",
+		{
+		0xcb, 0x00, 0x75, 0x3f, 0x45, 0xa3, 0x5e, 0x8b,
+		0xb5, 0xa0, 0x3d, 0x69, 0x9a, 0xc6, 0x50, 0x07,
+		0x27, 0x2c, 0x32, 0xab, 0x0e, 0xde, 0xd1, 0x63,
+		0x1a, 0x8b, 0x60, 0x5a, 0x43, 0xff, 0x5b, 0xed,
+		0x80, 0x86, 0x07, 0x2b, 0xa1, 0xe7, 0xcc, 0x23,
+		0x58, 0xba, 0xec, 0xa1, 0x34, 0xc8, 0x25, 0xa7,
+		},
+	},
+	{
+		"sha384", test_sha512_two_block,
+		{
+		0x09, 0x33, 0x0c, 0x33, 0xf7, 0x11, 0x47, 0xe8,
+		0x3d, 0x19, 0x2f, 0xc7, 0x82, 0xcd, 0x1b, 0x47,
+		0x53, 0x11, 0x1b, 0x17, 0x3b, 0x3b, 0x05, 0xd2,
+		0x2f, 0xa0, 0x80, 0x86, 0xe3, 0xb0, 0xf7, 0x12,
+		0xfc, 0xc7, 0xc7, 0x1a, 0x55, 0x7e, 0x2d, 0xb9,
+		0x66, 0xc3, 0xe9, 0xfa, 0x91, 0x74, 0x60, 0x39,
+		},
+	},
+	{
+		"sha512", "abc",
+		{
+		0xdd, 0xaf, 0x35, 0xa1, 0x93, 0x61, 0x7a, 0xba,
+		0xcc, 0x41, 0x73, 0x49, 0xae, 0x20, 0x41, 0x31,
+		0x12, 0xe6, 0xfa, 0x4e, 0x89, 0xa9, 0x7e, 0xa2,
+		0x0a, 0x9e, 0xee, 0xe6, 0x4b, 0x55, 0xd3, 0x9a,
+		0x21, 0x92, 0x99, 0x2a, 0x27, 0x4f, 0xc1, 0xa8,
+		0x36, 0xba, 0x3c, 0x23, 0xa3, 0xfe, 0xeb, 0xbd,
+		0x45, 0x4d, 0x44, 0x23, 0x64, 0x3c, 0xe8, 0x0e,
+		0x2a, 0x9a, 0xc9, 0x4f, 0xa5, 0x4c, 0xa4, 0x9f,
+		},
+	},
+	{
+		"sha512", test_sha512_two_block,
+		{
+		0x8e, 0x95, 0x9b, 0x75, 0xda, 0xe3, 0x13, 0xda,
+		0x8c, 0xf4, 0xf7, 0x28, 0x14, 0xfc, 0x14, 0x3f,
+		0x8f, 0x77, 0x79, 0xc6, 0xeb, 0x9f, 0x7f, 0xa1,
+		0x72, 0x99, 0xae, 0xad, 0xb6, 0x88, 0x90, 0x18,
+		0x50, 0x1d, 0x28, 0x9e, 0x49, 0x00, 0xf7, 0xe4,
+		0x33, 0x1b, 0x99, 0xde, 0xc4, 0xb5, 0x43, 0x3a,
+		0xc7, 0xd3, 0x29, 0xee, 0xb6, 0xdd, 0x26, 0x54,
+		0x5e, 0x96, 0xe5, 0x5b, 0x87, 0x4b, 0xe9, 0x09,
+		},
+	},
+};
+
+/* Check the known-answer vectors through the hash framework */
+static int lib_test_sha512_vectors(struct unit_test_state *uts)
+{
+	u8 output[HASH_MAX_DIGEST_SIZE];
+	struct test_sha512_s *test;
+	int i, size;
+
+	for (i = 0; i < ARRAY_SIZE(test_sha512); i++) {
+		test = &test_sha512[i];
+		size = sizeof(output);
+		ut_assertok(hash_block(test->algo, test->input,
+				       strlen(test->input), output, &size));
+		ut_asserteq(strcmp(test->algo, "sha384") ? SHA512_SUM_LEN :
+			    SHA384_SUM_LEN, size);
+		ut_asserteq_mem(test->digest, output, size);
+	}
+
+	return 0;
+}
+
+LIB_TEST(lib_test_sha512_vectors, 0);
+
+/* Hashing in odd-sized pieces must give the same result as one call */
+static int lib_test_sha512_progressive(struct unit_test_state *uts)
+{
+	static const char * const algos[] = { "sha384", "sha512" };
+	u8 expect[HASH_MAX_DIGEST_SIZE];
+	u8 output[HASH_MAX_DIGEST_SIZE];
+	struct hash_algo *algo;
+	unsigned int pos, len;
+	void *ctx;
+	u8 *buf;
+	int i;
+
+	buf = malloc(TEST_SHA512_BUF_SIZE);
+	ut_assertnonnull(buf);
+	for (pos = 0; pos < TEST_SHA512_BUF_SIZE; pos++)
+		buf[pos] = rand() & 0xff;
+
+	for (i = 0; i < ARRAY_SIZE(algos); i++) {
+		ut_assertok(hash_progressive_lookup_algo(algos[i], &algo));
+		algo->hash_func_ws(buf, TEST_SHA512_BUF_SIZE, expect,
+				   algo->chunk_size);
+
+		ut_assertok(algo->hash_init(algo, &ctx));
+		for (pos = 0, len = 1; pos < TEST_SHA512_BUF_SIZE;
+		     pos += len, len = len * 3 + 1) {
+			len = min(len, TEST_SHA512_BUF_SIZE - pos);
+			ut_assertok(algo->hash_update(algo, ctx, buf + pos, len,
+						      pos + len ==
+						      TEST_SHA512_BUF_SIZE));
+		}
+		ut_assertok(algo->hash_finish(algo, ctx, output,
+					      sizeof(output)));
+		ut_asserteq_mem(expect, output, algo->digest_size);
+	}
+	free(buf);
+
+	return 0;
+}
+
+LIB_TEST(lib_test_sha512_progressive, 0);
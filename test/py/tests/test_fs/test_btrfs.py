@@ -0,0 +1,113 @@
+# SPDX-License-Identifier:      GPL-2.0+
+#
+# U-Boot File System: BTRFS Test
+
+"""
+This test verifies reads from a compressed BTRFS image and checks that the
+tree node and extent caches are used.
+"""
+
+import hashlib
+import os
+import pytest
+import re
+from subprocess import call, check_call, CalledProcessError
+
+def tool_is_in_path(tool):
+    for path in os.environ['PATH'].split(os.pathsep):
+        if os.access(os.path.join(path, tool), os.X_OK):
+            return True
+    return False
+
+def md5(data):
+    return hashlib.md5(data).hexdigest()
+
+@pytest.yield_fixture()
+def btrfs_obj(u_boot_config):
+    """Build a zlib compressed BTRFS image holding a partly rewritten file
+
+    A 4 KiB block is rewritten in the middle of a compressed extent, so the
+    file refers to that extent twice: once before and once after the block.
+
+    Return:
+        Tuple of the image path and the file contents
+    """
+    if not tool_is_in_path('mkfs.btrfs'):
+        pytest.skip('mkfs.btrfs not found')
+
+    base = u_boot_config.persistent_data_dir
+    fs_img = os.path.join(base, 'btrfs.img')
+    mount_dir = os.path.join(base, 'btrfs.mnt')
+    mounted = False
+    data = b''.join(b'btrfs %08d\n' % i for i in range(70000))
+    data = bytearray(data)
+    try:
+        check_call('rm -f %s' % fs_img, shell=True)
+        check_call('truncate -s 256M %s' % fs_img, shell=True)
+        check_call('mkfs.btrfs -f %s' % fs_img, shell=True)
+        check_call('mkdir -p %s' % mount_dir, shell=True)
+        check_call('sudo mount -o loop,rw,compress=zlib %s %s'
+                   % (fs_img, mount_dir), shell=True)
+        mounted = True
+        check_call('sudo chmod a+rw %s' % mount_dir, shell=True)
+
+        with open(os.path.join(mount_dir, 'big'), 'wb') as fd:
+            fd.write(data)
+            fd.flush()
+            os.fsync(fd.fileno())
+        block = os.urandom(4096)
+        with open(os.path.join(mount_dir, 'big'), 'r+b') as fd:
+            fd.seek(200 * 1024)
+            fd.write(block)
+            fd.flush()
+            os.fsync(fd.fileno())
+        data[200 * 1024:204 * 1024] = block
+    except CalledProcessError:
+        pytest.skip('Setup failed for filesystem: btrfs')
+        return
+    finally:
+        if mounted:
+            call('sudo umount %s' % mount_dir, shell=True)
+        call('rmdir %s' % mount_dir, shell=True)
+
+    yield fs_img, bytes(data)
+    call('rm -f %s' % fs_img, shell=True)
+
+def cache_hits(u_boot_console, name):
+    """Return the number of hits of a BTRFS cache in the last access"""
+    output = u_boot_console.run_command('btrcache')
+    m = re.search('%s cache: (\\d+) entries, (\\d+) hits' % name, output)
+    assert m
+    return int(m.group(1)), int(m.group(2))
+
+@pytest.mark.boardspec('sandbox')
+@pytest.mark.buildconfigspec('cmd_btrfs')
+class TestFsBtrfs(object):
+    def test_btrfs_load(self, u_boot_console, btrfs_obj):
+        """Test Case 1 - load a file repeatedly and check the caches"""
+        fs_img, data = btrfs_obj
+        u_boot_console.run_command('host bind 0 %s' % fs_img)
+        for i in range(2):
+            output = u_boot_console.run_command_list([
+                'load host 0 1000000 /big',
+                'md5sum 1000000 %x' % len(data)])
+            assert md5(data) in ''.join(output)
+
+            # Lookups for each extent start again at the root node
+            entries, hits = cache_hits(u_boot_console, 'tree node')
+            assert not entries or hits
+
+            # The extent around the rewritten block is decompressed once
+            entries, hits = cache_hits(u_boot_console, 'extent')
+            assert not entries or hits
+
+    def test_btrfs_load_partial(self, u_boot_console, btrfs_obj):
+        """Test Case 2 - load parts of a file around the rewritten block"""
+        fs_img, data = btrfs_obj
+        u_boot_console.run_command('host bind 0 %s' % fs_img)
+        for pos, length in ((1, 1000), (130000, 80000), (199 * 1024, 8192),
+                            (204 * 1024, 10), (len(data) - 10, 10)):
+            output = u_boot_console.run_command_list([
+                'load host 0 1000000 /big %x %x' % (length, pos),
+                'md5sum 1000000 %x' % length])
+            assert md5(data[pos:pos + length]) in ''.join(output)
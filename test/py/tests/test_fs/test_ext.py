@@ -317,3 +317,38 @@ class TestFsExt(object):
             assert('FILE0123456789_79' in output)
 
             assert_fs_integrity(fs_type, fs_img)
+
+    def test_fs_ext12(self, u_boot_console, fs_obj_ext):
+        """
+        Test Case 12 - write a large file into fragmented free space
+        """
+        fs_type,fs_img,md5val = fs_obj_ext
+        with u_boot_console.log.section('Test Case 12 - write fragmented'):
+            # Test Case 12a - Leave holes of free clusters behind
+            output = u_boot_console.run_command(
+                'host bind 0 %s' % fs_img)
+            for i in range(0, 8):
+                output = u_boot_console.run_command(
+                    '%swrite host 0:0 %x /dir1/FRAG_%02x 10000'
+                    % (fs_type, ADDR, i))
+            for i in range(0, 8, 2):
+                output = u_boot_console.run_command(
+                    '%srm host 0:0 /dir1/FRAG_%02x' % (fs_type, i))
+
+            # Test Case 12b - Write a file larger than any hole
+            output = u_boot_console.run_command_list([
+                'mw.b %x a5 %x' % (ADDR, LENGTH),
+                '%swrite host 0:0 %x /dir1/%s.w12 %x'
+                    % (fs_type, ADDR, MIN_FILE, LENGTH),
+                'md5sum %x %x' % (ADDR, LENGTH)])
+            assert('%d bytes written' % LENGTH in ''.join(output))
+            md5 = re.search('==> ([0-9a-f]+)', ''.join(output)).group(1)
+
+            # Test Case 12c - Check md5 of file content
+            output = u_boot_console.run_command_list([
+                'mw.b %x 00 100' % ADDR,
+                '%sload host 0:0 %x /dir1/%s.w12' % (fs_type, ADDR, MIN_FILE),
+                'md5sum %x $filesize' % ADDR,
+                'setenv filesize'])
+            assert(md5 in ''.join(output))
+            assert_fs_integrity(fs_type, fs_img)
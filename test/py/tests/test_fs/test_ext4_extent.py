@@ -0,0 +1,143 @@
+# SPDX-License-Identifier:      GPL-2.0+
+#
+# U-Boot File System: ext4 Extent Write Test
+
+"""
+This test verifies that files written to ext4 are mapped with extents,
+using an extent tree of depth 1 for a file written into fragmented free
+space and a single extent for a run crossing a block group boundary.
+"""
+
+import hashlib
+import os
+import pytest
+import re
+from subprocess import call, check_call, check_output, CalledProcessError
+from fstest_defs import *
+from fstest_helpers import assert_fs_integrity
+
+# 1 KiB blocks in groups of 2 MiB, so that short files cross groups
+BLOCK_SIZE = 1024
+BLOCKS_PER_GROUP = 2048
+FIRST_DATA_BLOCK = 1
+
+def tool_is_in_path(tool):
+    for path in os.environ['PATH'].split(os.pathsep):
+        if os.access(os.path.join(path, tool), os.X_OK):
+            return True
+    return False
+
+def md5(data):
+    return hashlib.md5(data).hexdigest()
+
+@pytest.yield_fixture(scope='module')
+def ext4_obj(u_boot_config):
+    """Build a small ext4 image whose first free blocks are fragmented
+
+    The image is populated with 64 files of one block each, then every
+    other one is deleted, which leaves 32 single free blocks. Only group 0
+    holds bitmaps and inode tables, and group 1 the single backup
+    superblock, so that most group boundaries fall within free space.
+
+    Return:
+        Path of the image
+    """
+    for tool in ('mkfs.ext4', 'debugfs'):
+        if not tool_is_in_path(tool):
+            pytest.skip('%s not found' % tool)
+    if not u_boot_config.buildconfig.get('config_ext4_write'):
+        pytest.skip('.config feature "EXT4_WRITE" not enabled')
+
+    base = u_boot_config.persistent_data_dir
+    src = os.path.join(base, 'ext4ext.src')
+    fs_img = os.path.join(base, 'ext4ext.img')
+    cmds = os.path.join(base, 'ext4ext.cmds')
+    try:
+        check_call('rm -rf %s %s' % (src, fs_img), shell=True)
+        os.makedirs(src)
+        for i in range(64):
+            with open(os.path.join(src, 'f%02d' % i), 'wb') as fd:
+                fd.write(os.urandom(1000))
+        check_call('mkfs.ext4 -q -b %d -g %d -N 256 '
+                   '-O ^metadata_csum,^resize_inode,sparse_super2 -d %s %s 16M'
+                   % (BLOCK_SIZE, BLOCKS_PER_GROUP, src, fs_img), shell=True)
+        with open(cmds, 'w') as fd:
+            for i in range(1, 64, 2):
+                fd.write('rm /f%02d\n' % i)
+        check_call('debugfs -w -f %s %s' % (cmds, fs_img), shell=True)
+    except CalledProcessError:
+        call('rm -f %s' % fs_img, shell=True)
+        pytest.skip('Setup failed for filesystem: ext4')
+        return
+    finally:
+        call('rm -rf %s %s' % (src, cmds), shell=True)
+
+    yield fs_img
+    call('rm -f %s' % fs_img, shell=True)
+
+def get_extents(fs_img, name):
+    """Read the extent tree of a file with debugfs
+
+    Return:
+        Tuple of the depth of the tree and a list of (first, last) physical
+        blocks of the extents
+    """
+    output = check_output('debugfs -R "dump_extents /%s" %s' % (name, fs_img),
+                          shell=True).decode()
+    depth = 0
+    extents = []
+    for line in output.splitlines():
+        m = re.match(r'\s*\d+/\s*(\d+)\s+\d+/\s*\d+\s+\d+ -\s+\d+\s+'
+                     r'(\d+) -\s+(\d+)\s+\d+', line)
+        if m:
+            depth = int(m.group(1))
+            extents.append((int(m.group(2)), int(m.group(3))))
+    return depth, extents
+
+def write_and_check(u_boot_console, fs_img, name, data):
+    """Write a file with ext4write, then read it back and check it"""
+    src = os.path.join(u_boot_console.config.persistent_data_dir, name)
+    with open(src, 'wb') as fd:
+        fd.write(data)
+
+    output = u_boot_console.run_command_list([
+        'host bind 0 %s' % fs_img,
+        'host load hostfs - %x %s' % (ADDR, src),
+        'ext4write host 0 %x /%s %x' % (ADDR, name, len(data))])
+    assert '%d bytes written' % len(data) in ''.join(output)
+    os.remove(src)
+
+    output = u_boot_console.run_command_list([
+        'mw.b %x 00 %x' % (ADDR, len(data)),
+        'ext4load host 0 %x /%s' % (ADDR, name),
+        'md5sum %x %x' % (ADDR, len(data))])
+    assert md5(data) in ''.join(output)
+    assert_fs_integrity('ext4', fs_img)
+
+@pytest.mark.boardspec('sandbox')
+@pytest.mark.buildconfigspec('cmd_ext4_write')
+class TestFsExt4Extent(object):
+    def test_ext4_extent_depth1(self, u_boot_console, ext4_obj):
+        """Test Case 1 - write a file into fragmented free space"""
+        data = os.urandom(40 * BLOCK_SIZE)
+        write_and_check(u_boot_console, ext4_obj, 'frag', data)
+
+        # The single free blocks give more extents than fit in the inode
+        depth, extents = get_extents(ext4_obj, 'frag')
+        assert depth == 1
+        assert len(extents) > 4
+        assert sum(last - first + 1 for first, last in extents) == 40
+
+    def test_ext4_extent_group_boundary(self, u_boot_console, ext4_obj):
+        """Test Case 2 - write a run of blocks across group boundaries"""
+        data = os.urandom(6 * 1024 * 1024 + 123)
+        write_and_check(u_boot_console, ext4_obj, 'big', data)
+
+        # Runs which continue across a group boundary share an extent
+        depth, extents = get_extents(ext4_obj, 'big')
+        groups = [((first - FIRST_DATA_BLOCK) // BLOCKS_PER_GROUP,
+                   (last - FIRST_DATA_BLOCK) // BLOCKS_PER_GROUP)
+                  for first, last in extents]
+        assert any(start != end for start, end in groups)
+        assert sum(last - first + 1 for first, last in extents) == \
+            (len(data) + BLOCK_SIZE - 1) // BLOCK_SIZE
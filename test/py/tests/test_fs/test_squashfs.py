@@ -0,0 +1,119 @@
+# SPDX-License-Identifier:      GPL-2.0+
+#
+# U-Boot File System: SquashFS Test
+
+"""
+This test verifies read access to SquashFS images through the generic
+filesystem commands, for each supported compression type.
+"""
+
+import hashlib
+import os
+import pytest
+import re
+from subprocess import check_call
+
+def tool_is_in_path(tool):
+    for path in os.environ['PATH'].split(os.pathsep):
+        if os.access(os.path.join(path, tool), os.X_OK):
+            return True
+    return False
+
+def md5(data):
+    return hashlib.md5(data).hexdigest()
+
+@pytest.fixture(params=['gzip', 'lz4', 'zstd'])
+def sqfs_obj(request, u_boot_config):
+    """Build a SquashFS image with large, small and tail-only files
+
+    Return:
+        Tuple of the image path and a dict of file contents
+    """
+    comp = request.param
+    if not tool_is_in_path('mksquashfs'):
+        pytest.skip('mksquashfs not found')
+    option = {'gzip': 'fs_squashfs', 'lz4': 'squashfs_lz4',
+              'zstd': 'squashfs_zstd'}[comp]
+    if not u_boot_config.buildconfig.get('config_%s' % option):
+        pytest.skip('.config feature "%s" not enabled' % option.upper())
+
+    base = u_boot_config.persistent_data_dir
+    src = os.path.join(base, 'sqfs.src')
+    fs_img = os.path.join(base, 'sqfs.%s.img' % comp)
+    check_call('rm -rf %s %s' % (src, fs_img), shell=True)
+    os.makedirs(os.path.join(src, 'dir', 'sub'))
+    os.makedirs(os.path.join(src, 'many'))
+
+    files = {}
+    # Several data blocks, a compressible and an incompressible part
+    files['big'] = b'squashfs\n' * 40000 + os.urandom(300000)
+    # Tails of small files are packed into shared fragment blocks
+    for i in range(20):
+        files['dir/small%02d' % i] = os.urandom(100 + i * 37)
+    files['dir/sub/deep'] = b'deep\n'
+    # Large enough for the directory to get an index
+    for i in range(600):
+        files['many/f%04d' % i] = b'%d\n' % i
+    for name, data in files.items():
+        with open(os.path.join(src, name), 'wb') as fd:
+            fd.write(data)
+    os.symlink('dir/sub/deep', os.path.join(src, 'link'))
+    os.symlink('../big', os.path.join(src, 'dir', 'uplink'))
+
+    check_call('mksquashfs %s %s -comp %s -noappend -all-root'
+               % (src, fs_img, comp), shell=True)
+    return fs_img, files
+
+@pytest.mark.boardspec('sandbox')
+@pytest.mark.buildconfigspec('fs_squashfs')
+class TestFsSquashfs(object):
+    def test_sqfs_ls(self, u_boot_console, sqfs_obj):
+        """Test Case 1 - ls of the root and of a large directory"""
+        fs_img, files = sqfs_obj
+        output = u_boot_console.run_command_list([
+            'host bind 0 %s' % fs_img,
+            'ls host 0'])
+        out = ''.join(output)
+        assert re.search('%d *big' % len(files['big']), out)
+        assert re.search('dir/', out)
+        assert re.search('12 *link', out)
+        output = u_boot_console.run_command('ls host 0 /many')
+        assert '600 file(s), 0 dir(s)' in output
+        output = u_boot_console.run_command('ls host 0 /nonexistent')
+        assert 'file(s)' not in output
+
+    def test_sqfs_size(self, u_boot_console, sqfs_obj):
+        """Test Case 2 - size of files, through symbolic links and '..'"""
+        fs_img, files = sqfs_obj
+        u_boot_console.run_command('host bind 0 %s' % fs_img)
+        for path, name in (('/big', 'big'), ('/dir/uplink', 'big'),
+                           ('/link', 'dir/sub/deep'),
+                           ('/dir/sub/../small05', 'dir/small05'),
+                           ('/many/f0599', 'many/f0599')):
+            output = u_boot_console.run_command_list([
+                'size host 0 %s' % path,
+                'printenv filesize'])
+            assert 'filesize=%x' % len(files[name]) in ''.join(output)
+
+    def test_sqfs_load(self, u_boot_console, sqfs_obj):
+        """Test Case 3 - load whole files, stored in blocks and fragments"""
+        fs_img, files = sqfs_obj
+        u_boot_console.run_command('host bind 0 %s' % fs_img)
+        for name in ('big', 'dir/small00', 'dir/small19', 'dir/sub/deep',
+                     'many/f0300'):
+            output = u_boot_console.run_command_list([
+                'load host 0 1000000 /%s' % name,
+                'md5sum 1000000 %x' % len(files[name])])
+            assert md5(files[name]) in ''.join(output)
+
+    def test_sqfs_load_partial(self, u_boot_console, sqfs_obj):
+        """Test Case 4 - load part of a file, starting inside a block"""
+        fs_img, files = sqfs_obj
+        u_boot_console.run_command('host bind 0 %s' % fs_img)
+        data = files['big']
+        for pos, length in ((1, 1000), (131071, 2), (200000, 150000),
+                            (len(data) - 10, 10)):
+            output = u_boot_console.run_command_list([
+                'load host 0 1000000 /big %x %x' % (length, pos),
+                'md5sum 1000000 %x' % length])
+            assert md5(data[pos:pos + length]) in ''.join(output)
@@ -0,0 +1,159 @@
+# SPDX-License-Identifier: GPL-2.0+
+
+# Test reading files from a UBIFS volume. The tests load a file whole, which
+# takes the multi-block bulk-read path, load part of it with a size which is
+# not a multiple of the UBIFS block size, and load it from an offset. The data
+# read is checked against CRC32 values from the test configuration.
+
+import binascii
+import pytest
+import u_boot_utils
+
+"""
+This test relies on boardenv_* to contain configuration values which define
+the UBIFS volumes and files to read. For example:
+
+env__ubifs_configs = (
+    {
+        'fixture_id': 'rootfs',
+        # MTD partition holding the UBI device, passed to "ubi part"
+        'mtd_part': 'ubi',
+        # Volume holding the UBIFS file system, passed to "ubifsmount"
+        'volume': 'ubi0:rootfs',
+        # File to read; it should span many 4KiB UBIFS blocks
+        'filename': '/boot/Image',
+        'size': 0x123456,
+        'crc32': '8f6ecf0d',
+        # Leading part of the file, not a multiple of the block size
+        'partial_size': 0x5432,
+        'partial_crc32': '2d6a11c7',
+        # Part of the file at an offset, which must be a multiple of 4KiB
+        'offset': 0x3000,
+        'offset_size': 0x9100,
+        'offset_crc32': '64f1a3b2',
+    },
+)
+"""
+
+def ubifs_mount(u_boot_console, config):
+    """Attach the UBI device and mount the UBIFS volume of a configuration.
+
+    Args:
+        u_boot_console: A U-Boot console connection.
+        config: The UBIFS configuration to use.
+
+    Returns:
+        Nothing.
+    """
+
+    response = u_boot_console.run_command('ubi part %s' % config['mtd_part'])
+    assert 'UBI error' not in response
+    response = u_boot_console.run_command('ubifsmount %s' % config['volume'])
+    assert 'Error' not in response
+
+def ubifs_load_check(u_boot_console, config, size, expected_crc32,
+                     offset=None):
+    """Load part of the test file and check what was read.
+
+    RAM past the end of the load is filled with a pattern first, which must
+    survive the load.
+
+    Args:
+        u_boot_console: A U-Boot console connection.
+        config: The UBIFS configuration to use.
+        size: Number of bytes to load.
+        expected_crc32: CRC32 of the bytes to load.
+        offset: Offset in the file to load from, None to use ubifsload.
+
+    Returns:
+        Nothing.
+    """
+
+    guard = 0x1000
+    ram_base = u_boot_utils.find_ram_base(u_boot_console)
+    addr = '0x%08x' % ram_base
+    guard_crc32 = '%08x' % (binascii.crc32(b'\x5a' * guard) & 0xffffffff)
+
+    u_boot_console.run_command('mw.b %s 0x5a 0x%x' % (addr, size + guard))
+    if offset is None:
+        cmd = 'ubifsload %s %s %x' % (addr, config['filename'], size)
+    else:
+        cmd = 'load ubi 0 %s %s %x %x' % (addr, config['filename'], size,
+                                          offset)
+    response = u_boot_console.run_command(cmd)
+    assert 'Error' not in response
+    assert 'not found' not in response
+
+    assert expected_crc32 == u_boot_utils.crc32(u_boot_console, ram_base,
+                                                size)
+    assert guard_crc32 == u_boot_utils.crc32(u_boot_console,
+                                             ram_base + size, guard)
+
+@pytest.mark.buildconfigspec('cmd_ubifs')
+@pytest.mark.buildconfigspec('cmd_memory')
+@pytest.mark.buildconfigspec('cmd_crc32')
+def test_ubifs_load(u_boot_console, env__ubifs_config):
+    """Test loading a whole file which spans many UBIFS blocks.
+
+    Args:
+        u_boot_console: A U-Boot console connection.
+        env__ubifs_config: The single UBIFS configuration on which to run
+            the test. See the file-level comment above for details of the
+            format.
+
+    Returns:
+        Nothing.
+    """
+
+    ubifs_mount(u_boot_console, env__ubifs_config)
+    ubifs_load_check(u_boot_console, env__ubifs_config,
+                     env__ubifs_config['size'], env__ubifs_config['crc32'])
+    u_boot_console.run_command('ubifsumount')
+
+@pytest.mark.buildconfigspec('cmd_ubifs')
+@pytest.mark.buildconfigspec('cmd_memory')
+@pytest.mark.buildconfigspec('cmd_crc32')
+def test_ubifs_load_unaligned(u_boot_console, env__ubifs_config):
+    """Test loading a part of a file which ends within a UBIFS block.
+
+    Args:
+        u_boot_console: A U-Boot console connection.
+        env__ubifs_config: The single UBIFS configuration on which to run
+            the test. See the file-level comment above for details of the
+            format.
+
+    Returns:
+        Nothing.
+    """
+
+    size = env__ubifs_config['partial_size']
+    assert size % 0x1000, 'partial_size must not be a multiple of 4KiB'
+
+    ubifs_mount(u_boot_console, env__ubifs_config)
+    ubifs_load_check(u_boot_console, env__ubifs_config, size,
+                     env__ubifs_config['partial_crc32'])
+    u_boot_console.run_command('ubifsumount')
+
+@pytest.mark.buildconfigspec('cmd_ubifs')
+@pytest.mark.buildconfigspec('cmd_fs_generic')
+@pytest.mark.buildconfigspec('cmd_memory')
+@pytest.mark.buildconfigspec('cmd_crc32')
+def test_ubifs_load_offset(u_boot_console, env__ubifs_config):
+    """Test loading a part of a file from an offset into it.
+
+    Args:
+        u_boot_console: A U-Boot console connection.
+        env__ubifs_config: The single UBIFS configuration on which to run
+            the test. See the file-level comment above for details of the
+            format.
+
+    Returns:
+        Nothing.
+    """
+
+    ubifs_mount(u_boot_console, env__ubifs_config)
+    ubifs_load_check(u_boot_console, env__ubifs_config,
+                     env__ubifs_config['offset_size'],
+                     env__ubifs_config['offset_crc32'],
+                     env__ubifs_config['offset'])
+    u_boot_console.run_command('ubifsumount')